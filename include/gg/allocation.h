@@ -0,0 +1,126 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "gg/ast.h"
+#include "gg/escape.h"
+#include "gg/unboxing.h"
+
+namespace gg {
+namespace compiler {
+/**
+   One closure allocated by a basic block.
+*/
+struct allocation_site {
+    /**
+       The `ast::binding`, `ast::construct` or `ast::prim_apply` being
+       allocated.
+    */
+    std::shared_ptr<ast::node> node;
+
+    /**
+       The heap check of the block which allocates the closure.
+    */
+    std::size_t check;
+
+    /**
+       The offset of the closure from the heap pointer before its heap
+       check, in words.
+    */
+    std::size_t offset;
+
+    /**
+       The size of the closure in words.
+    */
+    std::size_t words;
+};
+
+/**
+   Everything a basic block allocates. The block does a heap check for each
+   entry of `checks` and then initialises each site at its offset.
+
+   No check asks for more than `runtime::max_block_object_words`, so sites
+   which would not fit in one are split across several. A closure too big
+   for any nursery block gets a check of its own, which allocates it as a
+   large object.
+*/
+struct heap_block {
+    /**
+       The total size of the sites in words.
+    */
+    std::size_t words = 0;
+
+    /**
+       The size in words of each heap check, in the order they are done.
+       Only the first is a safe point; it may be empty, if the block's first
+       closure is too big for a nursery block.
+    */
+    std::vector<std::size_t> checks;
+
+    std::vector<allocation_site> sites;
+};
+
+/**
+   The heap blocks of a program, keyed by the expression which starts each
+   basic block: the body of a lambda or of a case alternative.
+*/
+using allocation_plan = std::unordered_map<const ast::expr*, heap_block>;
+
+/**
+   The closures held in the frame of each case continuation, after its saved
+   variables, keyed by the case. These need no heap check and are freed when
+   the continuation returns.
+*/
+using frame_plan = std::unordered_map<const ast::case_*, heap_block>;
+
+/**
+   @param lam A lambda form.
+   @return    The size in words of a closure for `lam`.
+*/
+std::size_t closure_words(const ast::lambda& lam);
+
+/**
+   @param con A constructor application.
+   @return    The size in words of the value it builds.
+*/
+std::size_t construct_words(const ast::construct& con);
+
+/**
+   The space a primop's fast path needs for its result. `Integer`
+   arithmetic builds its result in the block's heap check when the result
+   is small; the slow path allocates for itself, leaving the space unused.
+
+   @param op A primop.
+   @return   The size in words of its result, or 0 if it allocates nothing
+             inline.
+*/
+std::size_t primop_words(const ast::primop& op);
+
+/**
+   Does a constructor application build a value which already has a
+   shared static closure, so that it allocates nothing? These are the
+   nullary constructors, and constructors of one `int64` field applied to a
+   literal from `runtime::min_shared_value` to `runtime::max_shared_value`.
+
+   @param con     A constructor application.
+   @param layouts The declared constructors.
+*/
+bool is_shared_construct(const ast::construct& con, const constructor_layouts& layouts);
+
+/**
+   Find the allocation done by every basic block of a program.
+
+   @param bindings The top level bindings.
+   @param layouts  The declared constructors.
+   @param stack    The closures to allocate in frames instead of the heap.
+   @param frames   Filled with the closures each frame holds.
+   @return         The heap blocks.
+*/
+allocation_plan plan_allocation(ast::sequence<ast::binding>& bindings,
+                                const constructor_layouts& layouts,
+                                const stack_closures& stack,
+                                frame_plan& frames);
+}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+
+#include "gg/runtime.h"
+#include "gg/stack.h"
+#include "gg/thunk.h"
+
+namespace gg {
+namespace runtime {
+/**
+   A partial application: a function closure applied to fewer arguments
+   than its arity. It is the function followed by the arguments, all
+   pointers, with the info table for its number of arguments from
+   `gg_pap_info`.
+
+   The info tables give an arity of 1 so that a partial application is a
+   value rather than a thunk; applying one to any number of arguments goes
+   through `gg_apply_entry`, which is also its entry code.
+*/
+constexpr std::size_t pap_function_slot = 0;
+
+/**
+   @param info An info table.
+   @return     Whether it is the info table of a partial application.
+*/
+bool is_partial_application(const info_table* info);
+
+/**
+   Entered by a thread which applied something other than a function, such
+   as a constructor, to arguments.
+*/
+extern error_closure not_a_function_closure;
+
+/**
+   Entered by a thread which partially applied a function to raw
+   arguments, or to so many that the arguments saved in a partial
+   application and the new ones do not fit in one frame.
+*/
+extern error_closure bad_application_closure;
+}
+}
+
+extern "C" {
+/**
+   Apply `registers::node` to the arguments in the frame on top of the
+   stack. This is both the entry code and the return code of argument
+   frames, so a thunk being applied is evaluated first and its value
+   returns here.
+
+   A function given exactly its arity is entered with the frame as it is.
+   One given more arguments is entered with the first of them and its
+   result is applied to the rest. One given fewer is returned as a partial
+   application, which is unpacked in front of the arguments when it is
+   applied in turn.
+
+   Generated code uses this for calls of unknown functions:
+
+       push [gg_apply_frames[n], arg1, ..., argn];
+       node = f;
+       next = f->info->arity == n ? f->info->entry_code : gg_apply_entry;
+*/
+void gg_apply_entry();
+
+/**
+   The info table of the argument frame of each size, for arguments which
+   are all pointers.
+*/
+extern const std::array<gg::runtime::info_table, gg::runtime::max_frame_words + 1>
+    gg_apply_frames;
+
+/**
+   The info table of the partial applications of each number of arguments.
+*/
+extern const std::array<gg::runtime::info_table, gg::runtime::max_frame_words + 1>
+    gg_pap_info;
+}
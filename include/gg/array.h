@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "gg/runtime.h"
+
+namespace gg {
+namespace runtime {
+/**
+   A `ByteArray#` or `MutableByteArray#`: raw bytes which the collector
+   never looks inside. The two only differ in their info table; freezing a
+   mutable array just changes it.
+*/
+struct byte_array {
+    const info_table* info;
+
+    /**
+       The size of `data` in bytes.
+    */
+    std::size_t bytes;
+
+    word data[];
+};
+
+/**
+   An `Array#` or `MutableArray#` of closure pointers.
+
+   Writing to a mutable array in the old generation puts it in the
+   remembered set, so the next minor collection scavenges all of it.
+*/
+struct array {
+    const info_table* info;
+
+    /**
+       The number of elements.
+    */
+    std::size_t size;
+
+    closure* elems[];
+};
+
+/**
+   The words before the contents of a `byte_array` or `array`.
+*/
+constexpr std::size_t array_header_words = 2;
+
+inline std::size_t byte_array_words(std::size_t bytes) {
+    return array_header_words + (bytes + sizeof(word) - 1) / sizeof(word);
+}
+
+inline std::size_t array_words(std::size_t size) {
+    return array_header_words + size;
+}
+
+extern const info_table byte_array_info;
+extern const info_table mutable_byte_array_info;
+extern const info_table array_info;
+extern const info_table mutable_array_info;
+}
+}
+
+/**
+   Array primops which are not compiled inline. Offsets and sizes of byte
+   arrays are in bytes except where noted; ranges are not bounds checked.
+*/
+extern "C" {
+/**
+   `newByteArray# {bytes}`
+
+   @return A new mutable byte array with uninitialised contents.
+*/
+gg::runtime::closure* gg_new_byte_array(std::int64_t bytes);
+
+/**
+   `newArray# {size, init}`
+
+   @return A new mutable array with every element set to `init`.
+*/
+gg::runtime::closure* gg_new_array(std::int64_t size, gg::runtime::closure* init);
+
+/**
+   `unsafeFreezeByteArray# {a}` and `unsafeFreezeArray# {a}`: the array may
+   not be written to again.
+
+   @return The same array.
+*/
+gg::runtime::closure* gg_unsafe_freeze(gg::runtime::closure* a);
+
+/**
+   `writeArray# {a, i, v}`
+*/
+void gg_write_array(gg::runtime::closure* a, std::int64_t i, gg::runtime::closure* v);
+
+/**
+   `copyByteArray# {src, src_offset, dst, dst_offset, bytes}`. The ranges
+   may overlap.
+*/
+void gg_copy_byte_array(gg::runtime::closure* src,
+                        std::int64_t src_offset,
+                        gg::runtime::closure* dst,
+                        std::int64_t dst_offset,
+                        std::int64_t bytes);
+
+/**
+   `setByteArray# {a, offset, bytes, value}`: set each byte in the range to
+   the low byte of `value`.
+*/
+void gg_set_byte_array(gg::runtime::closure* a,
+                       std::int64_t offset,
+                       std::int64_t bytes,
+                       std::int64_t value);
+
+/**
+   `compareByteArrays# {a, a_offset, b, b_offset, bytes}`
+
+   @return Less than, equal to or greater than 0 as the range of `a` orders
+           before, the same as or after the range of `b`.
+*/
+std::int64_t gg_compare_byte_arrays(gg::runtime::closure* a,
+                                    std::int64_t a_offset,
+                                    gg::runtime::closure* b,
+                                    std::int64_t b_offset,
+                                    std::int64_t bytes);
+
+/**
+   `sumIntArray# {a, offset, count}`, where the offset and count are in
+   elements. Overflow wraps.
+*/
+std::int64_t gg_sum_int_array(gg::runtime::closure* a,
+                              std::int64_t offset,
+                              std::int64_t count);
+
+/**
+   `sumDoubleArray# {a, offset, count}`, where the offset and count are in
+   elements. The additions are reassociated, so the result may differ from
+   a sequential sum in the last bits.
+*/
+double gg_sum_double_array(gg::runtime::closure* a,
+                           std::int64_t offset,
+                           std::int64_t count);
+
+/**
+   `copyArray# {src, src_offset, dst, dst_offset, count}`. The ranges may
+   overlap.
+*/
+void gg_copy_array(gg::runtime::closure* src,
+                   std::int64_t src_offset,
+                   gg::runtime::closure* dst,
+                   std::int64_t dst_offset,
+                   std::int64_t count);
+}
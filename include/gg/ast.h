@@ -251,9 +251,17 @@ public:
                                  std::size_t depth = 0) const;
 };
 
+/**
+   The value of an `Integer` literal such as `123I#`: its decimal digits,
+   with a leading `-` if it is negative. It is not limited to 64 bits.
+*/
+struct integer_digits {
+    std::string digits;
+};
+
 class literal : public atom {
 public:
-    std::variant<std::int64_t, double> value;
+    std::variant<std::int64_t, double, integer_digits> value;
 
     template<typename T>
     literal(const location& loc, T value) : atom(loc), value(value) {}
@@ -321,6 +329,54 @@ enum class primopcode {
     GT,
     INVERT,
     NEGATE,
+    FORK,
+    YIELD,
+    NEW_MVAR,
+    TAKE_MVAR,
+    PUT_MVAR,
+    ADD_DOUBLE,
+    SUB_DOUBLE,
+    MUL_DOUBLE,
+    DIV_DOUBLE,
+    POW_DOUBLE,
+    LT_DOUBLE,
+    LE_DOUBLE,
+    EQ_DOUBLE,
+    NE_DOUBLE,
+    GE_DOUBLE,
+    GT_DOUBLE,
+    NEGATE_DOUBLE,
+    SQRT_DOUBLE,
+    INT_TO_DOUBLE,
+    DOUBLE_TO_INT,
+    NEW_BYTE_ARRAY,
+    SIZEOF_BYTE_ARRAY,
+    INDEX_INT_ARRAY,
+    INDEX_DOUBLE_ARRAY,
+    READ_INT_ARRAY,
+    READ_DOUBLE_ARRAY,
+    WRITE_INT_ARRAY,
+    WRITE_DOUBLE_ARRAY,
+    COPY_BYTE_ARRAY,
+    SET_BYTE_ARRAY,
+    COMPARE_BYTE_ARRAYS,
+    SUM_INT_ARRAY,
+    SUM_DOUBLE_ARRAY,
+    UNSAFE_FREEZE_BYTE_ARRAY,
+    NEW_ARRAY,
+    SIZEOF_ARRAY,
+    INDEX_ARRAY,
+    READ_ARRAY,
+    WRITE_ARRAY,
+    COPY_ARRAY,
+    UNSAFE_FREEZE_ARRAY,
+    PLUS_INTEGER,
+    MINUS_INTEGER,
+    TIMES_INTEGER,
+    NEGATE_INTEGER,
+    COMPARE_INTEGER,
+    INT_TO_INTEGER,
+    INTEGER_TO_INT,
 };
 
 /**
@@ -357,8 +413,67 @@ public:
        The arity of the primitive operation.
     */
     inline std::size_t arity() const {
-        return (opcode != primopcode::INVERT &&
-                opcode != primopcode::NEGATE) + 1;
+        switch (opcode) {
+        case primopcode::YIELD:
+        case primopcode::NEW_MVAR:
+            return 0;
+        case primopcode::INVERT:
+        case primopcode::NEGATE:
+        case primopcode::FORK:
+        case primopcode::TAKE_MVAR:
+        case primopcode::NEGATE_DOUBLE:
+        case primopcode::SQRT_DOUBLE:
+        case primopcode::INT_TO_DOUBLE:
+        case primopcode::DOUBLE_TO_INT:
+        case primopcode::NEW_BYTE_ARRAY:
+        case primopcode::SIZEOF_BYTE_ARRAY:
+        case primopcode::UNSAFE_FREEZE_BYTE_ARRAY:
+        case primopcode::SIZEOF_ARRAY:
+        case primopcode::UNSAFE_FREEZE_ARRAY:
+        case primopcode::NEGATE_INTEGER:
+        case primopcode::INT_TO_INTEGER:
+        case primopcode::INTEGER_TO_INT:
+            return 1;
+        case primopcode::WRITE_INT_ARRAY:
+        case primopcode::WRITE_DOUBLE_ARRAY:
+        case primopcode::SUM_INT_ARRAY:
+        case primopcode::SUM_DOUBLE_ARRAY:
+        case primopcode::WRITE_ARRAY:
+            return 3;
+        case primopcode::SET_BYTE_ARRAY:
+            return 4;
+        case primopcode::COPY_BYTE_ARRAY:
+        case primopcode::COMPARE_BYTE_ARRAYS:
+        case primopcode::COPY_ARRAY:
+            return 5;
+        default:
+            return 2;
+        }
+    }
+
+    /**
+       Does the operation return a pointer to a heap object rather than a
+       raw value?
+    */
+    inline bool returns_closure() const {
+        switch (opcode) {
+        case primopcode::NEW_MVAR:
+        case primopcode::TAKE_MVAR:
+        case primopcode::NEW_BYTE_ARRAY:
+        case primopcode::UNSAFE_FREEZE_BYTE_ARRAY:
+        case primopcode::NEW_ARRAY:
+        case primopcode::INDEX_ARRAY:
+        case primopcode::READ_ARRAY:
+        case primopcode::UNSAFE_FREEZE_ARRAY:
+        case primopcode::PLUS_INTEGER:
+        case primopcode::MINUS_INTEGER:
+        case primopcode::TIMES_INTEGER:
+        case primopcode::NEGATE_INTEGER:
+        case primopcode::INT_TO_INTEGER:
+            return true;
+        default:
+            return false;
+        }
     }
 
     virtual std::ostream& format(std::ostream& s,
@@ -727,6 +842,96 @@ public:
 
     virtual std::vector<std::shared_ptr<node>> children();
 };
+
+/**
+   What a constructor field holds.
+*/
+enum class field_kind {
+    /**
+       A pointer to a closure, which may be unevaluated.
+    */
+    boxed,
+
+    /**
+       A strict, unboxed `int64_t` stored inline.
+    */
+    int64,
+
+    /**
+       A strict, unboxed `double` stored inline.
+    */
+    float64,
+};
+
+/**
+   A field of a data declaration.
+*/
+class field : public node {
+public:
+    field_kind kind;
+
+    /**
+       @param loc  The location of this node.
+       @param kind What the field holds.
+    */
+    field(const location& loc, field_kind kind);
+
+    virtual ~field() = default;
+
+    virtual std::ostream& format(std::ostream& s,
+                                 std::size_t depth = 0) const;
+};
+
+/**
+   Declare the fields of a constructor. Constructors which are not declared
+   have only boxed fields.
+*/
+class data_declaration : public node {
+public:
+    std::shared_ptr<constructor> con;
+    std::shared_ptr<sequence<field>> fields;
+
+    /**
+       @param loc    The location of this node.
+       @param con    The constructor being declared.
+       @param fields The fields of the constructor, in order.
+    */
+    data_declaration(const location& loc,
+                     const std::shared_ptr<constructor>& con,
+                     const std::shared_ptr<sequence<field>>& fields);
+
+    virtual ~data_declaration() = default;
+
+    virtual std::ostream& format(std::ostream& s,
+                                 std::size_t depth = 0) const;
+
+    virtual std::vector<std::shared_ptr<node>> children();
+};
+
+/**
+   A whole program: the data declarations and the top level bindings.
+*/
+class program : public node {
+public:
+    std::shared_ptr<sequence<data_declaration>> declarations;
+    std::shared_ptr<sequence<binding>> bindings;
+
+    /**
+       @param loc          The location of this node.
+       @param declarations The data declarations.
+       @param bindings     The top level bindings.
+    */
+    program(const location& loc,
+            const std::shared_ptr<sequence<data_declaration>>& declarations,
+            const std::shared_ptr<sequence<binding>>& bindings);
+
+    virtual ~program() = default;
+
+    virtual std::ostream& format(std::ostream& s,
+                                 std::size_t depth = 0) const;
+
+    virtual std::vector<std::shared_ptr<node>> children();
+};
 }
 }
 
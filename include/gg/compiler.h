@@ -1,38 +1,576 @@
 #pragma once
 
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include <libgccjit++.h>
 
+#include "gg/allocation.h"
 #include "gg/ast.h"
+#include "gg/let_floating.h"
+#include "gg/references.h"
+#include "gg/runtime.h"
 #include "gg/scoped_map.h"
+#include "gg/selectors.h"
+#include "gg/unboxing.h"
 
 namespace gg {
 namespace compiler {
+/**
+   Exception raised when a primitive operation cannot be lowered to a
+   value.
+*/
+struct bad_primop : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_primop(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+/**
+   What a batch compiled by a `session` can use from the batches before it.
+*/
+struct linkage {
+    /**
+       The static closure of each earlier top level binding.
+    */
+    std::unordered_map<std::string, void*> closures;
+
+    /**
+       The earlier top level bindings which are, or refer to, a CAF.
+    */
+    std::unordered_set<std::string> cafs;
+
+    /**
+       The info table of each constructor declared or used by an earlier
+       batch which has not been declared again since.
+    */
+    std::unordered_map<std::string, void*> constructors;
+
+    /**
+       The number of constructor tags handed out so far.
+    */
+    std::size_t tags = 0;
+};
+
+/**
+   Exception raised when a program cannot be compiled, either because it
+   uses a value as something it is not or because gccjit fails.
+*/
+struct bad_compile : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_compile(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+struct function_compiler;
 
 struct context {
 private:
+    friend struct session;
+    friend struct function_compiler;
+
     gccjit::context ctx;
     gccjit::type continuation_type;
+    gccjit::type evacuator_type;
+    gccjit::type scavenger_type;
+    gccjit::type word_type;
     gccjit::struct_ info_table_type;
     gccjit::struct_ closure_type;
+    gccjit::struct_ registers_type;
+    gccjit::field entry_code_field;
+    gccjit::field arity_field;
+    gccjit::field layout_field;
+    gccjit::field info_field;
+    gccjit::field payload_field;
+    gccjit::field next_field;
+    gccjit::field node_field;
+    gccjit::field sp_field;
+    gccjit::field sp_limit_field;
+    gccjit::field hp_field;
+    gccjit::field hp_limit_field;
+
+    /**
+       `gg_base`, the thread local pointer to the registers, and the
+       runtime entry points behind heap checks.
+    */
+    gccjit::lvalue base;
+    gccjit::function heap_overflow;
+    gccjit::function allocate;
+
+    /**
+       The runtime entry points generated code calls to grow the stack,
+       enter thunks and CAFs, and give up on a case.
+    */
+    gccjit::function grow_stack;
+    gccjit::function enter_thunk;
+    gccjit::function enter_caf;
+    gccjit::function match_failure;
+
+    /**
+       `gg_apply_entry`, the code behind calls of unknown functions, and
+       `gg_apply_frames`, the info tables of its argument frames.
+    */
+    gccjit::function apply_entry;
+    gccjit::lvalue apply_frames;
+
+    /**
+       The runtime's primop entry points, by name.
+    */
+    std::unordered_map<std::string, gccjit::function> runtime_primops;
+
+    /**
+       The runtime's `Integer` info tables, which the fast paths test for
+       and static literals point at.
+    */
+    gccjit::lvalue small_integer_info;
+    gccjit::lvalue big_integer_info;
+
+    /**
+       `gg_small_integers`, the runtime's shared small `Integer`s, and the
+       type of them and of every other static closure of one raw word.
+    */
+    gccjit::lvalue small_integers;
+    gccjit::struct_ boxed_word_type;
+
+    /**
+       `gg_selector_info`, the runtime's selector thunk info tables.
+    */
+    gccjit::lvalue selector_infos;
+
+    /**
+       The static object of each `Integer` literal, by its digits.
+    */
+    std::unordered_map<std::string, gccjit::lvalue> integer_literals;
+
+    /**
+       `gg_int_pow`, the generated integer power function behind `**#`.
+    */
+    gccjit::function int_pow;
 
     std::shared_ptr<ast::sequence<ast::binding>> bindings;
+    constructor_layouts layouts;
+    raw_parameters workers;
+
+    /**
+       The earlier batches when compiling for a `session`, otherwise
+       `nullptr`; and the names of their top level bindings.
+    */
+    const linkage* linked = nullptr;
+    std::unordered_set<std::string> externs;
+
+    /**
+       Batches export their static closures and constructor info tables so
+       that the session can find them in the result.
+    */
+    gcc_jit_global_kind global_kind = GCC_JIT_GLOBAL_INTERNAL;
+    pointer_fields closure_pointers;
+    allocation_plan heap_blocks;
+    frame_plan frame_closures;
+    srt_map srts;
+    selector_map selectors;
+
+    /**
+       A top level binding, which is always a static closure.
+    */
+    struct static_closure {
+        gccjit::struct_ type;
+        gccjit::lvalue global;
+
+        /**
+           The info table and entry code of the binding. These are not used
+           by static constructors, which point at the constructor's info
+           table instead.
+        */
+        gccjit::lvalue info;
+        gccjit::function entry;
+
+        /**
+           The static reference table shared by every info table of the
+           binding's code, as a `void*`.
+        */
+        gccjit::rvalue srt;
+    };
+    std::unordered_map<std::string, static_closure> statics;
+    std::unordered_map<std::string, gccjit::lvalue> constructor_infos;
+
+    /**
+       The tag of each constructor in `constructor_infos`.
+    */
+    std::unordered_map<std::string, unsigned long> constructor_tags;
+
+    /**
+       The info table and entry code of each let bound lambda, created by
+       `function_compiler` when the lambda is first allocated.
+    */
+    struct lambda_code {
+        gccjit::lvalue info;
+        gccjit::function entry;
+    };
+    std::unordered_map<const ast::lambda*, lambda_code> lambda_codes;
+
+    /**
+       The info tables of argument frames which hold raw words, by layout.
+       Frames of pointers use `apply_frames`.
+    */
+    std::unordered_map<unsigned long, gccjit::lvalue> argument_frames;
+
+    /**
+       The number of functions generated so far, which keeps their names
+       unique.
+    */
+    std::size_t generated_functions = 0;
+
+    /**
+       The shared static closures of the constructors in
+       `constructor_infos` which have them; see `make_shared_closures`.
+    */
+    std::unordered_map<std::string, gccjit::lvalue> shared_closures;
+
+    /**
+       Declare the types and runtime entry points every program uses.
+    */
+    void declare_runtime();
+
+    /**
+       Take the parent's runtime declarations, which a child context can
+       use as they are.
+    */
+    void share_runtime(const context& parent);
+
+    /**
+       Run the passes over the bindings and generate their globals and
+       code.
+
+       @param entries  The bindings to keep, with everything they refer to.
+       @param floating Which let bindings may be moved between scopes.
+    */
+    void compile_bindings(const std::vector<std::string>& entries,
+                          const float_options& floating);
 
     gccjit::type make_continuation_type();
     gccjit::struct_ make_info_table_type();
     gccjit::struct_ make_closure_type();
+    gccjit::struct_ make_registers_type();
 
     scoped_map<std::string, gccjit::lvalue> bound_closures;
 
     void create_globals();
+    void import_runtime();
+
+    /**
+       Generate the code of every top level binding which is not a static
+       constructor, and of every lambda they allocate.
+
+       @throws bad_compile if the code uses a value as something it is not.
+    */
+    void compile_code();
+
+    gccjit::struct_ make_static_closure_type(const ast::binding& binding);
+    void initialize_static(const ast::binding& binding);
+
+    /**
+       @param name A top level binding of this program or an earlier batch.
+       @throws bad_name_lookup if there is no such binding.
+       @return     A constant pointer to its static closure.
+    */
+    gccjit::rvalue static_address(const std::string& name);
+
+    /**
+       The info table of a constructor, which is created on first use unless
+       an earlier batch already has one. Constructors are tagged in the
+       order they are first used.
+
+       @param name   The constructor.
+       @param fields The number of fields it is applied to.
+       @return       A constant pointer to the info table.
+    */
+    gccjit::rvalue constructor_info(const std::string& name, std::size_t fields);
+
+    /**
+       @param name   The constructor.
+       @param fields The number of fields it is applied to.
+       @return       Its tag, from the info table `constructor_info` gives.
+    */
+    unsigned long constructor_tag(const std::string& name, std::size_t fields);
+
+    /**
+       Create the shared static closures of a new constructor: one for a
+       nullary constructor, or one for each value from
+       `runtime::min_shared_value` to `runtime::max_shared_value` for a
+       constructor of one `int64` field.
+
+       @param name   The constructor.
+       @param fields The number of fields it is applied to.
+       @param info   Its info table.
+       @return       The `shared` field of the info table.
+    */
+    gccjit::rvalue make_shared_closures(const std::string& name,
+                                        std::size_t fields,
+                                        gccjit::lvalue info);
+
+    /**
+       @param con A constructor application.
+       @return    A constant pointer to the shared static closure it builds
+                  if `is_shared_construct`, which it is compiled to instead
+                  of an allocation, otherwise a null pointer.
+    */
+    gccjit::rvalue shared_closure(const ast::construct& con);
+    gccjit::rvalue literal_value(const ast::literal& lit);
+
+    /**
+       @param lam A let bound lambda.
+       @return    A constant pointer to the runtime's selector info table
+                  for its closures if it is a selector thunk, otherwise a
+                  null pointer.
+    */
+    gccjit::rvalue selector_info(const ast::lambda& lam);
+
+    /**
+       @param lit An `Integer` literal.
+       @return    A pointer to a static `Integer` with its value, shared by
+                  every literal with the same digits, which is one of
+                  `gg_small_integers` if it is in their range.
+    */
+    gccjit::rvalue integer_literal(const ast::integer_digits& lit);
+    gccjit::function make_int_pow();
+
+    /**
+       Declare a function of the runtime.
+
+       @param name        The function's C name.
+       @param return_type Its return type.
+       @param param_types The types of its parameters.
+       @return            The function.
+    */
+    gccjit::function import_function(const std::string& name,
+                                     gccjit::type return_type,
+                                     const std::vector<gccjit::type>& param_types);
+
+    void import_runtime_primop(const std::string& name,
+                               gccjit::type return_type,
+                               const std::vector<gccjit::type>& param_types);
+
+    /**
+       Lower a primitive operation to native arithmetic, loads and stores,
+       or a call to the runtime for bulk array operations, `Integer`
+       arithmetic, `fork#` and `newMVar#`. Comparing and doing arithmetic
+       on small `Integer`s is done inline, and only big operands and
+       results which overflow go to the runtime.
+
+       @param block The block to add stores to; on return, the block to
+                    continue in.
+       @param op    The operation.
+       @param args  The arguments: `long`, `double` for the operations
+                    on doubles, or `closure*` for arrays, array elements
+                    and `Integer`s. They may be evaluated more than once.
+       @param space Where to build the result of `Integer` arithmetic,
+                    `primop_words` words from the block's heap check; unused
+                    by the other operations.
+       @param loc   The location of the operation.
+       @throws bad_primop for `yield#`, `takeMVar#` and `putMVar#`,
+                          which may deschedule the thread and so need a
+                          continuation.
+       @return      The result; 0 for the operations which only write.
+                    Comparisons give a `long` which is 0 or 1.
+    */
+    gccjit::rvalue primop_value(gccjit::block& block,
+                                const ast::primop& op,
+                                const std::vector<gccjit::rvalue>& args,
+                                gccjit::rvalue space,
+                                gccjit::location loc);
+
+    /**
+       Emit the first heap check of a basic block, which is a safe point
+       where the thread may be preempted or the nursery collected.
+
+       A block which starts a function can simply be rerun after a failed
+       check. A block which starts a case alternative has values in locals
+       which would be lost, so `save` pushes a frame holding them whose
+       return code is `self`; the heap pointer is back where it started
+       while it runs.
+
+       @param fn    The function being compiled.
+       @param block The current block; on return, the block to continue
+                    in once the check has passed.
+       @param self  The continuation to run after a failed check.
+       @param words The number of words the check asks for.
+       @param save  Called with the failure block, which it may replace, to
+                    save the block's locals; or empty to rerun the block.
+       @return      The heap pointer before the bump, which the block's
+                    allocation sites are offsets from.
+    */
+    gccjit::rvalue emit_heap_check(gccjit::function& fn,
+                                   gccjit::block& block,
+                                   gccjit::rvalue self,
+                                   std::size_t words,
+                                   const std::function<void(gccjit::block&)>& save = {});
+
+    /**
+       Emit one of the heap checks of a basic block after the first. These
+       are not safe points, so a failed check allocates with `gg_allocate`
+       instead of running the block again.
+
+       @param fn    The function being compiled.
+       @param block The current block; on return, the block to continue
+                    in.
+       @param words The number of words the check asks for; more than
+                    `runtime::max_block_object_words` for a large object.
+       @return      The start of the allocated words, which the check's
+                    allocation sites are offsets from.
+    */
+    gccjit::rvalue emit_allocation(gccjit::function& fn,
+                                   gccjit::block& block,
+                                   std::size_t words);
+
+    /**
+       @param start The value returned by the site's heap check.
+       @param site  An allocation site of the block.
+       @return      A pointer to the uninitialised closure.
+    */
+    gccjit::rvalue site_address(gccjit::rvalue start,
+                                const allocation_site& site);
 
     gccjit::location adapt_loc(const gg::location& loc);
 
+    /**
+       A context with only the runtime declarations, for a `session` to
+       compile its batches in children of.
+    */
+    context();
+
+    /**
+       A batch of a `session`, in a child context of `parent`.
+
+       @param parent   The session's root context.
+       @param batch    The new bindings; they are all kept.
+       @param layouts  Every constructor declared so far, including by
+                       `batch`.
+       @param linked   The earlier batches.
+       @param floating Which let bindings may be moved between scopes.
+    */
+    context(context& parent,
+            const std::shared_ptr<ast::program>& batch,
+            const constructor_layouts& layouts,
+            const linkage& linked,
+            const float_options& floating);
+
 public:
-    context(const std::shared_ptr<ast::sequence<ast::binding>>& bindings);
+    /**
+       @param program  The program; bindings which cannot be reached from
+                       `entry` are removed.
+       @param entry    The name of the binding the program starts from.
+       @param floating Which let bindings may be moved between scopes.
+    */
+    context(const std::shared_ptr<ast::program>& program,
+            const std::string& entry = "main",
+            const float_options& floating = float_options());
+
+    context(const context&) = delete;
 
     ~context() {
         ctx.release();
     }
 };
+
+/**
+   A constructor compiled by a `session`, as it was when it was compiled.
+*/
+struct constructor_description {
+    std::string name;
+
+    /**
+       The fields in declared order; constructors which are not declared
+       have only boxed fields.
+    */
+    std::vector<ast::field_kind> fields;
+};
+
+/**
+   A long lived compiler which takes a program one batch of top level
+   bindings at a time, for a REPL or for reloading small changes to a large
+   program.
+
+   The runtime's types and entry points are declared once in a root context.
+   Each batch is compiled in a child of it and sees the earlier batches'
+   static closures and constructor info tables as constant addresses, so
+   only the new bindings are compiled. A binding which is defined again
+   shadows the old one for later batches; code already compiled keeps
+   using the old one.
+*/
+struct session {
+private:
+    context root;
+    linkage linked;
+    constructor_layouts layouts;
+    float_options floating;
+
+    /**
+       The code of every batch, which the later batches point into.
+    */
+    std::vector<gcc_jit_result*> results;
+
+    /**
+       Every constructor info table from every batch, including the ones
+       that later batches redeclared.
+    */
+    std::unordered_map<const runtime::info_table*, constructor_description>
+        descriptions;
+
+public:
+    /**
+       @param floating Which let bindings may be moved between scopes in
+                       each batch.
+    */
+    session(const float_options& floating = float_options());
+
+    session(const session&) = delete;
+
+    ~session();
+
+    /**
+       Compile a batch of bindings.
+
+       @param batch The bindings, which may refer to any earlier batch, and
+                    the data declarations they use.
+       @throws bad_name_lookup if a binding refers to an unknown name.
+       @throws bad_declaration if the batch declares a constructor twice.
+       @throws bad_compile     if the batch uses a value as something it
+                               is not, or gccjit fails to compile it.
+    */
+    void add(const std::shared_ptr<ast::program>& batch);
+
+    /**
+       @param name A top level binding from any batch.
+       @return     Its static closure, or `nullptr` if there is none.
+    */
+    runtime::closure* lookup(const std::string& name) const;
+
+    /**
+       @return The static closures and current constructors of every batch.
+    */
+    const linkage& linked_bindings() const;
+
+    /**
+       @param info The info table of a closure.
+       @return     The constructor it belongs to, or `nullptr` if it is not
+                   a constructor compiled by this session.
+    */
+    const constructor_description* describe(const runtime::info_table* info) const;
+};
 }
 }
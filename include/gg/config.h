@@ -0,0 +1,205 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iosfwd>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gg {
+namespace runtime {
+/**
+   When updatable thunks are overwritten with a blackhole.
+*/
+enum class blackholing {
+    /**
+       Claim the thunk as soon as it is entered.
+    */
+    eager,
+
+    /**
+       Only blackhole the thunks under evaluation when the thread is
+       descheduled.
+    */
+    lazy,
+};
+
+/**
+   How the old generation is collected.
+*/
+enum class old_gen_collection {
+    /**
+       Stop the world and copy everything live into fresh blocks.
+    */
+    copying,
+
+    /**
+       Mark the old generation on a thread of its own while the mutator
+       runs, then sweep it a slice at a time. Only minor collections stop
+       the world, and nothing in the old generation moves.
+    */
+    concurrent,
+
+    /**
+       Stop the world, mark everything live and slide it down to the start
+       of the old generation, which needs no to-space.
+    */
+    compacting,
+};
+
+/**
+   How runtime statistics are printed.
+*/
+enum class stats_format {
+    none,
+    text,
+    json,
+};
+
+/**
+   Parse a count of bytes such as `512`, `2048K` or `8M`: up to 9 digits,
+   then an optional K, M or G suffix in either case.
+
+   @param text The count.
+   @return     The count, or 0 if it does not parse.
+*/
+std::uint64_t parse_bytes(const std::string& text);
+
+/**
+   A nursery size which fits in the share of the cache each core has to
+   itself: its L2 cache, or its slice of the L3 cache if there is no L2.
+   Read from sysfs once.
+
+   @return The size in words, or 2^17 words if the cache cannot be read.
+*/
+std::size_t cache_nursery_words();
+
+/**
+   Runtime system options.
+*/
+struct config {
+    /**
+       The number of OS threads to run green threads on.
+    */
+    std::size_t capabilities = std::thread::hardware_concurrency();
+
+    /**
+       How long a thread may run before it is preempted.
+    */
+    std::chrono::microseconds timeslice = std::chrono::milliseconds(20);
+
+    /**
+       The size of the first chunk of each thread's stack in words.
+    */
+    std::size_t stack_words = 256;
+
+    /**
+       The size of the chunks a stack grows by in words.
+    */
+    std::size_t stack_chunk_words = 4096;
+
+    /**
+       The largest a thread's stack may grow to in words before the thread
+       is killed with a stack overflow.
+    */
+    std::size_t max_stack_words = std::size_t(1) << 24;
+
+    blackholing blackholing_mode = blackholing::lazy;
+
+    /**
+       The size of each capability's nursery in words.
+    */
+    std::size_t nursery_words = cache_nursery_words();
+
+    /**
+       The most address space the heap may use.
+    */
+    std::size_t max_heap_bytes = std::size_t(1) << 36;
+
+    /**
+       The fraction of the time the old generation should take to collect.
+       After each major collection or concurrent cycle, the old generation
+       is allowed to grow by as much as it takes to meet this, given how
+       long that collection took, how fast the old generation filled before
+       it and how much of what was promoted survived.
+    */
+    double gc_time_target = 0.05;
+
+    /**
+       The smallest the old generation may grow to, in words, before the
+       first major collection.
+    */
+    std::size_t old_gen_min_words = std::size_t(1) << 20;
+
+    /**
+       The number of OS threads which copy closures during a collection.
+    */
+    std::size_t gc_threads = std::thread::hardware_concurrency();
+
+    old_gen_collection old_gen_mode = old_gen_collection::copying;
+
+    /**
+       With concurrent old generation collection, the longest the marking
+       thread works on the old generation at a time. A minor collection
+       never waits for it for longer than this, so it bounds what the old
+       generation adds to a pause.
+    */
+    std::chrono::microseconds pause_budget = std::chrono::milliseconds(1);
+
+    /**
+       Print the runtime statistics when the scheduler is destroyed.
+    */
+    stats_format stats_output = stats_format::none;
+
+    /**
+       If nonzero, print the statistics so far as a line of JSON this often
+       while running.
+    */
+    std::chrono::milliseconds stats_interval{0};
+
+    /**
+       Where statistics are printed; `nullptr` for standard error.
+    */
+    std::ostream* stats_stream = nullptr;
+};
+
+/**
+   Exception raised for a runtime option which cannot be parsed.
+*/
+struct bad_rts_option : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_rts_option(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+/**
+   Take the runtime options out of a command line:
+
+       --rts-stats                 print statistics at exit
+       --rts-stats=json            print them as JSON
+       --rts-stats-interval=<ms>   also print a JSON sample this often while
+                                   running
+       --rts-nursery=<size>        the size of each nursery in bytes, with an
+                                   optional K, M or G suffix
+       --rts-gc-target=<percent>   the share of time to spend collecting the
+                                   old generation
+
+   @param args    The arguments.
+   @param options The options to set.
+   @throws bad_rts_option if an option starting with `--rts-` is not one of
+                          these.
+   @return The arguments which are not runtime options, in order.
+*/
+std::vector<std::string> parse_rts_options(const std::vector<std::string>& args,
+                                           config& options);
+}
+}
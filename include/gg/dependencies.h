@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gg/ast.h"
+
+namespace gg {
+namespace compiler {
+/**
+   A graph of which bindings refer to which other bindings.
+*/
+using reference_graph = std::unordered_map<std::string, std::vector<std::string>>;
+
+/**
+   Find the strongly connected components of a reference graph.
+
+   @param nodes The nodes of the graph, in a fixed order so that the output
+                is deterministic.
+   @param graph The edges of the graph. Edges to names which are not in
+                `nodes` are ignored.
+   @return      The components, each after every component it refers to.
+*/
+std::vector<std::vector<std::string>>
+strongly_connected_components(const std::vector<std::string>& nodes,
+                              const reference_graph& graph);
+
+/**
+   Remove the top level and let bound bindings which cannot be reached from
+   the entry binding, and split each `letrec` into nested `let`s and
+   `letrec`s of its strongly connected components.
+
+   @param bindings The top level bindings.
+   @param entry    The name of the binding the program starts from.
+   @throws bad_name_lookup if there is no binding called `entry`.
+*/
+void prune_bindings(ast::sequence<ast::binding>& bindings,
+                    const std::string& entry = "main");
+
+/**
+   `prune_bindings` with several entry bindings.
+
+   @param bindings The top level bindings.
+   @param entries  The names of the bindings to keep, along with everything
+                   they refer to.
+   @throws bad_name_lookup if a name in `entries` is not bound.
+*/
+void prune_bindings(ast::sequence<ast::binding>& bindings,
+                    const std::vector<std::string>& entries);
+}
+}
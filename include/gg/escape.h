@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "gg/ast.h"
+
+namespace gg {
+namespace compiler {
+/**
+   The most words of closures the frame of one case continuation may hold.
+   Closures which do not fit are allocated on the heap as usual.
+*/
+constexpr std::size_t max_frame_closure_words = 32;
+
+/**
+   Let bound closures which live in the frame of a case continuation, and
+   the case whose frame holds each.
+*/
+using stack_closures = std::unordered_map<const ast::binding*, const ast::case_*>;
+
+/**
+   Find the let bound closures which cannot outlive the evaluation of the
+   scrutinee of a case.
+
+   While a scrutinee is evaluated its continuation's frame stays on the
+   stack, so a closure which is only used inside one scrutinee can live in
+   that frame and is freed when the continuation returns. The case must be
+   pushed on the way from the binding to the use, not in an alternative of
+   a case in between, whose frame is gone by then. A closure escapes if it
+   is:
+
+   - captured by a lambda, stored in a constructor or passed to a primop;
+   - passed to anything but a saturated call of a top level function whose
+     parameter does not escape;
+   - returned, which is entering a function with no arguments anywhere but
+     the scrutinee of a case without a binding alternative;
+   - partially applied.
+
+   Which parameters of top level functions escape is found first, by
+   iterating to a fixed point.
+
+   @param bindings The top level bindings.
+   @return         The closures which can be allocated in frames.
+*/
+stack_closures find_stack_closures(ast::sequence<ast::binding>& bindings);
+
+/**
+   Replace constructors which are only taken apart by their fields.
+
+   A case whose scrutinee is a constructor application, or the entry of a
+   let bound thunk whose body is one, is replaced by the matching
+   alternative with the pattern's variables substituted by the fields.
+   Thunks which are no longer used afterwards are dropped, so neither the
+   thunk nor the constructor is ever allocated.
+
+   The free variable lists of lambdas are recomputed.
+
+   @param bindings The top level bindings.
+   @param externs  Top level names bound outside of `bindings`.
+*/
+void replace_scalars(ast::sequence<ast::binding>& bindings,
+                     const std::unordered_set<std::string>& externs = {});
+}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <exception>
+#include <string>
+#include <unordered_set>
+
+#include "gg/ast.h"
+
+namespace gg {
+namespace compiler {
+/**
+   Exception raised when a lambda's declared free variables are wrong.
+*/
+struct bad_freevars : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_freevars(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+/**
+   What to do with the free variables a lambda declares.
+*/
+enum class freevar_mode {
+    /**
+       Raise `bad_freevars` if any lambda declares the wrong free variables.
+    */
+    check,
+
+    /**
+       Replace each lambda's free variables with the computed ones.
+    */
+    overwrite,
+};
+
+/**
+   Compute the free variables of every lambda in a program.
+
+   A free variable is a variable used in the body of a lambda which is bound
+   by an enclosing lambda, `let`, `letrec` or case alternative. Top level
+   bindings are static and are never captured.
+
+   The free variables become the fields of the closure, in order. Variables
+   the lambda already declared keep their declared order and come first, so
+   a correct list is never rearranged. Missing variables follow in the order
+   they are first used.
+
+   This takes time linear in the size of the program plus the total length
+   of the free variable lists.
+
+   @param bindings The top level bindings.
+   @param mode     Whether to check or overwrite the declared lists.
+   @param externs  Top level names bound outside of `bindings`, such as by
+                   an earlier batch of an incremental session.
+   @throws bad_freevars    in `check` mode if a list is wrong.
+   @throws bad_name_lookup if a variable is not bound anywhere.
+*/
+void compute_freevars(ast::sequence<ast::binding>& bindings,
+                      freevar_mode mode = freevar_mode::overwrite,
+                      const std::unordered_set<std::string>& externs = {});
+}
+}
@@ -0,0 +1,515 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "gg/config.h"
+#include "gg/heap.h"
+#include "gg/runtime.h"
+#include "gg/spinlock.h"
+#include "gg/stats.h"
+
+extern "C" {
+/**
+   Evacuate a pointer field; called from scavenge code.
+
+   @param c The closure pointed to.
+   @return  The new address of the closure.
+*/
+gg::runtime::closure* gg_evacuate(gg::runtime::closure* c);
+
+/**
+   Copy a closure of a given size; called from evacuation code.
+
+   @param c     The closure.
+   @param words The size of the closure in words.
+   @return      The new address of the closure.
+*/
+gg::runtime::closure* gg_copy(gg::runtime::closure* c, std::size_t words);
+}
+
+namespace gg {
+namespace runtime {
+struct capability;
+struct collector;
+struct compaction_block;
+struct scheduler;
+struct segment;
+struct thread;
+
+/**
+   One of the OS threads copying closures during a collection.
+
+   Each worker copies into blocks of its own, so copying only synchronises
+   to claim the closure being copied. A closure which has been copied but
+   whose fields have not been evacuated yet is grey; each worker keeps its
+   grey closures in a queue, and a worker with nothing left to do steals
+   the oldest closure from another worker's queue.
+*/
+struct gc_worker {
+    collector& gc;
+
+    /**
+       The blocks this worker has copied into during this collection.
+    */
+    block* to_head = nullptr;
+
+    /**
+       The block being copied into, which is always one of `to_head`.
+    */
+    block* current = nullptr;
+
+    std::deque<closure*> grey;
+    std::atomic<std::size_t> queued{0};
+    spinlock grey_lock;
+
+    /**
+       The static closures this worker has already visited, so that it only
+       takes the collector's lock the first time it sees each one.
+    */
+    std::unordered_set<closure*> visited_statics;
+
+    /**
+       With concurrent old generation collection, the segment this worker
+       promotes into for each size class. No other worker allocates in it.
+    */
+    std::vector<segment*> segments;
+
+    /**
+       The words this worker has copied during this collection.
+    */
+    std::size_t copied_words = 0;
+
+    /**
+       How many selector thunks this worker is in the middle of replacing
+       with the field they select.
+    */
+    std::size_t selector_depth = 0;
+
+    gc_worker(collector& gc) : gc(gc) {}
+};
+
+/**
+   A generational copying garbage collector.
+
+   New closures are bump allocated in a per capability nursery. A minor
+   collection copies everything live in the nurseries into the old
+   generation; once the old generation has grown past a threshold, a major
+   collection copies everything live in the old generation into fresh
+   blocks.
+
+   The threshold is set after each major collection so that collecting the
+   old generation takes about `gc_time_target` of the time. A collection is
+   taken to cost the same per live word as the last one did, and the old
+   generation to fill at the rate it did before it, with as much of what is
+   promoted surviving. For a headroom `H` over the `L` words live, a cost
+   `c` and a fill rate `r`, the time spent collecting is then
+
+       c (L + s H) / L / (c (L + s H) / L + H / r)
+
+   which is solved for `H`.
+
+   Collection is stop-the-world: it only happens while every capability is
+   between two continuations. The roots are split into tasks which
+   `gc_threads` workers share out, then the workers copy everything the
+   roots reach in parallel; see `gc_worker`.
+
+   Objects of `large_object_words` or more live in block groups of their
+   own and are never moved either. A collection which finds one live keeps
+   its group; the groups of the rest are freed.
+
+   Indirections are never copied; whatever points at one is given its
+   value instead, including indirections left in the old generation, which
+   a minor collection skips over. Likewise a selector thunk whose selectee
+   is already a constructor is replaced by the field it selects, and a
+   nullary constructor or small boxed value by its shared static closure;
+   see `shared_closure`.
+
+   Static closures are never moved. A major collection follows the static
+   reference tables of the info tables it sees to find which evaluated CAFs
+   are still reachable, and reverts the rest so that their values can be
+   reclaimed. A continuation which is not a frame's info table must keep
+   any static closure it will use in `node` or on the stack.
+
+   With `old_gen_collection::concurrent` there are no major collections.
+   Minor collections promote into segments: blocks divided into slots of one
+   size class, with a bitmap of the slots in use. Once the old generation
+   has grown past the threshold, a minor collection marks the thread stacks
+   and CAFs and a marking thread traces the old generation from them while
+   the mutator runs, then frees the slots it did not reach a slice at a
+   time. A slot promoted into while marking counts as marked.
+
+   Marking is snapshot-at-the-beginning: it keeps everything that was
+   reachable when it started. So while it runs, code which overwrites a
+   pointer in an old closure, or blackholes or updates an old thunk, hands
+   the pointers it loses to `snapshot_barrier`; each minor collection gives
+   them to the marker. Marking is over once the marker runs out of work and
+   a minor collection finds nothing new for it. Evaluated CAFs are always
+   kept, because their static reference tables are not traced.
+
+   With `old_gen_collection::compacting` a major collection first does a
+   minor one, then compacts the old generation in place rather than copying
+   it. Marking sets a bit for every word of each live closure; each block
+   gets a forwarding address, where its live words will start, so the new
+   address of a closure is that plus the number of live words before it in
+   its block. Every pointer is then rewritten, and the live words of each
+   block slid down. Marking and rewriting both go through `scavenge`, with
+   `evacuate` marking or forwarding a closure rather than copying it.
+*/
+struct collector {
+private:
+    heap& memory;
+    const config& options;
+
+    block* old_head = nullptr;
+    std::size_t old_words = 0;
+    std::size_t major_threshold;
+
+    /**
+       Every CAF which has been entered, with the info table to revert it
+       to.
+    */
+    struct caf {
+        closure* c;
+        const info_table* info;
+    };
+    std::vector<caf> cafs;
+    std::mutex caf_lock;
+
+    /**
+       The large objects allocated since the last collection, and those
+       which have survived one. Each is a block group.
+    */
+    block* young_large = nullptr;
+    std::size_t young_large_words = 0;
+    block* old_large = nullptr;
+    std::size_t old_large_words = 0;
+    std::mutex large_lock;
+
+    /**
+       The workers, and the OS threads that run every worker but the first,
+       which waits for each collection after the one they were started in.
+    */
+    std::vector<std::unique_ptr<gc_worker>> workers;
+    std::vector<std::thread> helpers;
+    std::mutex helpers_lock;
+    std::condition_variable helpers_wake;
+    std::condition_variable helpers_finished;
+    std::size_t collections = 0;
+    std::size_t helpers_done = 0;
+    bool stopping = false;
+
+    // state for the collection in progress
+    bool major = false;
+    std::vector<std::function<void()>> roots;
+    std::atomic<std::size_t> next_root{0};
+    std::atomic<std::size_t> idle_workers{0};
+    std::unordered_set<closure*> visited_statics;
+    std::vector<closure*> pending_statics;
+    std::atomic<std::size_t> statics_queued{0};
+    spinlock statics_lock;
+
+    /**
+       The concurrent collector, whose state is guarded by
+       `nonmoving_lock`. A collection holds the lock throughout; the
+       marking thread holds it for a slice at a time and lets go early when
+       `pause_requested` is set.
+    */
+    enum class mark_phase { idle, marking, sweeping };
+    scheduler& sched;
+    std::vector<segment*> segments;
+    std::vector<std::vector<segment*>> partial_segments;
+    spinlock segments_lock;
+    std::atomic<std::size_t> segment_words{0};
+    mark_phase phase = mark_phase::idle;
+    std::atomic<bool> marking{false};
+    std::size_t cycle = 0;
+    std::vector<closure*> mark_stack;
+    bool large_swept = false;
+    std::size_t sweep_position = 0;
+    std::thread marker;
+    bool marker_stopping = false;
+    std::mutex nonmoving_lock;
+    std::condition_variable marker_wake;
+    std::atomic<bool> pause_requested{false};
+
+    // the statistics of a cycle the marker has finished since the last
+    // collection
+    bool cycle_finished = false;
+    std::size_t cycle_live_words = 0;
+    std::size_t cycle_start_words = 0;
+    std::chrono::steady_clock::time_point cycle_started;
+    std::chrono::steady_clock::time_point cycle_ended;
+
+    // the flags of a large object promoted by this collection
+    unsigned promoted_large_flags = large_block;
+
+    /**
+       The phase of the compaction in progress, and the mark bitmaps and
+       forwarding address of each old block.
+    */
+    enum class compact_phase { none, marking, forwarding };
+    compact_phase compaction = compact_phase::none;
+    std::unordered_map<block*, compaction_block*> compaction_blocks;
+
+    bool concurrent() const;
+    word* allocate(gc_worker& w, std::size_t words);
+
+    /**
+       Give back the space of a copy which lost the race to claim its
+       closure.
+    */
+    void retract(gc_worker& w, word* p, std::size_t words);
+    word* allocate_in_segment(gc_worker& w, std::size_t words);
+    segment* take_segment(std::size_t size_class);
+    void push_grey(gc_worker& w, closure* c);
+
+    /**
+       Take a grey closure, or a static closure to visit, from anywhere.
+
+       @return Whether there was one.
+    */
+    bool take_work(gc_worker& w, closure*& c, bool& is_static);
+    bool work_visible();
+
+    /**
+       Copy a closure in from-space with its layout, or its evacuation code
+       if it has any.
+    */
+    closure* copy_closure(closure* c);
+
+    /**
+       @param c    A selector thunk in from-space.
+       @param info Its info table.
+       @return     The field it selects, or `nullptr` if its selectee is not
+                   known to be a constructor yet.
+    */
+    closure* selected_field(closure* c, const info_table* info);
+
+    /**
+       Evacuate the pointer fields of a closure with its layout, or its
+       scavenge code if it has any.
+
+       @return The size of the closure in words.
+    */
+    std::size_t scavenge(closure* c);
+
+    void flip(block* head, unsigned flags);
+    void visit_static(closure* c);
+    void visit_srt(const info_table* info);
+    void scavenge_static(closure* c);
+    void scavenge_grey(closure* c);
+    void scavenge_thread(thread& t);
+    void scavenge_cafs();
+    void sweep_large();
+    void revert_unreachable_cafs();
+
+    /**
+       Run root tasks until there are none left, then copy until every
+       worker has run out of work.
+    */
+    void work(gc_worker& w);
+    void helper(gc_worker& w, std::size_t seen);
+
+    /**
+       Mark a closure in the old generation, and queue it to have its
+       fields marked if it was not marked already.
+    */
+    void mark(closure* c);
+    void mark_fields(closure* c);
+    void start_marking(const std::unordered_set<thread*>& threads);
+    void drain_snapshot_logs(
+        const std::vector<std::unique_ptr<capability>>& capabilities);
+    closure* compact_evacuate(closure* c);
+    closure* forward(closure* c);
+    void compact(const std::unordered_set<thread*>& threads);
+    void sweep_segment(segment* s);
+    void sweep_old_large();
+
+    /**
+       Work on the current phase until the deadline passes or a collection
+       is waiting.
+    */
+    void mark_slice(std::chrono::steady_clock::time_point deadline);
+    void sweep_slice(std::chrono::steady_clock::time_point deadline);
+
+    /**
+       The body of the marking thread.
+    */
+    void mark_and_sweep();
+
+    /**
+       The collection counts and times, and the allocation and copying they
+       saw, guarded by the scheduler's lock.
+    */
+    rts_stats stats;
+
+    /**
+       What the last major collection or concurrent cycle left live, when it
+       ended, and the time minor collections had taken by then.
+    */
+    std::size_t last_live_words = 0;
+    std::chrono::steady_clock::time_point last_major_end;
+    std::chrono::nanoseconds last_minor_gc_time{0};
+
+    /**
+       Set the threshold for the next major collection or concurrent cycle
+       after one has finished.
+
+       @param before The words in the old generation before it.
+       @param live   The words it left live.
+       @param began  When it started.
+       @param ended  When it finished.
+    */
+    void resize_old_generation(std::size_t before,
+                               std::size_t live,
+                               std::chrono::steady_clock::time_point began,
+                               std::chrono::steady_clock::time_point ended);
+
+public:
+    /**
+       @param sched   The scheduler to request collections from.
+       @param memory  The block allocator.
+       @param options The runtime options.
+    */
+    collector(scheduler& sched, heap& memory, const config& options);
+
+    /**
+       Reverts every CAF, because their values live in the heap, and stops
+       the workers and the marking thread.
+    */
+    ~collector();
+
+    /**
+       Get the new address of a closure, copying it if this is the first
+       reference found to it. Closures outside the generation being
+       collected are returned as is, and indirections are skipped.
+
+       @param c The closure.
+       @return  The new address of the closure.
+    */
+    closure* evacuate(closure* c);
+
+    /**
+       Evacuate the closure being updated by an update frame. Unlike
+       `evacuate` this never skips an indirection, because the frame must
+       write to the thunk itself.
+
+       @param c The closure.
+       @return  The new address of the closure.
+    */
+    closure* evacuate_updatee(closure* c);
+
+    /**
+       Copy a closure to to-space and leave a forwarding pointer behind. If
+       another worker claims the closure first, its copy is used instead.
+
+       @param c     The closure.
+       @param words The size of the closure in words.
+       @return      The new address of the closure.
+    */
+    closure* copy(closure* c, std::size_t words);
+
+    /**
+       Allocate a large object in a block group of its own.
+
+       @param words The size of the object in words.
+       @return      The uninitialised object.
+    */
+    closure* allocate_large(std::size_t words);
+
+    /**
+       The number of words of large objects allocated since the last
+       collection.
+    */
+    std::size_t young_large_object_words();
+
+    /**
+       Record that a CAF has been entered.
+
+       @param c    The CAF.
+       @param info The info table of the CAF before it was entered.
+    */
+    void add_caf(closure* c, const info_table* info);
+
+    /**
+       Collect garbage.
+
+       @param threads      Every live thread.
+       @param capabilities Every capability.
+    */
+    void collect(const std::unordered_set<thread*>& threads,
+                 const std::vector<std::unique_ptr<capability>>& capabilities);
+
+    /**
+       The number of words in the old generation.
+    */
+    inline std::size_t old_generation_words() const {
+        return old_words;
+    }
+
+    /**
+       Is the concurrent collector marking, so that overwritten pointers
+       must be passed to `snapshot_barrier`?
+    */
+    inline bool is_marking() const {
+        return marking.load(std::memory_order_relaxed);
+    }
+
+    /**
+       The statistics of every collection so far. Allocation is counted
+       when it is collected.
+    */
+    inline const rts_stats& statistics() const {
+        return stats;
+    }
+};
+
+/**
+   Record that an old closure may now point into the nursery.
+
+   @param cap The current capability.
+   @param c   The closure which was written to.
+*/
+void write_barrier(capability& cap, closure* c);
+
+/**
+   Record a pointer which is about to be overwritten in an old closure, if
+   the concurrent collector is marking.
+
+   @param cap The current capability.
+   @param c   The closure the field points to.
+*/
+void snapshot_barrier(capability& cap, closure* c);
+
+/**
+   Record the pointer fields of a thunk which is about to be blackholed or
+   updated, if it is old and the concurrent collector is marking.
+
+   @param cap The current capability.
+   @param c   The thunk.
+*/
+void snapshot_barrier_fields(capability& cap, closure* c);
+
+/**
+   Allocate a closure from runtime code. This never collects garbage, so it
+   is safe to call with closure pointers in C++ locals; if the nursery is
+   full it is extended and a collection is requested instead. Large objects
+   are allocated in the large object space.
+
+   @param cap   The current capability.
+   @param words The size of the closure in words.
+   @return      The uninitialised closure.
+*/
+closure* allocate(capability& cap, std::size_t words);
+}
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <new>
+
+#include "gg/runtime.h"
+
+namespace gg {
+namespace runtime {
+/**
+   The heap is carved into fixed size, aligned blocks. Each block starts with
+   a `block` header which can be found from any pointer into the block.
+*/
+constexpr std::size_t block_bytes = std::size_t(1) << 15;
+
+enum block_flags : unsigned {
+    /**
+       The block is part of a nursery.
+    */
+    nursery_block = 1,
+
+    /**
+       The block is being collected by the current garbage collection.
+    */
+    from_space_block = 2,
+
+    /**
+       The block starts a group holding one large object, which is never
+       copied.
+    */
+    large_block = 4,
+
+    /**
+       The block is a segment of the concurrently collected old generation.
+    */
+    segment_block = 8,
+
+    /**
+       The large object of the group has been marked by the concurrent
+       collector.
+    */
+    marked_block = 16,
+
+    /**
+       The block was allocated by the collection in progress, which may
+       still be copying into it.
+    */
+    to_space_block = 32,
+};
+
+struct block {
+    /**
+       The next free word in the block.
+    */
+    word* free;
+
+    /**
+       The end of the block.
+    */
+    word* limit;
+
+    /**
+       The next block in whichever list this block is on.
+    */
+    block* link;
+
+    unsigned flags;
+};
+
+inline block* block_of(const void* p) {
+    return reinterpret_cast<block*>(reinterpret_cast<word>(p) &
+                                    ~(block_bytes - 1));
+}
+
+inline word* block_start(block* b) {
+    return reinterpret_cast<word*>(b + 1);
+}
+
+/**
+   The largest object which fits in a block, in words.
+*/
+constexpr std::size_t max_block_object_words =
+    (block_bytes - sizeof(block)) / sizeof(word);
+
+/**
+   Objects this big or bigger are allocated in a block group of their own.
+   Copying them would waste most of a to-space block, and the copy itself
+   costs more than the collector saves by compacting them.
+*/
+constexpr std::size_t large_object_words = max_block_object_words / 2;
+
+/**
+   Exception raised when the heap cannot grow any more.
+*/
+struct heap_exhausted : public std::bad_alloc {
+    virtual const char* what() const noexcept {
+        return "heap exhausted";
+    }
+};
+
+/**
+   The block allocator.
+
+   All blocks come from one range of address space reserved up front, so
+   checking whether a closure is in the heap or is static is two compares.
+   Freed blocks are kept as runs of contiguous blocks, merged with the runs
+   next to them, so that a group can reuse the space of smaller groups and
+   blocks freed before it. Fresh address space above `high_water` is only
+   used when no run is big enough.
+*/
+struct heap {
+private:
+    char* reserved;
+    std::size_t reserved_bytes;
+    char* base;
+    char* end;
+    char* high_water;
+
+    /**
+       The size in bytes of each free run, by its start. A run never ends
+       at `high_water`; it is given back to the fresh space instead.
+    */
+    std::map<char*, std::size_t> free_runs;
+    std::size_t free_bytes = 0;
+    std::mutex lock;
+
+    /**
+       Take the first free run big enough, or fresh address space. The lock
+       must be held.
+
+       @throws heap_exhausted if the reserved address space is used up.
+    */
+    char* take_run(std::size_t bytes);
+
+    /**
+       Free a run of blocks, merging it with its neighbours. The lock must
+       be held.
+    */
+    void free_run(char* start, std::size_t bytes);
+
+public:
+    /**
+       @param max_bytes The most address space the heap may use.
+    */
+    heap(std::size_t max_bytes);
+
+    ~heap();
+
+    heap(const heap&) = delete;
+    heap& operator=(const heap&) = delete;
+
+    /**
+       Is a closure in the heap, as opposed to being static data?
+    */
+    inline bool contains(const void* p) const {
+        return p >= base && p < end;
+    }
+
+    /**
+       @throws heap_exhausted if the reserved address space is used up.
+       @return An empty block.
+    */
+    block* allocate_block(unsigned flags = 0);
+
+    void free_block(block* b);
+
+    /**
+       Allocate contiguous blocks with a single header, for one large
+       object.
+
+       @param words The size of the object in words.
+       @param flags The flags of the group.
+       @throws heap_exhausted if the reserved address space is used up.
+       @return The group; `limit` is the end of its last block.
+    */
+    block* allocate_group(std::size_t words, unsigned flags = large_block);
+
+    void free_group(block* b);
+
+    /**
+       The number of bytes of blocks which are in use.
+    */
+    std::size_t used_bytes();
+};
+
+/**
+   Is a closure in the old generation?
+*/
+inline bool in_old_generation(const heap& h, const void* p) {
+    return h.contains(p) && !(block_of(p)->flags & nursery_block);
+}
+}
+}
+
+extern "C" {
+/**
+   Called by generated code when a heap check fails:
+
+       hp += words;
+       if (hp > hp_limit) {
+           next = <this continuation>;
+           gg_heap_overflow(words);
+           return;
+       }
+
+   The continuation is run again once there is room, so everything before
+   the heap check must be safe to repeat. The heap check is also where a
+   thread is preempted; the scheduler clears `hp_limit` to force it to
+   fail.
+
+   @param words The number of words the failed check asked for.
+*/
+void gg_heap_overflow(std::size_t words);
+
+/**
+   Called by generated code for the heap checks of a basic block after the
+   first, which are not safe points because the closures of the earlier
+   checks are not initialised yet:
+
+       start = hp;
+       hp += words;
+       if (hp > hp_limit) {
+           hp = start;
+           start = gg_allocate(words);
+       }
+
+   and, for a closure bigger than a block, by itself. Like the runtime's
+   own allocation this never collects garbage.
+
+   @param words The number of words the check asked for.
+   @return      The uninitialised words.
+*/
+gg::runtime::word* gg_allocate(std::size_t words);
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gg/runtime.h"
+
+namespace gg {
+namespace runtime {
+/**
+   An `Integer` which fits in 64 bits. Every `Integer` that fits is small,
+   so a big integer is always out of the range of `int64_t`.
+*/
+struct small_integer {
+    const info_table* info;
+    std::int64_t value;
+};
+
+/**
+   An `Integer` which does not fit in 64 bits, in sign and magnitude form.
+*/
+struct big_integer {
+    const info_table* info;
+
+    /**
+       The number of limbs, negated if the integer is negative.
+    */
+    std::int64_t size;
+
+    /**
+       The magnitude, least significant limb first, with no leading zero
+       limbs.
+    */
+    std::uint64_t limbs[];
+};
+
+constexpr std::size_t small_integer_words = 2;
+
+inline std::size_t big_integer_words(std::size_t limbs) {
+    return 2 + limbs;
+}
+
+/**
+   An integer being computed by the slow paths, outside of the heap.
+*/
+struct integer_value {
+    bool negative = false;
+
+    /**
+       Least significant limb first, with no leading zero limbs; zero has
+       none.
+    */
+    std::vector<std::uint64_t> limbs;
+};
+
+/**
+   @param value An integer.
+   @return      The integer if it fits in a `small_integer`.
+*/
+std::optional<std::int64_t> as_small_integer(const integer_value& value);
+
+/**
+   Exception raised when a string is not a decimal integer.
+*/
+struct bad_integer : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_integer(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+/**
+   @param digits Decimal digits with an optional leading `-`.
+   @throws bad_integer if `digits` is not a decimal integer.
+   @return       The value of the digits.
+*/
+integer_value parse_integer(const std::string& digits);
+
+/**
+   @param c An `Integer`.
+   @return  Its decimal digits with a leading `-` if it is negative.
+*/
+std::string integer_to_string(const closure* c);
+}
+}
+
+/**
+   `Integer` primops. The fast paths handle small integers whose results do
+   not overflow; everything else goes to an out-of-line slow path. Results
+   are allocated with `allocate`, so these never collect garbage.
+*/
+extern "C" {
+/**
+   The info tables of `Integer` objects, which static `Integer` literals
+   point at.
+*/
+extern const gg::runtime::info_table gg_small_integer_info;
+extern const gg::runtime::info_table gg_big_integer_info;
+
+/**
+   The shared small `Integer`s from `min_shared_value` to
+   `max_shared_value`, which results in that range are instead of being
+   allocated.
+*/
+extern std::array<gg::runtime::small_integer, gg::runtime::shared_values>
+    gg_small_integers;
+
+/**
+   `int2Integer# {i}`
+*/
+gg::runtime::closure* gg_integer_from_int(std::int64_t i);
+
+/**
+   `integer2Int# {a}`
+
+   @return The low 64 bits of `a` in two's complement.
+*/
+std::int64_t gg_integer_to_int(gg::runtime::closure* a);
+
+/**
+   `plusInteger# {a, b}`
+*/
+gg::runtime::closure* gg_integer_add(gg::runtime::closure* a, gg::runtime::closure* b);
+
+/**
+   `minusInteger# {a, b}`
+*/
+gg::runtime::closure* gg_integer_sub(gg::runtime::closure* a, gg::runtime::closure* b);
+
+/**
+   `timesInteger# {a, b}`
+*/
+gg::runtime::closure* gg_integer_mul(gg::runtime::closure* a, gg::runtime::closure* b);
+
+/**
+   `negateInteger# {a}`
+*/
+gg::runtime::closure* gg_integer_negate(gg::runtime::closure* a);
+
+/**
+   `compareInteger# {a, b}`
+
+   @return -1, 0 or 1 as `a` is less than, equal to or greater than `b`.
+*/
+std::int64_t gg_integer_compare(gg::runtime::closure* a, gg::runtime::closure* b);
+}
@@ -13,5 +13,28 @@ new_function_ptr_type(gccjit::context& ctx,
 void set_fields(gccjit::struct_& st,
                 const std::vector<gccjit::field>& fields,
                 const gccjit::location& loc = gccjit::location());
+
+void set_tls_model(gccjit::lvalue& global, gcc_jit_tls_model model);
+
+/**
+   Build a constant struct value, with one value per field in order.
+*/
+gccjit::rvalue
+new_struct_constructor(gccjit::context& ctx,
+                       const gccjit::type& type,
+                       const std::vector<gccjit::rvalue>& values,
+                       const gccjit::location& loc = gccjit::location());
+
+gccjit::rvalue
+new_array_constructor(gccjit::context& ctx,
+                      const gccjit::type& type,
+                      const std::vector<gccjit::rvalue>& values,
+                      const gccjit::location& loc = gccjit::location());
+
+/**
+   Give a global a constant initial value, so that it needs no code to run
+   at startup.
+*/
+void set_initializer(gccjit::lvalue& global, const gccjit::rvalue& value);
 }
 }
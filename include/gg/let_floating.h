@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <unordered_set>
+
+#include "gg/ast.h"
+
+namespace gg {
+namespace compiler {
+/**
+   Which bindings may be floated out of the lambdas they are in.
+*/
+enum class float_out_policy {
+    never,
+
+    /**
+       Everything but updatable thunks. Floating a function or a
+       constructor out of a lambda saves allocating it on every call and
+       cannot retain anything that was not already retained.
+    */
+    safe,
+
+    /**
+       Full laziness: updatable thunks are floated too, so their values are
+       shared between calls. This can keep large values alive for longer.
+    */
+    full,
+};
+
+/**
+   Which bindings may be floated into the case alternative that uses them.
+*/
+enum class float_in_policy {
+    never,
+
+    /**
+       Only bindings with at most one free variable. Floating past the
+       scrutinee of a case means saving the binding's free variables on the
+       stack instead of a pointer to the closure; with at most one free
+       variable this never keeps more alive.
+    */
+    safe,
+
+    always,
+};
+
+struct float_options {
+    float_out_policy out = float_out_policy::full;
+    float_in_policy in = float_in_policy::safe;
+};
+
+/**
+   Float let bindings out of the lambdas they do not depend on, as far out
+   as their free variables allow, including to the top level. Then float
+   the remaining let bindings into the single case alternative that uses
+   them.
+
+   Floated bindings are renamed so that they cannot be captured by the
+   scopes they move across. The free variable lists of lambdas are stale
+   afterwards and must be recomputed.
+
+   @param bindings The top level bindings.
+   @param options  What may be floated.
+   @param externs  Top level names bound outside of `bindings`, which
+                   floated bindings must not be renamed to.
+*/
+void float_lets(ast::sequence<ast::binding>& bindings,
+                const float_options& options = float_options(),
+                const std::unordered_set<std::string>& externs = {});
+}
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "gg/compiler.h"
+#include "gg/config.h"
+#include "gg/runtime.h"
+#include "gg/scheduler.h"
+#include "gg/snapshot.h"
+
+/**
+   The embedding API of `libgg`: load programs, then call their top level
+   bindings from C++.
+*/
+namespace gg {
+/**
+   An unboxed argument to a top level function.
+*/
+using argument = std::variant<std::int64_t, double>;
+
+/**
+   Exception raised when a binding cannot be called with the given
+   arguments.
+*/
+struct bad_call : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_call(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+/**
+   Exception raised when a value is taken apart as something it is not.
+*/
+struct bad_value : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_value(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+/**
+   Exception raised when a source file cannot be read.
+*/
+struct bad_source : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_source(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+struct program;
+
+/**
+   A value in the heap of a `program`. Views are only valid while the
+   `evaluation` they came from is alive, because the collector moves
+   closures between evaluations.
+*/
+struct value_view {
+private:
+    const program* owner;
+    runtime::closure* value;
+
+    const compiler::constructor_description& description() const;
+    std::size_t slot(std::size_t n, ast::field_kind kind) const;
+
+public:
+    value_view(const program* owner, runtime::closure* value);
+
+    /**
+       @return The closure, after following any indirections.
+    */
+    runtime::closure* get() const;
+
+    /**
+       @return Whether the value is an evaluated constructor.
+    */
+    bool is_constructor() const;
+
+    /**
+       @throws bad_value if the value is not a constructor.
+       @return The name of the constructor.
+    */
+    const std::string& constructor() const;
+
+    /**
+       @throws bad_value if the value is not a constructor.
+       @return The number of fields of the constructor.
+    */
+    std::size_t fields() const;
+
+    /**
+       @param n The index of a field in declared order.
+       @throws bad_value if the field does not hold the requested kind.
+       @return The field.
+    */
+    value_view field(std::size_t n) const;
+    std::int64_t int_field(std::size_t n) const;
+    double double_field(std::size_t n) const;
+
+    /**
+       Unbox an `Integer` which fits in 64 bits, or a constructor whose only
+       field is a strict `int`.
+
+       @throws bad_value if the value is neither.
+    */
+    std::int64_t as_int() const;
+
+    /**
+       Unbox a constructor whose only field is a strict `double`.
+
+       @throws bad_value if the value is not one.
+    */
+    double as_double() const;
+};
+
+/**
+   The results of a call. No other call on the same program can run until
+   the evaluation is destroyed.
+*/
+struct evaluation {
+    std::unique_lock<std::mutex> hold;
+    std::vector<value_view> results;
+};
+
+/**
+   A set of compiled bindings together with the runtime which evaluates
+   them. The heap, and the values of CAFs, are kept from one call to the
+   next.
+*/
+struct program {
+private:
+    friend struct value_view;
+
+    compiler::session compiled;
+
+    /**
+       The loaded snapshots, which the CAFs may point into.
+    */
+    std::vector<snapshot_image> images;
+
+    runtime::scheduler evaluator;
+    mutable std::mutex lock;
+
+    runtime::closure* callee(const std::string& name,
+                             std::size_t arguments) const;
+
+    /**
+       @param arg An argument.
+       @throws bad_call if no constructor of one strict field of its kind
+                        has been compiled.
+       @return The info table of the constructor it is boxed in: the first
+               by name whose only field is a strict field of its kind.
+    */
+    const runtime::info_table* box_info(const argument& arg) const;
+
+public:
+    /**
+       @param source  The source of the first batch of bindings.
+       @param options The runtime options.
+       @throws ast::bad_parse           if the source does not parse.
+       @throws compiler::bad_compile    if the source does not compile.
+    */
+    program(std::istream& source,
+            const runtime::config& options = runtime::config());
+
+    program(const program&) = delete;
+
+    /**
+       @param source  The source of the first batch of bindings.
+       @param options The runtime options.
+       @return        The compiled program.
+    */
+    static std::unique_ptr<program>
+    from_buffer(const std::string& source,
+                const runtime::config& options = runtime::config());
+
+    /**
+       @param path    The path of the source of the first batch of bindings.
+       @param options The runtime options.
+       @throws bad_source if the file cannot be read.
+       @return        The compiled program.
+    */
+    static std::unique_ptr<program>
+    from_path(const std::string& path,
+              const runtime::config& options = runtime::config());
+
+    /**
+       Compile another batch of bindings, which may refer to the bindings of
+       every earlier batch.
+
+       @param source The source of the batch.
+    */
+    void add(std::istream& source);
+
+    /**
+       @param name A top level binding.
+       @return     Its static closure, or `nullptr` if there is none.
+    */
+    runtime::closure* lookup(const std::string& name) const;
+
+    /**
+       Write the value of every CAF evaluated so far to an image, so that
+       another process running the same program can start with them.
+
+       @param path The file to write.
+       @throws bad_snapshot if a value cannot be saved.
+    */
+    void save_snapshot(const std::string& path) const;
+
+    /**
+       Start the CAFs saved in an image with their saved values.
+
+       @param path The file to read.
+       @throws bad_snapshot if the image does not match the program.
+    */
+    void load_snapshot(const std::string& path);
+
+    /**
+       Evaluate a top level binding, applied to some arguments if it is a
+       function.
+
+       Each argument is boxed in a constructor of one strict field of its
+       kind, such as `data I {!int}`, and the function is called as any
+       compiled code calls it. A binding which is not a function is
+       evaluated, so the result is always a value.
+
+       @param name      The binding.
+       @param arguments The arguments, which must match the binding's
+                        arity.
+       @throws bad_call                 if there is no such binding, the
+                                        arguments do not match its arity,
+                                        or no box is declared for one of
+                                        them.
+       @throws runtime::thread_killed   if evaluation raises an error.
+       @throws runtime::deadlock        if evaluation blocks forever.
+       @return The result.
+    */
+    evaluation call(const std::string& name,
+                    const std::vector<argument>& arguments = {});
+
+    /**
+       Evaluate a top level function for each of several argument vectors
+       at once, each on its own green thread so that the calls are spread
+       across every capability.
+
+       @param name  The binding.
+       @param batch The argument vectors.
+       @return      The result of each call, in order.
+    */
+    evaluation call_batch(const std::string& name,
+                          const std::vector<std::vector<argument>>& batch);
+
+    /**
+       @return What the runtime has done over every call so far.
+    */
+    runtime::rts_stats statistics();
+};
+}
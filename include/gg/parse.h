@@ -15,7 +15,7 @@ namespace gg {
            @throws bad_parse if the input does not form a valid program.
            @return           A shared pointer to the root of the ast.
         */
-        std::shared_ptr<sequence<binding>> parse(std::istream &in = std::cin);
+        std::shared_ptr<program> parse(std::istream &in = std::cin);
 
         /**
            Exception raised in a parse error.
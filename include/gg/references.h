@@ -0,0 +1,175 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "gg/ast.h"
+
+namespace gg {
+namespace compiler {
+/**
+   Is a lambda a thunk: does it take no arguments?
+*/
+bool is_thunk(const ast::lambda& lam);
+
+/**
+   @param alt A case alternative.
+   @return    The names the alternative binds in its body.
+*/
+std::vector<std::string> alt_binders(const ast::alternative& alt);
+
+/**
+   The local binders around the point a walk over an expression has
+   reached, for telling a use of a name from a use of a local binding which
+   shadows it. A name may be bound more than once.
+*/
+struct scope {
+private:
+    std::unordered_map<std::string, std::size_t> shadowed;
+
+public:
+    void bind(const std::string& name);
+    void unbind(const std::string& name);
+
+    /**
+       @return Whether a local binder of `name` is in scope.
+    */
+    bool shadows(const std::string& name) const;
+
+    /**
+       Walk the body of a lambda with its arguments in scope.
+
+       @param lam  The lambda.
+       @param body Called to walk the body.
+    */
+    template<typename F>
+    void walk_lambda(const ast::lambda& lam, F&& body) {
+        for (const auto& arg : lam.args->elems) {
+            bind(arg->name);
+        }
+        body();
+        for (const auto& arg : lam.args->elems) {
+            unbind(arg->name);
+        }
+    }
+
+    /**
+       Walk a `let` or `letrec` with its binders in scope in the body, and
+       also in the right hand sides of a `letrec`.
+
+       @param let  The bindings.
+       @param rhs  Called with each binding to walk its right hand side.
+       @param body Called to walk the body.
+    */
+    template<typename R, typename B>
+    void walk_let(const ast::local_bindings& let, R&& rhs, B&& body) {
+        bool recursive = dynamic_cast<const ast::local_recursion*>(&let);
+        if (recursive) {
+            for (const auto& binding : *let.bindings) {
+                bind(binding->lhs->name);
+            }
+        }
+        for (const auto& binding : *let.bindings) {
+            rhs(*binding);
+        }
+        if (!recursive) {
+            for (const auto& binding : *let.bindings) {
+                bind(binding->lhs->name);
+            }
+        }
+        body();
+        for (const auto& binding : *let.bindings) {
+            unbind(binding->lhs->name);
+        }
+    }
+
+    /**
+       Walk the body of a case alternative with its binders in scope.
+
+       @param alt  The alternative.
+       @param body Called to walk the body.
+    */
+    template<typename F>
+    void walk_alt(const ast::alternative& alt, F&& body) {
+        auto bound = alt_binders(alt);
+        for (const auto& name : bound) {
+            bind(name);
+        }
+        body();
+        for (const auto& name : bound) {
+            unbind(name);
+        }
+    }
+};
+
+/**
+   Find the top level bindings that a lambda refers to, either directly in
+   its body or through one of its free variables.
+
+   @param lam     The lambda.
+   @param globals The names of the top level bindings.
+   @return        The names of the top level bindings `lam` refers to.
+*/
+std::unordered_set<std::string>
+global_references(const ast::lambda& lam,
+                  const std::unordered_set<std::string>& globals);
+
+/**
+   Find the uses of some names in an expression which are not shadowed by a
+   local binding.
+
+   @param expr  The expression.
+   @param names The names to look for.
+   @return      The names `expr` refers to.
+*/
+std::unordered_set<std::string>
+expr_references(const std::shared_ptr<ast::expr>& expr,
+                const std::unordered_set<std::string>& names);
+
+/**
+   @param bindings The top level bindings.
+   @return         Every name bound anywhere in the program, including the
+                   top level names.
+*/
+std::unordered_set<std::string> bound_names(const ast::sequence<ast::binding>& bindings);
+
+/**
+   Make up a name for a binding introduced by a pass.
+
+   @param base  The name to derive the new name from.
+   @param taken The names in use, which the new name is added to.
+   @return      A name starting with `base` which was not in `taken`.
+*/
+std::string fresh_name(const std::string& base,
+                       std::unordered_set<std::string>& taken);
+
+/**
+   Is a top level lambda a CAF: a thunk with no free variables?
+*/
+bool is_caf(const ast::lambda& lam);
+
+/**
+   The static reference table of each top level binding: the top level
+   bindings it refers to which are, or refer to, a CAF. Bindings which
+   cannot reach a CAF are left out so that the garbage collector does not
+   have to visit them.
+
+   Every info table generated for the code of a binding, including its let
+   bound closures and case continuations, shares the binding's table.
+*/
+using srt_map = std::unordered_map<std::string, std::vector<std::string>>;
+
+/**
+   @param bindings      The top level bindings.
+   @param external_cafs Top level names bound outside of `bindings` which
+                        are, or refer to, a CAF.
+   @return              The static reference table of each binding: the
+                        external names first, by name, then the bindings
+                        in the order they are defined.
+*/
+srt_map static_reference_tables(ast::sequence<ast::binding>& bindings,
+                                const std::unordered_set<std::string>& external_cafs = {});
+}
+}
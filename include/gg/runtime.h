@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gg {
+namespace runtime {
+/**
+   A machine word, the unit of the STG stack and of closure payloads.
+*/
+using word = std::uintptr_t;
+
+struct closure;
+
+/**
+   The type of generated code.
+
+   A continuation never calls the next piece of code directly, instead it
+   stores it in `registers::next` and returns to the trampoline in
+   `capability::run`. This keeps the C stack flat and gives the scheduler a
+   chance to run between any two continuations.
+*/
+using continuation = void (*)();
+
+/**
+   Copy a closure out of the space being collected.
+
+   Generated evacuation code calls `gg_copy` with the size of the closure.
+   Most closures have none; see `closure_layout`.
+*/
+using evacuator = closure* (*)(closure*);
+
+/**
+   Evacuate every closure that a closure points to, by calling `gg_evacuate`
+   on each of its pointer fields. Most closures have none; see
+   `closure_layout`.
+
+   @return The size of the closure in words.
+*/
+using scavenger = std::size_t (*)(closure*);
+
+/**
+   The runtime view of the `info_table` struct declared by
+   `gg::compiler::context::make_info_table_type`.
+*/
+struct info_table {
+    continuation entry_code;
+    unsigned long arity;
+    evacuator evacuation_code;
+    scavenger scavenge_code;
+
+    /**
+       For stack frames, the packed size and pointer bitmap built by
+       `frame_layout`. For heap closures, the packed field counts and
+       constructor tag built by `closure_layout`.
+    */
+    unsigned long layout;
+
+    /**
+       The static reference table: a null terminated array of the static
+       closures that the code may reference which can reach a CAF, or
+       `nullptr`.
+    */
+    closure* const* srt;
+
+    /**
+       The static closures which can stand for the heap closures of this
+       info table, which the collector replaces copies with, or `nullptr`.
+       For a nullary constructor this is its one closure; for a closure of
+       one raw word it is the closures for `min_shared_value` up to
+       `max_shared_value` in order. See `shared_closure`.
+    */
+    closure* shared = nullptr;
+};
+
+/**
+   The runtime view of the `closure` struct declared by
+   `gg::compiler::context::make_closure_type`.
+*/
+struct closure {
+    const info_table* info;
+    word payload[];
+};
+
+/**
+   Build the `layout` field of a heap closure's info table.
+
+   The payload of a closure is its pointer fields followed by its raw
+   words. A closure whose info table has no evacuation and scavenge code is
+   copied and scavenged from its layout alone, which is everything but a
+   few runtime objects.
+
+   @param pointers The number of pointer fields. A null pointer field is
+                   allowed.
+   @param raw      The number of raw words after the pointer fields.
+   @param tag      The constructor's tag, or 0 if the closure is not a
+                   constructor.
+   @return         The packed layout.
+*/
+constexpr unsigned long closure_layout(std::size_t pointers,
+                                       std::size_t raw,
+                                       unsigned long tag = 0) {
+    return pointers | raw << 16 | tag << 32;
+}
+
+/**
+   The most pointer fields, or raw words, that `closure_layout` can
+   describe.
+*/
+constexpr std::size_t max_closure_fields = 0xffff;
+
+inline std::size_t closure_pointers(const info_table* info) {
+    return info->layout & 0xffff;
+}
+
+inline std::size_t closure_raw_words(const info_table* info) {
+    return info->layout >> 16 & 0xffff;
+}
+
+inline unsigned long closure_tag(const info_table* info) {
+    return info->layout >> 32;
+}
+
+/**
+   @return The size in words of a closure described by its layout,
+           including the info table pointer.
+*/
+inline std::size_t closure_size(const info_table* info) {
+    return 1 + closure_pointers(info) + closure_raw_words(info);
+}
+
+/**
+   The range of the raw words shared by closures of one raw word, which
+   covers the characters of Latin-1 and a few negative numbers.
+*/
+constexpr std::int64_t min_shared_value = -16;
+constexpr std::int64_t max_shared_value = 255;
+constexpr std::size_t shared_values = max_shared_value - min_shared_value + 1;
+
+/**
+   @param c    A closure.
+   @param info Its info table.
+   @return     The static closure with the same value as `c`, or `nullptr`
+               if there is none.
+*/
+inline closure* shared_closure(const closure* c, const info_table* info) {
+    if (!info->shared) {
+        return nullptr;
+    }
+    if (closure_size(info) == 1) {
+        return info->shared;
+    }
+    auto value = static_cast<std::int64_t>(c->payload[0]);
+    if (closure_size(info) != 2 || closure_pointers(info) ||
+        value < min_shared_value || value > max_shared_value) {
+        return nullptr;
+    }
+    return reinterpret_cast<closure*>(reinterpret_cast<word*>(info->shared) +
+                                      2 * (value - min_shared_value));
+}
+
+/**
+   The STG machine registers.
+
+   There is one set of registers per capability; a thread's registers are
+   saved into the thread object when it is descheduled.
+*/
+struct registers {
+    /**
+       The continuation to run when the current continuation returns, or
+       `nullptr` when the thread has finished.
+    */
+    continuation next;
+
+    /**
+       The closure being entered, or the value being returned.
+    */
+    closure* node;
+
+    /**
+       The top of the STG stack. The stack grows down towards `sp_limit`.
+    */
+    word* sp;
+    word* sp_limit;
+
+    /**
+       The topmost update frame on the stack, or `nullptr`.
+    */
+    word* su;
+
+    /**
+       The next free word of the nursery, and the end of the current nursery
+       block. These belong to the capability, not to the thread.
+    */
+    word* hp;
+    word* hp_limit;
+};
+}
+}
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "gg/config.h"
+#include "gg/gc.h"
+#include "gg/heap.h"
+#include "gg/runtime.h"
+#include "gg/spinlock.h"
+#include "gg/stack.h"
+#include "gg/stats.h"
+
+namespace gg {
+namespace runtime {
+enum class thread_status {
+    runnable,
+    blocked,
+    finished,
+    killed,
+};
+
+/**
+   A green thread.
+
+   Threads are cheap: each one is a small heap allocated STG stack and a
+   saved copy of the registers. Many threads are multiplexed onto the fixed
+   pool of capabilities owned by a `scheduler`.
+*/
+struct thread {
+    std::int64_t id;
+    std::atomic<thread_status> status{thread_status::runnable};
+
+    /**
+       The registers of the thread while it is not running. `hp` and
+       `hp_limit` are not saved.
+    */
+    registers saved;
+
+    /**
+       The number of words in the chunks of the thread's stack.
+    */
+    std::size_t stack_words;
+
+    /**
+       A chunk kept after the stack shrinks, or `nullptr`.
+    */
+    stack_chunk* spare = nullptr;
+
+    /**
+       Intrusive link for the run queue and the mvar wait queues. A thread
+       is on at most one queue at a time.
+    */
+    thread* link = nullptr;
+
+    /**
+       The value a blocked `putMVar#` is waiting to write.
+    */
+    closure* blocked_value = nullptr;
+
+    /**
+       The value handed to a blocked `takeMVar#` by the thread that woke it.
+    */
+    closure* delivered = nullptr;
+
+    /**
+       Set when a blocked thread has been descheduled; whoever wakes it is
+       responsible for putting it back on the run queue.
+    */
+    bool parked = false;
+    std::mutex lock;
+
+    /**
+       Why the thread was killed.
+    */
+    std::string error;
+
+    /**
+       @param id          The thread id.
+       @param stack_words The size of the first chunk of the thread's stack
+                          in words.
+    */
+    thread(std::int64_t id, std::size_t stack_words);
+
+    ~thread();
+};
+
+struct scheduler;
+
+/**
+   A capability is the right to run STG code: one OS thread with one set of
+   registers.
+*/
+struct capability {
+    scheduler& sched;
+    std::size_t index;
+    registers regs;
+
+    /**
+       Set asynchronously by the scheduler's ticker when the current thread's
+       timeslice is over.
+    */
+    std::atomic<bool> context_switch{false};
+
+    /**
+       Set by the running thread when it yields or blocks.
+    */
+    bool stop = false;
+
+    /**
+       The thread being run on this capability.
+    */
+    thread* current = nullptr;
+
+    /**
+       The blocks of the nursery, and the one being allocated from.
+    */
+    block* nursery = nullptr;
+    block* nursery_current = nullptr;
+
+    /**
+       Old closures written to since the last collection.
+    */
+    std::vector<closure*> remembered;
+
+    /**
+       Pointers overwritten in old closures while the concurrent collector
+       is marking, which it has not necessarily seen yet.
+    */
+    std::vector<closure*> snapshot_log;
+
+    /**
+       The thunks this capability has updated with their values. Only the
+       capability writes it.
+    */
+    std::atomic<std::uint64_t> thunk_updates{0};
+
+    capability(scheduler& sched, std::size_t index);
+
+    /**
+       Empty the nursery after a collection, freeing any blocks it grew by.
+    */
+    void reset_nursery();
+
+    /**
+       Point `hp_limit` back at the end of the current nursery block after
+       the scheduler cleared it.
+    */
+    void restore_hp_limit();
+
+    /**
+       Run a thread until it finishes, blocks, yields or is preempted.
+
+       @param t The thread to run.
+    */
+    void run(thread& t);
+};
+
+/**
+   The capability owned by the calling OS thread, if any.
+*/
+extern thread_local capability* current_capability;
+
+/**
+   Exception raised when every live thread is blocked.
+*/
+struct deadlock : public std::exception {
+    virtual const char* what() const noexcept {
+        return "thread blocked indefinitely";
+    }
+};
+
+/**
+   Exception raised when the main thread is killed.
+*/
+struct thread_killed : public std::exception {
+private:
+    std::string msg;
+
+public:
+    thread_killed(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+/**
+   An M:N scheduler for green threads.
+*/
+struct scheduler {
+private:
+    std::vector<std::unique_ptr<capability>> capabilities;
+    std::vector<std::thread> workers;
+    std::thread ticker;
+
+    std::mutex lock;
+    std::condition_variable work_available;
+    std::condition_variable main_done;
+    std::condition_variable gc_done;
+    bool gc_requested = false;
+    std::size_t gc_waiting = 0;
+    std::size_t gc_epoch = 0;
+    thread* run_queue_head = nullptr;
+    thread* run_queue_tail = nullptr;
+    std::size_t running = 0;
+    bool shutting_down = false;
+    bool deadlocked = false;
+
+    std::unordered_set<thread*> threads;
+    std::atomic<std::int64_t> next_thread_id{1};
+
+    /**
+       The threads `run_all` is waiting for, and how many of them have not
+       finished or been killed.
+    */
+    std::unordered_set<thread*> roots;
+    std::size_t roots_running = 0;
+
+    /**
+       The time spent in earlier runs, and when the current one started.
+    */
+    std::chrono::nanoseconds run_time{0};
+    std::chrono::steady_clock::time_point run_started;
+    bool in_run = false;
+
+    void worker(capability& cap);
+    void interrupt_all();
+    void sync_gc(std::unique_lock<std::mutex>& guard);
+    void tick();
+
+    /**
+       Create a thread which enters `c`, without queueing it. The caller
+       must hold `lock`.
+    */
+    thread* new_thread(closure* c);
+    void push(thread* t);
+    thread* pop();
+    void retire(thread* t);
+    void shutdown();
+    void report_stats();
+
+public:
+    const config options;
+    heap memory;
+    collector gc;
+
+    /**
+       @param options The runtime options.
+    */
+    scheduler(const config& options = config());
+
+    ~scheduler();
+
+    /**
+       Create a new thread which enters the given closure.
+
+       @param c The closure to evaluate.
+       @return  The id of the new thread, which another capability may
+                have run to completion and freed by the time this returns.
+    */
+    std::int64_t fork(closure* c);
+
+    /**
+       Make a thread which was blocked runnable again.
+
+       @param t The thread to wake.
+    */
+    void wake(thread* t);
+
+    /**
+       Stop every capability at its next safe point and collect garbage.
+    */
+    void request_gc();
+
+    /**
+       @return What the runtime has done so far. Allocation in the nurseries
+               is only counted once a collection or the end of a run has
+               flushed it.
+    */
+    rts_stats statistics();
+
+    /**
+       Evaluate a closure on a new thread and wait for it to finish.
+
+       @param main The closure to evaluate.
+       @throws deadlock       if every thread becomes blocked.
+       @throws thread_killed  if `main` is killed.
+       @return The value `main` returned, which lives until the next run or
+               until the scheduler is destroyed.
+    */
+    closure* run(closure* main);
+
+    /**
+       Evaluate each closure on its own thread and wait for all of them to
+       finish, running them on every capability at once.
+
+       A scheduler can run any number of times; the heap, and the values of
+       CAFs, carry over from one run to the next. Other threads still
+       running when the roots finish are left to carry on in the next run.
+
+       @param roots The closures to evaluate.
+       @throws deadlock       if every thread becomes blocked.
+       @throws thread_killed  if a root is killed.
+       @return The value each root returned, in order, which live until the
+               next run or until the scheduler is destroyed.
+    */
+    std::vector<closure*> run_all(const std::vector<closure*>& roots);
+};
+
+/**
+   A synchronisation variable which is either empty or full. Mvars live in
+   the heap; the thread queues are not traced because a blocked thread is
+   always in the scheduler's set of threads.
+*/
+struct mvar {
+    const info_table* info;
+    closure* value;
+    thread* takers_head;
+    thread* takers_tail;
+    thread* putters_head;
+    thread* putters_tail;
+    spinlock lock;
+};
+
+extern const info_table mvar_info;
+}
+}
+
+/**
+   Entry points called from generated code.
+
+   Operations which may block take their continuation from
+   `registers::next`; it is run once the operation completes, with any
+   result in `registers::node`.
+*/
+extern "C" {
+/**
+   The registers of the capability owned by the calling OS thread. Generated
+   code reaches the heap pointer and limit through this.
+*/
+extern thread_local gg::runtime::registers* gg_base;
+
+/**
+   `fork# {c}`
+
+   @return The id of the new thread.
+*/
+std::int64_t gg_fork(gg::runtime::closure* c);
+
+/**
+   `yield# {}`
+*/
+void gg_yield();
+
+/**
+   `newMVar# {}`
+
+   @return A new empty mvar.
+*/
+gg::runtime::closure* gg_new_mvar();
+
+/**
+   `takeMVar# {m}`
+*/
+void gg_take_mvar(gg::runtime::closure* m);
+
+/**
+   `putMVar# {m, v}`
+*/
+void gg_put_mvar(gg::runtime::closure* m, gg::runtime::closure* v);
+}
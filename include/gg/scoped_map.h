@@ -80,7 +80,7 @@ public:
 
     void new_global(const key_type& key, const mapped_type& value) {
         auto e = globals.find(key);
-        if (e == globals.cend()) {
+        if (e != globals.cend()) {
             throw bad_name_add(key);
         }
         globals.emplace(key, value);
@@ -90,7 +90,7 @@ public:
         auto& current_locals = locals.back();
 
         auto e = current_locals.find(key);
-        if (e == current_locals.cend()) {
+        if (e != current_locals.cend()) {
             throw bad_name_add(key);
         }
         current_locals.emplace(key, value);
@@ -98,13 +98,15 @@ public:
     }
 
     const mapped_type& lookup(const key_type& key) {
-        auto from_globals = globals->find(key);
-        if (from_globals != globals->cend()) {
-            return from_globals->second;
+        for (auto scope = locals.rbegin(); scope != locals.rend(); ++scope) {
+            auto from_locals = scope->find(key);
+            if (from_locals != scope->cend()) {
+                return from_locals->second;
+            }
         }
-        auto from_locals = locals.back().find(key);
-        if (from_locals != locals->cend()) {
-            return from_locals->second;
+        auto from_globals = globals.find(key);
+        if (from_globals != globals.cend()) {
+            return from_globals->second;
         }
         throw bad_name_lookup(key);
     }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "gg/ast.h"
+#include "gg/unboxing.h"
+
+namespace gg {
+namespace compiler {
+/**
+   The payload slot selected by each selector thunk.
+*/
+using selector_map = std::unordered_map<const ast::lambda*, std::size_t>;
+
+/**
+   Find the let bound selector thunks of a program: thunks whose only free
+   variable is scrutinised by a case with one algebraic alternative which
+   returns one of the boxed fields it binds,
+
+       {x} \u {} -> case x of C a b -> a
+
+   Each one is allocated with the runtime's selector info table for its
+   slot, and is made updatable to match its layout. Top level thunks are
+   CAFs and keep code of their own.
+
+   @param bindings The top level bindings, after free variables are known.
+   @param layouts  The declared constructors.
+   @return         The selector thunks.
+*/
+selector_map find_selectors(ast::sequence<ast::binding>& bindings,
+                            const constructor_layouts& layouts);
+}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "gg/compiler.h"
+
+/**
+   Heap snapshots: the values of evaluated CAFs written to an image file, so
+   that a later process running the same program can start with them
+   already computed.
+
+   An image holds a copy of everything reachable from those values. Each
+   pointer in it is relative to the start of the objects or names a top
+   level binding, and each info table is named by its constructor or its
+   runtime object kind. Loading maps the file, relocates it in place and
+   points the CAFs at it.
+
+   Only immutable data can be saved: constructors, `Integer`s and frozen
+   arrays. Loaded objects live outside the heap, like static closures; they
+   point at nothing in the heap, so the collector never has to look inside
+   them.
+*/
+namespace gg {
+/**
+   Exception raised when a heap cannot be saved, or an image cannot be
+   loaded.
+*/
+struct bad_snapshot : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_snapshot(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+/**
+   A loaded image, which must outlive every use of the CAFs it set.
+*/
+struct snapshot_image {
+private:
+    void* base = nullptr;
+    std::size_t bytes = 0;
+
+public:
+    snapshot_image(void* base, std::size_t bytes);
+
+    snapshot_image(snapshot_image&& other);
+    snapshot_image& operator=(snapshot_image&& other);
+
+    snapshot_image(const snapshot_image&) = delete;
+
+    ~snapshot_image();
+};
+
+/**
+   Write the value of every evaluated CAF to an image. Nothing may be
+   running.
+
+   @param compiled The bindings of the program.
+   @param path     The file to write.
+   @throws bad_snapshot if a value reaches something which is not
+                        immutable data, or the file cannot be written.
+*/
+void save_snapshot(const compiler::session& compiled, const std::string& path);
+
+/**
+   Map an image and set the CAFs it holds. Nothing may be running.
+
+   @param compiled The bindings of the program, which must define every
+                   name the image uses with the same constructor fields.
+   @param path     The file to read.
+   @throws bad_snapshot if the image is malformed or does not match the
+                        program.
+   @return The mapped image.
+*/
+snapshot_image load_snapshot(const compiler::session& compiled, const std::string& path);
+}
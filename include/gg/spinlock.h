@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+namespace gg {
+namespace runtime {
+/**
+   A lock small enough to live inside of a heap object.
+*/
+struct spinlock {
+private:
+    std::atomic<bool> held{false};
+
+public:
+    void lock() {
+        while (held.exchange(true, std::memory_order_acquire)) {
+            while (held.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void unlock() {
+        held.store(false, std::memory_order_release);
+    }
+};
+}
+}
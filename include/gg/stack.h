@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+
+#include "gg/runtime.h"
+
+namespace gg {
+namespace runtime {
+/**
+   A piece of an STG stack.
+
+   Stacks start as a single small chunk; when a function needs more stack
+   than is left in the current chunk a new chunk is linked on top of it.
+   The bottom frame of every chunk but the first is an underflow frame which
+   returns into the chunk below.
+*/
+struct stack_chunk {
+    /**
+       The chunk below this one, or `nullptr`.
+    */
+    stack_chunk* prev;
+
+    /**
+       The stack pointer of this chunk while a newer chunk is in use.
+    */
+    word* saved_sp;
+
+    /**
+       The size of `data` in words.
+    */
+    std::size_t words;
+
+    word data[];
+};
+
+/**
+   Build the `layout` field of a frame's info table.
+
+   @param size     The number of words in the frame after its info table.
+   @param pointers A bitmap of which of those words are closure pointers,
+                   starting from the lowest bit.
+   @return         The packed layout.
+*/
+constexpr unsigned long frame_layout(std::size_t size, unsigned long pointers) {
+    return size | pointers << 6;
+}
+
+/**
+   The largest frame that `frame_layout` can describe.
+*/
+constexpr std::size_t max_frame_words = 58;
+
+inline std::size_t frame_size(const info_table* info) {
+    return info->layout & 63;
+}
+
+inline unsigned long frame_pointers(const info_table* info) {
+    return info->layout >> 6;
+}
+
+/**
+   The info table of the frame at the bottom of each chunk but the first.
+*/
+extern const info_table underflow_frame_info;
+
+/**
+   The info table of the frame at the bottom of every thread's stack.
+   Returning to it finishes the thread.
+*/
+extern const info_table stop_frame_info;
+
+/**
+   @param sp_limit The `sp_limit` register.
+   @return         The chunk that the stack pointer is in.
+*/
+inline stack_chunk* chunk_of(word* sp_limit) {
+    return reinterpret_cast<stack_chunk*>(
+        reinterpret_cast<char*>(sp_limit) - offsetof(stack_chunk, data));
+}
+
+/**
+   Allocate a chunk.
+
+   @param words The size of the chunk in words.
+   @return      The new chunk.
+*/
+stack_chunk* new_chunk(std::size_t words);
+
+void free_chunk(stack_chunk* chunk);
+
+/**
+   Set up a new stack with just a stop frame.
+
+   @param regs  The registers to point at the new stack.
+   @param words The size of the first chunk in words.
+*/
+void new_stack(registers& regs, std::size_t words);
+
+/**
+   Free every chunk of a stack.
+
+   @param regs The registers pointing at the stack.
+*/
+void free_stack(registers& regs);
+
+/**
+   Call a function on every frame of a stack, from the top of the stack to
+   the bottom, skipping the stop and underflow frames.
+
+   The stack must only contain complete frames, which is the case between
+   any two continuations.
+
+   @param regs The registers pointing at the stack.
+   @param f    The function to call with the frame's `const info_table*`
+               and a `word*` to the frame.
+*/
+template<typename F>
+void for_each_frame(const registers& regs, F&& f) {
+    word* sp = regs.sp;
+    stack_chunk* chunk = chunk_of(regs.sp_limit);
+    while (true) {
+        auto info = reinterpret_cast<const info_table*>(sp[0]);
+        if (info == &stop_frame_info) {
+            return;
+        }
+        if (info == &underflow_frame_info) {
+            chunk = chunk->prev;
+            sp = chunk->saved_sp;
+            continue;
+        }
+
+        f(info, sp);
+        sp += frame_size(info) + 1;
+    }
+}
+
+/**
+   Call a function on the address of every closure pointer in the frames of
+   a stack, from the top of the stack to the bottom.
+
+   @param regs The registers pointing at the stack.
+   @param f    The function to call with a `closure**`.
+*/
+template<typename F>
+void for_each_stack_pointer(const registers& regs, F&& f) {
+    for_each_frame(regs, [&f](const info_table* info, word* sp) {
+        unsigned long pointers = frame_pointers(info);
+        for (std::size_t n = 0; pointers; ++n, pointers >>= 1) {
+            if (pointers & 1) {
+                f(reinterpret_cast<closure**>(&sp[n + 1]));
+            }
+        }
+    });
+}
+}
+}
+
+extern "C" {
+/**
+   Called by generated code on function entry when the current chunk has
+   fewer than `words` words left:
+
+       if (sp - words < sp_limit && !gg_grow_stack(words)) return;
+
+   @param words The number of words the function will push.
+   @return      Nonzero if the stack was grown. Otherwise the thread has been
+                killed with a stack overflow and the caller should return.
+*/
+int gg_grow_stack(std::size_t words);
+}
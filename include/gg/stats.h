@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#include "gg/config.h"
+
+namespace gg {
+namespace runtime {
+/**
+   What the runtime has done so far. Times are wall clock time.
+*/
+struct rts_stats {
+    std::uint64_t allocated_bytes = 0;
+
+    /**
+       Bytes copied or slid by collections, including promotion.
+    */
+    std::uint64_t copied_bytes = 0;
+
+    std::uint64_t minor_collections = 0;
+    std::uint64_t major_collections = 0;
+
+    /**
+       Marking cycles finished by the concurrent old generation collector,
+       which are not counted as major collections.
+    */
+    std::uint64_t concurrent_cycles = 0;
+
+    std::chrono::nanoseconds minor_gc_time{0};
+    std::chrono::nanoseconds major_gc_time{0};
+
+    /**
+       The longest any one collection stopped the world for.
+    */
+    std::chrono::nanoseconds max_pause{0};
+
+    /**
+       The most bytes found live in the old generation by a major
+       collection or a concurrent cycle.
+    */
+    std::uint64_t max_residency_bytes = 0;
+
+    std::uint64_t thunk_updates = 0;
+
+    /**
+       The time spent running, summed over every run of the scheduler.
+    */
+    std::chrono::nanoseconds elapsed{0};
+
+    inline std::chrono::nanoseconds gc_time() const {
+        return minor_gc_time + major_gc_time;
+    }
+
+    inline std::chrono::nanoseconds mutator_time() const {
+        return elapsed - gc_time();
+    }
+};
+
+/**
+   Write statistics in a form meant to be read by people.
+*/
+void format_stats(std::ostream& out, const rts_stats& stats);
+
+/**
+   Write statistics as one JSON object on one line, with times in seconds.
+*/
+void format_stats_json(std::ostream& out, const rts_stats& stats);
+}
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+
+#include "gg/runtime.h"
+#include "gg/scheduler.h"
+
+namespace gg {
+namespace runtime {
+/**
+   Updatable closures reserve the first word of their payload; free
+   variables start at `payload[1]`. After the update the word holds the
+   value of the thunk. It counts as the thunk's first pointer field, so it
+   must be null until then.
+*/
+constexpr std::size_t thunk_result_slot = 0;
+
+/**
+   A thunk which is under evaluation.
+*/
+extern const info_table blackhole_info;
+
+/**
+   A thunk which is under evaluation and which other threads are waiting
+   on. The result slot holds the list of waiting threads.
+*/
+extern const info_table blocking_blackhole_info;
+
+/**
+   A thunk which has been updated with its value.
+*/
+extern const info_table indirection_info;
+
+/**
+   The info table of update frames.
+
+   An update frame is three words on the STG stack: the info table, the
+   closure to update, and the previous update frame.
+*/
+extern const info_table update_frame_info;
+
+constexpr std::size_t update_frame_words = 3;
+
+/**
+   Selector thunks, `case x of C ... a ... -> a`, are given one of the
+   runtime's selector info tables rather than code of their own, so that
+   the garbage collector can recognise them. Once the selectee is evaluated
+   a collection replaces the thunk with the selected field, which stops the
+   thunk from keeping the rest of the constructor alive.
+
+   A selector thunk is updatable and holds the selectee in the payload word
+   after the result. Fields at payload slots of `max_selector_slot` and
+   above are selected by ordinary thunks.
+*/
+constexpr std::size_t max_selector_slot = 16;
+constexpr std::size_t selectee_slot = thunk_result_slot + 1;
+
+/**
+   A static closure which kills any thread that enters it.
+*/
+struct error_closure {
+    const info_table* info;
+    const char* message;
+};
+
+/**
+   The info table of every `error_closure`.
+*/
+extern const info_table error_info;
+
+/**
+   Entered by a thread which demands the value of a thunk it is already
+   evaluating: `<<loop>>`.
+*/
+extern error_closure nontermination_closure;
+
+/**
+   Entered by a thread which has run out of stack.
+*/
+extern error_closure stack_overflow_closure;
+
+/**
+   Entered by a thread which tried to allocate a closure larger than a heap
+   block.
+*/
+extern error_closure heap_overflow_closure;
+
+/**
+   Entered by a thread whose case has no alternative for the value of its
+   scrutinee.
+*/
+extern error_closure match_failure_closure;
+
+/**
+   Skip over any indirections.
+
+   @param c A closure.
+   @return  The first closure which is not an indirection.
+*/
+inline closure* follow_indirections(closure* c) {
+    while (c->info == &indirection_info) {
+        c = reinterpret_cast<closure*>(c->payload[thunk_result_slot]);
+    }
+    return c;
+}
+
+/**
+   Blackhole every thunk under evaluation by a thread which has not already
+   been claimed. This is called when the thread is descheduled.
+
+   @param t The thread.
+*/
+void lazy_blackhole(thread& t);
+
+/**
+   Kill the current thread. Every thunk it was evaluating is updated with
+   `error` so that any thread which demands them is killed too.
+
+   @param cap   The current capability.
+   @param error An `error_closure`.
+*/
+void raise(capability& cap, error_closure& error);
+}
+}
+
+extern "C" {
+/**
+   Called by the entry code of every updatable closure before evaluating the
+   body. Pushes an update frame and, when blackholing eagerly, claims the
+   thunk.
+
+   A blackholed thunk no longer keeps its free variables alive, so the
+   caller must read them before its first continuation boundary.
+
+   @param c The thunk being entered.
+   @return  Nonzero if the caller should evaluate the body. Otherwise
+            `registers::next` has been set and the caller should return.
+*/
+int gg_enter_thunk(gg::runtime::closure* c);
+
+/**
+   `gg_enter_thunk` for a CAF: a static thunk. The CAF is recorded so that
+   the garbage collector can find its value, and revert it once it is no
+   longer reachable.
+
+   @param c    The CAF being entered.
+   @param info The info table of the CAF.
+   @return     As for `gg_enter_thunk`.
+*/
+int gg_enter_caf(gg::runtime::closure* c, const gg::runtime::info_table* info);
+
+/**
+   Overwrite a thunk with an indirection to its value and wake any threads
+   blocked on it.
+
+   @param updatee The thunk.
+   @param value   The value of the thunk.
+*/
+void gg_update(gg::runtime::closure* updatee, gg::runtime::closure* value);
+
+/**
+   Called by generated code when no alternative of a case matches. Kills the
+   current thread with `match_failure_closure`; the caller should return.
+*/
+void gg_match_failure();
+
+/**
+   The info table of the selector thunks for each payload slot.
+*/
+extern const std::array<gg::runtime::info_table, gg::runtime::max_selector_slot>
+    gg_selector_info;
+}
+
+namespace gg {
+namespace runtime {
+/**
+   @param info An info table.
+   @return     Whether it is the info table of a selector thunk.
+*/
+inline bool is_selector_thunk(const info_table* info) {
+    return info >= gg_selector_info.data() &&
+           info < gg_selector_info.data() + gg_selector_info.size();
+}
+
+/**
+   @param info The info table of a selector thunk.
+   @return     The payload slot of the field it selects.
+*/
+inline std::size_t selector_slot(const info_table* info) {
+    return info - gg_selector_info.data();
+}
+}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "gg/ast.h"
+
+namespace gg {
+namespace compiler {
+/**
+   Exception raised when data declarations are inconsistent with each other
+   or with the constructors in the program.
+*/
+struct bad_declaration : public std::exception {
+private:
+    std::string msg;
+
+public:
+    bad_declaration(const std::string& msg) : msg(msg) {}
+
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+};
+
+/**
+   The fields of each declared constructor. Constructors which are not
+   declared have only boxed fields.
+*/
+using constructor_layouts = std::unordered_map<std::string, std::vector<ast::field_kind>>;
+
+/**
+   For each function which takes some arguments raw, what each of its
+   parameters holds.
+*/
+using raw_parameters = std::unordered_map<std::string, std::vector<ast::field_kind>>;
+
+/**
+   @param declarations The data declarations of a program.
+   @throws bad_declaration if a constructor is declared twice.
+   @return             The layout of each declared constructor.
+*/
+constructor_layouts
+declared_layouts(const ast::sequence<ast::data_declaration>& declarations);
+
+/**
+   Make constructor applications evaluate their strict fields.
+
+   A strict field holds the raw value. A literal, or a variable known to hold
+   a raw value, is stored as is. Any other variable is a boxed value; it is
+   evaluated and taken apart with the box for the field's type: a declared
+   constructor whose only field has that type, such as `data Int {!int}`.
+   Matching a strict field binds the raw value.
+
+   Variables hold raw values when they are bound to a strict field, or by a
+   case on a primitive operation or literal.
+
+   The free variable lists of lambdas are recomputed.
+
+   @param bindings The top level bindings.
+   @param layouts  The declared constructors.
+   @param externs  Top level names bound outside of `bindings`.
+   @throws bad_declaration if a constructor is used with the wrong number
+                           of fields, or a boxed value is stored in a strict
+                           field with no box declared for its type.
+*/
+void unbox_strict_fields(ast::sequence<ast::binding>& bindings,
+                         const constructor_layouts& layouts,
+                         const std::unordered_set<std::string>& externs = {});
+
+/**
+   Split top level functions which immediately unbox some of their
+   arguments into a worker, which takes those arguments raw, and a
+   wrapper, which unboxes them and calls the worker.
+
+   Saturated calls of the function are replaced by the wrapper's body, so
+   a caller that builds a box just to pass it can have the box removed by
+   `replace_scalars`. The worker reboxes an argument if it uses the boxed
+   value too.
+
+   The free variable lists of lambdas are recomputed.
+
+   Only functions in `bindings` are split; calls of functions bound
+   outside of them keep calling the function itself.
+
+   @param bindings The top level bindings.
+   @param layouts  The declared constructors.
+   @param externs  Top level names bound outside of `bindings`.
+   @return         What each parameter of each worker holds.
+*/
+raw_parameters split_workers(ast::sequence<ast::binding>& bindings,
+                             const constructor_layouts& layouts,
+                             const std::unordered_set<std::string>& externs = {});
+
+/**
+   Where each field of a constructor is stored: boxed fields are pointers,
+   which come first in the payload, followed by the raw strict fields. Both
+   keep their declared order.
+
+   @param fields The declared fields of the constructor.
+   @return       The payload index of each field.
+*/
+std::vector<std::size_t> field_slots(const std::vector<ast::field_kind>& fields);
+
+/**
+   The number of free variables of each lambda which are pointers. The rest
+   hold raw values and are stored after them, as the raw words of the
+   closure.
+*/
+using pointer_fields = std::unordered_map<const ast::lambda*, std::size_t>;
+
+/**
+   Reorder the free variables of every lambda so that the pointers come
+   first, keeping the order within the pointers and within the raw values.
+
+   This must run after every pass which recomputes free variables.
+
+   @param bindings The top level bindings.
+   @param layouts  The declared constructors.
+   @param workers  The result of `split_workers`.
+   @return         The number of pointers among each lambda's free
+                   variables.
+*/
+pointer_fields order_closure_fields(ast::sequence<ast::binding>& bindings,
+                                    const constructor_layouts& layouts,
+                                    const raw_parameters& workers);
+}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "gg/ast.h"
+
+namespace gg {
+namespace compiler {
+/**
+   Clear the update flag of thunks which never need to be updated:
+
+   - let bound thunks which are entered at most once, because nothing would
+     ever read the updated value;
+   - thunks whose body is a constructor application, because entering them
+     costs no more than reading an indirection would.
+
+   A thunk counts as entered at most once if it is the head of at most one
+   application on every path through its scope, and that application is
+   not inside a lambda which may run more than once. Passing a thunk as an
+   argument or storing it in a constructor counts as many entries because
+   it escapes.
+
+   @param bindings The top level bindings.
+*/
+void infer_update_flags(ast::sequence<ast::binding>& bindings);
+}
+}
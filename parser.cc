@@ -0,0 +1,1763 @@
+// A Bison parser, made by GNU Bison 3.8.2.
+
+// Skeleton implementation for Bison LALR(1) parsers in C++
+
+// Copyright (C) 2002-2015, 2018-2021 Free Software Foundation, Inc.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// As a special exception, you may create a larger work that contains
+// part or all of the Bison parser skeleton and distribute that work
+// under terms of your choice, so long as that work isn't itself a
+// parser generator using the skeleton or a modified version thereof
+// as a parser skeleton.  Alternatively, if you modify or redistribute
+// the parser skeleton itself, you may (at your option) remove this
+// special exception, which will cause the skeleton and the resulting
+// Bison output files to be licensed under the GNU General Public
+// License without this special exception.
+
+// This special exception was added by the Free Software Foundation in
+// version 2.2 of Bison.
+
+// DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+// especially those whose name start with YY_ or yy_.  They are
+// private implementation details that can be changed or removed.
+
+
+
+
+
+#include "parser.hh"
+
+
+// Unqualified %code blocks.
+#line 27 "/tmp/mine/base.yy"
+
+#include "gg/lexer.h"
+#include "gg/parse.h"
+
+// use the lex method of the lexer argument
+#define yylex lex.yylex
+
+namespace {
+template<typename T>
+auto make_shared_seq(const gg::parser::location_type &loc,
+                     const std::initializer_list<std::shared_ptr<T>> &es) {
+    return std::make_shared<gg::ast::sequence<T>>(
+        loc,
+        std::vector<std::shared_ptr<T>>(es));
+}
+}
+
+#line 64 "parser.cc"
+
+
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> // FIXME: INFRINGES ON USER NAME SPACE.
+#   define YY_(msgid) dgettext ("bison-runtime", msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(msgid) msgid
+# endif
+#endif
+
+
+// Whether we are compiled with exception support.
+#ifndef YY_EXCEPTIONS
+# if defined __GNUC__ && !defined __EXCEPTIONS
+#  define YY_EXCEPTIONS 0
+# else
+#  define YY_EXCEPTIONS 1
+# endif
+#endif
+
+#define YYRHSLOC(Rhs, K) ((Rhs)[K].location)
+/* YYLLOC_DEFAULT -- Set CURRENT to span from RHS[1] to RHS[N].
+   If N is 0, then set CURRENT to the empty location which ends
+   the previous symbol: RHS[0] (always defined).  */
+
+# ifndef YYLLOC_DEFAULT
+#  define YYLLOC_DEFAULT(Current, Rhs, N)                               \
+    do                                                                  \
+      if (N)                                                            \
+        {                                                               \
+          (Current).begin  = YYRHSLOC (Rhs, 1).begin;                   \
+          (Current).end    = YYRHSLOC (Rhs, N).end;                     \
+        }                                                               \
+      else                                                              \
+        {                                                               \
+          (Current).begin = (Current).end = YYRHSLOC (Rhs, 0).end;      \
+        }                                                               \
+    while (false)
+# endif
+
+
+// Enable debugging if requested.
+#if YYDEBUG
+
+// A pseudo ostream that takes yydebug_ into account.
+# define YYCDEBUG if (yydebug_) (*yycdebug_)
+
+# define YY_SYMBOL_PRINT(Title, Symbol)         \
+  do {                                          \
+    if (yydebug_)                               \
+    {                                           \
+      *yycdebug_ << Title << ' ';               \
+      yy_print_ (*yycdebug_, Symbol);           \
+      *yycdebug_ << '\n';                       \
+    }                                           \
+  } while (false)
+
+# define YY_REDUCE_PRINT(Rule)          \
+  do {                                  \
+    if (yydebug_)                       \
+      yy_reduce_print_ (Rule);          \
+  } while (false)
+
+# define YY_STACK_PRINT()               \
+  do {                                  \
+    if (yydebug_)                       \
+      yy_stack_print_ ();                \
+  } while (false)
+
+#else // !YYDEBUG
+
+# define YYCDEBUG if (false) std::cerr
+# define YY_SYMBOL_PRINT(Title, Symbol)  YY_USE (Symbol)
+# define YY_REDUCE_PRINT(Rule)           static_cast<void> (0)
+# define YY_STACK_PRINT()                static_cast<void> (0)
+
+#endif // !YYDEBUG
+
+#define yyerrok         (yyerrstatus_ = 0)
+#define yyclearin       (yyla.clear ())
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYRECOVERING()  (!!yyerrstatus_)
+
+#line 5 "/tmp/mine/base.yy"
+namespace gg {
+#line 157 "parser.cc"
+
+  /// Build a parser object.
+  parser::parser (gg::lexer &lex_yyarg, std::shared_ptr<gg::ast::sequence<gg::ast::binding>> &result_yyarg)
+#if YYDEBUG
+    : yydebug_ (false),
+      yycdebug_ (&std::cerr),
+#else
+    :
+#endif
+      lex (lex_yyarg),
+      result (result_yyarg)
+  {}
+
+  parser::~parser ()
+  {}
+
+  parser::syntax_error::~syntax_error () YY_NOEXCEPT YY_NOTHROW
+  {}
+
+  /*---------.
+  | symbol.  |
+  `---------*/
+
+
+
+  // by_state.
+  parser::by_state::by_state () YY_NOEXCEPT
+    : state (empty_state)
+  {}
+
+  parser::by_state::by_state (const by_state& that) YY_NOEXCEPT
+    : state (that.state)
+  {}
+
+  void
+  parser::by_state::clear () YY_NOEXCEPT
+  {
+    state = empty_state;
+  }
+
+  void
+  parser::by_state::move (by_state& that)
+  {
+    state = that.state;
+    that.clear ();
+  }
+
+  parser::by_state::by_state (state_type s) YY_NOEXCEPT
+    : state (s)
+  {}
+
+  parser::symbol_kind_type
+  parser::by_state::kind () const YY_NOEXCEPT
+  {
+    if (state == empty_state)
+      return symbol_kind::S_YYEMPTY;
+    else
+      return YY_CAST (symbol_kind_type, yystos_[+state]);
+  }
+
+  parser::stack_symbol_type::stack_symbol_type ()
+  {}
+
+  parser::stack_symbol_type::stack_symbol_type (YY_RVREF (stack_symbol_type) that)
+    : super_type (YY_MOVE (that.state), YY_MOVE (that.location))
+  {
+    switch (that.kind ())
+    {
+      case symbol_kind::S_UPDATEFLAG: // "updateflag"
+        value.YY_MOVE_OR_COPY< bool > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_PRIMOP: // "primop"
+        value.YY_MOVE_OR_COPY< gg::ast::primopcode > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_INTEGER_LIT: // "int"
+        value.YY_MOVE_OR_COPY< int64_t > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_algalt: // algalt
+      case symbol_kind::S_primalt: // primalt
+      case symbol_kind::S_defaultalt: // defaultalt
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::alternative> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_atom: // atom
+      case symbol_kind::S_atomlistelem: // atomlistelem
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::atom> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_binding: // binding
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::binding> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_constructor: // constructor
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::constructor> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_expr: // expr
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::expr> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_lambdaform: // lambdaform
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::lambda> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_literal: // literal
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::literal> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_primop: // primop
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::primop> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_alts: // alts
+      case symbol_kind::S_algaltlist: // algaltlist
+      case symbol_kind::S_primaltlist: // primaltlist
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_atomlistbody: // atomlistbody
+      case symbol_kind::S_atomlist: // atomlist
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_bindings: // bindings
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_variablelistbody: // variablelistbody
+      case symbol_kind::S_variablelist: // variablelist
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_variablelistelem: // variablelistelem
+      case symbol_kind::S_variable: // variable
+        value.YY_MOVE_OR_COPY< std::shared_ptr<gg::ast::variable> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_VARNAME: // "varname"
+      case symbol_kind::S_CONNAME: // "conname"
+        value.YY_MOVE_OR_COPY< std::string > (YY_MOVE (that.value));
+        break;
+
+      default:
+        break;
+    }
+
+#if 201103L <= YY_CPLUSPLUS
+    // that is emptied.
+    that.state = empty_state;
+#endif
+  }
+
+  parser::stack_symbol_type::stack_symbol_type (state_type s, YY_MOVE_REF (symbol_type) that)
+    : super_type (s, YY_MOVE (that.location))
+  {
+    switch (that.kind ())
+    {
+      case symbol_kind::S_UPDATEFLAG: // "updateflag"
+        value.move< bool > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_PRIMOP: // "primop"
+        value.move< gg::ast::primopcode > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_INTEGER_LIT: // "int"
+        value.move< int64_t > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_algalt: // algalt
+      case symbol_kind::S_primalt: // primalt
+      case symbol_kind::S_defaultalt: // defaultalt
+        value.move< std::shared_ptr<gg::ast::alternative> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_atom: // atom
+      case symbol_kind::S_atomlistelem: // atomlistelem
+        value.move< std::shared_ptr<gg::ast::atom> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_binding: // binding
+        value.move< std::shared_ptr<gg::ast::binding> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_constructor: // constructor
+        value.move< std::shared_ptr<gg::ast::constructor> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_expr: // expr
+        value.move< std::shared_ptr<gg::ast::expr> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_lambdaform: // lambdaform
+        value.move< std::shared_ptr<gg::ast::lambda> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_literal: // literal
+        value.move< std::shared_ptr<gg::ast::literal> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_primop: // primop
+        value.move< std::shared_ptr<gg::ast::primop> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_alts: // alts
+      case symbol_kind::S_algaltlist: // algaltlist
+      case symbol_kind::S_primaltlist: // primaltlist
+        value.move< std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_atomlistbody: // atomlistbody
+      case symbol_kind::S_atomlist: // atomlist
+        value.move< std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_bindings: // bindings
+        value.move< std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_variablelistbody: // variablelistbody
+      case symbol_kind::S_variablelist: // variablelist
+        value.move< std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_variablelistelem: // variablelistelem
+      case symbol_kind::S_variable: // variable
+        value.move< std::shared_ptr<gg::ast::variable> > (YY_MOVE (that.value));
+        break;
+
+      case symbol_kind::S_VARNAME: // "varname"
+      case symbol_kind::S_CONNAME: // "conname"
+        value.move< std::string > (YY_MOVE (that.value));
+        break;
+
+      default:
+        break;
+    }
+
+    // that is emptied.
+    that.kind_ = symbol_kind::S_YYEMPTY;
+  }
+
+#if YY_CPLUSPLUS < 201103L
+  parser::stack_symbol_type&
+  parser::stack_symbol_type::operator= (const stack_symbol_type& that)
+  {
+    state = that.state;
+    switch (that.kind ())
+    {
+      case symbol_kind::S_UPDATEFLAG: // "updateflag"
+        value.copy< bool > (that.value);
+        break;
+
+      case symbol_kind::S_PRIMOP: // "primop"
+        value.copy< gg::ast::primopcode > (that.value);
+        break;
+
+      case symbol_kind::S_INTEGER_LIT: // "int"
+        value.copy< int64_t > (that.value);
+        break;
+
+      case symbol_kind::S_algalt: // algalt
+      case symbol_kind::S_primalt: // primalt
+      case symbol_kind::S_defaultalt: // defaultalt
+        value.copy< std::shared_ptr<gg::ast::alternative> > (that.value);
+        break;
+
+      case symbol_kind::S_atom: // atom
+      case symbol_kind::S_atomlistelem: // atomlistelem
+        value.copy< std::shared_ptr<gg::ast::atom> > (that.value);
+        break;
+
+      case symbol_kind::S_binding: // binding
+        value.copy< std::shared_ptr<gg::ast::binding> > (that.value);
+        break;
+
+      case symbol_kind::S_constructor: // constructor
+        value.copy< std::shared_ptr<gg::ast::constructor> > (that.value);
+        break;
+
+      case symbol_kind::S_expr: // expr
+        value.copy< std::shared_ptr<gg::ast::expr> > (that.value);
+        break;
+
+      case symbol_kind::S_lambdaform: // lambdaform
+        value.copy< std::shared_ptr<gg::ast::lambda> > (that.value);
+        break;
+
+      case symbol_kind::S_literal: // literal
+        value.copy< std::shared_ptr<gg::ast::literal> > (that.value);
+        break;
+
+      case symbol_kind::S_primop: // primop
+        value.copy< std::shared_ptr<gg::ast::primop> > (that.value);
+        break;
+
+      case symbol_kind::S_alts: // alts
+      case symbol_kind::S_algaltlist: // algaltlist
+      case symbol_kind::S_primaltlist: // primaltlist
+        value.copy< std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (that.value);
+        break;
+
+      case symbol_kind::S_atomlistbody: // atomlistbody
+      case symbol_kind::S_atomlist: // atomlist
+        value.copy< std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > (that.value);
+        break;
+
+      case symbol_kind::S_bindings: // bindings
+        value.copy< std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (that.value);
+        break;
+
+      case symbol_kind::S_variablelistbody: // variablelistbody
+      case symbol_kind::S_variablelist: // variablelist
+        value.copy< std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > (that.value);
+        break;
+
+      case symbol_kind::S_variablelistelem: // variablelistelem
+      case symbol_kind::S_variable: // variable
+        value.copy< std::shared_ptr<gg::ast::variable> > (that.value);
+        break;
+
+      case symbol_kind::S_VARNAME: // "varname"
+      case symbol_kind::S_CONNAME: // "conname"
+        value.copy< std::string > (that.value);
+        break;
+
+      default:
+        break;
+    }
+
+    location = that.location;
+    return *this;
+  }
+
+  parser::stack_symbol_type&
+  parser::stack_symbol_type::operator= (stack_symbol_type& that)
+  {
+    state = that.state;
+    switch (that.kind ())
+    {
+      case symbol_kind::S_UPDATEFLAG: // "updateflag"
+        value.move< bool > (that.value);
+        break;
+
+      case symbol_kind::S_PRIMOP: // "primop"
+        value.move< gg::ast::primopcode > (that.value);
+        break;
+
+      case symbol_kind::S_INTEGER_LIT: // "int"
+        value.move< int64_t > (that.value);
+        break;
+
+      case symbol_kind::S_algalt: // algalt
+      case symbol_kind::S_primalt: // primalt
+      case symbol_kind::S_defaultalt: // defaultalt
+        value.move< std::shared_ptr<gg::ast::alternative> > (that.value);
+        break;
+
+      case symbol_kind::S_atom: // atom
+      case symbol_kind::S_atomlistelem: // atomlistelem
+        value.move< std::shared_ptr<gg::ast::atom> > (that.value);
+        break;
+
+      case symbol_kind::S_binding: // binding
+        value.move< std::shared_ptr<gg::ast::binding> > (that.value);
+        break;
+
+      case symbol_kind::S_constructor: // constructor
+        value.move< std::shared_ptr<gg::ast::constructor> > (that.value);
+        break;
+
+      case symbol_kind::S_expr: // expr
+        value.move< std::shared_ptr<gg::ast::expr> > (that.value);
+        break;
+
+      case symbol_kind::S_lambdaform: // lambdaform
+        value.move< std::shared_ptr<gg::ast::lambda> > (that.value);
+        break;
+
+      case symbol_kind::S_literal: // literal
+        value.move< std::shared_ptr<gg::ast::literal> > (that.value);
+        break;
+
+      case symbol_kind::S_primop: // primop
+        value.move< std::shared_ptr<gg::ast::primop> > (that.value);
+        break;
+
+      case symbol_kind::S_alts: // alts
+      case symbol_kind::S_algaltlist: // algaltlist
+      case symbol_kind::S_primaltlist: // primaltlist
+        value.move< std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (that.value);
+        break;
+
+      case symbol_kind::S_atomlistbody: // atomlistbody
+      case symbol_kind::S_atomlist: // atomlist
+        value.move< std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > (that.value);
+        break;
+
+      case symbol_kind::S_bindings: // bindings
+        value.move< std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (that.value);
+        break;
+
+      case symbol_kind::S_variablelistbody: // variablelistbody
+      case symbol_kind::S_variablelist: // variablelist
+        value.move< std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > (that.value);
+        break;
+
+      case symbol_kind::S_variablelistelem: // variablelistelem
+      case symbol_kind::S_variable: // variable
+        value.move< std::shared_ptr<gg::ast::variable> > (that.value);
+        break;
+
+      case symbol_kind::S_VARNAME: // "varname"
+      case symbol_kind::S_CONNAME: // "conname"
+        value.move< std::string > (that.value);
+        break;
+
+      default:
+        break;
+    }
+
+    location = that.location;
+    // that is emptied.
+    that.state = empty_state;
+    return *this;
+  }
+#endif
+
+  template <typename Base>
+  void
+  parser::yy_destroy_ (const char* yymsg, basic_symbol<Base>& yysym) const
+  {
+    if (yymsg)
+      YY_SYMBOL_PRINT (yymsg, yysym);
+  }
+
+#if YYDEBUG
+  template <typename Base>
+  void
+  parser::yy_print_ (std::ostream& yyo, const basic_symbol<Base>& yysym) const
+  {
+    std::ostream& yyoutput = yyo;
+    YY_USE (yyoutput);
+    if (yysym.empty ())
+      yyo << "empty symbol";
+    else
+      {
+        symbol_kind_type yykind = yysym.kind ();
+        yyo << (yykind < YYNTOKENS ? "token" : "nterm")
+            << ' ' << yysym.name () << " ("
+            << yysym.location << ": ";
+        YY_USE (yykind);
+        yyo << ')';
+      }
+  }
+#endif
+
+  void
+  parser::yypush_ (const char* m, YY_MOVE_REF (stack_symbol_type) sym)
+  {
+    if (m)
+      YY_SYMBOL_PRINT (m, sym);
+    yystack_.push (YY_MOVE (sym));
+  }
+
+  void
+  parser::yypush_ (const char* m, state_type s, YY_MOVE_REF (symbol_type) sym)
+  {
+#if 201103L <= YY_CPLUSPLUS
+    yypush_ (m, stack_symbol_type (s, std::move (sym)));
+#else
+    stack_symbol_type ss (s, sym);
+    yypush_ (m, ss);
+#endif
+  }
+
+  void
+  parser::yypop_ (int n) YY_NOEXCEPT
+  {
+    yystack_.pop (n);
+  }
+
+#if YYDEBUG
+  std::ostream&
+  parser::debug_stream () const
+  {
+    return *yycdebug_;
+  }
+
+  void
+  parser::set_debug_stream (std::ostream& o)
+  {
+    yycdebug_ = &o;
+  }
+
+
+  parser::debug_level_type
+  parser::debug_level () const
+  {
+    return yydebug_;
+  }
+
+  void
+  parser::set_debug_level (debug_level_type l)
+  {
+    yydebug_ = l;
+  }
+#endif // YYDEBUG
+
+  parser::state_type
+  parser::yy_lr_goto_state_ (state_type yystate, int yysym)
+  {
+    int yyr = yypgoto_[yysym - YYNTOKENS] + yystate;
+    if (0 <= yyr && yyr <= yylast_ && yycheck_[yyr] == yystate)
+      return yytable_[yyr];
+    else
+      return yydefgoto_[yysym - YYNTOKENS];
+  }
+
+  bool
+  parser::yy_pact_value_is_default_ (int yyvalue) YY_NOEXCEPT
+  {
+    return yyvalue == yypact_ninf_;
+  }
+
+  bool
+  parser::yy_table_value_is_error_ (int yyvalue) YY_NOEXCEPT
+  {
+    return yyvalue == yytable_ninf_;
+  }
+
+  int
+  parser::operator() ()
+  {
+    return parse ();
+  }
+
+  int
+  parser::parse ()
+  {
+    int yyn;
+    /// Length of the RHS of the rule being reduced.
+    int yylen = 0;
+
+    // Error handling.
+    int yynerrs_ = 0;
+    int yyerrstatus_ = 0;
+
+    /// The lookahead symbol.
+    symbol_type yyla;
+
+    /// The locations where the error started and ended.
+    stack_symbol_type yyerror_range[3];
+
+    /// The return value of parse ().
+    int yyresult;
+
+#if YY_EXCEPTIONS
+    try
+#endif // YY_EXCEPTIONS
+      {
+    YYCDEBUG << "Starting parse\n";
+
+
+    // User initialization code.
+#line 23 "/tmp/mine/base.yy"
+{
+}
+
+#line 730 "parser.cc"
+
+
+    /* Initialize the stack.  The initial state will be set in
+       yynewstate, since the latter expects the semantical and the
+       location values to have been already stored, initialize these
+       stacks with a primary value.  */
+    yystack_.clear ();
+    yypush_ (YY_NULLPTR, 0, YY_MOVE (yyla));
+
+  /*-----------------------------------------------.
+  | yynewstate -- push a new symbol on the stack.  |
+  `-----------------------------------------------*/
+  yynewstate:
+    YYCDEBUG << "Entering state " << int (yystack_[0].state) << '\n';
+    YY_STACK_PRINT ();
+
+    // Accept?
+    if (yystack_[0].state == yyfinal_)
+      YYACCEPT;
+
+    goto yybackup;
+
+
+  /*-----------.
+  | yybackup.  |
+  `-----------*/
+  yybackup:
+    // Try to take a decision without lookahead.
+    yyn = yypact_[+yystack_[0].state];
+    if (yy_pact_value_is_default_ (yyn))
+      goto yydefault;
+
+    // Read a lookahead token.
+    if (yyla.empty ())
+      {
+        YYCDEBUG << "Reading a token\n";
+#if YY_EXCEPTIONS
+        try
+#endif // YY_EXCEPTIONS
+          {
+            symbol_type yylookahead (yylex (nullptr));
+            yyla.move (yylookahead);
+          }
+#if YY_EXCEPTIONS
+        catch (const syntax_error& yyexc)
+          {
+            YYCDEBUG << "Caught exception: " << yyexc.what() << '\n';
+            error (yyexc);
+            goto yyerrlab1;
+          }
+#endif // YY_EXCEPTIONS
+      }
+    YY_SYMBOL_PRINT ("Next token is", yyla);
+
+    if (yyla.kind () == symbol_kind::S_YYerror)
+    {
+      // The scanner already issued an error message, process directly
+      // to error recovery.  But do not keep the error token as
+      // lookahead, it is too special and may lead us to an endless
+      // loop in error recovery. */
+      yyla.kind_ = symbol_kind::S_YYUNDEF;
+      goto yyerrlab1;
+    }
+
+    /* If the proper action on seeing token YYLA.TYPE is to reduce or
+       to detect an error, take that action.  */
+    yyn += yyla.kind ();
+    if (yyn < 0 || yylast_ < yyn || yycheck_[yyn] != yyla.kind ())
+      {
+        goto yydefault;
+      }
+
+    // Reduce or error.
+    yyn = yytable_[yyn];
+    if (yyn <= 0)
+      {
+        if (yy_table_value_is_error_ (yyn))
+          goto yyerrlab;
+        yyn = -yyn;
+        goto yyreduce;
+      }
+
+    // Count tokens shifted since error; after three, turn off error status.
+    if (yyerrstatus_)
+      --yyerrstatus_;
+
+    // Shift the lookahead token.
+    yypush_ ("Shifting", state_type (yyn), YY_MOVE (yyla));
+    goto yynewstate;
+
+
+  /*-----------------------------------------------------------.
+  | yydefault -- do the default action for the current state.  |
+  `-----------------------------------------------------------*/
+  yydefault:
+    yyn = yydefact_[+yystack_[0].state];
+    if (yyn == 0)
+      goto yyerrlab;
+    goto yyreduce;
+
+
+  /*-----------------------------.
+  | yyreduce -- do a reduction.  |
+  `-----------------------------*/
+  yyreduce:
+    yylen = yyr2_[yyn];
+    {
+      stack_symbol_type yylhs;
+      yylhs.state = yy_lr_goto_state_ (yystack_[yylen].state, yyr1_[yyn]);
+      /* Variants are always initialized to an empty instance of the
+         correct type. The default '$$ = $1' action is NOT applied
+         when using variants.  */
+      switch (yyr1_[yyn])
+    {
+      case symbol_kind::S_UPDATEFLAG: // "updateflag"
+        yylhs.value.emplace< bool > ();
+        break;
+
+      case symbol_kind::S_PRIMOP: // "primop"
+        yylhs.value.emplace< gg::ast::primopcode > ();
+        break;
+
+      case symbol_kind::S_INTEGER_LIT: // "int"
+        yylhs.value.emplace< int64_t > ();
+        break;
+
+      case symbol_kind::S_algalt: // algalt
+      case symbol_kind::S_primalt: // primalt
+      case symbol_kind::S_defaultalt: // defaultalt
+        yylhs.value.emplace< std::shared_ptr<gg::ast::alternative> > ();
+        break;
+
+      case symbol_kind::S_atom: // atom
+      case symbol_kind::S_atomlistelem: // atomlistelem
+        yylhs.value.emplace< std::shared_ptr<gg::ast::atom> > ();
+        break;
+
+      case symbol_kind::S_binding: // binding
+        yylhs.value.emplace< std::shared_ptr<gg::ast::binding> > ();
+        break;
+
+      case symbol_kind::S_constructor: // constructor
+        yylhs.value.emplace< std::shared_ptr<gg::ast::constructor> > ();
+        break;
+
+      case symbol_kind::S_expr: // expr
+        yylhs.value.emplace< std::shared_ptr<gg::ast::expr> > ();
+        break;
+
+      case symbol_kind::S_lambdaform: // lambdaform
+        yylhs.value.emplace< std::shared_ptr<gg::ast::lambda> > ();
+        break;
+
+      case symbol_kind::S_literal: // literal
+        yylhs.value.emplace< std::shared_ptr<gg::ast::literal> > ();
+        break;
+
+      case symbol_kind::S_primop: // primop
+        yylhs.value.emplace< std::shared_ptr<gg::ast::primop> > ();
+        break;
+
+      case symbol_kind::S_alts: // alts
+      case symbol_kind::S_algaltlist: // algaltlist
+      case symbol_kind::S_primaltlist: // primaltlist
+        yylhs.value.emplace< std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > ();
+        break;
+
+      case symbol_kind::S_atomlistbody: // atomlistbody
+      case symbol_kind::S_atomlist: // atomlist
+        yylhs.value.emplace< std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > ();
+        break;
+
+      case symbol_kind::S_bindings: // bindings
+        yylhs.value.emplace< std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > ();
+        break;
+
+      case symbol_kind::S_variablelistbody: // variablelistbody
+      case symbol_kind::S_variablelist: // variablelist
+        yylhs.value.emplace< std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > ();
+        break;
+
+      case symbol_kind::S_variablelistelem: // variablelistelem
+      case symbol_kind::S_variable: // variable
+        yylhs.value.emplace< std::shared_ptr<gg::ast::variable> > ();
+        break;
+
+      case symbol_kind::S_VARNAME: // "varname"
+      case symbol_kind::S_CONNAME: // "conname"
+        yylhs.value.emplace< std::string > ();
+        break;
+
+      default:
+        break;
+    }
+
+
+      // Default location.
+      {
+        stack_type::slice range (yystack_, yylen);
+        YYLLOC_DEFAULT (yylhs.location, range, yylen);
+        yyerror_range[1].location = yylhs.location;
+      }
+
+      // Perform the reduction.
+      YY_REDUCE_PRINT (yyn);
+#if YY_EXCEPTIONS
+      try
+#endif // YY_EXCEPTIONS
+        {
+          switch (yyn)
+            {
+  case 2: // program: bindings "<EOF>"
+#line 90 "/tmp/mine/base.yy"
+                           { result = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (); }
+#line 945 "parser.cc"
+    break;
+
+  case 3: // program: "\n" bindings "<EOF>"
+#line 91 "/tmp/mine/base.yy"
+                                { result = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (); }
+#line 951 "parser.cc"
+    break;
+
+  case 4: // program: bindings "\n" "<EOF>"
+#line 92 "/tmp/mine/base.yy"
+                                { result = yystack_[2].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (); }
+#line 957 "parser.cc"
+    break;
+
+  case 5: // program: "\n" bindings "\n" "<EOF>"
+#line 93 "/tmp/mine/base.yy"
+                                     { result = yystack_[2].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (); }
+#line 963 "parser.cc"
+    break;
+
+  case 6: // bindings: binding
+#line 96 "/tmp/mine/base.yy"
+                   { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > () = make_shared_seq<gg::ast::binding>(yylhs.location, {yystack_[0].value.as < std::shared_ptr<gg::ast::binding> > ()}); }
+#line 969 "parser.cc"
+    break;
+
+  case 7: // bindings: bindings "\n" binding
+#line 97 "/tmp/mine/base.yy"
+                                 { yystack_[2].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > ()->elems.push_back(yystack_[0].value.as < std::shared_ptr<gg::ast::binding> > ()); yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > () = yystack_[2].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (); }
+#line 975 "parser.cc"
+    break;
+
+  case 8: // binding: variable "=" lambdaform
+#line 100 "/tmp/mine/base.yy"
+                                  { yylhs.value.as < std::shared_ptr<gg::ast::binding> > () = std::make_shared<gg::ast::binding>(yylhs.location, yystack_[2].value.as < std::shared_ptr<gg::ast::variable> > (), yystack_[0].value.as < std::shared_ptr<gg::ast::lambda> > ()); }
+#line 981 "parser.cc"
+    break;
+
+  case 9: // lambdaform: variablelist "updateflag" variablelist "->" expr
+#line 103 "/tmp/mine/base.yy"
+                                                             { yylhs.value.as < std::shared_ptr<gg::ast::lambda> > () = std::make_shared<gg::ast::lambda>(yylhs.location, yystack_[4].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > (), yystack_[3].value.as < bool > (), yystack_[2].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > (), yystack_[0].value.as < std::shared_ptr<gg::ast::expr> > ()); }
+#line 987 "parser.cc"
+    break;
+
+  case 10: // expr: "let" bindings "in" expr
+#line 106 "/tmp/mine/base.yy"
+                                { yylhs.value.as < std::shared_ptr<gg::ast::expr> > () = std::make_shared<gg::ast::local_definition>(yylhs.location, yystack_[2].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (), yystack_[0].value.as < std::shared_ptr<gg::ast::expr> > ()); }
+#line 993 "parser.cc"
+    break;
+
+  case 11: // expr: "letrec" bindings "in" expr
+#line 107 "/tmp/mine/base.yy"
+                                   { yylhs.value.as < std::shared_ptr<gg::ast::expr> > () = std::make_shared<gg::ast::local_recursion>(yylhs.location, yystack_[2].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::binding>> > (), yystack_[0].value.as < std::shared_ptr<gg::ast::expr> > ()); }
+#line 999 "parser.cc"
+    break;
+
+  case 12: // expr: "case" expr "of" alts
+#line 108 "/tmp/mine/base.yy"
+                             { yylhs.value.as < std::shared_ptr<gg::ast::expr> > () = std::make_shared<gg::ast::case_>(yylhs.location, yystack_[2].value.as < std::shared_ptr<gg::ast::expr> > (), yystack_[0].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > ()); }
+#line 1005 "parser.cc"
+    break;
+
+  case 13: // expr: "case" expr "of" "\n" alts
+#line 109 "/tmp/mine/base.yy"
+                                  { yylhs.value.as < std::shared_ptr<gg::ast::expr> > () = std::make_shared<gg::ast::case_>(yylhs.location, yystack_[3].value.as < std::shared_ptr<gg::ast::expr> > (), yystack_[0].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > ()); }
+#line 1011 "parser.cc"
+    break;
+
+  case 14: // expr: constructor atomlist
+#line 110 "/tmp/mine/base.yy"
+                            { yylhs.value.as < std::shared_ptr<gg::ast::expr> > () = std::make_shared<gg::ast::construct>(yylhs.location, yystack_[1].value.as < std::shared_ptr<gg::ast::constructor> > (), yystack_[0].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > ()); }
+#line 1017 "parser.cc"
+    break;
+
+  case 15: // expr: variable atomlist
+#line 111 "/tmp/mine/base.yy"
+                         { yylhs.value.as < std::shared_ptr<gg::ast::expr> > () = std::make_shared<gg::ast::apply>(yylhs.location, yystack_[1].value.as < std::shared_ptr<gg::ast::variable> > (), yystack_[0].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > ()); }
+#line 1023 "parser.cc"
+    break;
+
+  case 16: // expr: primop atomlist
+#line 112 "/tmp/mine/base.yy"
+                       { yylhs.value.as < std::shared_ptr<gg::ast::expr> > () = std::make_shared<gg::ast::prim_apply>(yylhs.location, yystack_[1].value.as < std::shared_ptr<gg::ast::primop> > (), yystack_[0].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > ()); }
+#line 1029 "parser.cc"
+    break;
+
+  case 17: // expr: literal
+#line 113 "/tmp/mine/base.yy"
+               {yylhs.value.as < std::shared_ptr<gg::ast::expr> > () = std::make_shared<gg::ast::lit_expr>(yylhs.location, yystack_[0].value.as < std::shared_ptr<gg::ast::literal> > ()); }
+#line 1035 "parser.cc"
+    break;
+
+  case 18: // primop: "primop"
+#line 116 "/tmp/mine/base.yy"
+                  { yylhs.value.as < std::shared_ptr<gg::ast::primop> > () = std::make_shared<gg::ast::primop>(yylhs.location, yystack_[0].value.as < gg::ast::primopcode > ()); }
+#line 1041 "parser.cc"
+    break;
+
+  case 19: // constructor: "conname"
+#line 119 "/tmp/mine/base.yy"
+                        { yylhs.value.as < std::shared_ptr<gg::ast::constructor> > () = std::make_shared<gg::ast::constructor>(yylhs.location, yystack_[0].value.as < std::string > ()); }
+#line 1047 "parser.cc"
+    break;
+
+  case 20: // alts: defaultalt
+#line 122 "/tmp/mine/base.yy"
+                  { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > () = make_shared_seq<gg::ast::alternative>(yylhs.location, {yystack_[0].value.as < std::shared_ptr<gg::ast::alternative> > ()}); }
+#line 1053 "parser.cc"
+    break;
+
+  case 21: // alts: algaltlist
+#line 123 "/tmp/mine/base.yy"
+                  { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > () = yystack_[0].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (); }
+#line 1059 "parser.cc"
+    break;
+
+  case 22: // alts: algaltlist defaultalt
+#line 124 "/tmp/mine/base.yy"
+                             { yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > ()->elems.push_back(yystack_[0].value.as < std::shared_ptr<gg::ast::alternative> > ()); yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (); }
+#line 1065 "parser.cc"
+    break;
+
+  case 23: // alts: primaltlist
+#line 125 "/tmp/mine/base.yy"
+                   { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > () = yystack_[0].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (); }
+#line 1071 "parser.cc"
+    break;
+
+  case 24: // alts: primaltlist defaultalt
+#line 126 "/tmp/mine/base.yy"
+                              { yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > ()->elems.push_back(yystack_[0].value.as < std::shared_ptr<gg::ast::alternative> > ()); yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (); }
+#line 1077 "parser.cc"
+    break;
+
+  case 25: // algaltlist: algalt
+#line 129 "/tmp/mine/base.yy"
+                    { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > () = make_shared_seq<gg::ast::alternative>(yylhs.location, {yystack_[0].value.as < std::shared_ptr<gg::ast::alternative> > ()}); }
+#line 1083 "parser.cc"
+    break;
+
+  case 26: // algaltlist: algaltlist algalt
+#line 130 "/tmp/mine/base.yy"
+                               { yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > ()->elems.push_back(yystack_[0].value.as < std::shared_ptr<gg::ast::alternative> > ()); yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (); }
+#line 1089 "parser.cc"
+    break;
+
+  case 27: // algalt: constructor variablelist "->" expr "\n"
+#line 133 "/tmp/mine/base.yy"
+                                                 { yylhs.value.as < std::shared_ptr<gg::ast::alternative> > () = std::make_shared<gg::ast::algebraic_alt>(yylhs.location, yystack_[4].value.as < std::shared_ptr<gg::ast::constructor> > (), yystack_[3].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > (), yystack_[1].value.as < std::shared_ptr<gg::ast::expr> > ()); }
+#line 1095 "parser.cc"
+    break;
+
+  case 28: // primaltlist: primalt
+#line 136 "/tmp/mine/base.yy"
+                      { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > () = make_shared_seq<gg::ast::alternative>(yylhs.location, {yystack_[0].value.as < std::shared_ptr<gg::ast::alternative> > ()}); }
+#line 1101 "parser.cc"
+    break;
+
+  case 29: // primaltlist: primaltlist primalt
+#line 137 "/tmp/mine/base.yy"
+                                  { yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > ()->elems.push_back(yystack_[0].value.as < std::shared_ptr<gg::ast::alternative> > ()); yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::alternative>> > (); }
+#line 1107 "parser.cc"
+    break;
+
+  case 30: // primalt: literal "->" expr "\n"
+#line 140 "/tmp/mine/base.yy"
+                                 { yylhs.value.as < std::shared_ptr<gg::ast::alternative> > () = std::make_shared<gg::ast::prim_alt>(yylhs.location, yystack_[3].value.as < std::shared_ptr<gg::ast::literal> > (), yystack_[1].value.as < std::shared_ptr<gg::ast::expr> > ()); }
+#line 1113 "parser.cc"
+    break;
+
+  case 31: // defaultalt: variable "->" expr "\n"
+#line 143 "/tmp/mine/base.yy"
+                                     { yylhs.value.as < std::shared_ptr<gg::ast::alternative> > () = std::make_shared<gg::ast::binding_alt>(yylhs.location, yystack_[3].value.as < std::shared_ptr<gg::ast::variable> > (), yystack_[1].value.as < std::shared_ptr<gg::ast::expr> > ()); }
+#line 1119 "parser.cc"
+    break;
+
+  case 32: // defaultalt: "default" "->" expr "\n"
+#line 144 "/tmp/mine/base.yy"
+                                      { yylhs.value.as < std::shared_ptr<gg::ast::alternative> > () = std::make_shared<gg::ast::default_alt>(yylhs.location, yystack_[1].value.as < std::shared_ptr<gg::ast::expr> > ()); }
+#line 1125 "parser.cc"
+    break;
+
+  case 33: // literal: "int"
+#line 147 "/tmp/mine/base.yy"
+                { yylhs.value.as < std::shared_ptr<gg::ast::literal> > () = std::make_shared<gg::ast::literal>(yylhs.location, yystack_[0].value.as < int64_t > ()); }
+#line 1131 "parser.cc"
+    break;
+
+  case 34: // variablelistelem: variable
+#line 150 "/tmp/mine/base.yy"
+                            { yylhs.value.as < std::shared_ptr<gg::ast::variable> > () = yystack_[0].value.as < std::shared_ptr<gg::ast::variable> > (); }
+#line 1137 "parser.cc"
+    break;
+
+  case 35: // variablelistelem: variable ","
+#line 151 "/tmp/mine/base.yy"
+                                { yylhs.value.as < std::shared_ptr<gg::ast::variable> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::variable> > (); }
+#line 1143 "parser.cc"
+    break;
+
+  case 36: // variablelistbody: variablelistelem
+#line 153 "/tmp/mine/base.yy"
+                                    { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > () = make_shared_seq<gg::ast::variable>(yylhs.location, {yystack_[0].value.as < std::shared_ptr<gg::ast::variable> > ()}); }
+#line 1149 "parser.cc"
+    break;
+
+  case 37: // variablelistbody: variablelistbody variablelistelem
+#line 154 "/tmp/mine/base.yy"
+                                                     { yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > ()->elems.push_back(yystack_[0].value.as < std::shared_ptr<gg::ast::variable> > ()); yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > (); }
+#line 1155 "parser.cc"
+    break;
+
+  case 38: // variablelist: "{" variablelistbody "}"
+#line 156 "/tmp/mine/base.yy"
+                                        { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > (); }
+#line 1161 "parser.cc"
+    break;
+
+  case 39: // variablelist: "{" "}"
+#line 157 "/tmp/mine/base.yy"
+                       {yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::variable>> > () = make_shared_seq<gg::ast::variable>(yylhs.location, {}); }
+#line 1167 "parser.cc"
+    break;
+
+  case 40: // variable: "varname"
+#line 160 "/tmp/mine/base.yy"
+                     { yylhs.value.as < std::shared_ptr<gg::ast::variable> > () = std::make_shared<gg::ast::variable>(yylhs.location, yystack_[0].value.as < std::string > ()); }
+#line 1173 "parser.cc"
+    break;
+
+  case 41: // atom: variable
+#line 163 "/tmp/mine/base.yy"
+                { yylhs.value.as < std::shared_ptr<gg::ast::atom> > () = yystack_[0].value.as < std::shared_ptr<gg::ast::variable> > (); }
+#line 1179 "parser.cc"
+    break;
+
+  case 42: // atom: literal
+#line 164 "/tmp/mine/base.yy"
+               { yylhs.value.as < std::shared_ptr<gg::ast::atom> > () = yystack_[0].value.as < std::shared_ptr<gg::ast::literal> > (); }
+#line 1185 "parser.cc"
+    break;
+
+  case 43: // atomlistelem: atom
+#line 167 "/tmp/mine/base.yy"
+                    { yylhs.value.as < std::shared_ptr<gg::ast::atom> > () = yystack_[0].value.as < std::shared_ptr<gg::ast::atom> > (); }
+#line 1191 "parser.cc"
+    break;
+
+  case 44: // atomlistelem: atom ","
+#line 168 "/tmp/mine/base.yy"
+                        { yylhs.value.as < std::shared_ptr<gg::ast::atom> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::atom> > (); }
+#line 1197 "parser.cc"
+    break;
+
+  case 45: // atomlistbody: atomlistelem
+#line 170 "/tmp/mine/base.yy"
+                            { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > () = make_shared_seq<gg::ast::atom>(yylhs.location, {yystack_[0].value.as < std::shared_ptr<gg::ast::atom> > ()}); }
+#line 1203 "parser.cc"
+    break;
+
+  case 46: // atomlistbody: atomlistbody atomlistelem
+#line 171 "/tmp/mine/base.yy"
+                                         { yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > ()->elems.push_back(yystack_[0].value.as < std::shared_ptr<gg::ast::atom> > ()); yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > (); }
+#line 1209 "parser.cc"
+    break;
+
+  case 47: // atomlist: "{" atomlistbody "}"
+#line 173 "/tmp/mine/base.yy"
+                                { yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > () = yystack_[1].value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > (); }
+#line 1215 "parser.cc"
+    break;
+
+  case 48: // atomlist: "{" "}"
+#line 174 "/tmp/mine/base.yy"
+                   {yylhs.value.as < std::shared_ptr<gg::ast::sequence<gg::ast::atom>> > () = make_shared_seq<gg::ast::atom>(yylhs.location, {}); }
+#line 1221 "parser.cc"
+    break;
+
+
+#line 1225 "parser.cc"
+
+            default:
+              break;
+            }
+        }
+#if YY_EXCEPTIONS
+      catch (const syntax_error& yyexc)
+        {
+          YYCDEBUG << "Caught exception: " << yyexc.what() << '\n';
+          error (yyexc);
+          YYERROR;
+        }
+#endif // YY_EXCEPTIONS
+      YY_SYMBOL_PRINT ("-> $$ =", yylhs);
+      yypop_ (yylen);
+      yylen = 0;
+
+      // Shift the result of the reduction.
+      yypush_ (YY_NULLPTR, YY_MOVE (yylhs));
+    }
+    goto yynewstate;
+
+
+  /*--------------------------------------.
+  | yyerrlab -- here on detecting error.  |
+  `--------------------------------------*/
+  yyerrlab:
+    // If not already recovering from an error, report this error.
+    if (!yyerrstatus_)
+      {
+        ++yynerrs_;
+        context yyctx (*this, yyla);
+        std::string msg = yysyntax_error_ (yyctx);
+        error (yyla.location, YY_MOVE (msg));
+      }
+
+
+    yyerror_range[1].location = yyla.location;
+    if (yyerrstatus_ == 3)
+      {
+        /* If just tried and failed to reuse lookahead token after an
+           error, discard it.  */
+
+        // Return failure if at end of input.
+        if (yyla.kind () == symbol_kind::S_YYEOF)
+          YYABORT;
+        else if (!yyla.empty ())
+          {
+            yy_destroy_ ("Error: discarding", yyla);
+            yyla.clear ();
+          }
+      }
+
+    // Else will try to reuse lookahead token after shifting the error token.
+    goto yyerrlab1;
+
+
+  /*---------------------------------------------------.
+  | yyerrorlab -- error raised explicitly by YYERROR.  |
+  `---------------------------------------------------*/
+  yyerrorlab:
+    /* Pacify compilers when the user code never invokes YYERROR and
+       the label yyerrorlab therefore never appears in user code.  */
+    if (false)
+      YYERROR;
+
+    /* Do not reclaim the symbols of the rule whose action triggered
+       this YYERROR.  */
+    yypop_ (yylen);
+    yylen = 0;
+    YY_STACK_PRINT ();
+    goto yyerrlab1;
+
+
+  /*-------------------------------------------------------------.
+  | yyerrlab1 -- common code for both syntax error and YYERROR.  |
+  `-------------------------------------------------------------*/
+  yyerrlab1:
+    yyerrstatus_ = 3;   // Each real token shifted decrements this.
+    // Pop stack until we find a state that shifts the error token.
+    for (;;)
+      {
+        yyn = yypact_[+yystack_[0].state];
+        if (!yy_pact_value_is_default_ (yyn))
+          {
+            yyn += symbol_kind::S_YYerror;
+            if (0 <= yyn && yyn <= yylast_
+                && yycheck_[yyn] == symbol_kind::S_YYerror)
+              {
+                yyn = yytable_[yyn];
+                if (0 < yyn)
+                  break;
+              }
+          }
+
+        // Pop the current state because it cannot handle the error token.
+        if (yystack_.size () == 1)
+          YYABORT;
+
+        yyerror_range[1].location = yystack_[0].location;
+        yy_destroy_ ("Error: popping", yystack_[0]);
+        yypop_ ();
+        YY_STACK_PRINT ();
+      }
+    {
+      stack_symbol_type error_token;
+
+      yyerror_range[2].location = yyla.location;
+      YYLLOC_DEFAULT (error_token.location, yyerror_range, 2);
+
+      // Shift the error token.
+      error_token.state = state_type (yyn);
+      yypush_ ("Shifting", YY_MOVE (error_token));
+    }
+    goto yynewstate;
+
+
+  /*-------------------------------------.
+  | yyacceptlab -- YYACCEPT comes here.  |
+  `-------------------------------------*/
+  yyacceptlab:
+    yyresult = 0;
+    goto yyreturn;
+
+
+  /*-----------------------------------.
+  | yyabortlab -- YYABORT comes here.  |
+  `-----------------------------------*/
+  yyabortlab:
+    yyresult = 1;
+    goto yyreturn;
+
+
+  /*-----------------------------------------------------.
+  | yyreturn -- parsing is finished, return the result.  |
+  `-----------------------------------------------------*/
+  yyreturn:
+    if (!yyla.empty ())
+      yy_destroy_ ("Cleanup: discarding lookahead", yyla);
+
+    /* Do not reclaim the symbols of the rule whose action triggered
+       this YYABORT or YYACCEPT.  */
+    yypop_ (yylen);
+    YY_STACK_PRINT ();
+    while (1 < yystack_.size ())
+      {
+        yy_destroy_ ("Cleanup: popping", yystack_[0]);
+        yypop_ ();
+      }
+
+    return yyresult;
+  }
+#if YY_EXCEPTIONS
+    catch (...)
+      {
+        YYCDEBUG << "Exception caught: cleaning lookahead and stack\n";
+        // Do not try to display the values of the reclaimed symbols,
+        // as their printers might throw an exception.
+        if (!yyla.empty ())
+          yy_destroy_ (YY_NULLPTR, yyla);
+
+        while (1 < yystack_.size ())
+          {
+            yy_destroy_ (YY_NULLPTR, yystack_[0]);
+            yypop_ ();
+          }
+        throw;
+      }
+#endif // YY_EXCEPTIONS
+  }
+
+  void
+  parser::error (const syntax_error& yyexc)
+  {
+    error (yyexc.location, yyexc.what ());
+  }
+
+  /* Return YYSTR after stripping away unnecessary quotes and
+     backslashes, so that it's suitable for yyerror.  The heuristic is
+     that double-quoting is unnecessary unless the string contains an
+     apostrophe, a comma, or backslash (other than backslash-backslash).
+     YYSTR is taken from yytname.  */
+  std::string
+  parser::yytnamerr_ (const char *yystr)
+  {
+    if (*yystr == '"')
+      {
+        std::string yyr;
+        char const *yyp = yystr;
+
+        for (;;)
+          switch (*++yyp)
+            {
+            case '\'':
+            case ',':
+              goto do_not_strip_quotes;
+
+            case '\\':
+              if (*++yyp != '\\')
+                goto do_not_strip_quotes;
+              else
+                goto append;
+
+            append:
+            default:
+              yyr += *yyp;
+              break;
+
+            case '"':
+              return yyr;
+            }
+      do_not_strip_quotes: ;
+      }
+
+    return yystr;
+  }
+
+  std::string
+  parser::symbol_name (symbol_kind_type yysymbol)
+  {
+    return yytnamerr_ (yytname_[yysymbol]);
+  }
+
+
+
+  // parser::context.
+  parser::context::context (const parser& yyparser, const symbol_type& yyla)
+    : yyparser_ (yyparser)
+    , yyla_ (yyla)
+  {}
+
+  int
+  parser::context::expected_tokens (symbol_kind_type yyarg[], int yyargn) const
+  {
+    // Actual number of expected tokens
+    int yycount = 0;
+
+    const int yyn = yypact_[+yyparser_.yystack_[0].state];
+    if (!yy_pact_value_is_default_ (yyn))
+      {
+        /* Start YYX at -YYN if negative to avoid negative indexes in
+           YYCHECK.  In other words, skip the first -YYN actions for
+           this state because they are default actions.  */
+        const int yyxbegin = yyn < 0 ? -yyn : 0;
+        // Stay within bounds of both yycheck and yytname.
+        const int yychecklim = yylast_ - yyn + 1;
+        const int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
+        for (int yyx = yyxbegin; yyx < yyxend; ++yyx)
+          if (yycheck_[yyx + yyn] == yyx && yyx != symbol_kind::S_YYerror
+              && !yy_table_value_is_error_ (yytable_[yyx + yyn]))
+            {
+              if (!yyarg)
+                ++yycount;
+              else if (yycount == yyargn)
+                return 0;
+              else
+                yyarg[yycount++] = YY_CAST (symbol_kind_type, yyx);
+            }
+      }
+
+    if (yyarg && yycount == 0 && 0 < yyargn)
+      yyarg[0] = symbol_kind::S_YYEMPTY;
+    return yycount;
+  }
+
+
+
+
+
+
+  int
+  parser::yy_syntax_error_arguments_ (const context& yyctx,
+                                                 symbol_kind_type yyarg[], int yyargn) const
+  {
+    /* There are many possibilities here to consider:
+       - If this state is a consistent state with a default action, then
+         the only way this function was invoked is if the default action
+         is an error action.  In that case, don't check for expected
+         tokens because there are none.
+       - The only way there can be no lookahead present (in yyla) is
+         if this state is a consistent state with a default action.
+         Thus, detecting the absence of a lookahead is sufficient to
+         determine that there is no unexpected or expected token to
+         report.  In that case, just report a simple "syntax error".
+       - Don't assume there isn't a lookahead just because this state is
+         a consistent state with a default action.  There might have
+         been a previous inconsistent state, consistent state with a
+         non-default action, or user semantic action that manipulated
+         yyla.  (However, yyla is currently not documented for users.)
+       - Of course, the expected token list depends on states to have
+         correct lookahead information, and it depends on the parser not
+         to perform extra reductions after fetching a lookahead from the
+         scanner and before detecting a syntax error.  Thus, state merging
+         (from LALR or IELR) and default reductions corrupt the expected
+         token list.  However, the list is correct for canonical LR with
+         one exception: it will still contain any token that will not be
+         accepted due to an error action in a later state.
+    */
+
+    if (!yyctx.lookahead ().empty ())
+      {
+        if (yyarg)
+          yyarg[0] = yyctx.token ();
+        int yyn = yyctx.expected_tokens (yyarg ? yyarg + 1 : yyarg, yyargn - 1);
+        return yyn + 1;
+      }
+    return 0;
+  }
+
+  // Generate an error message.
+  std::string
+  parser::yysyntax_error_ (const context& yyctx) const
+  {
+    // Its maximum.
+    enum { YYARGS_MAX = 5 };
+    // Arguments of yyformat.
+    symbol_kind_type yyarg[YYARGS_MAX];
+    int yycount = yy_syntax_error_arguments_ (yyctx, yyarg, YYARGS_MAX);
+
+    char const* yyformat = YY_NULLPTR;
+    switch (yycount)
+      {
+#define YYCASE_(N, S)                         \
+        case N:                               \
+          yyformat = S;                       \
+        break
+      default: // Avoid compiler warnings.
+        YYCASE_ (0, YY_("syntax error"));
+        YYCASE_ (1, YY_("syntax error, unexpected %s"));
+        YYCASE_ (2, YY_("syntax error, unexpected %s, expecting %s"));
+        YYCASE_ (3, YY_("syntax error, unexpected %s, expecting %s or %s"));
+        YYCASE_ (4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
+        YYCASE_ (5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
+#undef YYCASE_
+      }
+
+    std::string yyres;
+    // Argument number.
+    std::ptrdiff_t yyi = 0;
+    for (char const* yyp = yyformat; *yyp; ++yyp)
+      if (yyp[0] == '%' && yyp[1] == 's' && yyi < yycount)
+        {
+          yyres += symbol_name (yyarg[yyi++]);
+          ++yyp;
+        }
+      else
+        yyres += *yyp;
+    return yyres;
+  }
+
+
+  const signed char parser::yypact_ninf_ = -34;
+
+  const signed char parser::yytable_ninf_ = -1;
+
+  const signed char
+  parser::yypact_[] =
+  {
+      47,    -3,   -34,    69,    81,   -34,    87,    83,   -34,   -34,
+       8,    38,   -34,    14,   -34,   -34,    19,   -34,    68,   -34,
+     -34,   -34,    39,    85,    38,   -34,   -34,   -34,    88,    58,
+      -3,    -3,    58,   -34,   -34,   -34,   -34,    89,    89,   -34,
+      89,     4,     6,    84,    41,   -34,   -34,   -34,    -3,    58,
+      58,    23,   -34,   -34,   -34,    90,   -34,    43,   -34,   -34,
+      64,    92,    38,   -34,    73,   -34,    57,   -34,   -34,    93,
+      94,   -34,   -34,   -34,   -34,    58,    95,   -34,   -34,   -34,
+     -34,    58,    58,   100,    58,   101,   102,   -34,   103,   -34,
+     -34,   -34
+  };
+
+  const signed char
+  parser::yydefact_[] =
+  {
+       0,     0,    40,     0,     0,     6,     0,     0,     1,     2,
+       0,     0,     3,     0,     4,     7,     0,     8,     0,     5,
+      39,    36,     0,    34,     0,    38,    37,    35,     0,     0,
+       0,     0,     0,    19,    33,    18,     9,     0,     0,    17,
+       0,     0,     0,     0,     0,    16,    14,    15,     0,     0,
+       0,     0,    48,    42,    41,    43,    45,     0,    10,    11,
+       0,     0,     0,    12,    21,    25,    23,    28,    20,     0,
+       0,    44,    47,    46,    13,     0,     0,    26,    22,    29,
+      24,     0,     0,     0,     0,     0,     0,    32,     0,    30,
+      31,    27
+  };
+
+  const signed char
+  parser::yypgoto_[] =
+  {
+     -34,   -34,     5,    -8,   -34,   -29,   -34,   -32,    36,   -34,
+      44,   -34,    45,    -1,   -33,    91,   -34,   -20,     0,   -34,
+      50,   -34,    52
+  };
+
+  const signed char
+  parser::yydefgoto_[] =
+  {
+       0,     3,     4,     5,    17,    36,    37,    38,    63,    64,
+      65,    66,    67,    68,    39,    21,    22,    18,    40,    55,
+      56,    57,    45
+  };
+
+  const signed char
+  parser::yytable_[] =
+  {
+       6,     6,    15,    43,    28,    15,     7,    48,    14,    48,
+       6,    53,     2,     6,    19,    49,    23,    50,    69,    62,
+      58,    59,    23,     2,    53,    20,    60,    69,    62,     2,
+       6,     6,    62,    69,     2,    41,    42,    61,     2,    33,
+      15,    34,    76,    16,    54,    25,    83,    52,     6,    72,
+       1,    70,    85,    86,     2,    88,     2,    54,     2,    34,
+      70,    34,     2,    78,    70,    80,    70,    30,    31,     8,
+      32,    61,     2,     2,    33,    34,    34,    35,    61,     2,
+      33,     9,    34,    12,    10,    24,    13,    61,     2,    33,
+      46,    11,    47,    27,    44,    29,    74,    51,    71,    75,
+      81,    82,    84,    87,    89,    90,    91,    73,    77,     0,
+       0,    79,     0,    26
+  };
+
+  const signed char
+  parser::yycheck_[] =
+  {
+       0,     1,    10,    32,    24,    13,     1,     3,     0,     3,
+      10,    44,    15,    13,     0,    11,    16,    11,    51,    51,
+      49,    50,    22,    15,    57,     6,     3,    60,    60,    15,
+      30,    31,    64,    66,    15,    30,    31,    14,    15,    16,
+      48,    18,    62,     5,    44,     6,    75,     6,    48,     6,
+       3,    51,    81,    82,    15,    84,    15,    57,    15,    18,
+      60,    18,    15,    64,    64,    66,    66,     9,    10,     0,
+      12,    14,    15,    15,    16,    18,    18,    19,    14,    15,
+      16,     0,    18,     0,     3,    17,     3,    14,    15,    16,
+      38,     4,    40,     8,     5,     7,    60,    13,     8,     7,
+       7,     7,     7,     3,     3,     3,     3,    57,    64,    -1,
+      -1,    66,    -1,    22
+  };
+
+  const signed char
+  parser::yystos_[] =
+  {
+       0,     3,    15,    21,    22,    23,    38,    22,     0,     0,
+       3,     4,     0,     3,     0,    23,     5,    24,    37,     0,
+       6,    35,    36,    38,    17,     6,    35,     8,    37,     7,
+       9,    10,    12,    16,    18,    19,    25,    26,    27,    34,
+      38,    22,    22,    25,     5,    42,    42,    42,     3,    11,
+      11,    13,     6,    34,    38,    39,    40,    41,    25,    25,
+       3,    14,    27,    28,    29,    30,    31,    32,    33,    34,
+      38,     8,     6,    40,    28,     7,    37,    30,    33,    32,
+      33,     7,     7,    25,     7,    25,    25,     3,    25,     3,
+       3,     3
+  };
+
+  const signed char
+  parser::yyr1_[] =
+  {
+       0,    20,    21,    21,    21,    21,    22,    22,    23,    24,
+      25,    25,    25,    25,    25,    25,    25,    25,    26,    27,
+      28,    28,    28,    28,    28,    29,    29,    30,    31,    31,
+      32,    33,    33,    34,    35,    35,    36,    36,    37,    37,
+      38,    39,    39,    40,    40,    41,    41,    42,    42
+  };
+
+  const signed char
+  parser::yyr2_[] =
+  {
+       0,     2,     2,     3,     3,     4,     1,     3,     3,     5,
+       4,     4,     4,     5,     2,     2,     2,     1,     1,     1,
+       1,     1,     2,     1,     2,     1,     2,     5,     1,     2,
+       4,     4,     4,     1,     1,     2,     1,     2,     3,     2,
+       1,     1,     1,     1,     2,     1,     2,     3,     2
+  };
+
+
+#if YYDEBUG || 1
+  // YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+  // First, the terminals, then, starting at \a YYNTOKENS, nonterminals.
+  const char*
+  const parser::yytname_[] =
+  {
+  "\"<EOF>\"", "error", "\"invalid token\"", "\"\\n\"", "\"=\"", "\"{\"",
+  "\"}\"", "\"->\"", "\",\"", "\"let\"", "\"letrec\"", "\"in\"",
+  "\"case\"", "\"of\"", "\"default\"", "\"varname\"", "\"conname\"",
+  "\"updateflag\"", "\"int\"", "\"primop\"", "$accept", "program",
+  "bindings", "binding", "lambdaform", "expr", "primop", "constructor",
+  "alts", "algaltlist", "algalt", "primaltlist", "primalt", "defaultalt",
+  "literal", "variablelistelem", "variablelistbody", "variablelist",
+  "variable", "atom", "atomlistelem", "atomlistbody", "atomlist", YY_NULLPTR
+  };
+#endif
+
+
+#if YYDEBUG
+  const unsigned char
+  parser::yyrline_[] =
+  {
+       0,    90,    90,    91,    92,    93,    96,    97,   100,   103,
+     106,   107,   108,   109,   110,   111,   112,   113,   116,   119,
+     122,   123,   124,   125,   126,   129,   130,   133,   136,   137,
+     140,   143,   144,   147,   150,   151,   153,   154,   156,   157,
+     160,   163,   164,   167,   168,   170,   171,   173,   174
+  };
+
+  void
+  parser::yy_stack_print_ () const
+  {
+    *yycdebug_ << "Stack now";
+    for (stack_type::const_iterator
+           i = yystack_.begin (),
+           i_end = yystack_.end ();
+         i != i_end; ++i)
+      *yycdebug_ << ' ' << int (i->state);
+    *yycdebug_ << '\n';
+  }
+
+  void
+  parser::yy_reduce_print_ (int yyrule) const
+  {
+    int yylno = yyrline_[yyrule];
+    int yynrhs = yyr2_[yyrule];
+    // Print the symbols being reduced, and their result.
+    *yycdebug_ << "Reducing stack by rule " << yyrule - 1
+               << " (line " << yylno << "):\n";
+    // The symbols being reduced.
+    for (int yyi = 0; yyi < yynrhs; yyi++)
+      YY_SYMBOL_PRINT ("   $" << yyi + 1 << " =",
+                       yystack_[(yynrhs) - (yyi + 1)]);
+  }
+#endif // YYDEBUG
+
+
+#line 5 "/tmp/mine/base.yy"
+} // gg
+#line 1756 "parser.cc"
+
+#line 177 "/tmp/mine/base.yy"
+
+void gg::parser::error(const location_type &loc, const std::string &msg) {
+    std::stringstream ss;
+    ss << "parse error: " << msg;
+    throw gg::ast::bad_parse(ss.str(), loc);
+}
@@ -0,0 +1,137 @@
+#include "gg/allocation.h"
+#include "gg/heap.h"
+#include "gg/integer.h"
+#include "gg/runtime.h"
+
+namespace gg {
+namespace compiler {
+namespace {
+void add_site(heap_block& block,
+              const std::shared_ptr<ast::node>& node,
+              std::size_t words) {
+    if (block.checks.empty()) {
+        block.checks.emplace_back(0);
+    }
+    if (block.checks.back() + words > runtime::max_block_object_words) {
+        block.checks.emplace_back(0);
+    }
+    block.sites.push_back({node, block.checks.size() - 1, block.checks.back(), words});
+    block.checks.back() += words;
+    block.words += words;
+}
+
+/**
+   The plan being built for a program.
+*/
+struct planner {
+    const constructor_layouts& layouts;
+    const stack_closures& stack;
+    frame_plan& frames;
+    allocation_plan plan;
+
+    planner(const constructor_layouts& layouts,
+            const stack_closures& stack,
+            frame_plan& frames)
+        : layouts(layouts), stack(stack), frames(frames) {}
+
+    void plan_lambda(ast::lambda& lam);
+    void plan_expr(heap_block& block, const std::shared_ptr<ast::expr>& expr);
+};
+
+/**
+   Add the allocation done by an expression to the basic block it is part
+   of. Expressions which are compiled into new basic blocks get their own
+   entry in the plan.
+*/
+void planner::plan_expr(heap_block& block, const std::shared_ptr<ast::expr>& expr) {
+    if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+        // every closure of a `letrec` must exist before any is initialised,
+        // so they share the block's one heap check
+        for (const auto& binding : *let->bindings) {
+            auto frame = stack.find(binding.get());
+            add_site(frame == stack.end() ? block : frames[frame->second],
+                     binding,
+                     closure_words(*binding->rhs));
+        }
+        for (const auto& binding : *let->bindings) {
+            plan_lambda(*binding->rhs);
+        }
+        plan_expr(block, let->body);
+    }
+    else if (auto con = std::dynamic_pointer_cast<ast::construct>(expr)) {
+        if (!is_shared_construct(*con, layouts)) {
+            add_site(block, con, construct_words(*con));
+        }
+    }
+    else if (auto prim = std::dynamic_pointer_cast<ast::prim_apply>(expr)) {
+        if (std::size_t words = primop_words(*prim->op)) {
+            add_site(block, prim, words);
+        }
+    }
+    else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+        // the scrutinee runs before the return into the alternatives
+        plan_expr(block, case_->scrutinee);
+        for (const auto& alt : *case_->alts) {
+            plan_expr(plan[alt->body.get()], alt->body);
+        }
+    }
+}
+
+void planner::plan_lambda(ast::lambda& lam) {
+    plan_expr(plan[lam.body.get()], lam.body);
+}
+}
+
+std::size_t closure_words(const ast::lambda& lam) {
+    // the info table, the result slot of an updatable closure, and one
+    // word per free variable
+    return 1 + lam.update + lam.freevars->elems.size();
+}
+
+std::size_t construct_words(const ast::construct& con) {
+    return 1 + con.args->elems.size();
+}
+
+std::size_t primop_words(const ast::primop& op) {
+    switch (op.opcode) {
+    case ast::primopcode::PLUS_INTEGER:
+    case ast::primopcode::MINUS_INTEGER:
+    case ast::primopcode::TIMES_INTEGER:
+    case ast::primopcode::NEGATE_INTEGER:
+        return runtime::small_integer_words;
+    default:
+        return 0;
+    }
+}
+
+bool is_shared_construct(const ast::construct& con, const constructor_layouts& layouts) {
+    auto layout = layouts.find(con.con->name);
+    const auto& args = con.args->elems;
+    if (args.empty()) {
+        return layout == layouts.end() || layout->second.empty();
+    }
+    if (args.size() != 1 || layout == layouts.end() ||
+        layout->second != std::vector<ast::field_kind>{ast::field_kind::int64}) {
+        return false;
+    }
+    auto lit = std::dynamic_pointer_cast<ast::literal>(args.front());
+    if (!lit) {
+        return false;
+    }
+    const std::int64_t* value = std::get_if<std::int64_t>(&lit->value);
+    return value && *value >= runtime::min_shared_value &&
+           *value <= runtime::max_shared_value;
+}
+
+allocation_plan plan_allocation(ast::sequence<ast::binding>& bindings,
+                                const constructor_layouts& layouts,
+                                const stack_closures& stack,
+                                frame_plan& frames) {
+    planner p(layouts, stack, frames);
+    for (const auto& binding : bindings) {
+        p.plan_lambda(*binding->rhs);
+    }
+    return std::move(p.plan);
+}
+}
+}
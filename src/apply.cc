@@ -0,0 +1,148 @@
+#include <algorithm>
+
+#include "gg/apply.h"
+#include "gg/gc.h"
+#include "gg/scheduler.h"
+
+namespace gg {
+namespace runtime {
+namespace {
+using frame_infos = std::array<info_table, max_frame_words + 1>;
+
+constexpr unsigned long all_pointers(std::size_t words) {
+    return (1ul << words) - 1;
+}
+
+constexpr frame_infos make_apply_frames() {
+    frame_infos infos{};
+    for (std::size_t n = 0; n < infos.size(); ++n) {
+        infos[n] = {gg_apply_entry,
+                    0,
+                    nullptr,
+                    nullptr,
+                    frame_layout(n, all_pointers(n)),
+                    nullptr};
+    }
+    return infos;
+}
+
+constexpr frame_infos make_pap_infos() {
+    frame_infos infos{};
+    for (std::size_t n = 0; n < infos.size(); ++n) {
+        infos[n] = {gg_apply_entry, 1, nullptr, nullptr, closure_layout(1 + n, 0), nullptr};
+    }
+    return infos;
+}
+
+/**
+   Replace the frame on top of the stack. The new frame may not fit in the
+   current chunk, so the old one is popped first and the new one is built
+   in a buffer.
+
+   @param regs      The registers.
+   @param old_words The size of the old frame, with its info table.
+   @param words     The new frame, from the top of the stack down.
+   @param count     The size of the new frame.
+   @return          Whether there was room. Otherwise the thread has been
+                    killed and the caller should return.
+*/
+bool replace_frame(registers& regs,
+                   std::size_t old_words,
+                   const word* words,
+                   std::size_t count) {
+    regs.sp += old_words;
+    if (regs.sp - count < regs.sp_limit && !gg_grow_stack(count)) {
+        return false;
+    }
+    regs.sp -= count;
+    std::copy(words, words + count, regs.sp);
+    return true;
+}
+}
+
+bool is_partial_application(const info_table* info) {
+    return info >= gg_pap_info.data() && info < gg_pap_info.data() + gg_pap_info.size();
+}
+
+error_closure not_a_function_closure = {&error_info,
+                                        "applied a value which is not a function"};
+error_closure bad_application_closure = {&error_info,
+                                         "cannot partially apply a function to "
+                                         "these arguments"};
+}
+}
+
+using namespace gg::runtime;
+
+const frame_infos gg_apply_frames = make_apply_frames();
+const frame_infos gg_pap_info = make_pap_infos();
+
+void gg_apply_entry() {
+    capability& cap = *current_capability;
+    registers& regs = cap.regs;
+    closure* f = follow_indirections(regs.node);
+    regs.node = f;
+
+    auto frame = reinterpret_cast<const info_table*>(regs.sp[0]);
+    std::size_t count = frame_size(frame);
+    bool boxed = frame_pointers(frame) == all_pointers(count);
+    word* args = regs.sp + 1;
+    word buffer[2 * max_frame_words + 2];
+
+    const info_table* info = __atomic_load_n(&f->info, __ATOMIC_ACQUIRE);
+    if (is_partial_application(info)) {
+        std::size_t held = closure_pointers(info) - 1;
+        if (!boxed || held + count > max_frame_words) {
+            raise(cap, bad_application_closure);
+            return;
+        }
+        buffer[0] = reinterpret_cast<word>(&gg_apply_frames[held + count]);
+        std::copy(f->payload + 1, f->payload + 1 + held, buffer + 1);
+        std::copy(args, args + count, buffer + 1 + held);
+        if (!replace_frame(regs, count + 1, buffer, held + count + 1)) {
+            return;
+        }
+        regs.node = reinterpret_cast<closure*>(f->payload[pap_function_slot]);
+        regs.next = gg_apply_entry;
+        return;
+    }
+    if (info->entry_code && !info->arity) {
+        // a thunk, whose value returns to this frame
+        regs.next = info->entry_code;
+        return;
+    }
+    if (!info->entry_code) {
+        raise(cap, not_a_function_closure);
+        return;
+    }
+
+    std::size_t arity = info->arity;
+    if (arity == count) {
+        regs.next = info->entry_code;
+        return;
+    }
+    if (!boxed) {
+        raise(cap, bad_application_closure);
+        return;
+    }
+    if (arity < count) {
+        // call with the first arguments and apply the result to the rest
+        buffer[0] = reinterpret_cast<word>(&gg_apply_frames[arity]);
+        std::copy(args, args + arity, buffer + 1);
+        buffer[arity + 1] = reinterpret_cast<word>(&gg_apply_frames[count - arity]);
+        std::copy(args + arity, args + count, buffer + arity + 2);
+        if (!replace_frame(regs, count + 1, buffer, count + 2)) {
+            return;
+        }
+        regs.next = info->entry_code;
+        return;
+    }
+
+    closure* pap = allocate(cap, 2 + count);
+    pap->info = &gg_pap_info[count];
+    pap->payload[pap_function_slot] = reinterpret_cast<word>(f);
+    std::copy(args, args + count, pap->payload + 1);
+    regs.sp += count + 1;
+    regs.node = pap;
+    regs.next = reinterpret_cast<const info_table*>(regs.sp[0])->entry_code;
+}
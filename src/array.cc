@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cstring>
+
+#include "gg/array.h"
+#include "gg/gc.h"
+#include "gg/scheduler.h"
+
+namespace gg {
+namespace runtime {
+namespace {
+closure* copy_byte_array(closure* c) {
+    auto a = reinterpret_cast<byte_array*>(c);
+    return gg_copy(c, byte_array_words(a->bytes));
+}
+
+std::size_t scavenge_byte_array(closure* c) {
+    return byte_array_words(reinterpret_cast<byte_array*>(c)->bytes);
+}
+
+closure* copy_array(closure* c) {
+    auto a = reinterpret_cast<array*>(c);
+    return gg_copy(c, array_words(a->size));
+}
+
+std::size_t scavenge_array(closure* c) {
+    auto a = reinterpret_cast<array*>(c);
+    for (std::size_t n = 0; n < a->size; ++n) {
+        a->elems[n] = gg_evacuate(a->elems[n]);
+    }
+    return array_words(a->size);
+}
+
+/**
+   Sum a range with several vector accumulators, so that independent adds
+   can be in flight at once.
+*/
+template<typename T>
+T sum_range(const T* p, std::size_t count) {
+    typedef T vector __attribute__((vector_size(32)));
+    constexpr std::size_t lanes = sizeof(vector) / sizeof(T);
+    constexpr std::size_t accumulators = 4;
+
+    vector acc[accumulators] = {};
+    std::size_t n = 0;
+    for (; n + accumulators * lanes <= count; n += accumulators * lanes) {
+        for (std::size_t k = 0; k < accumulators; ++k) {
+            // the data is only word aligned
+            vector v;
+            std::memcpy(&v, p + n + k * lanes, sizeof(v));
+            acc[k] += v;
+        }
+    }
+
+    vector total = acc[0];
+    for (std::size_t k = 1; k < accumulators; ++k) {
+        total += acc[k];
+    }
+    T sum = 0;
+    for (std::size_t lane = 0; lane < lanes; ++lane) {
+        sum += total[lane];
+    }
+    for (; n < count; ++n) {
+        sum += p[n];
+    }
+    return sum;
+}
+
+unsigned char* bytes_of(closure* c, std::int64_t offset) {
+    return reinterpret_cast<unsigned char*>(reinterpret_cast<byte_array*>(c)->data) +
+        offset;
+}
+}
+
+const info_table byte_array_info = {nullptr,
+                                    0,
+                                    copy_byte_array,
+                                    scavenge_byte_array,
+                                    0,
+                                    nullptr};
+const info_table mutable_byte_array_info = {nullptr,
+                                            0,
+                                            copy_byte_array,
+                                            scavenge_byte_array,
+                                            0,
+                                            nullptr};
+const info_table array_info = {nullptr,
+                               0,
+                               copy_array,
+                               scavenge_array,
+                               0,
+                               nullptr};
+const info_table mutable_array_info = {nullptr,
+                                       0,
+                                       copy_array,
+                                       scavenge_array,
+                                       0,
+                                       nullptr};
+}
+}
+
+using namespace gg::runtime;
+
+closure* gg_new_byte_array(std::int64_t bytes) {
+    closure* c = allocate(*current_capability, byte_array_words(bytes));
+    auto a = reinterpret_cast<byte_array*>(c);
+    a->info = &mutable_byte_array_info;
+    a->bytes = bytes;
+    return c;
+}
+
+closure* gg_new_array(std::int64_t size, closure* init) {
+    closure* c = allocate(*current_capability, array_words(size));
+    auto a = reinterpret_cast<array*>(c);
+    a->info = &mutable_array_info;
+    a->size = size;
+    std::fill_n(a->elems, size, init);
+    return c;
+}
+
+closure* gg_unsafe_freeze(closure* c) {
+    if (c->info == &mutable_byte_array_info) {
+        c->info = &byte_array_info;
+    }
+    else if (c->info == &mutable_array_info) {
+        c->info = &array_info;
+    }
+    return c;
+}
+
+void gg_write_array(closure* c, std::int64_t i, closure* v) {
+    capability& cap = *current_capability;
+    closure*& elem = reinterpret_cast<array*>(c)->elems[i];
+    snapshot_barrier(cap, elem);
+    elem = v;
+    write_barrier(cap, c);
+}
+
+void gg_copy_byte_array(closure* src,
+                        std::int64_t src_offset,
+                        closure* dst,
+                        std::int64_t dst_offset,
+                        std::int64_t bytes) {
+    std::memmove(bytes_of(dst, dst_offset), bytes_of(src, src_offset), bytes);
+}
+
+void gg_set_byte_array(closure* c,
+                       std::int64_t offset,
+                       std::int64_t bytes,
+                       std::int64_t value) {
+    std::memset(bytes_of(c, offset), static_cast<unsigned char>(value), bytes);
+}
+
+std::int64_t gg_compare_byte_arrays(closure* a,
+                                    std::int64_t a_offset,
+                                    closure* b,
+                                    std::int64_t b_offset,
+                                    std::int64_t bytes) {
+    return std::memcmp(bytes_of(a, a_offset), bytes_of(b, b_offset), bytes);
+}
+
+std::int64_t gg_sum_int_array(closure* c, std::int64_t offset, std::int64_t count) {
+    // unsigned so that overflow wraps rather than being undefined
+    auto data = reinterpret_cast<const std::uint64_t*>(
+        reinterpret_cast<byte_array*>(c)->data);
+    return static_cast<std::int64_t>(sum_range(data + offset, count));
+}
+
+double gg_sum_double_array(closure* c, std::int64_t offset, std::int64_t count) {
+    auto data = reinterpret_cast<const double*>(reinterpret_cast<byte_array*>(c)->data);
+    return sum_range(data + offset, count);
+}
+
+void gg_copy_array(closure* src,
+                   std::int64_t src_offset,
+                   closure* dst,
+                   std::int64_t dst_offset,
+                   std::int64_t count) {
+    auto from = reinterpret_cast<array*>(src)->elems + src_offset;
+    auto to = reinterpret_cast<array*>(dst)->elems + dst_offset;
+    capability& cap = *current_capability;
+    if (cap.sched.gc.is_marking()) {
+        for (std::int64_t n = 0; n < count; ++n) {
+            snapshot_barrier(cap, to[n]);
+        }
+    }
+    std::memmove(to, from, count * sizeof(closure*));
+    write_barrier(cap, dst);
+}
@@ -1,4 +1,6 @@
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 #include <functional>
 
@@ -56,7 +58,26 @@ std::ostream& constructor::format(std::ostream& s, std::size_t depth) const {
 std::ostream& literal::format(std::ostream& s, std::size_t depth) const {
     std::stringstream ss;
     std::visit([&ss](auto v) {
-            ss << v << '#';
+            if constexpr (std::is_same_v<decltype(v), double>) {
+                // the fewest digits which read back as the same double
+                std::stringstream digits;
+                for (int precision = std::numeric_limits<double>::digits10;
+                     precision <= std::numeric_limits<double>::max_digits10;
+                     ++precision) {
+                    digits.str("");
+                    digits << std::setprecision(precision) << v;
+                    if (std::stod(digits.str()) == v) {
+                        break;
+                    }
+                }
+                ss << digits.str() << "##";
+            }
+            else if constexpr (std::is_same_v<decltype(v), integer_digits>) {
+                ss << v.digits << "I#";
+            }
+            else {
+                ss << v << '#';
+            }
     }, value);
     return pformat::format_with_args("literal",
                                      s,
@@ -89,6 +110,54 @@ std::ostream& primop::format(std::ostream& s, std::size_t depth) const {
         {primopcode::GT, ">#"},
         {primopcode::INVERT, "~#"},
         {primopcode::NEGATE, "~-#"},
+        {primopcode::FORK, "fork#"},
+        {primopcode::YIELD, "yield#"},
+        {primopcode::NEW_MVAR, "newMVar#"},
+        {primopcode::TAKE_MVAR, "takeMVar#"},
+        {primopcode::PUT_MVAR, "putMVar#"},
+        {primopcode::ADD_DOUBLE, "+##"},
+        {primopcode::SUB_DOUBLE, "-##"},
+        {primopcode::MUL_DOUBLE, "*##"},
+        {primopcode::DIV_DOUBLE, "/##"},
+        {primopcode::POW_DOUBLE, "**##"},
+        {primopcode::LT_DOUBLE, "<##"},
+        {primopcode::LE_DOUBLE, "<=##"},
+        {primopcode::EQ_DOUBLE, "==##"},
+        {primopcode::NE_DOUBLE, "/=##"},
+        {primopcode::GE_DOUBLE, ">=##"},
+        {primopcode::GT_DOUBLE, ">##"},
+        {primopcode::NEGATE_DOUBLE, "~-##"},
+        {primopcode::SQRT_DOUBLE, "sqrtDouble#"},
+        {primopcode::INT_TO_DOUBLE, "int2Double#"},
+        {primopcode::DOUBLE_TO_INT, "double2Int#"},
+        {primopcode::NEW_BYTE_ARRAY, "newByteArray#"},
+        {primopcode::SIZEOF_BYTE_ARRAY, "sizeofByteArray#"},
+        {primopcode::INDEX_INT_ARRAY, "indexIntArray#"},
+        {primopcode::INDEX_DOUBLE_ARRAY, "indexDoubleArray#"},
+        {primopcode::READ_INT_ARRAY, "readIntArray#"},
+        {primopcode::READ_DOUBLE_ARRAY, "readDoubleArray#"},
+        {primopcode::WRITE_INT_ARRAY, "writeIntArray#"},
+        {primopcode::WRITE_DOUBLE_ARRAY, "writeDoubleArray#"},
+        {primopcode::COPY_BYTE_ARRAY, "copyByteArray#"},
+        {primopcode::SET_BYTE_ARRAY, "setByteArray#"},
+        {primopcode::COMPARE_BYTE_ARRAYS, "compareByteArrays#"},
+        {primopcode::SUM_INT_ARRAY, "sumIntArray#"},
+        {primopcode::SUM_DOUBLE_ARRAY, "sumDoubleArray#"},
+        {primopcode::UNSAFE_FREEZE_BYTE_ARRAY, "unsafeFreezeByteArray#"},
+        {primopcode::NEW_ARRAY, "newArray#"},
+        {primopcode::SIZEOF_ARRAY, "sizeofArray#"},
+        {primopcode::INDEX_ARRAY, "indexArray#"},
+        {primopcode::READ_ARRAY, "readArray#"},
+        {primopcode::WRITE_ARRAY, "writeArray#"},
+        {primopcode::COPY_ARRAY, "copyArray#"},
+        {primopcode::UNSAFE_FREEZE_ARRAY, "unsafeFreezeArray#"},
+        {primopcode::PLUS_INTEGER, "plusInteger#"},
+        {primopcode::MINUS_INTEGER, "minusInteger#"},
+        {primopcode::TIMES_INTEGER, "timesInteger#"},
+        {primopcode::NEGATE_INTEGER, "negateInteger#"},
+        {primopcode::COMPARE_INTEGER, "compareInteger#"},
+        {primopcode::INT_TO_INTEGER, "int2Integer#"},
+        {primopcode::INTEGER_TO_INT, "integer2Int#"},
     };
     auto search = lookup.find(opcode);
     return pformat::format_with_args("primop",
@@ -270,6 +339,39 @@ std::ostream& lit_expr::format(std::ostream& s, std::size_t depth) const {
 
 defchildren(lit_expr, lit)
 
+field::field(const location& loc, field_kind kind) : node(loc), kind(kind) {}
+
+std::ostream& field::format(std::ostream& s, std::size_t depth) const {
+    static std::unordered_map<field_kind, std::string> lookup = {
+        {field_kind::boxed, "boxed"},
+        {field_kind::int64, "!int"},
+        {field_kind::float64, "!double"},
+    };
+    return pformat::format_with_args("field", s, depth, loc, lookup[kind]);
+}
+
+data_declaration::data_declaration(const location& loc,
+                                   const std::shared_ptr<constructor>& con,
+                                   const std::shared_ptr<sequence<field>>& fields)
+    : node(loc), con(con), fields(fields) {}
+
+std::ostream& data_declaration::format(std::ostream& s, std::size_t depth) const {
+    return pformat::format_with_args("data_declaration", s, depth, loc, con, fields);
+}
+
+defchildren(data_declaration, con, fields)
+
+program::program(const location& loc,
+                 const std::shared_ptr<sequence<data_declaration>>& declarations,
+                 const std::shared_ptr<sequence<binding>>& bindings)
+    : node(loc), declarations(declarations), bindings(bindings) {}
+
+std::ostream& program::format(std::ostream& s, std::size_t depth) const {
+    return pformat::format_with_args("program", s, depth, loc, declarations, bindings);
+}
+
+defchildren(program, declarations, bindings)
+
 std::optional<primopcode> primopcode_from_s(const std::string& cs) {
     static std::unordered_map<std::string, primopcode> lookup = {
         {"+#", primopcode::ADD},
@@ -291,6 +393,54 @@ std::optional<primopcode> primopcode_from_s(const std::string& cs) {
         {">#", primopcode::GT},
         {"~#", primopcode::INVERT},
         {"~-#", primopcode::NEGATE},
+        {"fork#", primopcode::FORK},
+        {"yield#", primopcode::YIELD},
+        {"newMVar#", primopcode::NEW_MVAR},
+        {"takeMVar#", primopcode::TAKE_MVAR},
+        {"putMVar#", primopcode::PUT_MVAR},
+        {"+##", primopcode::ADD_DOUBLE},
+        {"-##", primopcode::SUB_DOUBLE},
+        {"*##", primopcode::MUL_DOUBLE},
+        {"/##", primopcode::DIV_DOUBLE},
+        {"**##", primopcode::POW_DOUBLE},
+        {"<##", primopcode::LT_DOUBLE},
+        {"<=##", primopcode::LE_DOUBLE},
+        {"==##", primopcode::EQ_DOUBLE},
+        {"/=##", primopcode::NE_DOUBLE},
+        {">=##", primopcode::GE_DOUBLE},
+        {">##", primopcode::GT_DOUBLE},
+        {"~-##", primopcode::NEGATE_DOUBLE},
+        {"sqrtDouble#", primopcode::SQRT_DOUBLE},
+        {"int2Double#", primopcode::INT_TO_DOUBLE},
+        {"double2Int#", primopcode::DOUBLE_TO_INT},
+        {"newByteArray#", primopcode::NEW_BYTE_ARRAY},
+        {"sizeofByteArray#", primopcode::SIZEOF_BYTE_ARRAY},
+        {"indexIntArray#", primopcode::INDEX_INT_ARRAY},
+        {"indexDoubleArray#", primopcode::INDEX_DOUBLE_ARRAY},
+        {"readIntArray#", primopcode::READ_INT_ARRAY},
+        {"readDoubleArray#", primopcode::READ_DOUBLE_ARRAY},
+        {"writeIntArray#", primopcode::WRITE_INT_ARRAY},
+        {"writeDoubleArray#", primopcode::WRITE_DOUBLE_ARRAY},
+        {"copyByteArray#", primopcode::COPY_BYTE_ARRAY},
+        {"setByteArray#", primopcode::SET_BYTE_ARRAY},
+        {"compareByteArrays#", primopcode::COMPARE_BYTE_ARRAYS},
+        {"sumIntArray#", primopcode::SUM_INT_ARRAY},
+        {"sumDoubleArray#", primopcode::SUM_DOUBLE_ARRAY},
+        {"unsafeFreezeByteArray#", primopcode::UNSAFE_FREEZE_BYTE_ARRAY},
+        {"newArray#", primopcode::NEW_ARRAY},
+        {"sizeofArray#", primopcode::SIZEOF_ARRAY},
+        {"indexArray#", primopcode::INDEX_ARRAY},
+        {"readArray#", primopcode::READ_ARRAY},
+        {"writeArray#", primopcode::WRITE_ARRAY},
+        {"copyArray#", primopcode::COPY_ARRAY},
+        {"unsafeFreezeArray#", primopcode::UNSAFE_FREEZE_ARRAY},
+        {"plusInteger#", primopcode::PLUS_INTEGER},
+        {"minusInteger#", primopcode::MINUS_INTEGER},
+        {"timesInteger#", primopcode::TIMES_INTEGER},
+        {"negateInteger#", primopcode::NEGATE_INTEGER},
+        {"compareInteger#", primopcode::COMPARE_INTEGER},
+        {"int2Integer#", primopcode::INT_TO_INTEGER},
+        {"integer2Int#", primopcode::INTEGER_TO_INT},
     };
 
     auto search = lookup.find(cs);
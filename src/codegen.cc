@@ -0,0 +1,1672 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+#include "gg/compiler.h"
+#include "gg/jit_polyfill.h"
+#include "gg/references.h"
+#include "gg/runtime.h"
+#include "gg/stack.h"
+#include "gg/thunk.h"
+
+namespace gg {
+namespace compiler {
+namespace {
+bool is_raw(ast::field_kind kind) {
+    return kind != ast::field_kind::boxed;
+}
+
+/**
+   @return The size of a basic block's first heap check, the one which is
+           a safe point.
+*/
+std::size_t first_check(const heap_block& heap) {
+    return heap.checks.empty() ? 0 : heap.checks.front();
+}
+
+/**
+   @return A name made of the characters of `name` which may appear in a C
+           identifier, for naming generated functions after a binding.
+*/
+std::string c_name(const std::string& name) {
+    std::string out = name;
+    for (char& c : out) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+            c = '_';
+        }
+    }
+    return out;
+}
+
+/**
+   @return What the result of a primitive operation holds.
+*/
+ast::field_kind result_kind(const ast::primop& op) {
+    if (op.returns_closure()) {
+        return ast::field_kind::boxed;
+    }
+    switch (op.opcode) {
+    case ast::primopcode::ADD_DOUBLE:
+    case ast::primopcode::SUB_DOUBLE:
+    case ast::primopcode::MUL_DOUBLE:
+    case ast::primopcode::DIV_DOUBLE:
+    case ast::primopcode::POW_DOUBLE:
+    case ast::primopcode::NEGATE_DOUBLE:
+    case ast::primopcode::SQRT_DOUBLE:
+    case ast::primopcode::INT_TO_DOUBLE:
+    case ast::primopcode::INDEX_DOUBLE_ARRAY:
+    case ast::primopcode::READ_DOUBLE_ARRAY:
+    case ast::primopcode::SUM_DOUBLE_ARRAY:
+        return ast::field_kind::float64;
+    default:
+        return ast::field_kind::int64;
+    }
+}
+
+/**
+   @return The runtime entry point of an operation which may deschedule the
+           thread, or `nullptr` if the operation always runs to completion.
+*/
+const char* scheduler_call(const ast::primop& op) {
+    switch (op.opcode) {
+    case ast::primopcode::YIELD:
+        return "gg_yield";
+    case ast::primopcode::TAKE_MVAR:
+        return "gg_take_mvar";
+    case ast::primopcode::PUT_MVAR:
+        return "gg_put_mvar";
+    default:
+        return nullptr;
+    }
+}
+
+/**
+   @return Whether the closure an operation returns may be a thunk: an array
+           element or the contents of an mvar.
+*/
+bool may_return_thunk(const ast::primop& op) {
+    return op.opcode == ast::primopcode::INDEX_ARRAY ||
+        op.opcode == ast::primopcode::READ_ARRAY ||
+        op.opcode == ast::primopcode::TAKE_MVAR;
+}
+
+/**
+   A variable in scope in the code being generated.
+*/
+struct local_value {
+    gccjit::lvalue value;
+    ast::field_kind kind;
+
+    /**
+       The let bound lambda the variable is a closure of, which can be
+       called directly, or `nullptr`.
+    */
+    const ast::lambda* lam = nullptr;
+};
+
+/**
+   Where the words of a case continuation's frame go.
+
+   A frame is described by one info table, which covers at most
+   `runtime::max_frame_words` words. Larger frames are split into segments
+   of that many words, each after an info table of its own; only the first
+   one has return code, which pops the whole frame, and the others are only
+   there for the collector.
+*/
+struct frame_shape {
+    /**
+       Whether each word of the frame, not counting the info tables, is a
+       closure pointer.
+    */
+    std::vector<bool> pointers;
+
+    std::size_t words() const {
+        return pointers.size();
+    }
+
+    std::size_t segments() const {
+        constexpr std::size_t max = runtime::max_frame_words;
+        return std::max<std::size_t>(1, (words() + max - 1) / max);
+    }
+
+    /**
+       @return The number of stack words the frame takes.
+    */
+    std::size_t stack_words() const {
+        return words() + segments();
+    }
+
+    /**
+       @param word A word of the frame.
+       @return     Its offset from the stack pointer.
+    */
+    static long offset(std::size_t word) {
+        return word + word / runtime::max_frame_words + 1;
+    }
+
+    /**
+       @param segment A segment of the frame.
+       @return        The offset of its info table from the stack pointer.
+    */
+    static long header(std::size_t segment) {
+        return segment * (runtime::max_frame_words + 1);
+    }
+
+    std::size_t add(bool pointer) {
+        pointers.push_back(pointer);
+        return words() - 1;
+    }
+
+    /**
+       Add the words of a closure, which must all be in the same segment.
+
+       @param fields Whether each word of the closure is a pointer.
+       @return       The first word of the closure.
+    */
+    std::size_t add_closure(const std::vector<bool>& fields) {
+        constexpr std::size_t max = runtime::max_frame_words;
+        if (words() / max != (words() + fields.size() - 1) / max) {
+            while (words() % max) {
+                add(false);
+            }
+        }
+        std::size_t start = words();
+        for (bool pointer : fields) {
+            add(pointer);
+        }
+        return start;
+    }
+
+    unsigned long layout(std::size_t segment) const {
+        std::size_t begin = segment * runtime::max_frame_words;
+        std::size_t end = std::min(words(), begin + runtime::max_frame_words);
+        unsigned long bitmap = 0;
+        for (std::size_t n = begin; n < end; ++n) {
+            if (pointers[n]) {
+                bitmap |= 1ul << (n - begin);
+            }
+        }
+        return runtime::frame_layout(end - begin, bitmap);
+    }
+};
+
+/**
+   A point a lambda's code can be resumed at, by returning to a frame or
+   rerunning a heap check.
+*/
+struct resume_point {
+    /**
+       The continuation which resumes the lambda, which is the return code
+       of the frame.
+    */
+    gccjit::function code;
+
+    /**
+       The block it starts in.
+    */
+    gccjit::block block;
+};
+
+/**
+   A let bound closure which lives in the frame of a case continuation. It
+   is written when the frame is pushed.
+*/
+struct frame_closure {
+    const ast::lambda* lam;
+    gccjit::lvalue local;
+    std::vector<local_value> freevars;
+};
+}
+
+/**
+   Generates the code of one lambda.
+
+   The code is a function which takes the point to resume at: 0 to enter
+   the lambda, or a point after a case's scrutinee has returned or a heap
+   check has failed. Each point has a continuation of its own which calls
+   the function; the lambda's entry code is the one for 0. Locals do not
+   survive a return, so a case saves the variables its alternatives use in
+   its frame, and reloads them when it is resumed.
+
+   Let bound lambdas are compiled by a `function_compiler` of their own as
+   they are allocated, except for selector thunks, which run the runtime's
+   code.
+*/
+struct function_compiler {
+    context& cx;
+    gccjit::context& ctx;
+    const ast::lambda& lam;
+    std::string prefix;
+
+    /**
+       The static reference table of the top level binding the lambda is
+       part of, as a `void*`.
+    */
+    gccjit::rvalue srt;
+
+    /**
+       The lambda of every top level binding of the batch, for calling them
+       directly.
+    */
+    const std::unordered_map<std::string, const ast::lambda*>& globals;
+
+    gccjit::type void_type;
+    gccjit::type int_type;
+    gccjit::type long_type;
+    gccjit::type ulong_type;
+    gccjit::type double_type;
+    gccjit::type size_type;
+    gccjit::type void_ptr;
+    gccjit::type closure_ptr;
+    gccjit::type info_ptr;
+
+    gccjit::function body;
+    gccjit::param resume;
+    std::vector<resume_point> resumes;
+    std::size_t frames = 0;
+
+    std::unordered_map<std::string, std::vector<local_value>> locals;
+    std::unordered_map<const ast::binding*, frame_closure> frame_closures;
+
+    /**
+       The allocation of the basic block being compiled, and where each of
+       its heap checks starts, which its allocation sites are offsets from.
+    */
+    const heap_block* heap = nullptr;
+    std::vector<gccjit::rvalue> heap_starts;
+
+    function_compiler(context& cx,
+                      const ast::lambda& lam,
+                      const std::string& prefix,
+                      gccjit::rvalue srt,
+                      const std::unordered_map<std::string, const ast::lambda*>& globals)
+        : cx(cx), ctx(cx.ctx), lam(lam), prefix(prefix), srt(srt), globals(globals) {
+        void_type = ctx.get_type(GCC_JIT_TYPE_VOID);
+        int_type = ctx.get_type(GCC_JIT_TYPE_INT);
+        long_type = ctx.get_type(GCC_JIT_TYPE_LONG);
+        ulong_type = ctx.get_type(GCC_JIT_TYPE_UNSIGNED_LONG);
+        double_type = ctx.get_type(GCC_JIT_TYPE_DOUBLE);
+        size_type = ctx.get_type(GCC_JIT_TYPE_SIZE_T);
+        void_ptr = ctx.get_type(GCC_JIT_TYPE_VOID_PTR);
+        closure_ptr = cx.closure_type.get_pointer();
+        info_ptr = cx.info_table_type.get_pointer();
+    }
+
+    /**
+       Generate the lambda's code.
+
+       @param entry    Its entry code, which has been declared but not
+                       defined.
+       @param info     Its info table.
+       @param caf      Whether it is a CAF.
+       @param captured The values of its free variables where it is
+                       allocated, in order.
+       @param params   What each parameter holds, or `nullptr` if they are
+                       all boxed.
+    */
+    void compile(gccjit::function entry,
+                 gccjit::lvalue info,
+                 bool caf,
+                 const std::vector<local_value>& captured,
+                 const std::vector<ast::field_kind>* params);
+
+    gccjit::type type_of(ast::field_kind kind) {
+        switch (kind) {
+        case ast::field_kind::int64:
+            return long_type;
+        case ast::field_kind::float64:
+            return double_type;
+        default:
+            return closure_ptr;
+        }
+    }
+
+    gccjit::lvalue reg(gccjit::field field) {
+        return cx.base.dereference_field(field);
+    }
+
+    gccjit::rvalue index(long n) {
+        return ctx.new_rvalue(long_type, n);
+    }
+
+    /**
+       @param words A `word*`, or a closure's payload.
+       @param n     An index into it.
+       @param type  The type to see the word as.
+       @return      The word.
+    */
+    gccjit::lvalue word_at(gccjit::rvalue words, long n, gccjit::type type) {
+        auto slot = ctx.new_array_access(words, index(n));
+        return ctx.new_cast(slot.get_address(), type.get_pointer()).dereference();
+    }
+
+    gccjit::lvalue payload(gccjit::rvalue c, std::size_t n, gccjit::type type) {
+        return word_at(c.dereference_field(cx.payload_field), n, type);
+    }
+
+    gccjit::lvalue info_of(gccjit::rvalue c) {
+        return c.dereference_field(cx.info_field);
+    }
+
+    /**
+       @return The return code of the frame on top of the stack.
+    */
+    gccjit::rvalue top_frame_code() {
+        return word_at(reg(cx.sp_field), 0, info_ptr).dereference_field(cx.entry_code_field);
+    }
+
+    /**
+       @return Whether a closure with this info table is a thunk, which is
+               entered rather than returned.
+    */
+    gccjit::rvalue is_thunk(gccjit::rvalue info) {
+        auto has_code = ctx.new_comparison(GCC_JIT_COMPARISON_NE,
+                                           info.dereference_field(cx.entry_code_field),
+                                           ctx.null(cx.continuation_type));
+        auto no_arguments = ctx.new_comparison(GCC_JIT_COMPARISON_EQ,
+                                               info.dereference_field(cx.arity_field),
+                                               ctx.zero(ulong_type));
+        return ctx.new_binary_op(GCC_JIT_BINARY_OP_LOGICAL_AND,
+                                 ctx.get_type(GCC_JIT_TYPE_BOOL),
+                                 has_code,
+                                 no_arguments);
+    }
+
+    void bind(const std::string& name, const local_value& value) {
+        locals[name].emplace_back(value);
+    }
+
+    void unbind(const std::string& name) {
+        locals[name].pop_back();
+    }
+
+    const local_value* find_local(const std::string& name) const {
+        auto it = locals.find(name);
+        if (it == locals.end() || it->second.empty()) {
+            return nullptr;
+        }
+        return &it->second.back();
+    }
+
+    /**
+       @return The value of an atom, and what it holds.
+    */
+    std::pair<gccjit::rvalue, ast::field_kind> atom_value(const ast::atom& atom);
+
+    /**
+       @return A fresh resume point, whose block the caller fills in.
+    */
+    resume_point new_resume_point();
+
+    /**
+       Make room for some words on the stack, or return from the function if
+       the stack cannot grow.
+    */
+    void reserve_stack(gccjit::block& block, std::size_t words);
+
+    /**
+       Return a value to the frame on top of the stack.
+    */
+    void return_value(gccjit::block& block, gccjit::rvalue value);
+
+    /**
+       Return a closure, or enter it if it is a thunk.
+    */
+    void evaluate(gccjit::block& block, gccjit::rvalue value);
+
+    /**
+       @param node The `ast::binding`, `ast::construct` or `ast::prim_apply`.
+       @return     Its allocation site in the current basic block, or
+                   `nullptr` if it is allocated somewhere else.
+    */
+    const allocation_site* find_site(const ast::node* node) const;
+
+    gccjit::rvalue site_address(const allocation_site& site) {
+        return cx.site_address(heap_starts.at(site.check), site);
+    }
+
+    /**
+       Emit the heap checks of the current basic block after its first.
+    */
+    void emit_later_checks(gccjit::block& block);
+
+    /**
+       @return The info table of an argument frame holding values of these
+               kinds.
+    */
+    gccjit::rvalue argument_frame(const std::vector<ast::field_kind>& kinds);
+
+    /**
+       @return The info tables of a frame of this shape, one per segment.
+    */
+    std::vector<gccjit::rvalue> frame_infos(const frame_shape& shape,
+                                            const resume_point& point);
+
+    /**
+       Push the frame of a case continuation or of a failed heap check.
+
+       @param block    The current block; on return, the block to continue
+                       in.
+       @param saved    The variables to save, which come first.
+       @param closures The closures the frame holds, after them.
+       @param shape    The shape of the frame.
+       @param starts   The first word of each closure.
+       @param point    Where to resume when the frame is returned to.
+    */
+    void push_frame(gccjit::block& block,
+                    const std::vector<local_value>& saved,
+                    const std::vector<const frame_closure*>& closures,
+                    const frame_shape& shape,
+                    const std::vector<std::size_t>& starts,
+                    const resume_point& point);
+
+    /**
+       Reload the variables saved by `push_frame` and pop the frame.
+    */
+    void pop_frame(gccjit::block& block,
+                   const std::vector<local_value>& saved,
+                   const frame_shape& shape);
+
+    /**
+       Add the variables in scope which an expression uses to `live`.
+
+       @param live     The names.
+       @param expr     The expression.
+       @param excluded Names which the expression is in the scope of, but
+                       which are not bound yet.
+    */
+    void add_live(std::set<std::string>& live,
+                  const std::shared_ptr<ast::expr>& expr,
+                  const std::vector<std::string>& excluded = {});
+
+    /**
+       @return The values of some variables, to save in a frame.
+    */
+    std::vector<local_value> saved_locals(const std::set<std::string>& live);
+
+    /**
+       @return The values of the free variables of a lambda where it is
+               allocated.
+    */
+    std::vector<local_value> capture(const ast::lambda& lam);
+
+    /**
+       Write the header and free variables of a let bound closure.
+    */
+    void write_closure(gccjit::block& block,
+                       gccjit::rvalue c,
+                       const ast::lambda& lam,
+                       const std::vector<local_value>& freevars);
+
+    /**
+       Declare the info table and entry code of a let bound lambda.
+
+       @return The prefix of the names of its generated code.
+    */
+    std::string declare_lambda(const ast::binding& binding);
+
+    void compile_tail(gccjit::block block, const std::shared_ptr<ast::expr>& expr);
+    void compile_let(gccjit::block& block, const ast::local_bindings& let);
+    void compile_apply(gccjit::block& block, const ast::apply& app);
+    gccjit::rvalue construct_value(gccjit::block& block, const ast::construct& con);
+    void compile_case(gccjit::block& block, const ast::case_& case_);
+
+    /**
+       @return The values of the arguments of a primitive operation.
+    */
+    std::vector<gccjit::rvalue> prim_args(const ast::prim_apply& prim);
+
+    /**
+       Compute a primitive operation which always runs to completion.
+
+       @return The result, and what it holds.
+    */
+    std::pair<gccjit::rvalue, ast::field_kind> prim_value(gccjit::block& block,
+                                                          const ast::prim_apply& prim);
+
+    /**
+       Call an operation which may deschedule the thread. The call returns
+       to the scheduler, which runs a new resume point once the operation
+       has completed.
+
+       @param block The current block; on return, the block of the resume
+                    point, where the result is in `node`.
+       @param prim  The operation.
+       @param saved The variables to keep across the call.
+    */
+    void call_scheduler(gccjit::block& block,
+                        const ast::prim_apply& prim,
+                        const std::vector<local_value>& saved);
+
+    void compile_prim(gccjit::block& block, const ast::prim_apply& prim);
+    void compile_prim_case(gccjit::block& block,
+                           const ast::prim_apply& prim,
+                           const ast::case_& case_);
+
+    /**
+       @return The variables the alternatives of a case use.
+    */
+    std::vector<local_value> alternative_locals(const ast::case_& case_);
+
+    /**
+       Take apart a boxed value with the alternatives of a case, entering it
+       first if it is a thunk.
+
+       @param value A local holding the value, which is overwritten with
+                    the thunk's value.
+    */
+    void dispatch_lazy(gccjit::block& block, gccjit::lvalue value, const ast::case_& case_);
+
+    /**
+       Take apart an evaluated boxed value with the alternatives of a case.
+    */
+    void dispatch_boxed(gccjit::block& block, gccjit::rvalue value, const ast::case_& case_);
+
+    /**
+       Choose the alternative of a case for a raw value.
+    */
+    void dispatch_raw(gccjit::block& block,
+                      gccjit::rvalue value,
+                      ast::field_kind kind,
+                      const ast::case_& case_);
+
+    /**
+       Compile an alternative of a case.
+
+       @param alt   The alternative.
+       @param value The scrutinee's value.
+       @param kind  What the value holds.
+       @return      The block the alternative starts in.
+    */
+    gccjit::block compile_alt(const ast::alternative& alt,
+                              gccjit::rvalue value,
+                              ast::field_kind kind);
+
+    gccjit::block match_failure();
+};
+
+std::pair<gccjit::rvalue, ast::field_kind>
+function_compiler::atom_value(const ast::atom& atom) {
+    if (auto var = dynamic_cast<const ast::variable*>(&atom)) {
+        if (const local_value* local = find_local(var->name)) {
+            return {local->value, local->kind};
+        }
+        return {ctx.new_cast(cx.static_address(var->name), closure_ptr),
+                ast::field_kind::boxed};
+    }
+    const auto& lit = dynamic_cast<const ast::literal&>(atom);
+    auto value = cx.literal_value(lit);
+    if (std::holds_alternative<ast::integer_digits>(lit.value)) {
+        return {ctx.new_cast(value, closure_ptr), ast::field_kind::boxed};
+    }
+    if (std::holds_alternative<double>(lit.value)) {
+        return {value, ast::field_kind::float64};
+    }
+    return {value, ast::field_kind::int64};
+}
+
+resume_point function_compiler::new_resume_point() {
+    std::size_t n = resumes.size() + 1;
+    std::vector<gccjit::param> params;
+    auto code = ctx.new_function(GCC_JIT_FUNCTION_INTERNAL,
+                                 void_type,
+                                 prefix + "_resume" + std::to_string(n),
+                                 params,
+                                 0);
+    auto call = code.new_block("call");
+    call.add_eval(ctx.new_call(body, ctx.new_rvalue(int_type, static_cast<int>(n))));
+    call.end_with_return();
+
+    resumes.push_back({code, body.new_block("resume" + std::to_string(n))});
+    return resumes.back();
+}
+
+void function_compiler::reserve_stack(gccjit::block& block, std::size_t words) {
+    auto sp = reg(cx.sp_field);
+    auto top = ctx.new_array_access(sp, index(-static_cast<long>(words))).get_address();
+    auto grow = body.new_block("grow_stack");
+    auto overflow = body.new_block("stack_overflow");
+    auto ok = body.new_block("stack_ok");
+
+    block.end_with_conditional(
+        ctx.new_comparison(GCC_JIT_COMPARISON_LT, top, reg(cx.sp_limit_field)),
+        grow,
+        ok);
+    auto size = ctx.new_rvalue(size_type, static_cast<long>(words));
+    grow.end_with_conditional(ctx.new_comparison(GCC_JIT_COMPARISON_EQ,
+                                                 ctx.new_call(cx.grow_stack, size),
+                                                 ctx.zero(int_type)),
+                              overflow,
+                              ok);
+    overflow.end_with_return();
+
+    // in the new chunk if the stack grew
+    ok.add_assignment(sp, top);
+    block = ok;
+}
+
+void function_compiler::return_value(gccjit::block& block, gccjit::rvalue value) {
+    block.add_assignment(reg(cx.node_field), value);
+    block.add_assignment(reg(cx.next_field), top_frame_code());
+    block.end_with_return();
+}
+
+void function_compiler::evaluate(gccjit::block& block, gccjit::rvalue value) {
+    auto node = reg(cx.node_field);
+    block.add_assignment(node, value);
+    auto info = info_of(node);
+    auto enter = body.new_block("enter");
+    auto ret = body.new_block("return");
+    block.end_with_conditional(is_thunk(info), enter, ret);
+
+    enter.add_assignment(reg(cx.next_field), info.dereference_field(cx.entry_code_field));
+    enter.end_with_return();
+    ret.add_assignment(reg(cx.next_field), top_frame_code());
+    ret.end_with_return();
+}
+
+void function_compiler::emit_later_checks(gccjit::block& block) {
+    for (std::size_t n = 1; n < heap->checks.size(); ++n) {
+        heap_starts.emplace_back(cx.emit_allocation(body, block, heap->checks[n]));
+    }
+}
+
+const allocation_site* function_compiler::find_site(const ast::node* node) const {
+    if (!heap) {
+        return nullptr;
+    }
+    for (const auto& site : heap->sites) {
+        if (site.node.get() == node) {
+            return &site;
+        }
+    }
+    return nullptr;
+}
+
+gccjit::rvalue
+function_compiler::argument_frame(const std::vector<ast::field_kind>& kinds) {
+    unsigned long pointers = 0;
+    bool boxed = true;
+    for (std::size_t n = 0; n < kinds.size(); ++n) {
+        if (is_raw(kinds[n])) {
+            boxed = false;
+        }
+        else {
+            pointers |= 1ul << n;
+        }
+    }
+    if (boxed) {
+        auto slot = ctx.new_rvalue(int_type, static_cast<int>(kinds.size()));
+        return ctx.new_array_access(cx.apply_frames, slot).get_address();
+    }
+
+    unsigned long layout = runtime::frame_layout(kinds.size(), pointers);
+    auto it = cx.argument_frames.find(layout);
+    if (it == cx.argument_frames.end()) {
+        auto info = ctx.new_global(GCC_JIT_GLOBAL_INTERNAL,
+                                   cx.info_table_type,
+                                   "argument_frame_" + std::to_string(layout));
+        std::vector<gccjit::rvalue> values = {
+            cx.apply_entry.get_address(),
+            ctx.zero(ulong_type),
+            ctx.null(cx.evacuator_type),
+            ctx.null(cx.scavenger_type),
+            ctx.new_rvalue(ulong_type, static_cast<long>(layout)),
+            ctx.null(void_ptr),
+            ctx.null(void_ptr),
+        };
+        gg::jit::set_initializer(info,
+                                 gg::jit::new_struct_constructor(ctx,
+                                                                 cx.info_table_type,
+                                                                 values));
+        it = cx.argument_frames.emplace(layout, info).first;
+    }
+    return it->second.get_address();
+}
+
+std::vector<gccjit::rvalue> function_compiler::frame_infos(const frame_shape& shape,
+                                                           const resume_point& point) {
+    std::string name = prefix + "_frame" + std::to_string(++frames);
+    gccjit::function code = point.code;
+    std::vector<gccjit::rvalue> infos;
+    for (std::size_t segment = 0; segment < shape.segments(); ++segment) {
+        auto info = ctx.new_global(GCC_JIT_GLOBAL_INTERNAL,
+                                   cx.info_table_type,
+                                   name + "_" + std::to_string(segment));
+        // only the first segment is returned to
+        std::vector<gccjit::rvalue> values = {
+            segment ? ctx.null(cx.continuation_type) : code.get_address(),
+            ctx.zero(ulong_type),
+            ctx.null(cx.evacuator_type),
+            ctx.null(cx.scavenger_type),
+            ctx.new_rvalue(ulong_type, static_cast<long>(shape.layout(segment))),
+            segment ? ctx.null(void_ptr) : srt,
+            ctx.null(void_ptr),
+        };
+        gg::jit::set_initializer(info,
+                                 gg::jit::new_struct_constructor(ctx,
+                                                                 cx.info_table_type,
+                                                                 values));
+        infos.emplace_back(info.get_address());
+    }
+    return infos;
+}
+
+void function_compiler::push_frame(gccjit::block& block,
+                                   const std::vector<local_value>& saved,
+                                   const std::vector<const frame_closure*>& closures,
+                                   const frame_shape& shape,
+                                   const std::vector<std::size_t>& starts,
+                                   const resume_point& point) {
+    reserve_stack(block, shape.stack_words());
+    auto sp = reg(cx.sp_field);
+    auto infos = frame_infos(shape, point);
+    for (std::size_t segment = 0; segment < infos.size(); ++segment) {
+        block.add_assignment(word_at(sp, frame_shape::header(segment), info_ptr),
+                             infos[segment]);
+    }
+    for (std::size_t n = 0; n < saved.size(); ++n) {
+        block.add_assignment(word_at(sp, frame_shape::offset(n), type_of(saved[n].kind)),
+                             saved[n].value);
+    }
+    for (std::size_t n = 0; n < closures.size(); ++n) {
+        auto slot = ctx.new_array_access(sp, index(frame_shape::offset(starts[n])));
+        block.add_assignment(closures[n]->local,
+                             ctx.new_cast(slot.get_address(), closure_ptr));
+        write_closure(block, closures[n]->local, *closures[n]->lam, closures[n]->freevars);
+    }
+}
+
+void function_compiler::pop_frame(gccjit::block& block,
+                                  const std::vector<local_value>& saved,
+                                  const frame_shape& shape) {
+    auto sp = reg(cx.sp_field);
+    for (std::size_t n = 0; n < saved.size(); ++n) {
+        block.add_assignment(saved[n].value,
+                             word_at(sp, frame_shape::offset(n), type_of(saved[n].kind)));
+    }
+    auto top = ctx.new_array_access(sp, index(shape.stack_words()));
+    block.add_assignment(sp, top.get_address());
+}
+
+void function_compiler::add_live(std::set<std::string>& live,
+                                 const std::shared_ptr<ast::expr>& expr,
+                                 const std::vector<std::string>& excluded) {
+    std::unordered_set<std::string> names;
+    for (const auto& [name, values] : locals) {
+        if (values.size()) {
+            names.insert(name);
+        }
+    }
+    for (const auto& name : excluded) {
+        names.erase(name);
+    }
+    for (const auto& name : expr_references(expr, names)) {
+        live.insert(name);
+    }
+}
+
+std::vector<local_value>
+function_compiler::saved_locals(const std::set<std::string>& live) {
+    std::vector<local_value> saved;
+    for (const auto& name : live) {
+        saved.emplace_back(*find_local(name));
+    }
+    return saved;
+}
+
+std::vector<local_value> function_compiler::capture(const ast::lambda& lam) {
+    std::vector<local_value> values;
+    for (const auto& var : lam.freevars->elems) {
+        const local_value* local = find_local(var->name);
+        if (!local) {
+            // top level bindings are referred to directly
+            std::stringstream ss;
+            ss << "lambda at " << lam.loc << " captures the top level binding "
+               << var->name;
+            throw bad_compile(ss.str());
+        }
+        values.emplace_back(*local);
+    }
+    return values;
+}
+
+void function_compiler::write_closure(gccjit::block& block,
+                                      gccjit::rvalue c,
+                                      const ast::lambda& lam,
+                                      const std::vector<local_value>& freevars) {
+    std::size_t pointers = cx.closure_pointers.at(&lam);
+    for (std::size_t n = 0; n < freevars.size(); ++n) {
+        if (is_raw(freevars[n].kind) != (n >= pointers)) {
+            std::stringstream ss;
+            ss << "lambda at " << lam.loc << " captures "
+               << lam.freevars->elems[n]->name << " as the wrong kind of value";
+            throw bad_compile(ss.str());
+        }
+    }
+
+    // selector thunks run the runtime's code, so have none of their own
+    block.add_assignment(info_of(c),
+                         cx.selectors.count(&lam) ?
+                             cx.selector_info(lam) :
+                             cx.lambda_codes.at(&lam).info.get_address());
+    if (lam.update) {
+        // the result slot counts as a pointer until the update
+        block.add_assignment(payload(c, runtime::thunk_result_slot, closure_ptr),
+                             ctx.null(closure_ptr));
+    }
+    for (std::size_t n = 0; n < freevars.size(); ++n) {
+        block.add_assignment(payload(c, lam.update + n, type_of(freevars[n].kind)),
+                             freevars[n].value);
+    }
+}
+
+std::string function_compiler::declare_lambda(const ast::binding& binding) {
+    const ast::lambda& lam = *binding.rhs;
+    std::string name = c_name(binding.lhs->name) + "_" +
+                       std::to_string(cx.generated_functions++);
+
+    std::vector<gccjit::param> params;
+    auto entry = ctx.new_function(GCC_JIT_FUNCTION_INTERNAL,
+                                  void_type,
+                                  name + "_entry",
+                                  params,
+                                  0);
+    auto info = ctx.new_global(GCC_JIT_GLOBAL_INTERNAL,
+                               cx.info_table_type,
+                               name + "_info");
+    std::size_t pointers = cx.closure_pointers.at(&lam);
+    std::vector<gccjit::rvalue> values = {
+        entry.get_address(),
+        ctx.new_rvalue(ulong_type, static_cast<long>(lam.args->elems.size())),
+        // copied and scavenged from the layout
+        ctx.null(cx.evacuator_type),
+        ctx.null(cx.scavenger_type),
+        ctx.new_rvalue(ulong_type,
+                       static_cast<long>(runtime::closure_layout(
+                           lam.update + pointers,
+                           lam.freevars->elems.size() - pointers))),
+        srt,
+        ctx.null(void_ptr),
+    };
+    gg::jit::set_initializer(info,
+                             gg::jit::new_struct_constructor(ctx,
+                                                             cx.info_table_type,
+                                                             values));
+    cx.lambda_codes[&lam] = {info, entry};
+    return name;
+}
+
+void function_compiler::compile(gccjit::function entry,
+                                gccjit::lvalue info,
+                                bool caf,
+                                const std::vector<local_value>& captured,
+                                const std::vector<ast::field_kind>* params) {
+    std::vector<gccjit::param> body_params = {ctx.new_param(int_type, "resume")};
+    body = ctx.new_function(GCC_JIT_FUNCTION_INTERNAL,
+                            void_type,
+                            prefix + "_body",
+                            body_params,
+                            0);
+    resume = body_params[0];
+    auto dispatch = body.new_block("dispatch");
+    auto start = body.new_block("entry");
+
+    auto call = entry.new_block("call");
+    call.add_eval(ctx.new_call(body, ctx.zero(int_type)));
+    call.end_with_return();
+
+    // nothing has happened yet, so a failed heap check reruns the entry
+    gccjit::block block = start;
+    heap = &cx.heap_blocks.at(lam.body.get());
+    heap_starts = {cx.emit_heap_check(body, block, entry.get_address(), first_check(*heap))};
+
+    auto self = body.new_local(closure_ptr, "self");
+    block.add_assignment(self, reg(cx.node_field));
+    // a blackhole has no free variables, so they are loaded before the
+    // thunk is claimed
+    const auto& freevars = lam.freevars->elems;
+    for (std::size_t n = 0; n < freevars.size(); ++n) {
+        local_value value = captured[n];
+        value.value = body.new_local(type_of(value.kind), c_name(freevars[n]->name));
+        block.add_assignment(value.value,
+                             payload(self, lam.update + n, type_of(value.kind)));
+        bind(freevars[n]->name, value);
+    }
+
+    if (lam.update) {
+        auto claimed = caf ?
+            ctx.new_call(cx.enter_caf, self, info.get_address()) :
+            ctx.new_call(cx.enter_thunk, self);
+        auto lost = body.new_block("not_claimed");
+        auto run = body.new_block("claimed");
+        block.end_with_conditional(ctx.new_comparison(GCC_JIT_COMPARISON_EQ,
+                                                      claimed,
+                                                      ctx.zero(int_type)),
+                                   lost,
+                                   run);
+        // the thread is dead or the thunk is someone else's; give back the
+        // heap
+        lost.add_assignment(reg(cx.hp_field), heap_starts.front());
+        lost.end_with_return();
+        block = run;
+    }
+
+    const auto& args = lam.args->elems;
+    if (args.size()) {
+        auto sp = reg(cx.sp_field);
+        for (std::size_t n = 0; n < args.size(); ++n) {
+            ast::field_kind kind = params ? (*params)[n] : ast::field_kind::boxed;
+            auto arg = body.new_local(type_of(kind), c_name(args[n]->name));
+            block.add_assignment(arg, word_at(sp, n + 1, type_of(kind)));
+            bind(args[n]->name, {arg, kind});
+        }
+        // pop the argument frame
+        block.add_assignment(sp, ctx.new_array_access(sp, index(args.size() + 1))
+                                     .get_address());
+    }
+
+    // only once the thunk is claimed, so that losing it gives back all the
+    // heap there is to give back
+    emit_later_checks(block);
+    compile_tail(block, lam.body);
+
+    if (resumes.empty()) {
+        dispatch.end_with_jump(start);
+        return;
+    }
+    std::vector<gccjit::case_> cases;
+    for (std::size_t n = 0; n < resumes.size(); ++n) {
+        auto point = ctx.new_rvalue(int_type, static_cast<int>(n + 1));
+        cases.emplace_back(ctx.new_case(point, point, resumes[n].block));
+    }
+    dispatch.end_with_switch(resume, start, cases);
+}
+
+void function_compiler::compile_tail(gccjit::block block,
+                                     const std::shared_ptr<ast::expr>& expr) {
+    if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+        compile_let(block, *let);
+        compile_tail(block, let->body);
+        for (const auto& binding : *let->bindings) {
+            unbind(binding->lhs->name);
+        }
+    }
+    else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+        compile_case(block, *case_);
+    }
+    else if (auto con = std::dynamic_pointer_cast<ast::construct>(expr)) {
+        return_value(block, construct_value(block, *con));
+    }
+    else if (auto app = std::dynamic_pointer_cast<ast::apply>(expr)) {
+        compile_apply(block, *app);
+    }
+    else if (auto lit = std::dynamic_pointer_cast<ast::lit_expr>(expr)) {
+        auto [value, kind] = atom_value(*lit->lit);
+        if (is_raw(kind)) {
+            std::stringstream ss;
+            ss << "raw literal at " << lit->loc << " is returned";
+            throw bad_compile(ss.str());
+        }
+        return_value(block, value);
+    }
+    else {
+        compile_prim(block, dynamic_cast<const ast::prim_apply&>(*expr));
+    }
+}
+
+void function_compiler::compile_let(gccjit::block& block, const ast::local_bindings& let) {
+    bool recursive = dynamic_cast<const ast::local_recursion*>(&let);
+    const auto& bindings = let.bindings->elems;
+
+    std::vector<bool> selectors;
+    std::vector<std::string> prefixes;
+    std::vector<gccjit::lvalue> closures;
+    for (const auto& binding : bindings) {
+        selectors.emplace_back(cx.selectors.count(binding->rhs.get()));
+        prefixes.emplace_back(selectors.back() ? "" : declare_lambda(*binding));
+        closures.emplace_back(body.new_local(closure_ptr, c_name(binding->lhs->name)));
+    }
+
+    auto bind_all = [&] {
+        for (std::size_t n = 0; n < bindings.size(); ++n) {
+            bind(bindings[n]->lhs->name,
+                 {closures[n],
+                  ast::field_kind::boxed,
+                  selectors[n] ? nullptr : bindings[n]->rhs.get()});
+        }
+    };
+    // the closures of a letrec capture each other
+    if (recursive) {
+        bind_all();
+    }
+    std::vector<std::vector<local_value>> captured;
+    for (const auto& binding : bindings) {
+        captured.emplace_back(capture(*binding->rhs));
+    }
+    if (!recursive) {
+        bind_all();
+    }
+
+    // every address is known before any closure is written
+    std::vector<std::size_t> on_heap;
+    for (std::size_t n = 0; n < bindings.size(); ++n) {
+        if (const allocation_site* site = find_site(bindings[n].get())) {
+            block.add_assignment(closures[n], site_address(*site));
+            on_heap.emplace_back(n);
+        }
+        else {
+            // written when the frame of its case is pushed
+            frame_closures[bindings[n].get()] = {bindings[n]->rhs.get(),
+                                                 closures[n],
+                                                 captured[n]};
+        }
+    }
+    for (std::size_t n : on_heap) {
+        write_closure(block, closures[n], *bindings[n]->rhs, captured[n]);
+    }
+
+    for (std::size_t n = 0; n < bindings.size(); ++n) {
+        if (selectors[n]) {
+            continue;
+        }
+        const ast::lambda& lam = *bindings[n]->rhs;
+        const auto& code = cx.lambda_codes.at(&lam);
+        function_compiler(cx, lam, prefixes[n], srt, globals)
+            .compile(code.entry, code.info, false, captured[n], nullptr);
+    }
+}
+
+void function_compiler::compile_apply(gccjit::block& block, const ast::apply& app) {
+    auto [function, function_kind] = atom_value(*app.var);
+    const auto& args = app.args->elems;
+    std::stringstream ss;
+    if (is_raw(function_kind)) {
+        ss << "call at " << app.loc << " applies the raw value " << app.var->name;
+        throw bad_compile(ss.str());
+    }
+    if (args.empty()) {
+        evaluate(block, function);
+        return;
+    }
+    if (args.size() > runtime::max_frame_words) {
+        ss << "call at " << app.loc << " has more than "
+           << runtime::max_frame_words << " arguments";
+        throw bad_compile(ss.str());
+    }
+
+    // a function whose code is known can be entered directly
+    const ast::lambda* known = nullptr;
+    const std::vector<ast::field_kind>* params = nullptr;
+    gccjit::rvalue code;
+    if (const local_value* local = find_local(app.var->name)) {
+        known = local->lam;
+        if (known) {
+            code = cx.lambda_codes.at(known).entry.get_address();
+        }
+    }
+    else {
+        auto global = globals.find(app.var->name);
+        if (global != globals.end() && cx.statics.at(global->first).entry.get_inner_function()) {
+            known = global->second;
+            code = cx.statics.at(global->first).entry.get_address();
+            auto worker = cx.workers.find(global->first);
+            if (worker != cx.workers.end()) {
+                params = &worker->second;
+            }
+        }
+    }
+    if (known && known->args->elems.size() != args.size()) {
+        known = nullptr;
+    }
+
+    std::vector<gccjit::rvalue> values;
+    std::vector<ast::field_kind> kinds;
+    for (std::size_t n = 0; n < args.size(); ++n) {
+        auto [value, kind] = atom_value(*args[n]);
+        ast::field_kind expected = params && known ? (*params)[n] : ast::field_kind::boxed;
+        if (kind != expected) {
+            ss << "call at " << app.loc << " passes argument " << n
+               << " as the wrong kind of value";
+            throw bad_compile(ss.str());
+        }
+        values.emplace_back(value);
+        kinds.emplace_back(kind);
+    }
+
+    reserve_stack(block, args.size() + 1);
+    auto sp = reg(cx.sp_field);
+    block.add_assignment(word_at(sp, 0, info_ptr), argument_frame(kinds));
+    for (std::size_t n = 0; n < args.size(); ++n) {
+        block.add_assignment(word_at(sp, n + 1, type_of(kinds[n])), values[n]);
+    }
+    auto node = reg(cx.node_field);
+    block.add_assignment(node, function);
+    if (known) {
+        block.add_assignment(reg(cx.next_field), code);
+        block.end_with_return();
+        return;
+    }
+
+    // saturated calls enter the function, anything else goes through
+    // gg_apply_entry
+    auto info = info_of(node);
+    auto saturated = ctx.new_binary_op(
+        GCC_JIT_BINARY_OP_LOGICAL_AND,
+        ctx.get_type(GCC_JIT_TYPE_BOOL),
+        ctx.new_comparison(GCC_JIT_COMPARISON_EQ,
+                           info.dereference_field(cx.arity_field),
+                           ctx.new_rvalue(ulong_type, static_cast<long>(args.size()))),
+        ctx.new_comparison(GCC_JIT_COMPARISON_NE,
+                           info.dereference_field(cx.entry_code_field),
+                           ctx.null(cx.continuation_type)));
+    auto enter = body.new_block("enter");
+    auto apply = body.new_block("apply");
+    block.end_with_conditional(saturated, enter, apply);
+    enter.add_assignment(reg(cx.next_field), info.dereference_field(cx.entry_code_field));
+    enter.end_with_return();
+    apply.add_assignment(reg(cx.next_field), cx.apply_entry.get_address());
+    apply.end_with_return();
+}
+
+gccjit::rvalue function_compiler::construct_value(gccjit::block& block,
+                                                  const ast::construct& con) {
+    if (is_shared_construct(con, cx.layouts)) {
+        return cx.shared_closure(con);
+    }
+    std::stringstream ss;
+    const allocation_site* site = find_site(&con);
+    if (!site) {
+        ss << "constructor at " << con.loc << " has no allocation";
+        throw bad_compile(ss.str());
+    }
+
+    const std::string& name = con.con->name;
+    const auto& args = con.args->elems;
+    auto layout = cx.layouts.find(name);
+    std::vector<ast::field_kind> fields = layout == cx.layouts.end() ?
+        std::vector<ast::field_kind>(args.size(), ast::field_kind::boxed) :
+        layout->second;
+    if (fields.size() != args.size()) {
+        ss << "constructor at " << con.loc << " is applied to " << args.size()
+           << " fields";
+        throw bad_compile(ss.str());
+    }
+
+    auto c = body.new_local(closure_ptr, "con");
+    block.add_assignment(c, site_address(*site));
+    block.add_assignment(info_of(c), cx.constructor_info(name, args.size()));
+    auto slots = field_slots(fields);
+    for (std::size_t n = 0; n < args.size(); ++n) {
+        auto [value, kind] = atom_value(*args[n]);
+        if (kind != fields[n]) {
+            ss << "constructor at " << con.loc << " is given the wrong kind of "
+               << "value for field " << n;
+            throw bad_compile(ss.str());
+        }
+        block.add_assignment(payload(c, slots[n], type_of(kind)), value);
+    }
+    return c;
+}
+
+void function_compiler::compile_case(gccjit::block& block, const ast::case_& case_) {
+    std::stringstream ss;
+    std::vector<const frame_closure*> closures;
+    auto planned = cx.frame_closures.find(&case_);
+    if (planned != cx.frame_closures.end()) {
+        for (const auto& site : planned->second.sites) {
+            auto it = frame_closures.find(static_cast<const ast::binding*>(site.node.get()));
+            if (it == frame_closures.end()) {
+                ss << "case at " << case_.loc << " holds a closure bound elsewhere";
+                throw bad_compile(ss.str());
+            }
+            closures.emplace_back(&it->second);
+        }
+    }
+
+    // scrutinees which are already values are taken apart in place
+    std::shared_ptr<ast::atom> atom;
+    if (auto lit = std::dynamic_pointer_cast<ast::lit_expr>(case_.scrutinee)) {
+        atom = lit->lit;
+    }
+    else if (auto app = std::dynamic_pointer_cast<ast::apply>(case_.scrutinee)) {
+        if (app->args->elems.empty()) {
+            atom = app->var;
+        }
+    }
+    else if (auto con = std::dynamic_pointer_cast<ast::construct>(case_.scrutinee)) {
+        if (closures.empty()) {
+            dispatch_boxed(block, construct_value(block, *con), case_);
+            return;
+        }
+    }
+    else if (auto prim = std::dynamic_pointer_cast<ast::prim_apply>(case_.scrutinee)) {
+        // a closure passed to a primop escapes, so none can be in the frame
+        if (closures.size()) {
+            ss << "case at " << case_.loc << " on a primop holds closures";
+            throw bad_compile(ss.str());
+        }
+        compile_prim_case(block, *prim, case_);
+        return;
+    }
+
+    auto value = body.new_local(closure_ptr, "scrutinee");
+    if (atom) {
+        auto [atom_val, kind] = atom_value(*atom);
+        if (is_raw(kind) || std::dynamic_pointer_cast<ast::literal>(atom)) {
+            if (closures.size()) {
+                ss << "case at " << case_.loc << " on a value holds closures";
+                throw bad_compile(ss.str());
+            }
+            if (!is_raw(kind)) {
+                dispatch_boxed(block, atom_val, case_);
+                return;
+            }
+            auto raw = body.new_local(type_of(kind), "scrutinee");
+            block.add_assignment(raw, atom_val);
+            dispatch_raw(block, raw, kind, case_);
+            return;
+        }
+        if (closures.empty()) {
+            block.add_assignment(value, atom_val);
+            dispatch_lazy(block, value, case_);
+            return;
+        }
+    }
+
+    auto saved = alternative_locals(case_);
+    frame_shape shape;
+    for (const auto& local : saved) {
+        shape.add(!is_raw(local.kind));
+    }
+    std::vector<std::size_t> starts;
+    for (const frame_closure* closure : closures) {
+        // the info table, the result slot, and the free variables
+        std::vector<bool> fields = {false};
+        if (closure->lam->update) {
+            fields.emplace_back(true);
+        }
+        for (const auto& freevar : closure->freevars) {
+            fields.emplace_back(!is_raw(freevar.kind));
+        }
+        starts.emplace_back(shape.add_closure(fields));
+    }
+
+    resume_point point = new_resume_point();
+    push_frame(block, saved, closures, shape, starts, point);
+    compile_tail(block, case_.scrutinee);
+
+    gccjit::block resumed = point.block;
+    pop_frame(resumed, saved, shape);
+    resumed.add_assignment(value, reg(cx.node_field));
+    dispatch_boxed(resumed, value, case_);
+}
+
+std::vector<gccjit::rvalue> function_compiler::prim_args(const ast::prim_apply& prim) {
+    const auto& args = prim.args->elems;
+    if (args.size() != prim.op->arity()) {
+        std::stringstream ss;
+        ss << "primop at " << prim.loc << " is applied to " << args.size()
+           << " arguments";
+        throw bad_compile(ss.str());
+    }
+    std::vector<gccjit::rvalue> values;
+    for (const auto& arg : args) {
+        values.emplace_back(atom_value(*arg).first);
+    }
+    return values;
+}
+
+std::pair<gccjit::rvalue, ast::field_kind>
+function_compiler::prim_value(gccjit::block& block, const ast::prim_apply& prim) {
+    auto args = prim_args(prim);
+    gccjit::rvalue space = ctx.null(closure_ptr);
+    if (primop_words(*prim.op)) {
+        const allocation_site* site = find_site(&prim);
+        if (!site) {
+            std::stringstream ss;
+            ss << "primop at " << prim.loc << " has no allocation";
+            throw bad_compile(ss.str());
+        }
+        space = site_address(*site);
+    }
+    try {
+        return {cx.primop_value(block, *prim.op, args, space, gccjit::location()),
+                result_kind(*prim.op)};
+    }
+    catch (const bad_primop& e) {
+        throw bad_compile(e.what());
+    }
+}
+
+void function_compiler::call_scheduler(gccjit::block& block,
+                                       const ast::prim_apply& prim,
+                                       const std::vector<local_value>& saved) {
+    frame_shape shape;
+    for (const auto& local : saved) {
+        shape.add(!is_raw(local.kind));
+    }
+    auto args = prim_args(prim);
+
+    // the locals are saved in a frame which nothing returns to; the
+    // scheduler runs `next` once the operation has completed
+    resume_point point = new_resume_point();
+    push_frame(block, saved, {}, shape, {}, point);
+    block.add_assignment(reg(cx.next_field), point.code.get_address());
+    block.add_eval(ctx.new_call(cx.runtime_primops.at(scheduler_call(*prim.op)), args));
+    block.end_with_return();
+
+    block = point.block;
+    pop_frame(block, saved, shape);
+}
+
+void function_compiler::compile_prim(gccjit::block& block, const ast::prim_apply& prim) {
+    const ast::primop& op = *prim.op;
+    if (is_raw(result_kind(op))) {
+        std::stringstream ss;
+        ss << "primop at " << prim.loc << " returns a raw value";
+        throw bad_compile(ss.str());
+    }
+
+    if (scheduler_call(op)) {
+        call_scheduler(block, prim, {});
+        evaluate(block, reg(cx.node_field));
+        return;
+    }
+    auto [value, kind] = prim_value(block, prim);
+    if (may_return_thunk(op)) {
+        evaluate(block, value);
+    }
+    else {
+        return_value(block, value);
+    }
+}
+
+void function_compiler::compile_prim_case(gccjit::block& block,
+                                          const ast::prim_apply& prim,
+                                          const ast::case_& case_) {
+    const ast::primop& op = *prim.op;
+    ast::field_kind kind = result_kind(op);
+    auto value = body.new_local(type_of(kind), "scrutinee");
+    if (scheduler_call(op)) {
+        call_scheduler(block, prim, alternative_locals(case_));
+        // `yield#` and `putMVar#` give 0
+        block.add_assignment(value,
+                             is_raw(kind) ? ctx.zero(long_type) : reg(cx.node_field));
+    }
+    else {
+        block.add_assignment(value, prim_value(block, prim).first);
+    }
+
+    if (is_raw(kind)) {
+        dispatch_raw(block, value, kind, case_);
+    }
+    else if (may_return_thunk(op)) {
+        dispatch_lazy(block, value, case_);
+    }
+    else {
+        dispatch_boxed(block, value, case_);
+    }
+}
+
+std::vector<local_value> function_compiler::alternative_locals(const ast::case_& case_) {
+    std::set<std::string> live;
+    for (const auto& alt : *case_.alts) {
+        add_live(live, alt->body, alt_binders(*alt));
+    }
+    return saved_locals(live);
+}
+
+void function_compiler::dispatch_lazy(gccjit::block& block,
+                                      gccjit::lvalue value,
+                                      const ast::case_& case_) {
+    // only thunks need a frame to return to
+    auto saved = alternative_locals(case_);
+    frame_shape shape;
+    for (const auto& local : saved) {
+        shape.add(!is_raw(local.kind));
+    }
+
+    auto eval = body.new_block("evaluate");
+    auto evaluated = body.new_block("evaluated");
+    block.end_with_conditional(is_thunk(info_of(value)), eval, evaluated);
+
+    resume_point point = new_resume_point();
+    push_frame(eval, saved, {}, shape, {}, point);
+    eval.add_assignment(reg(cx.node_field), value);
+    eval.add_assignment(reg(cx.next_field),
+                        info_of(value).dereference_field(cx.entry_code_field));
+    eval.end_with_return();
+
+    gccjit::block resumed = point.block;
+    pop_frame(resumed, saved, shape);
+    resumed.add_assignment(value, reg(cx.node_field));
+    resumed.end_with_jump(evaluated);
+
+    dispatch_boxed(evaluated, value, case_);
+}
+
+void function_compiler::dispatch_boxed(gccjit::block& block,
+                                       gccjit::rvalue value,
+                                       const ast::case_& case_) {
+    std::vector<gccjit::case_> cases;
+    std::unordered_set<unsigned long> seen;
+    gccjit::block fallback;
+    bool has_fallback = false;
+    for (const auto& alt : *case_.alts) {
+        if (auto alg = std::dynamic_pointer_cast<ast::algebraic_alt>(alt)) {
+            unsigned long tag = cx.constructor_tag(alg->con->name, alg->vars->elems.size());
+            // a later alternative for the same constructor never matches
+            if (!seen.insert(tag).second) {
+                continue;
+            }
+            auto tag_value = ctx.new_rvalue(long_type, static_cast<long>(tag));
+            cases.emplace_back(ctx.new_case(tag_value,
+                                            tag_value,
+                                            compile_alt(*alt, value, ast::field_kind::boxed)));
+        }
+        else if (std::dynamic_pointer_cast<ast::prim_alt>(alt)) {
+            std::stringstream ss;
+            ss << "alternative at " << alt->loc << " matches a boxed value with a literal";
+            throw bad_compile(ss.str());
+        }
+        else {
+            fallback = compile_alt(*alt, value, ast::field_kind::boxed);
+            has_fallback = true;
+            break;
+        }
+    }
+    if (!has_fallback) {
+        fallback = match_failure();
+    }
+    if (cases.empty()) {
+        block.end_with_jump(fallback);
+        return;
+    }
+
+    auto layout = info_of(value).dereference_field(cx.layout_field);
+    auto tag = ctx.new_cast(ctx.new_binary_op(GCC_JIT_BINARY_OP_RSHIFT,
+                                              ulong_type,
+                                              layout,
+                                              ctx.new_rvalue(ulong_type, 32)),
+                            long_type);
+    block.end_with_switch(tag, fallback, cases);
+}
+
+void function_compiler::dispatch_raw(gccjit::block& block,
+                                     gccjit::rvalue value,
+                                     ast::field_kind kind,
+                                     const ast::case_& case_) {
+    std::vector<gccjit::case_> cases;
+    std::set<std::int64_t> seen_ints;
+    std::set<double> seen_doubles;
+    gccjit::block fallback;
+    bool has_fallback = false;
+    for (const auto& alt : *case_.alts) {
+        if (auto prim = std::dynamic_pointer_cast<ast::prim_alt>(alt)) {
+            auto [lit, lit_kind] = atom_value(*prim->lit);
+            if (lit_kind != kind) {
+                std::stringstream ss;
+                ss << "alternative at " << alt->loc
+                   << " matches a literal of the wrong kind";
+                throw bad_compile(ss.str());
+            }
+            if (kind == ast::field_kind::int64) {
+                if (!seen_ints.insert(std::get<std::int64_t>(prim->lit->value)).second) {
+                    continue;
+                }
+                cases.emplace_back(ctx.new_case(lit, lit, compile_alt(*alt, value, kind)));
+            }
+            else {
+                if (!seen_doubles.insert(std::get<double>(prim->lit->value)).second) {
+                    continue;
+                }
+                auto next = body.new_block("compare");
+                block.end_with_conditional(
+                    ctx.new_comparison(GCC_JIT_COMPARISON_EQ, value, lit),
+                    compile_alt(*alt, value, kind),
+                    next);
+                block = next;
+            }
+        }
+        else if (std::dynamic_pointer_cast<ast::algebraic_alt>(alt)) {
+            std::stringstream ss;
+            ss << "alternative at " << alt->loc << " takes apart a raw value";
+            throw bad_compile(ss.str());
+        }
+        else {
+            fallback = compile_alt(*alt, value, kind);
+            has_fallback = true;
+            break;
+        }
+    }
+    if (!has_fallback) {
+        fallback = match_failure();
+    }
+    if (cases.empty()) {
+        block.end_with_jump(fallback);
+        return;
+    }
+    block.end_with_switch(value, fallback, cases);
+}
+
+gccjit::block function_compiler::compile_alt(const ast::alternative& alt,
+                                             gccjit::rvalue value,
+                                             ast::field_kind kind) {
+    const heap_block* outer_heap = heap;
+    std::vector<gccjit::rvalue> outer_starts = heap_starts;
+
+    auto start = body.new_block("alternative");
+    gccjit::block block = start;
+    std::vector<std::string> bound;
+    if (auto alg = dynamic_cast<const ast::algebraic_alt*>(&alt)) {
+        const auto& vars = alg->vars->elems;
+        auto layout = cx.layouts.find(alg->con->name);
+        std::vector<ast::field_kind> fields = layout == cx.layouts.end() ?
+            std::vector<ast::field_kind>(vars.size(), ast::field_kind::boxed) :
+            layout->second;
+        if (fields.size() != vars.size()) {
+            std::stringstream ss;
+            ss << "alternative at " << alt.loc << " binds " << vars.size() << " fields";
+            throw bad_compile(ss.str());
+        }
+        auto slots = field_slots(fields);
+        for (std::size_t n = 0; n < vars.size(); ++n) {
+            auto field = body.new_local(type_of(fields[n]), c_name(vars[n]->name));
+            block.add_assignment(field, payload(value, slots[n], type_of(fields[n])));
+            bind(vars[n]->name, {field, fields[n]});
+            bound.emplace_back(vars[n]->name);
+        }
+    }
+    else if (auto var = dynamic_cast<const ast::binding_alt*>(&alt)) {
+        auto local = body.new_local(type_of(kind), c_name(var->var->name));
+        block.add_assignment(local, value);
+        bind(var->var->name, {local, kind});
+        bound.emplace_back(var->var->name);
+    }
+
+    heap = &cx.heap_blocks.at(alt.body.get());
+    if (first_check(*heap)) {
+        // the locals are saved in a frame while the heap check fails, and
+        // the check is run again when it returns
+        std::set<std::string> live;
+        add_live(live, alt.body);
+        auto saved = saved_locals(live);
+        frame_shape shape;
+        for (const auto& local : saved) {
+            shape.add(!is_raw(local.kind));
+        }
+
+        resume_point point = new_resume_point();
+        auto check = body.new_block("heap_check");
+        block.end_with_jump(check);
+        block = check;
+        heap_starts = {cx.emit_heap_check(body,
+                                          block,
+                                          point.code.get_address(),
+                                          first_check(*heap),
+                                          [&](gccjit::block& overflow) {
+                                              push_frame(overflow, saved, {}, shape, {}, point);
+                                          })};
+
+        gccjit::block resumed = point.block;
+        pop_frame(resumed, saved, shape);
+        resumed.end_with_jump(check);
+    }
+    else {
+        heap_starts = {cx.emit_heap_check(body, block, ctx.null(cx.continuation_type), 0)};
+    }
+    emit_later_checks(block);
+
+    compile_tail(block, alt.body);
+
+    for (const auto& name : bound) {
+        unbind(name);
+    }
+    heap = outer_heap;
+    heap_starts = outer_starts;
+    return start;
+}
+
+gccjit::block function_compiler::match_failure() {
+    auto block = body.new_block("match_failure");
+    block.add_eval(ctx.new_call(cx.match_failure));
+    block.end_with_return();
+    return block;
+}
+}
+}
+
+void gg::compiler::context::compile_code() {
+    std::unordered_map<std::string, const ast::lambda*> globals;
+    for (const auto& binding : *bindings) {
+        globals.emplace(binding->lhs->name, binding->rhs.get());
+    }
+
+    for (const auto& binding : *bindings) {
+        const std::string& name = binding->lhs->name;
+        static_closure& st = statics.at(name);
+        if (!st.entry.get_inner_function()) {
+            // a static constructor, which has no code
+            continue;
+        }
+        auto worker = workers.find(name);
+        function_compiler(*this,
+                          *binding->rhs,
+                          c_name(name) + "_" + std::to_string(generated_functions++),
+                          st.srt,
+                          globals)
+            .compile(st.entry,
+                     st.info,
+                     is_caf(*binding->rhs),
+                     {},
+                     worker == workers.end() ? nullptr : &worker->second);
+    }
+}
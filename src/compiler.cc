@@ -1,13 +1,212 @@
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+#include "gg/array.h"
 #include "gg/compiler.h"
+#include "gg/dependencies.h"
+#include "gg/escape.h"
+#include "gg/freevars.h"
+#include "gg/heap.h"
+#include "gg/integer.h"
 #include "gg/jit_polyfill.h"
+#include "gg/let_floating.h"
+#include "gg/runtime.h"
+#include "gg/thunk.h"
+#include "gg/unboxing.h"
+#include "gg/update_flags.h"
+
+namespace {
+/**
+   Is a top level lambda a constructor applied to literals, which can be
+   built at compile time?
+
+   @param lam The lambda.
+   @return    The constructor application, or `nullptr`.
+*/
+std::shared_ptr<gg::ast::construct> static_construct(const gg::ast::lambda& lam) {
+    if (lam.update || lam.args->elems.size() || lam.freevars->elems.size()) {
+        return nullptr;
+    }
+    auto con = std::dynamic_pointer_cast<gg::ast::construct>(lam.body);
+    if (!con) {
+        return nullptr;
+    }
+    for (const auto& arg : con->args->elems) {
+        if (!std::dynamic_pointer_cast<gg::ast::literal>(arg)) {
+            return nullptr;
+        }
+    }
+    return con;
+}
+
+/**
+   @return The kind of field a literal can be stored in.
+*/
+gg::ast::field_kind literal_kind(const gg::ast::literal& lit) {
+    if (std::holds_alternative<gg::ast::integer_digits>(lit.value)) {
+        return gg::ast::field_kind::boxed;
+    }
+    if (std::holds_alternative<double>(lit.value)) {
+        return gg::ast::field_kind::float64;
+    }
+    return gg::ast::field_kind::int64;
+}
 
-gg::compiler::context::context(const std::shared_ptr<ast::sequence<ast::binding>>& bindings)
-    : ctx(gccjit::context::acquire()), bindings(bindings) {
+/**
+   @return The fields of a constructor application to literals in the order
+           they are stored in the payload.
+   @throws bad_compile if the constructor is applied to the wrong number or
+           kinds of fields.
+*/
+std::vector<std::shared_ptr<gg::ast::atom>>
+payload_order(const gg::ast::construct& con,
+              const gg::compiler::constructor_layouts& layouts) {
+    const auto& args = con.args->elems;
+    auto it = layouts.find(con.con->name);
+    std::vector<gg::ast::field_kind> fields = it == layouts.end() ?
+        std::vector<gg::ast::field_kind>(args.size(), gg::ast::field_kind::boxed) :
+        it->second;
+    std::stringstream ss;
+    if (fields.size() != args.size()) {
+        ss << "constructor at " << con.loc << " is applied to " << args.size()
+           << " fields";
+        throw gg::compiler::bad_compile(ss.str());
+    }
+    for (std::size_t n = 0; n < args.size(); ++n) {
+        auto lit = std::static_pointer_cast<gg::ast::literal>(args[n]);
+        if (literal_kind(*lit) != fields[n]) {
+            ss << "constructor at " << con.loc << " is given the wrong kind of "
+               << "value for field " << n;
+            throw gg::compiler::bad_compile(ss.str());
+        }
+    }
+
+    auto slots = gg::compiler::field_slots(fields);
+    std::vector<std::shared_ptr<gg::ast::atom>> ordered(slots.size());
+    for (std::size_t n = 0; n < slots.size(); ++n) {
+        ordered[slots[n]] = args[n];
+    }
+    return ordered;
+}
+}
+
+gg::compiler::context::context(const std::shared_ptr<ast::program>& program,
+                               const std::string& entry,
+                               const float_options& floating)
+    : ctx(gccjit::context::acquire()),
+      bindings(program->bindings),
+      layouts(declared_layouts(*program->declarations)) {
+    declare_runtime();
+    compile_bindings({entry}, floating);
+}
+
+gg::compiler::context::context() : ctx(gccjit::context::acquire()) {
+    declare_runtime();
+}
+
+gg::compiler::context::context(context& parent,
+                               const std::shared_ptr<ast::program>& batch,
+                               const constructor_layouts& layouts,
+                               const linkage& linked,
+                               const float_options& floating)
+    : ctx(parent.ctx.new_child_context()),
+      bindings(batch->bindings),
+      layouts(layouts),
+      linked(&linked),
+      global_kind(GCC_JIT_GLOBAL_EXPORTED) {
+    share_runtime(parent);
+    for (const auto& [name, closure] : linked.closures) {
+        externs.insert(name);
+    }
+
+    std::vector<std::string> entries;
+    for (const auto& binding : *bindings) {
+        entries.emplace_back(binding->lhs->name);
+    }
+    compile_bindings(entries, floating);
+
+    // a constructor which no binding builds still gets an info table, so
+    // that callers of the program can box arguments in it
+    for (const auto& [name, fields] : declared_layouts(*batch->declarations)) {
+        constructor_info(name, fields.size());
+    }
+}
+
+void gg::compiler::context::declare_runtime() {
     continuation_type = make_continuation_type();
+    word_type = ctx.get_type(GCC_JIT_TYPE_UNSIGNED_LONG);
+    closure_type = ctx.new_opaque_struct_type("closure");
     info_table_type = make_info_table_type();
     closure_type = make_closure_type();
+    registers_type = make_registers_type();
+
+    import_runtime();
+    int_pow = make_int_pow();
+}
+
+void gg::compiler::context::share_runtime(const context& parent) {
+    continuation_type = parent.continuation_type;
+    evacuator_type = parent.evacuator_type;
+    scavenger_type = parent.scavenger_type;
+    word_type = parent.word_type;
+    info_table_type = parent.info_table_type;
+    closure_type = parent.closure_type;
+    registers_type = parent.registers_type;
+    entry_code_field = parent.entry_code_field;
+    arity_field = parent.arity_field;
+    layout_field = parent.layout_field;
+    info_field = parent.info_field;
+    payload_field = parent.payload_field;
+    next_field = parent.next_field;
+    node_field = parent.node_field;
+    sp_field = parent.sp_field;
+    sp_limit_field = parent.sp_limit_field;
+    hp_field = parent.hp_field;
+    hp_limit_field = parent.hp_limit_field;
+    base = parent.base;
+    heap_overflow = parent.heap_overflow;
+    allocate = parent.allocate;
+    grow_stack = parent.grow_stack;
+    enter_thunk = parent.enter_thunk;
+    enter_caf = parent.enter_caf;
+    match_failure = parent.match_failure;
+    apply_entry = parent.apply_entry;
+    apply_frames = parent.apply_frames;
+    runtime_primops = parent.runtime_primops;
+    small_integer_info = parent.small_integer_info;
+    small_integers = parent.small_integers;
+    boxed_word_type = parent.boxed_word_type;
+    big_integer_info = parent.big_integer_info;
+    selector_infos = parent.selector_infos;
+    int_pow = parent.int_pow;
+}
+
+void gg::compiler::context::compile_bindings(const std::vector<std::string>& entries,
+                                             const float_options& floating) {
+    // exact free variables first so that stale lists do not keep dead
+    // bindings alive
+    compute_freevars(*bindings, freevar_mode::overwrite, externs);
+    prune_bindings(*bindings, entries);
+    // floating changes how often thunks are entered, so update flags are
+    // inferred afterwards
+    float_lets(*bindings, floating, externs);
+    unbox_strict_fields(*bindings, layouts, externs);
+    workers = split_workers(*bindings, layouts, externs);
+    infer_update_flags(*bindings);
+    replace_scalars(*bindings, externs);
+    // selector thunks are made updatable, which changes their size
+    selectors = find_selectors(*bindings, layouts);
+    closure_pointers = order_closure_fields(*bindings, layouts, workers);
 
     create_globals();
+    heap_blocks = plan_allocation(*bindings,
+                                  layouts,
+                                  find_stack_closures(*bindings),
+                                  frame_closures);
+    compile_code();
 }
 
 gccjit::type gg::compiler::context::make_continuation_type() {
@@ -17,43 +216,1088 @@ gccjit::type gg::compiler::context::make_continuation_type() {
 }
 
 gccjit::struct_ gg::compiler::context::make_info_table_type() {
-    auto entry_code_field = ctx.new_field(continuation_type, "entry_code");
-    auto arity_field = ctx.new_field(ctx.get_type(GCC_JIT_TYPE_UNSIGNED_LONG),
-                                     "arity");
-    auto evacuation_code_field = ctx.new_field(continuation_type,
+    entry_code_field = ctx.new_field(continuation_type, "entry_code");
+    arity_field = ctx.new_field(ctx.get_type(GCC_JIT_TYPE_UNSIGNED_LONG), "arity");
+    auto closure_ptr = closure_type.get_pointer();
+    evacuator_type = gg::jit::new_function_ptr_type(ctx,
+                                                    closure_ptr,
+                                                    {closure_ptr});
+    scavenger_type = gg::jit::new_function_ptr_type(
+        ctx,
+        ctx.get_type(GCC_JIT_TYPE_SIZE_T),
+        {closure_ptr});
+    auto evacuation_code_field = ctx.new_field(evacuator_type,
                                                "evacuation_code");
-    auto scavenge_code_field = ctx.new_field(continuation_type,
-                                             "scavenge_code_code");
+    auto scavenge_code_field = ctx.new_field(scavenger_type,
+                                             "scavenge_code");
+    layout_field = ctx.new_field(ctx.get_type(GCC_JIT_TYPE_UNSIGNED_LONG), "layout");
+    // really `closure**`, but void* accepts the address of any srt global
+    auto srt_field = ctx.new_field(ctx.get_type(GCC_JIT_TYPE_VOID_PTR), "srt");
+    auto shared_field = ctx.new_field(ctx.get_type(GCC_JIT_TYPE_VOID_PTR), "shared");
 
     std::vector<gccjit::field> fields = {entry_code_field,
                                          arity_field,
                                          evacuation_code_field,
-                                         scavenge_code_field};
+                                         scavenge_code_field,
+                                         layout_field,
+                                         srt_field,
+                                         shared_field};
 
     return ctx.new_struct_type("info_table", fields);
 }
 
 gccjit::struct_ gg::compiler::context::make_closure_type() {
-    auto closure_type = ctx.new_opaque_struct_type("closure");
-    auto info_table_field = ctx.new_field(info_table_type, "info_table");
-    auto freevars_field = ctx.new_field(ctx.new_array_type(closure_type, 0),
-                                        "freevars");
+    info_field = ctx.new_field(info_table_type.get_pointer(), "info_table");
+    // the pointer fields followed by the raw words, as described by the
+    // info table's layout
+    payload_field = ctx.new_field(ctx.new_array_type(word_type, 0), "payload");
 
-    gg::jit::set_fields(closure_type, {info_table_field, freevars_field});
+    gg::jit::set_fields(closure_type, {info_field, payload_field});
     return closure_type;
 }
 
+gccjit::struct_ gg::compiler::context::make_registers_type() {
+    auto word_ptr = word_type.get_pointer();
+    next_field = ctx.new_field(continuation_type, "next");
+    node_field = ctx.new_field(closure_type.get_pointer(), "node");
+    sp_field = ctx.new_field(word_ptr, "sp");
+    sp_limit_field = ctx.new_field(word_ptr, "sp_limit");
+    auto su_field = ctx.new_field(word_ptr, "su");
+    hp_field = ctx.new_field(word_ptr, "hp");
+    hp_limit_field = ctx.new_field(word_ptr, "hp_limit");
+
+    std::vector<gccjit::field> fields = {next_field,
+                                         node_field,
+                                         sp_field,
+                                         sp_limit_field,
+                                         su_field,
+                                         hp_field,
+                                         hp_limit_field};
+
+    return ctx.new_struct_type("registers", fields);
+}
+
+void gg::compiler::context::import_runtime() {
+    base = ctx.new_global(GCC_JIT_GLOBAL_IMPORTED,
+                          registers_type.get_pointer(),
+                          "gg_base");
+    gg::jit::set_tls_model(base, GCC_JIT_TLS_MODEL_INITIAL_EXEC);
+
+    std::vector<gccjit::param> params = {
+        ctx.new_param(ctx.get_type(GCC_JIT_TYPE_SIZE_T), "words"),
+    };
+    heap_overflow = ctx.new_function(GCC_JIT_FUNCTION_IMPORTED,
+                                     ctx.get_type(GCC_JIT_TYPE_VOID),
+                                     "gg_heap_overflow",
+                                     params,
+                                     0);
+    allocate = import_function("gg_allocate",
+                               word_type.get_pointer(),
+                               {ctx.get_type(GCC_JIT_TYPE_SIZE_T)});
+
+    auto void_type = ctx.get_type(GCC_JIT_TYPE_VOID);
+    auto int_type = ctx.get_type(GCC_JIT_TYPE_INT);
+    auto long_type = ctx.get_type(GCC_JIT_TYPE_LONG);
+    auto double_type = ctx.get_type(GCC_JIT_TYPE_DOUBLE);
+    auto closure_ptr = closure_type.get_pointer();
+    grow_stack = import_function("gg_grow_stack",
+                                 int_type,
+                                 {ctx.get_type(GCC_JIT_TYPE_SIZE_T)});
+    enter_thunk = import_function("gg_enter_thunk", int_type, {closure_ptr});
+    enter_caf = import_function("gg_enter_caf",
+                                int_type,
+                                {closure_ptr, info_table_type.get_pointer()});
+    match_failure = import_function("gg_match_failure", void_type, {});
+    apply_entry = import_function("gg_apply_entry", void_type, {});
+    apply_frames = ctx.new_global(
+        GCC_JIT_GLOBAL_IMPORTED,
+        ctx.new_array_type(info_table_type, runtime::max_frame_words + 1),
+        "gg_apply_frames");
+    small_integer_info = ctx.new_global(GCC_JIT_GLOBAL_IMPORTED,
+                                        info_table_type,
+                                        "gg_small_integer_info");
+    big_integer_info = ctx.new_global(GCC_JIT_GLOBAL_IMPORTED,
+                                      info_table_type,
+                                      "gg_big_integer_info");
+    std::vector<gccjit::field> boxed_word_fields = {
+        ctx.new_field(info_table_type.get_pointer(), "info"),
+        ctx.new_field(long_type, "value"),
+    };
+    boxed_word_type = ctx.new_struct_type("boxed_word", boxed_word_fields);
+    small_integers = ctx.new_global(
+        GCC_JIT_GLOBAL_IMPORTED,
+        ctx.new_array_type(boxed_word_type, runtime::shared_values),
+        "gg_small_integers");
+    selector_infos = ctx.new_global(
+        GCC_JIT_GLOBAL_IMPORTED,
+        ctx.new_array_type(info_table_type, runtime::max_selector_slot),
+        "gg_selector_info");
+
+    import_runtime_primop("gg_new_byte_array", closure_ptr, {long_type});
+    import_runtime_primop("gg_new_array", closure_ptr, {long_type, closure_ptr});
+    import_runtime_primop("gg_unsafe_freeze", closure_ptr, {closure_ptr});
+    import_runtime_primop("gg_write_array",
+                          void_type,
+                          {closure_ptr, long_type, closure_ptr});
+    import_runtime_primop("gg_copy_byte_array",
+                          void_type,
+                          {closure_ptr, long_type, closure_ptr, long_type, long_type});
+    import_runtime_primop("gg_set_byte_array",
+                          void_type,
+                          {closure_ptr, long_type, long_type, long_type});
+    import_runtime_primop("gg_compare_byte_arrays",
+                          long_type,
+                          {closure_ptr, long_type, closure_ptr, long_type, long_type});
+    import_runtime_primop("gg_sum_int_array",
+                          long_type,
+                          {closure_ptr, long_type, long_type});
+    import_runtime_primop("gg_sum_double_array",
+                          double_type,
+                          {closure_ptr, long_type, long_type});
+    import_runtime_primop("gg_copy_array",
+                          void_type,
+                          {closure_ptr, long_type, closure_ptr, long_type, long_type});
+    import_runtime_primop("gg_integer_add", closure_ptr, {closure_ptr, closure_ptr});
+    import_runtime_primop("gg_integer_sub", closure_ptr, {closure_ptr, closure_ptr});
+    import_runtime_primop("gg_integer_mul", closure_ptr, {closure_ptr, closure_ptr});
+    import_runtime_primop("gg_integer_negate", closure_ptr, {closure_ptr});
+    import_runtime_primop("gg_integer_compare", long_type, {closure_ptr, closure_ptr});
+    import_runtime_primop("gg_integer_from_int", closure_ptr, {long_type});
+    import_runtime_primop("gg_integer_to_int", long_type, {closure_ptr});
+    import_runtime_primop("gg_fork", long_type, {closure_ptr});
+    import_runtime_primop("gg_new_mvar", closure_ptr, {});
+    import_runtime_primop("gg_yield", void_type, {});
+    import_runtime_primop("gg_take_mvar", void_type, {closure_ptr});
+    import_runtime_primop("gg_put_mvar", void_type, {closure_ptr, closure_ptr});
+}
+
+gccjit::function gg::compiler::context::import_function(
+    const std::string& name,
+    gccjit::type return_type,
+    const std::vector<gccjit::type>& param_types) {
+    std::vector<gccjit::param> params;
+    for (std::size_t n = 0; n < param_types.size(); ++n) {
+        params.emplace_back(ctx.new_param(param_types[n], "arg" + std::to_string(n)));
+    }
+    return ctx.new_function(GCC_JIT_FUNCTION_IMPORTED, return_type, name, params, 0);
+}
+
+void gg::compiler::context::import_runtime_primop(
+    const std::string& name,
+    gccjit::type return_type,
+    const std::vector<gccjit::type>& param_types) {
+    runtime_primops.emplace(name, import_function(name, return_type, param_types));
+}
+
+gccjit::rvalue gg::compiler::context::emit_heap_check(
+    gccjit::function& fn,
+    gccjit::block& block,
+    gccjit::rvalue self,
+    std::size_t words,
+    const std::function<void(gccjit::block&)>& save) {
+    auto hp = base.dereference_field(hp_field);
+    auto start = fn.new_local(word_type.get_pointer(), "hp_start");
+    block.add_assignment(start, hp);
+    if (!words) {
+        return start;
+    }
+
+    auto size = ctx.new_rvalue(ctx.get_type(GCC_JIT_TYPE_SIZE_T),
+                               static_cast<long>(words));
+    block.add_assignment(hp, ctx.new_array_access(start, size).get_address());
+
+    auto overflow = fn.new_block("heap_overflow");
+    auto ok = fn.new_block("heap_ok");
+    block.end_with_conditional(
+        ctx.new_comparison(GCC_JIT_COMPARISON_GT,
+                           hp,
+                           base.dereference_field(hp_limit_field)),
+        overflow,
+        ok);
+
+    if (save) {
+        // the frame is pushed with nothing allocated, and gg_heap_overflow
+        // takes the bump back off
+        overflow.add_assignment(hp, start);
+        save(overflow);
+        overflow.add_assignment(hp, ctx.new_array_access(start, size).get_address());
+    }
+    overflow.add_assignment(base.dereference_field(next_field), self);
+    overflow.add_eval(ctx.new_call(heap_overflow, size));
+    overflow.end_with_return();
+
+    block = ok;
+    return start;
+}
+
+gccjit::rvalue gg::compiler::context::emit_allocation(gccjit::function& fn,
+                                                      gccjit::block& block,
+                                                      std::size_t words) {
+    auto start = fn.new_local(word_type.get_pointer(), "hp_start");
+    auto size = ctx.new_rvalue(ctx.get_type(GCC_JIT_TYPE_SIZE_T),
+                               static_cast<long>(words));
+    if (words > runtime::max_block_object_words) {
+        block.add_assignment(start, ctx.new_call(allocate, size));
+        return start;
+    }
+
+    auto hp = base.dereference_field(hp_field);
+    block.add_assignment(start, hp);
+    block.add_assignment(hp, ctx.new_array_access(start, size).get_address());
+
+    auto full = fn.new_block("nursery_block_full");
+    auto ok = fn.new_block("allocated");
+    block.end_with_conditional(
+        ctx.new_comparison(GCC_JIT_COMPARISON_GT,
+                           hp,
+                           base.dereference_field(hp_limit_field)),
+        full,
+        ok);
+
+    full.add_assignment(hp, start);
+    full.add_assignment(start, ctx.new_call(allocate, size));
+    full.end_with_jump(ok);
+
+    block = ok;
+    return start;
+}
+
+gccjit::rvalue gg::compiler::context::site_address(gccjit::rvalue start,
+                                                   const allocation_site& site) {
+    auto offset = ctx.new_rvalue(ctx.get_type(GCC_JIT_TYPE_SIZE_T),
+                                 static_cast<long>(site.offset));
+    return ctx.new_cast(ctx.new_array_access(start, offset).get_address(),
+                        closure_type.get_pointer());
+}
+
 gccjit::location gg::compiler::context::adapt_loc(const gg::location &loc) {
     auto begin = loc.begin;
     return ctx.new_location(begin.filename->c_str(), begin.line, begin.column);
 }
 
 void gg::compiler::context::create_globals() {
+    // declare everything first so that the static closures can point at
+    // each other
+    for (const auto& binding : *bindings) {
+        const std::string& name = binding->lhs->name;
+        static_closure st;
+        st.type = make_static_closure_type(*binding);
+        st.global = ctx.new_global(global_kind, st.type, name);
+        if (!static_construct(*binding->rhs)) {
+            st.info = ctx.new_global(GCC_JIT_GLOBAL_INTERNAL,
+                                     info_table_type,
+                                     name + "_info");
+            std::vector<gccjit::param> params;
+            st.entry = ctx.new_function(GCC_JIT_FUNCTION_INTERNAL,
+                                        ctx.get_type(GCC_JIT_TYPE_VOID),
+                                        name + "_entry",
+                                        params,
+                                        0);
+        }
+
+        bound_closures.new_global(name, st.global);
+        statics.emplace(name, st);
+    }
+
+    if (linked) {
+        for (const auto& [name, address] : linked->closures) {
+            // a binding which is defined again shadows the earlier one
+            if (!statics.count(name)) {
+                auto closure = ctx.new_rvalue(closure_type.get_pointer(), address);
+                bound_closures.new_global(name, closure.dereference());
+            }
+        }
+    }
+
+    srts = static_reference_tables(*bindings,
+                                   linked ? linked->cafs
+                                          : std::unordered_set<std::string>());
     for (const auto& binding : *bindings) {
-        auto global = ctx.new_global(GCC_JIT_GLOBAL_INTERNAL,
-                                     closure_type,
-                                     binding->lhs->name);
+        initialize_static(*binding);
+    }
+}
+
+gccjit::struct_
+gg::compiler::context::make_static_closure_type(const ast::binding& binding) {
+    const ast::lambda& lam = *binding.rhs;
+    std::vector<gccjit::field> fields = {
+        ctx.new_field(info_table_type.get_pointer(), "info"),
+    };
+
+    if (auto con = static_construct(lam)) {
+        std::size_t n = 0;
+        for (const auto& arg : payload_order(*con, layouts)) {
+            auto lit = std::static_pointer_cast<ast::literal>(arg);
+            fields.emplace_back(
+                ctx.new_field(literal_value(*lit).get_type(),
+                              "field" + std::to_string(n++)));
+        }
+    }
+    else {
+        if (lam.update) {
+            fields.emplace_back(ctx.new_field(word_type, "result"));
+        }
+        for (const auto& var : lam.freevars->elems) {
+            // top level free variables can only be other static closures
+            fields.emplace_back(ctx.new_field(ctx.get_type(GCC_JIT_TYPE_VOID_PTR),
+                                              var->name));
+        }
+    }
+
+    return ctx.new_struct_type(binding.lhs->name + "_closure", fields);
+}
+
+gccjit::rvalue gg::compiler::context::static_address(const std::string& name) {
+    auto it = statics.find(name);
+    if (it != statics.end()) {
+        return it->second.global.get_address();
+    }
+    if (linked) {
+        auto extern_it = linked->closures.find(name);
+        if (extern_it != linked->closures.end()) {
+            return ctx.new_rvalue(ctx.get_type(GCC_JIT_TYPE_VOID_PTR), extern_it->second);
+        }
+    }
+    throw bad_name_lookup(name);
+}
+
+gccjit::rvalue gg::compiler::context::constructor_info(const std::string& name,
+                                                       std::size_t fields) {
+    auto it = constructor_infos.find(name);
+    if (it != constructor_infos.end()) {
+        return it->second.get_address();
+    }
+    if (linked) {
+        auto extern_it = linked->constructors.find(name);
+        if (extern_it != linked->constructors.end()) {
+            return ctx.new_rvalue(info_table_type.get_pointer(), extern_it->second);
+        }
+    }
+
+    std::size_t pointers = fields;
+    auto layout = layouts.find(name);
+    if (layout != layouts.end()) {
+        pointers = std::count(layout->second.begin(),
+                              layout->second.end(),
+                              ast::field_kind::boxed);
+    }
+    // tags only need to tell apart the constructors a case can see, so
+    // numbering every constructor in the program is enough; a batch carries
+    // on from the numbers its session has used
+    unsigned long tag = constructor_infos.size() + 1;
+    if (linked) {
+        tag += linked->tags;
+    }
+
+    auto ulong = ctx.get_type(GCC_JIT_TYPE_UNSIGNED_LONG);
+    std::vector<gccjit::rvalue> info_values = {
+        ctx.null(continuation_type),
+        ctx.new_rvalue(ulong, static_cast<long>(fields)),
+        // copied and scavenged from the layout
+        ctx.null(evacuator_type),
+        ctx.null(scavenger_type),
+        ctx.new_rvalue(ulong,
+                       static_cast<long>(runtime::closure_layout(pointers,
+                                                                 fields - pointers,
+                                                                 tag))),
+        ctx.null(ctx.get_type(GCC_JIT_TYPE_VOID_PTR)),
+    };
+    auto info = ctx.new_global(global_kind, info_table_type, name + "_con_info");
+    info_values.emplace_back(make_shared_closures(name, fields, info));
+    gg::jit::set_initializer(info,
+                             gg::jit::new_struct_constructor(ctx,
+                                                             info_table_type,
+                                                             info_values));
+    constructor_infos.emplace(name, info);
+    constructor_tags.emplace(name, tag);
+    return info.get_address();
+}
+
+unsigned long gg::compiler::context::constructor_tag(const std::string& name,
+                                                     std::size_t fields) {
+    constructor_info(name, fields);
+    auto it = constructor_tags.find(name);
+    if (it != constructor_tags.end()) {
+        return it->second;
+    }
+    return runtime::closure_tag(
+        static_cast<const runtime::info_table*>(linked->constructors.at(name)));
+}
+
+gccjit::rvalue gg::compiler::context::make_shared_closures(const std::string& name,
+                                                           std::size_t fields,
+                                                           gccjit::lvalue info) {
+    auto void_ptr = ctx.get_type(GCC_JIT_TYPE_VOID_PTR);
+    auto layout = layouts.find(name);
+    bool nullary = fields == 0 && (layout == layouts.end() || layout->second.empty());
+    bool boxed_word = layout != layouts.end() &&
+                      layout->second == std::vector<ast::field_kind>{ast::field_kind::int64};
+    if (!nullary && !boxed_word) {
+        return ctx.null(void_ptr);
+    }
+
+    gccjit::lvalue global;
+    if (nullary) {
+        std::vector<gccjit::field> closure_fields = {
+            ctx.new_field(info_table_type.get_pointer(), "info"),
+        };
+        auto type = ctx.new_struct_type(name + "_con_shared_type", closure_fields);
+        global = ctx.new_global(GCC_JIT_GLOBAL_INTERNAL, type, name + "_con_shared");
+        gg::jit::set_initializer(global,
+                                 gg::jit::new_struct_constructor(ctx,
+                                                                 type,
+                                                                 {info.get_address()}));
+    }
+    else {
+        auto long_type = ctx.get_type(GCC_JIT_TYPE_LONG);
+        auto type = ctx.new_array_type(boxed_word_type, runtime::shared_values);
+        std::vector<gccjit::rvalue> closures;
+        for (std::int64_t value = runtime::min_shared_value;
+             value <= runtime::max_shared_value;
+             ++value) {
+            std::vector<gccjit::rvalue> values = {info.get_address(),
+                                                  ctx.new_rvalue(long_type,
+                                                                 static_cast<long>(value))};
+            closures.emplace_back(
+                gg::jit::new_struct_constructor(ctx, boxed_word_type, values));
+        }
+        global = ctx.new_global(GCC_JIT_GLOBAL_INTERNAL, type, name + "_con_shared");
+        gg::jit::set_initializer(global,
+                                 gg::jit::new_array_constructor(ctx, type, closures));
+    }
+    shared_closures.emplace(name, global);
+    return ctx.new_cast(global.get_address(), void_ptr);
+}
+
+gccjit::rvalue gg::compiler::context::shared_closure(const ast::construct& con) {
+    auto closure_ptr = closure_type.get_pointer();
+    if (!is_shared_construct(con, layouts)) {
+        return ctx.null(closure_ptr);
+    }
+    const std::string& name = con.con->name;
+    constructor_info(name, con.args->elems.size());
+
+    std::size_t index = 0;
+    if (con.args->elems.size()) {
+        auto lit = std::static_pointer_cast<ast::literal>(con.args->elems.front());
+        index = std::get<std::int64_t>(lit->value) - runtime::min_shared_value;
+    }
+    auto it = shared_closures.find(name);
+    if (it == shared_closures.end()) {
+        // an earlier batch's constructor, whose info table is already loaded
+        auto info = static_cast<const runtime::info_table*>(linked->constructors.at(name));
+        auto closures = reinterpret_cast<runtime::word*>(info->shared);
+        return ctx.new_rvalue(closure_ptr, static_cast<void*>(closures + 2 * index));
+    }
+    if (con.args->elems.empty()) {
+        return ctx.new_cast(it->second.get_address(), closure_ptr);
+    }
+    auto slot = ctx.new_rvalue(ctx.get_type(GCC_JIT_TYPE_INT), static_cast<int>(index));
+    return ctx.new_cast(ctx.new_array_access(it->second, slot).get_address(), closure_ptr);
+}
+
+gccjit::rvalue gg::compiler::context::selector_info(const ast::lambda& lam) {
+    auto it = selectors.find(&lam);
+    if (it == selectors.end()) {
+        return ctx.null(info_table_type.get_pointer());
+    }
+    auto slot = ctx.new_rvalue(ctx.get_type(GCC_JIT_TYPE_INT), static_cast<int>(it->second));
+    return ctx.new_array_access(selector_infos, slot).get_address();
+}
+
+gccjit::rvalue gg::compiler::context::literal_value(const ast::literal& lit) {
+    return std::visit([&](auto value) {
+        using T = decltype(value);
+        if constexpr (std::is_same_v<T, double>) {
+            return ctx.new_rvalue(ctx.get_type(GCC_JIT_TYPE_DOUBLE), value);
+        }
+        else if constexpr (std::is_same_v<T, ast::integer_digits>) {
+            return integer_literal(value);
+        }
+        else {
+            return ctx.new_rvalue(ctx.get_type(GCC_JIT_TYPE_LONG),
+                                  static_cast<long>(value));
+        }
+    }, lit.value);
+}
+
+gccjit::rvalue
+gg::compiler::context::integer_literal(const ast::integer_digits& lit) {
+    auto it = integer_literals.find(lit.digits);
+    if (it != integer_literals.end()) {
+        return it->second.get_address();
+    }
+
+    auto long_type = ctx.get_type(GCC_JIT_TYPE_LONG);
+    auto ulong = ctx.get_type(GCC_JIT_TYPE_UNSIGNED_LONG);
+    runtime::integer_value value = runtime::parse_integer(lit.digits);
+    auto small = runtime::as_small_integer(value);
+    if (small && *small >= runtime::min_shared_value && *small <= runtime::max_shared_value) {
+        auto slot = ctx.new_rvalue(ctx.get_type(GCC_JIT_TYPE_INT),
+                                   static_cast<int>(*small - runtime::min_shared_value));
+        return ctx.new_array_access(small_integers, slot).get_address();
+    }
+    std::vector<gccjit::field> fields = {
+        ctx.new_field(info_table_type.get_pointer(), "info"),
+    };
+    std::vector<gccjit::rvalue> values;
+    if (small) {
+        fields.emplace_back(ctx.new_field(long_type, "value"));
+        values = {small_integer_info.get_address(),
+                  ctx.new_rvalue(long_type, static_cast<long>(*small))};
+    }
+    else {
+        auto limbs_type = ctx.new_array_type(ulong, value.limbs.size());
+        std::vector<gccjit::rvalue> limbs;
+        for (std::uint64_t limb : value.limbs) {
+            limbs.emplace_back(ctx.new_rvalue(ulong, static_cast<long>(limb)));
+        }
+        fields.emplace_back(ctx.new_field(long_type, "size"));
+        fields.emplace_back(ctx.new_field(limbs_type, "limbs"));
+        long size = value.limbs.size();
+        values = {big_integer_info.get_address(),
+                  ctx.new_rvalue(long_type, value.negative ? -size : size),
+                  gg::jit::new_array_constructor(ctx, limbs_type, limbs)};
+    }
+
+    std::string name = "integer_literal" + std::to_string(integer_literals.size());
+    auto type = ctx.new_struct_type(name + "_type", fields);
+    auto global = ctx.new_global(GCC_JIT_GLOBAL_INTERNAL, type, name);
+    gg::jit::set_initializer(global,
+                             gg::jit::new_struct_constructor(ctx, type, values));
+    integer_literals.emplace(lit.digits, global);
+    return global.get_address();
+}
+
+gccjit::function gg::compiler::context::make_int_pow() {
+    auto long_type = ctx.get_type(GCC_JIT_TYPE_LONG);
+    auto base = ctx.new_param(long_type, "base");
+    auto exponent = ctx.new_param(long_type, "exponent");
+    std::vector<gccjit::param> params = {base, exponent};
+    auto fn = ctx.new_function(GCC_JIT_FUNCTION_INTERNAL,
+                               long_type,
+                               "gg_int_pow",
+                               params,
+                               0);
+
+    // square and multiply; a negative exponent gives 1
+    auto result = fn.new_local(long_type, "result");
+    auto entry = fn.new_block("entry");
+    auto loop = fn.new_block("loop");
+    auto body = fn.new_block("body");
+    auto multiply = fn.new_block("multiply");
+    auto square = fn.new_block("square");
+    auto done = fn.new_block("done");
+
+    entry.add_assignment(result, ctx.one(long_type));
+    entry.end_with_jump(loop);
+
+    loop.end_with_conditional(
+        ctx.new_comparison(GCC_JIT_COMPARISON_GT, exponent, ctx.zero(long_type)),
+        body,
+        done);
+
+    body.end_with_conditional(
+        ctx.new_comparison(GCC_JIT_COMPARISON_NE,
+                           ctx.new_binary_op(GCC_JIT_BINARY_OP_BITWISE_AND,
+                                             long_type,
+                                             exponent,
+                                             ctx.one(long_type)),
+                           ctx.zero(long_type)),
+        multiply,
+        square);
+
+    multiply.add_assignment_op(result, GCC_JIT_BINARY_OP_MULT, base);
+    multiply.end_with_jump(square);
+
+    square.add_assignment_op(base, GCC_JIT_BINARY_OP_MULT, base);
+    square.add_assignment_op(exponent, GCC_JIT_BINARY_OP_RSHIFT, ctx.one(long_type));
+    square.end_with_jump(loop);
+
+    done.end_with_return(result);
+    return fn;
+}
+
+gccjit::rvalue
+gg::compiler::context::primop_value(gccjit::block& block,
+                                    const ast::primop& op,
+                                    const std::vector<gccjit::rvalue>& args,
+                                    gccjit::rvalue space,
+                                    gccjit::location loc) {
+    auto long_type = ctx.get_type(GCC_JIT_TYPE_LONG);
+    auto double_type = ctx.get_type(GCC_JIT_TYPE_DOUBLE);
+    auto closure_ptr = closure_type.get_pointer();
+
+    auto binary = [&](gcc_jit_binary_op binop, gccjit::type type) {
+        return ctx.new_binary_op(binop, type, args[0], args[1], loc);
+    };
+    auto compare = [&](gcc_jit_comparison comparison) {
+        return ctx.new_cast(ctx.new_comparison(comparison, args[0], args[1], loc),
+                            long_type,
+                            loc);
+    };
+    auto call = [&](gccjit::function fn) {
+        std::vector<gccjit::rvalue> call_args = args;
+        return ctx.new_call(fn, call_args, loc);
+    };
+    auto call_runtime = [&](const std::string& name) {
+        return call(runtime_primops.at(name));
+    };
+    auto run_runtime = [&](const std::string& name) {
+        block.add_eval(call_runtime(name), loc);
+        return ctx.zero(long_type);
+    };
+
+    // every element is one word, after the array's header; both headers
+    // hold the size in their second word
+    auto word_at = [&](gccjit::type type, gccjit::rvalue index) {
+        auto words = ctx.new_cast(args[0], type.get_pointer(), loc);
+        return ctx.new_array_access(words, index, loc);
+    };
+    auto element = [&](gccjit::type type) {
+        auto header = ctx.new_rvalue(long_type,
+                                     static_cast<long>(runtime::array_header_words));
+        return word_at(type,
+                       ctx.new_binary_op(GCC_JIT_BINARY_OP_PLUS,
+                                         long_type,
+                                         args[1],
+                                         header,
+                                         loc));
+    };
+    auto size = [&] {
+        return word_at(long_type, ctx.one(long_type));
+    };
+    auto write = [&](gccjit::type type) {
+        block.add_assignment(element(type), args[2], loc);
+        return ctx.zero(long_type);
+    };
+
+    // a small integer is its info table pointer followed by the value
+    auto is_small_integer = [&](gccjit::rvalue c) {
+        auto header = ctx.new_cast(c, info_table_type.get_pointer().get_pointer(), loc);
+        return ctx.new_comparison(GCC_JIT_COMPARISON_EQ,
+                                  ctx.new_array_access(header, ctx.zero(long_type), loc),
+                                  small_integer_info.get_address(),
+                                  loc);
+    };
+    auto small_integer_value = [&](gccjit::rvalue c) {
+        auto words = ctx.new_cast(c, long_type.get_pointer(), loc);
+        return ctx.new_array_access(words, ctx.one(long_type), loc);
+    };
+    auto compare_integers = [&] {
+        gccjit::function fn = block.get_function();
+        auto order = fn.new_local(long_type, "order");
+        auto small = fn.new_block("small_compare");
+        auto big = fn.new_block("big_compare");
+        auto done = fn.new_block("compared");
+
+        block.end_with_conditional(
+            ctx.new_binary_op(GCC_JIT_BINARY_OP_LOGICAL_AND,
+                              ctx.get_type(GCC_JIT_TYPE_BOOL),
+                              is_small_integer(args[0]),
+                              is_small_integer(args[1]),
+                              loc),
+            small,
+            big,
+            loc);
+
+        auto x = small_integer_value(args[0]);
+        auto y = small_integer_value(args[1]);
+        auto test = [&](gcc_jit_comparison comparison) {
+            return ctx.new_cast(ctx.new_comparison(comparison, x, y, loc),
+                                long_type,
+                                loc);
+        };
+        small.add_assignment(order,
+                             ctx.new_binary_op(GCC_JIT_BINARY_OP_MINUS,
+                                               long_type,
+                                               test(GCC_JIT_COMPARISON_GT),
+                                               test(GCC_JIT_COMPARISON_LT),
+                                               loc),
+                             loc);
+        small.end_with_jump(done, loc);
+
+        big.add_assignment(order, call_runtime("gg_integer_compare"), loc);
+        big.end_with_jump(done, loc);
+
+        block = done;
+        return order;
+    };
+
+    // small results in the shared range are the runtime's, and the others
+    // are built in `space`
+    auto integer_arithmetic = [&](const char* overflow, const std::string& slow) {
+        gccjit::function fn = block.get_function();
+        auto bool_type = ctx.get_type(GCC_JIT_TYPE_BOOL);
+        auto result = fn.new_local(closure_ptr, "integer");
+        auto value = fn.new_local(long_type, "integer_value");
+        auto small = fn.new_block("small_arithmetic");
+        auto fits = fn.new_block("small_result");
+        auto shared = fn.new_block("shared_result");
+        auto built = fn.new_block("built_result");
+        auto big = fn.new_block("big_arithmetic");
+        auto done = fn.new_block("arithmetic_done");
+
+        // negation is subtraction from zero
+        bool unary = args.size() == 1;
+        block.end_with_conditional(
+            unary ? is_small_integer(args[0]) :
+                ctx.new_binary_op(GCC_JIT_BINARY_OP_LOGICAL_AND,
+                                  bool_type,
+                                  is_small_integer(args[0]),
+                                  is_small_integer(args[1]),
+                                  loc),
+            small,
+            big,
+            loc);
+
+        std::vector<gccjit::rvalue> operands = {
+            unary ? ctx.zero(long_type) : small_integer_value(args[0]),
+            small_integer_value(args[unary ? 0 : 1]),
+            value.get_address(),
+        };
+        small.end_with_conditional(
+            ctx.new_call(ctx.get_builtin_function(overflow), operands, loc),
+            big,
+            fits,
+            loc);
+
+        auto in_range = [&](gcc_jit_comparison comparison, std::int64_t bound) {
+            return ctx.new_comparison(comparison,
+                                      value,
+                                      ctx.new_rvalue(long_type, static_cast<long>(bound)),
+                                      loc);
+        };
+        fits.end_with_conditional(
+            ctx.new_binary_op(GCC_JIT_BINARY_OP_LOGICAL_AND,
+                              bool_type,
+                              in_range(GCC_JIT_COMPARISON_GE, runtime::min_shared_value),
+                              in_range(GCC_JIT_COMPARISON_LE, runtime::max_shared_value),
+                              loc),
+            shared,
+            built,
+            loc);
+
+        auto slot = ctx.new_binary_op(
+            GCC_JIT_BINARY_OP_MINUS,
+            long_type,
+            value,
+            ctx.new_rvalue(long_type, static_cast<long>(runtime::min_shared_value)),
+            loc);
+        shared.add_assignment(
+            result,
+            ctx.new_cast(ctx.new_array_access(small_integers, slot, loc).get_address(),
+                         closure_ptr,
+                         loc),
+            loc);
+        shared.end_with_jump(done, loc);
+
+        auto header = ctx.new_cast(space, info_table_type.get_pointer().get_pointer(), loc);
+        auto words = ctx.new_cast(space, long_type.get_pointer(), loc);
+        built.add_assignment(ctx.new_array_access(header, ctx.zero(long_type), loc),
+                             small_integer_info.get_address(),
+                             loc);
+        built.add_assignment(ctx.new_array_access(words, ctx.one(long_type), loc),
+                             value,
+                             loc);
+        built.add_assignment(result, ctx.new_cast(space, closure_ptr, loc), loc);
+        built.end_with_jump(done, loc);
+
+        big.add_assignment(result, call_runtime(slow), loc);
+        big.end_with_jump(done, loc);
+
+        block = done;
+        return result;
+    };
+
+    switch (op.opcode) {
+    case ast::primopcode::ADD:
+        return binary(GCC_JIT_BINARY_OP_PLUS, long_type);
+    case ast::primopcode::SUB:
+        return binary(GCC_JIT_BINARY_OP_MINUS, long_type);
+    case ast::primopcode::MUL:
+        return binary(GCC_JIT_BINARY_OP_MULT, long_type);
+    case ast::primopcode::DIV:
+        return binary(GCC_JIT_BINARY_OP_DIVIDE, long_type);
+    case ast::primopcode::MOD:
+        return binary(GCC_JIT_BINARY_OP_MODULO, long_type);
+    case ast::primopcode::POW:
+        return call(int_pow);
+    case ast::primopcode::LSHIFT:
+        return binary(GCC_JIT_BINARY_OP_LSHIFT, long_type);
+    case ast::primopcode::RSHIFT:
+        return binary(GCC_JIT_BINARY_OP_RSHIFT, long_type);
+    case ast::primopcode::BITOR:
+        return binary(GCC_JIT_BINARY_OP_BITWISE_OR, long_type);
+    case ast::primopcode::BITAND:
+        return binary(GCC_JIT_BINARY_OP_BITWISE_AND, long_type);
+    case ast::primopcode::BITXOR:
+        return binary(GCC_JIT_BINARY_OP_BITWISE_XOR, long_type);
+    case ast::primopcode::LT:
+    case ast::primopcode::LT_DOUBLE:
+        return compare(GCC_JIT_COMPARISON_LT);
+    case ast::primopcode::LE:
+    case ast::primopcode::LE_DOUBLE:
+        return compare(GCC_JIT_COMPARISON_LE);
+    case ast::primopcode::EQ:
+    case ast::primopcode::EQ_DOUBLE:
+        return compare(GCC_JIT_COMPARISON_EQ);
+    case ast::primopcode::NE:
+    case ast::primopcode::NE_DOUBLE:
+        return compare(GCC_JIT_COMPARISON_NE);
+    case ast::primopcode::GE:
+    case ast::primopcode::GE_DOUBLE:
+        return compare(GCC_JIT_COMPARISON_GE);
+    case ast::primopcode::GT:
+    case ast::primopcode::GT_DOUBLE:
+        return compare(GCC_JIT_COMPARISON_GT);
+    case ast::primopcode::INVERT:
+        return ctx.new_unary_op(GCC_JIT_UNARY_OP_BITWISE_NEGATE,
+                                long_type,
+                                args[0],
+                                loc);
+    case ast::primopcode::NEGATE:
+        return ctx.new_unary_op(GCC_JIT_UNARY_OP_MINUS, long_type, args[0], loc);
+    case ast::primopcode::ADD_DOUBLE:
+        return binary(GCC_JIT_BINARY_OP_PLUS, double_type);
+    case ast::primopcode::SUB_DOUBLE:
+        return binary(GCC_JIT_BINARY_OP_MINUS, double_type);
+    case ast::primopcode::MUL_DOUBLE:
+        return binary(GCC_JIT_BINARY_OP_MULT, double_type);
+    case ast::primopcode::DIV_DOUBLE:
+        return binary(GCC_JIT_BINARY_OP_DIVIDE, double_type);
+    case ast::primopcode::POW_DOUBLE:
+        return call(ctx.get_builtin_function("__builtin_pow"));
+    case ast::primopcode::NEGATE_DOUBLE:
+        return ctx.new_unary_op(GCC_JIT_UNARY_OP_MINUS, double_type, args[0], loc);
+    case ast::primopcode::SQRT_DOUBLE:
+        return call(ctx.get_builtin_function("__builtin_sqrt"));
+    case ast::primopcode::INT_TO_DOUBLE:
+        return ctx.new_cast(args[0], double_type, loc);
+    case ast::primopcode::DOUBLE_TO_INT:
+        // truncates towards zero
+        return ctx.new_cast(args[0], long_type, loc);
+    case ast::primopcode::NEW_BYTE_ARRAY:
+        return call_runtime("gg_new_byte_array");
+    case ast::primopcode::SIZEOF_BYTE_ARRAY:
+    case ast::primopcode::SIZEOF_ARRAY:
+        return size();
+    case ast::primopcode::INDEX_INT_ARRAY:
+    case ast::primopcode::READ_INT_ARRAY:
+        return element(long_type);
+    case ast::primopcode::INDEX_DOUBLE_ARRAY:
+    case ast::primopcode::READ_DOUBLE_ARRAY:
+        return element(double_type);
+    case ast::primopcode::WRITE_INT_ARRAY:
+        return write(long_type);
+    case ast::primopcode::WRITE_DOUBLE_ARRAY:
+        return write(double_type);
+    case ast::primopcode::COPY_BYTE_ARRAY:
+        return run_runtime("gg_copy_byte_array");
+    case ast::primopcode::SET_BYTE_ARRAY:
+        return run_runtime("gg_set_byte_array");
+    case ast::primopcode::COMPARE_BYTE_ARRAYS:
+        return call_runtime("gg_compare_byte_arrays");
+    case ast::primopcode::SUM_INT_ARRAY:
+        return call_runtime("gg_sum_int_array");
+    case ast::primopcode::SUM_DOUBLE_ARRAY:
+        return call_runtime("gg_sum_double_array");
+    case ast::primopcode::UNSAFE_FREEZE_BYTE_ARRAY:
+    case ast::primopcode::UNSAFE_FREEZE_ARRAY:
+        return call_runtime("gg_unsafe_freeze");
+    case ast::primopcode::NEW_ARRAY:
+        return call_runtime("gg_new_array");
+    case ast::primopcode::INDEX_ARRAY:
+    case ast::primopcode::READ_ARRAY:
+        return element(closure_ptr);
+    case ast::primopcode::WRITE_ARRAY:
+        // through the runtime for the write barrier
+        return run_runtime("gg_write_array");
+    case ast::primopcode::COPY_ARRAY:
+        return run_runtime("gg_copy_array");
+    case ast::primopcode::PLUS_INTEGER:
+        return integer_arithmetic("__builtin_saddl_overflow", "gg_integer_add");
+    case ast::primopcode::MINUS_INTEGER:
+        return integer_arithmetic("__builtin_ssubl_overflow", "gg_integer_sub");
+    case ast::primopcode::TIMES_INTEGER:
+        return integer_arithmetic("__builtin_smull_overflow", "gg_integer_mul");
+    case ast::primopcode::NEGATE_INTEGER:
+        return integer_arithmetic("__builtin_ssubl_overflow", "gg_integer_negate");
+    case ast::primopcode::COMPARE_INTEGER:
+        return compare_integers();
+    case ast::primopcode::INT_TO_INTEGER:
+        return call_runtime("gg_integer_from_int");
+    case ast::primopcode::INTEGER_TO_INT:
+        return call_runtime("gg_integer_to_int");
+    case ast::primopcode::FORK:
+        return call_runtime("gg_fork");
+    case ast::primopcode::NEW_MVAR:
+        return call_runtime("gg_new_mvar");
+    case ast::primopcode::YIELD:
+    case ast::primopcode::TAKE_MVAR:
+    case ast::primopcode::PUT_MVAR:
+        break;
+    }
+
+    std::stringstream ss;
+    ss << "primop at " << op.loc << " may deschedule the thread";
+    throw bad_primop(ss.str());
+}
+
+void gg::compiler::context::initialize_static(const ast::binding& binding) {
+    const ast::lambda& lam = *binding.rhs;
+    static_closure& st = statics.at(binding.lhs->name);
+    auto void_ptr = ctx.get_type(GCC_JIT_TYPE_VOID_PTR);
+
+    std::vector<gccjit::rvalue> values;
+    if (auto con = static_construct(lam)) {
+        values.emplace_back(
+            constructor_info(con->con->name, con->args->elems.size()));
+        for (const auto& arg : payload_order(*con, layouts)) {
+            values.emplace_back(
+                literal_value(*std::static_pointer_cast<ast::literal>(arg)));
+        }
+        gg::jit::set_initializer(st.global,
+                                 gg::jit::new_struct_constructor(ctx,
+                                                                 st.type,
+                                                                 values));
+        return;
+    }
+
+    gccjit::rvalue srt = ctx.null(void_ptr);
+    const auto& srt_names = srts.at(binding.lhs->name);
+    if (srt_names.size()) {
+        std::vector<gccjit::rvalue> entries;
+        for (const auto& name : srt_names) {
+            entries.emplace_back(static_address(name));
+        }
+        entries.emplace_back(ctx.null(void_ptr));
+
+        auto srt_type = ctx.new_array_type(void_ptr, entries.size());
+        auto srt_global = ctx.new_global(GCC_JIT_GLOBAL_INTERNAL,
+                                         srt_type,
+                                         binding.lhs->name + "_srt");
+        gg::jit::set_initializer(srt_global,
+                                 gg::jit::new_array_constructor(ctx,
+                                                                srt_type,
+                                                                entries));
+        srt = srt_global.get_address();
+    }
+    st.srt = srt;
+
+    auto ulong = ctx.get_type(GCC_JIT_TYPE_UNSIGNED_LONG);
+    std::size_t pointers = closure_pointers.at(&lam);
+    std::vector<gccjit::rvalue> info_values = {
+        st.entry.get_address(),
+        ctx.new_rvalue(ulong, static_cast<long>(lam.args->elems.size())),
+        // static closures are never moved or scavenged, but the layout
+        // still describes them
+        ctx.null(evacuator_type),
+        ctx.null(scavenger_type),
+        ctx.new_rvalue(ulong,
+                       static_cast<long>(runtime::closure_layout(
+                           lam.update + pointers,
+                           lam.freevars->elems.size() - pointers))),
+        srt,
+        ctx.null(void_ptr),
+    };
+    gg::jit::set_initializer(st.info,
+                             gg::jit::new_struct_constructor(ctx,
+                                                             info_table_type,
+                                                             info_values));
+
+    values.emplace_back(st.info.get_address());
+    if (lam.update) {
+        values.emplace_back(ctx.zero(word_type));
+    }
+    for (const auto& var : lam.freevars->elems) {
+        values.emplace_back(static_address(var->name));
+    }
+    gg::jit::set_initializer(st.global,
+                             gg::jit::new_struct_constructor(ctx,
+                                                             st.type,
+                                                             values));
+}
+
+gg::compiler::session::session(const float_options& floating) : floating(floating) {}
+
+gg::compiler::session::~session() {
+    for (gcc_jit_result* result : results) {
+        gcc_jit_result_release(result);
+    }
+}
+
+void gg::compiler::session::add(const std::shared_ptr<ast::program>& batch) {
+    constructor_layouts declared = declared_layouts(*batch->declarations);
+    constructor_layouts merged = layouts;
+    linkage visible = linked;
+    auto described = descriptions;
+    for (const auto& [con, fields] : declared) {
+        merged[con] = fields;
+        // the old info tables describe the old fields
+        visible.constructors.erase(con);
+    }
+
+    // nothing changes until the batch has compiled
+    {
+        context child(root, batch, merged, visible, floating);
+        gcc_jit_result* result = child.ctx.compile();
+        if (!result) {
+            const char* error = gcc_jit_context_get_first_error(
+                child.ctx.get_inner_context());
+            throw bad_compile(error ? error : "failed to compile batch");
+        }
+        results.emplace_back(result);
+
+        for (const auto& binding : *child.bindings) {
+            const std::string& name = binding->lhs->name;
+            visible.closures[name] = gcc_jit_result_get_global(result, name.c_str());
+            if (is_caf(*binding->rhs) || child.srts.at(name).size()) {
+                visible.cafs.insert(name);
+            }
+            else {
+                visible.cafs.erase(name);
+            }
+        }
+        for (const auto& [con, info] : child.constructor_infos) {
+            std::string info_name = con + "_con_info";
+            void* address = gcc_jit_result_get_global(result, info_name.c_str());
+            visible.constructors[con] = address;
+
+            auto table = static_cast<const runtime::info_table*>(address);
+            auto layout = merged.find(con);
+            described[table] = {con,
+                                layout != merged.end() ?
+                                    layout->second :
+                                    std::vector<ast::field_kind>(
+                                        runtime::closure_pointers(table),
+                                        ast::field_kind::boxed)};
+        }
+        visible.tags += child.constructor_infos.size();
+    }
+
+    linked = std::move(visible);
+    layouts = std::move(merged);
+    descriptions = std::move(described);
+}
+
+gg::runtime::closure* gg::compiler::session::lookup(const std::string& name) const {
+    auto it = linked.closures.find(name);
+    if (it == linked.closures.end()) {
+        return nullptr;
+    }
+    return static_cast<runtime::closure*>(it->second);
+}
+
+const gg::compiler::linkage& gg::compiler::session::linked_bindings() const {
+    return linked;
+}
 
-        bound_closures.new_global(binding->lhs->name, global);
+const gg::compiler::constructor_description*
+gg::compiler::session::describe(const runtime::info_table* info) const {
+    auto it = descriptions.find(info);
+    if (it == descriptions.end()) {
+        return nullptr;
     }
+    return &it->second;
 }
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+
+#include "gg/config.h"
+#include "gg/runtime.h"
+
+namespace gg {
+namespace runtime {
+namespace {
+constexpr std::size_t default_nursery_words = std::size_t(1) << 17;
+
+/**
+   Count the CPUs in a list such as `0-3,8-11`.
+*/
+std::size_t count_cpus(const std::string& list) {
+    std::size_t cpus = 0;
+    std::istringstream in(list);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        std::size_t first;
+        std::size_t last;
+        char dash;
+        std::istringstream r(range);
+        if (!(r >> first)) {
+            continue;
+        }
+        last = r >> dash >> last ? last : first;
+        cpus += last >= first ? last - first + 1 : 1;
+    }
+    return std::max<std::size_t>(cpus, 1);
+}
+
+std::string read_line(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+std::size_t read_cache_nursery_words() {
+    std::uint64_t l2 = 0;
+    std::uint64_t l3 = 0;
+    for (std::size_t n = 0;; ++n) {
+        std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(n) + '/';
+        std::string level = read_line(dir + "level");
+        if (level.empty()) {
+            break;
+        }
+        if (read_line(dir + "type") != "Unified") {
+            continue;
+        }
+        std::uint64_t share = parse_bytes(read_line(dir + "size")) /
+                              count_cpus(read_line(dir + "shared_cpu_list"));
+        if (level == "2") {
+            l2 = share;
+        }
+        else if (level == "3") {
+            l3 = share;
+        }
+    }
+    std::uint64_t bytes = l2 ? l2 : l3;
+    return bytes ? bytes / sizeof(word) : default_nursery_words;
+}
+}
+
+std::uint64_t parse_bytes(const std::string& text) {
+    std::size_t digits = std::min(text.find_first_not_of("0123456789"), text.size());
+    if (digits == 0 || digits > 9 || digits + 1 < text.size()) {
+        return 0;
+    }
+    std::uint64_t count = std::stoull(text.substr(0, digits));
+    if (digits == text.size()) {
+        return count;
+    }
+    switch (text[digits]) {
+    case 'K':
+    case 'k':
+        return count << 10;
+    case 'M':
+    case 'm':
+        return count << 20;
+    case 'G':
+    case 'g':
+        return count << 30;
+    default:
+        return 0;
+    }
+}
+
+std::size_t cache_nursery_words() {
+    static const std::size_t words = read_cache_nursery_words();
+    return words;
+}
+
+std::vector<std::string> parse_rts_options(const std::vector<std::string>& args,
+                                           config& options) {
+    const std::string interval = "--rts-stats-interval=";
+    const std::string nursery = "--rts-nursery=";
+    const std::string target = "--rts-gc-target=";
+    std::vector<std::string> rest;
+    for (const std::string& arg : args) {
+        if (arg.compare(0, 6, "--rts-")) {
+            rest.emplace_back(arg);
+        }
+        else if (arg == "--rts-stats") {
+            options.stats_output = stats_format::text;
+        }
+        else if (arg == "--rts-stats=json") {
+            options.stats_output = stats_format::json;
+        }
+        else if (!arg.compare(0, interval.size(), interval)) {
+            std::string ms = arg.substr(interval.size());
+            if (ms.empty() || ms.size() > 12 ||
+                ms.find_first_not_of("0123456789") != std::string::npos) {
+                throw bad_rts_option("bad interval in " + arg);
+            }
+            options.stats_interval = std::chrono::milliseconds(std::stoll(ms));
+        }
+        else if (!arg.compare(0, nursery.size(), nursery)) {
+            std::uint64_t bytes = parse_bytes(arg.substr(nursery.size()));
+            if (bytes < sizeof(word)) {
+                throw bad_rts_option("bad size in " + arg);
+            }
+            options.nursery_words = bytes / sizeof(word);
+        }
+        else if (!arg.compare(0, target.size(), target)) {
+            std::string percent = arg.substr(target.size());
+            std::size_t end = 0;
+            double value = 0;
+            try {
+                value = std::stod(percent, &end);
+            }
+            catch (const std::exception&) {
+            }
+            if (end != percent.size() || !(value > 0 && value < 100)) {
+                throw bad_rts_option("bad percentage in " + arg);
+            }
+            options.gc_time_target = value / 100;
+        }
+        else {
+            throw bad_rts_option("unknown runtime option " + arg);
+        }
+    }
+    return rest;
+}
+}
+}
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <unordered_set>
+
+#include "gg/dependencies.h"
+#include "gg/references.h"
+#include "gg/scoped_map.h"
+
+namespace gg {
+namespace compiler {
+std::vector<std::vector<std::string>>
+strongly_connected_components(const std::vector<std::string>& nodes,
+                              const reference_graph& graph) {
+    // Tarjan's algorithm, with an explicit stack so that long chains of
+    // bindings cannot overflow the C++ stack
+    struct state {
+        std::size_t index;
+        std::size_t lowlink;
+        bool on_stack;
+    };
+    std::unordered_map<std::string, state> states;
+    std::vector<std::string> stack;
+    std::vector<std::vector<std::string>> components;
+    static const std::vector<std::string> no_edges;
+
+    auto edges_of = [&](const std::string& name) -> const std::vector<std::string>& {
+        auto it = graph.find(name);
+        return it == graph.end() ? no_edges : it->second;
+    };
+
+    std::unordered_set<std::string> in_graph(nodes.begin(), nodes.end());
+    for (const auto& root : nodes) {
+        if (states.count(root)) {
+            continue;
+        }
+
+        // each frame is a node and the next of its edges to visit
+        std::vector<std::pair<std::string, std::size_t>> frames;
+        auto visit = [&](const std::string& name) {
+            std::size_t index = states.size();
+            states[name] = {index, index, true};
+            stack.emplace_back(name);
+            frames.emplace_back(name, 0);
+        };
+        visit(root);
+
+        while (frames.size()) {
+            auto& [name, edge] = frames.back();
+            const auto& edges = edges_of(name);
+            if (edge < edges.size()) {
+                const std::string& next = edges[edge++];
+                if (!in_graph.count(next)) {
+                    continue;
+                }
+                auto it = states.find(next);
+                if (it == states.end()) {
+                    visit(next);
+                }
+                else if (it->second.on_stack) {
+                    state& s = states[name];
+                    s.lowlink = std::min(s.lowlink, it->second.index);
+                }
+                continue;
+            }
+
+            std::string done = name;
+            frames.pop_back();
+            state& s = states[done];
+            if (frames.size()) {
+                state& parent = states[frames.back().first];
+                parent.lowlink = std::min(parent.lowlink, s.lowlink);
+            }
+            if (s.lowlink == s.index) {
+                std::vector<std::string> component;
+                std::string member;
+                do {
+                    member = std::move(stack.back());
+                    stack.pop_back();
+                    states[member].on_stack = false;
+                    component.emplace_back(member);
+                } while (member != done);
+                components.emplace_back(std::move(component));
+            }
+        }
+    }
+    return components;
+}
+
+namespace {
+void prune_expr(std::shared_ptr<ast::expr>& expr);
+
+void prune_lambda(ast::lambda& lam) {
+    prune_expr(lam.body);
+}
+
+/**
+   Rewrite a `let` or `letrec` without its dead bindings, with each
+   `letrec` split into its strongly connected components.
+*/
+void prune_local_bindings(std::shared_ptr<ast::expr>& expr,
+                          const std::shared_ptr<ast::local_bindings>& let) {
+    bool recursive = static_cast<bool>(
+        std::dynamic_pointer_cast<ast::local_recursion>(let));
+
+    std::unordered_set<std::string> names;
+    std::vector<std::string> order;
+    std::unordered_map<std::string, std::shared_ptr<ast::binding>> by_name;
+    for (const auto& binding : *let->bindings) {
+        names.insert(binding->lhs->name);
+        order.emplace_back(binding->lhs->name);
+        by_name[binding->lhs->name] = binding;
+    }
+
+    reference_graph graph;
+    if (recursive) {
+        for (const auto& binding : *let->bindings) {
+            auto refs = global_references(*binding->rhs, names);
+            graph[binding->lhs->name].assign(refs.begin(), refs.end());
+        }
+    }
+
+    // find everything the body needs
+    auto live_roots = expr_references(let->body, names);
+    std::unordered_set<std::string> live;
+    std::vector<std::string> pending(live_roots.begin(), live_roots.end());
+    while (pending.size()) {
+        std::string name = std::move(pending.back());
+        pending.pop_back();
+        if (live.insert(name).second) {
+            for (const auto& ref : graph[name]) {
+                pending.emplace_back(ref);
+            }
+        }
+    }
+
+    std::vector<std::string> live_order;
+    for (const auto& name : order) {
+        if (live.count(name)) {
+            live_order.emplace_back(name);
+        }
+    }
+    if (live_order.empty()) {
+        expr = let->body;
+        return;
+    }
+
+    auto group = [&](const std::vector<std::string>& members) {
+        std::vector<std::shared_ptr<ast::binding>> elems;
+        // keep the source order within a group
+        for (const auto& name : live_order) {
+            if (std::find(members.begin(), members.end(), name) != members.end()) {
+                elems.emplace_back(by_name[name]);
+            }
+        }
+        return std::make_shared<ast::sequence<ast::binding>>(let->bindings->loc,
+                                                             elems);
+    };
+
+    if (!recursive) {
+        let->bindings = group(live_order);
+        return;
+    }
+
+    auto components = strongly_connected_components(live_order, graph);
+    std::shared_ptr<ast::expr> body = let->body;
+    // the components come out dependencies first, which is outermost first
+    for (auto it = components.rbegin(); it != components.rend(); ++it) {
+        const auto& members = *it;
+        bool self_recursive = members.size() > 1 ||
+            std::find(graph[members[0]].begin(),
+                      graph[members[0]].end(),
+                      members[0]) != graph[members[0]].end();
+        if (self_recursive) {
+            body = std::make_shared<ast::local_recursion>(let->loc,
+                                                          group(members),
+                                                          body);
+        }
+        else {
+            body = std::make_shared<ast::local_definition>(let->loc,
+                                                           group(members),
+                                                           body);
+        }
+    }
+    expr = body;
+}
+
+void prune_expr(std::shared_ptr<ast::expr>& expr) {
+    if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+        // prune from the inside out so that bindings only used by dead code
+        // are dead too
+        for (const auto& binding : *let->bindings) {
+            prune_lambda(*binding->rhs);
+        }
+        prune_expr(let->body);
+        prune_local_bindings(expr, let);
+    }
+    else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+        prune_expr(case_->scrutinee);
+        for (const auto& alt : *case_->alts) {
+            prune_expr(alt->body);
+        }
+    }
+}
+}
+
+void prune_bindings(ast::sequence<ast::binding>& bindings,
+                    const std::string& entry) {
+    prune_bindings(bindings, std::vector<std::string>{entry});
+}
+
+void prune_bindings(ast::sequence<ast::binding>& bindings,
+                    const std::vector<std::string>& entries) {
+    std::unordered_set<std::string> globals;
+    for (const auto& binding : bindings) {
+        globals.insert(binding->lhs->name);
+    }
+    for (const auto& entry : entries) {
+        if (!globals.count(entry)) {
+            throw bad_name_lookup(entry);
+        }
+    }
+
+    reference_graph graph;
+    for (const auto& binding : bindings) {
+        prune_lambda(*binding->rhs);
+        auto refs = global_references(*binding->rhs, globals);
+        graph[binding->lhs->name].assign(refs.begin(), refs.end());
+    }
+
+    std::unordered_set<std::string> live;
+    std::vector<std::string> pending = entries;
+    while (pending.size()) {
+        std::string name = std::move(pending.back());
+        pending.pop_back();
+        if (live.insert(name).second) {
+            for (const auto& ref : graph[name]) {
+                pending.emplace_back(ref);
+            }
+        }
+    }
+
+    auto& elems = bindings.elems;
+    elems.erase(std::remove_if(elems.begin(),
+                               elems.end(),
+                               [&](const auto& binding) {
+                                   return !live.count(binding->lhs->name);
+                               }),
+                elems.end());
+}
+}
+}
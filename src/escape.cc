@@ -0,0 +1,659 @@
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "gg/allocation.h"
+#include "gg/escape.h"
+#include "gg/freevars.h"
+#include "gg/references.h"
+
+namespace gg {
+namespace compiler {
+namespace {
+/**
+   Which parameters of each top level function escape.
+*/
+using escape_summaries = std::unordered_map<std::string, std::vector<bool>>;
+
+/**
+   What is known about a closure being followed through its scope.
+*/
+struct tracked_closure {
+    /**
+       The closure's arity, if it is known.
+    */
+    std::size_t arity;
+    bool known_arity;
+
+    /**
+       The lambda the closure is bound in.
+    */
+    std::size_t activation;
+
+    /**
+       The number of case frames pushed when the closure was bound.
+    */
+    std::size_t frame_base;
+
+    /**
+       How many alternatives deep the closure was bound.
+    */
+    std::size_t alt_depth;
+
+    /**
+       The outermost case pushed since the closure was bound which every use
+       so far is inside the scrutinee of.
+    */
+    const ast::case_* frame = nullptr;
+
+    bool escapes = false;
+
+    /**
+       Whether some use is not inside the scrutinee of `frame`.
+    */
+    bool unframed = false;
+};
+
+struct escape_walker {
+    const escape_summaries& functions;
+    bool track_lets;
+    std::deque<std::pair<const ast::binding*, tracked_closure>> lets;
+    std::unordered_map<std::string, std::vector<tracked_closure*>> scopes;
+    /**
+       The cases whose scrutinee is being walked, with how many alternatives
+       deep each was pushed.
+    */
+    std::vector<std::pair<const ast::case_*, std::size_t>> frames;
+    std::size_t alt_depth = 0;
+    std::size_t activation = 0;
+    std::size_t activations = 0;
+
+    escape_walker(const escape_summaries& functions, bool track_lets)
+        : functions(functions), track_lets(track_lets) {}
+
+    void bind(const std::string& name, tracked_closure* closure = nullptr) {
+        scopes[name].emplace_back(closure);
+    }
+
+    void unbind(const std::string& name) {
+        scopes[name].pop_back();
+    }
+
+    bool is_local(const std::string& name) {
+        auto it = scopes.find(name);
+        return it != scopes.end() && it->second.size();
+    }
+
+    tracked_closure* lookup(const std::string& name) {
+        return is_local(name) ? scopes[name].back() : nullptr;
+    }
+
+    void use(tracked_closure& closure) {
+        if (closure.activation != activation) {
+            // captured by a lambda
+            closure.escapes = true;
+            return;
+        }
+        if (frames.size() <= closure.frame_base) {
+            closure.unframed = true;
+            return;
+        }
+        const auto& [outer, depth] = frames[closure.frame_base];
+        if (depth != closure.alt_depth) {
+            // the case is pushed in an alternative of a case after the
+            // binding, which has already popped its own frame
+            closure.unframed = true;
+            return;
+        }
+        if (closure.frame && closure.frame != outer) {
+            closure.unframed = true;
+        }
+        closure.frame = outer;
+    }
+
+    /**
+       The closures among some atoms are stored somewhere which may outlive
+       the frame.
+    */
+    void store_atoms(const ast::sequence<ast::atom>& atoms) {
+        for (const auto& atom : atoms.elems) {
+            if (auto var = std::dynamic_pointer_cast<ast::variable>(atom)) {
+                if (tracked_closure* closure = lookup(var->name)) {
+                    use(*closure);
+                    closure->escapes = true;
+                }
+            }
+        }
+    }
+
+    /**
+       Does passing a closure as argument `n` of a call escape?
+    */
+    bool escapes_as_argument(const std::string& callee,
+                             std::size_t n,
+                             std::size_t args) {
+        if (is_local(callee)) {
+            return true;
+        }
+        auto it = functions.find(callee);
+        return it == functions.end() || it->second.size() != args || it->second[n];
+    }
+
+    void walk_apply(const ast::apply& app, bool strict) {
+        std::size_t args = app.args->elems.size();
+        if (tracked_closure* head = lookup(app.var->name)) {
+            use(*head);
+            if (!args) {
+                // entering a function without arguments returns it
+                bool function = !head->known_arity || head->arity;
+                head->escapes |= function && !strict;
+            }
+            else if (head->known_arity && args < head->arity) {
+                head->escapes = true;
+            }
+        }
+        for (std::size_t n = 0; n < args; ++n) {
+            auto var = std::dynamic_pointer_cast<ast::variable>(app.args->elems[n]);
+            if (!var) {
+                continue;
+            }
+            if (tracked_closure* arg = lookup(var->name)) {
+                use(*arg);
+                arg->escapes |= escapes_as_argument(app.var->name, n, args);
+            }
+        }
+    }
+
+    void walk(ast::lambda& lam) {
+        std::size_t outer = activation;
+        activation = ++activations;
+        std::vector<std::pair<const ast::case_*, std::size_t>> outer_frames =
+            std::move(frames);
+        frames.clear();
+
+        for (const auto& arg : lam.args->elems) {
+            bind(arg->name);
+        }
+        walk(lam.body, false);
+        for (const auto& arg : lam.args->elems) {
+            unbind(arg->name);
+        }
+
+        frames = std::move(outer_frames);
+        activation = outer;
+    }
+
+    /**
+       @return Whether each of the function's parameters escapes.
+    */
+    std::vector<bool> summarize(ast::lambda& lam) {
+        activation = ++activations;
+        std::vector<tracked_closure> params(lam.args->elems.size());
+        for (std::size_t n = 0; n < params.size(); ++n) {
+            params[n].known_arity = false;
+            params[n].activation = activation;
+            params[n].frame_base = 0;
+            params[n].alt_depth = alt_depth;
+            bind(lam.args->elems[n]->name, &params[n]);
+        }
+        walk(lam.body, false);
+        std::vector<bool> escapes;
+        for (std::size_t n = 0; n < params.size(); ++n) {
+            unbind(lam.args->elems[n]->name);
+            escapes.push_back(params[n].escapes);
+        }
+        return escapes;
+    }
+
+    /**
+       @param strict Whether `expr` is the scrutinee of a case without a
+                     binding alternative, so its value is only taken apart.
+    */
+    void walk(const std::shared_ptr<ast::expr>& expr, bool strict) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            bool recursive = static_cast<bool>(
+                std::dynamic_pointer_cast<ast::local_recursion>(expr));
+            std::vector<tracked_closure*> closures;
+            for (const auto& binding : *let->bindings) {
+                tracked_closure* closure = nullptr;
+                if (track_lets) {
+                    tracked_closure state;
+                    state.arity = binding->rhs->args->elems.size();
+                    state.known_arity = true;
+                    state.activation = activation;
+                    state.frame_base = frames.size();
+                    state.alt_depth = alt_depth;
+                    lets.emplace_back(binding.get(), state);
+                    closure = &lets.back().second;
+                }
+                closures.emplace_back(closure);
+            }
+
+            if (recursive) {
+                for (std::size_t n = 0; n < closures.size(); ++n) {
+                    bind(let->bindings->elems[n]->lhs->name, closures[n]);
+                }
+            }
+            for (const auto& binding : *let->bindings) {
+                walk(*binding->rhs);
+            }
+            if (!recursive) {
+                for (std::size_t n = 0; n < closures.size(); ++n) {
+                    bind(let->bindings->elems[n]->lhs->name, closures[n]);
+                }
+            }
+            walk(let->body, false);
+            for (const auto& binding : *let->bindings) {
+                unbind(binding->lhs->name);
+            }
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            bool takes_apart = true;
+            for (const auto& alt : *case_->alts) {
+                if (std::dynamic_pointer_cast<ast::binding_alt>(alt)) {
+                    takes_apart = false;
+                }
+            }
+            frames.emplace_back(case_.get(), alt_depth);
+            walk(case_->scrutinee, takes_apart);
+            frames.pop_back();
+
+            ++alt_depth;
+            for (const auto& alt : *case_->alts) {
+                auto bound = alt_binders(*alt);
+                for (const auto& name : bound) {
+                    bind(name);
+                }
+                walk(alt->body, false);
+                for (const auto& name : bound) {
+                    unbind(name);
+                }
+            }
+            --alt_depth;
+        }
+        else if (auto con = std::dynamic_pointer_cast<ast::construct>(expr)) {
+            store_atoms(*con->args);
+        }
+        else if (auto prim = std::dynamic_pointer_cast<ast::prim_apply>(expr)) {
+            // primops may store their arguments in mvars and arrays, or
+            // hand them to another thread
+            store_atoms(*prim->args);
+        }
+        else if (auto app = std::dynamic_pointer_cast<ast::apply>(expr)) {
+            walk_apply(*app, strict);
+        }
+    }
+};
+
+/**
+   The constructor a let bound thunk builds, and which binding of each of its
+   fields it refers to.
+*/
+struct known_constructor {
+    std::shared_ptr<ast::construct> con;
+    std::vector<std::size_t> field_ids;
+};
+
+/**
+   Substitute atoms for variables.
+*/
+struct substitution {
+    const std::unordered_map<std::string, std::shared_ptr<ast::atom>>& atoms;
+    compiler::scope scope;
+
+    /**
+       Names the substituted atoms refer to.
+    */
+    std::unordered_set<std::string> targets;
+
+    substitution(const std::unordered_map<std::string, std::shared_ptr<ast::atom>>& atoms)
+        : atoms(atoms) {
+        for (const auto& [name, atom] : atoms) {
+            if (auto var = std::dynamic_pointer_cast<ast::variable>(atom)) {
+                targets.insert(var->name);
+            }
+        }
+    }
+
+    const ast::atom* target(const std::string& name) {
+        auto it = atoms.find(name);
+        if (it == atoms.end() || scope.shadows(name)) {
+            return nullptr;
+        }
+        return it->second.get();
+    }
+
+    /**
+       Would substituting inside `expr` capture a variable or put a literal
+       in the head of an application?
+    */
+    bool conflicts(const std::shared_ptr<ast::expr>& expr) {
+        bool conflict = false;
+        visit(expr, [&](auto& var, bool head) {
+            const ast::atom* to = target(var->name);
+            if (!to) {
+                return;
+            }
+            auto replacement = dynamic_cast<const ast::variable*>(to);
+            if ((head && !replacement) ||
+                (replacement && scope.shadows(replacement->name))) {
+                conflict = true;
+            }
+        });
+        return conflict;
+    }
+
+    void apply(const std::shared_ptr<ast::expr>& expr) {
+        visit(expr, [&](auto& var, bool) {
+            if (const ast::atom* to = target(var->name)) {
+                auto replacement = dynamic_cast<const ast::variable*>(to);
+                var = std::make_shared<ast::variable>(var->loc, replacement->name);
+            }
+        }, true);
+    }
+
+    template<typename F>
+    void visit_atoms(ast::sequence<ast::atom>& args, F&& f, bool replace) {
+        for (auto& atom : args.elems) {
+            auto var = std::dynamic_pointer_cast<ast::variable>(atom);
+            if (!var) {
+                continue;
+            }
+            const ast::atom* to = target(var->name);
+            if (replace && to) {
+                atom = atoms.at(var->name);
+            }
+            else if (!replace) {
+                f(var, false);
+            }
+        }
+    }
+
+    template<typename F>
+    void visit(ast::lambda& lam, F&& f, bool replace) {
+        if (replace) {
+            // literals are not captured; freevars are recomputed afterwards
+            for (auto& var : lam.freevars->elems) {
+                const ast::atom* to = target(var->name);
+                if (auto replacement = dynamic_cast<const ast::variable*>(to)) {
+                    var = std::make_shared<ast::variable>(var->loc, replacement->name);
+                }
+            }
+        }
+        scope.walk_lambda(lam, [&] { visit(lam.body, f, replace); });
+    }
+
+    template<typename F>
+    void visit(const std::shared_ptr<ast::expr>& expr, F&& f, bool replace = false) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            scope.walk_let(*let,
+                           [&](ast::binding& binding) { visit(*binding.rhs, f, replace); },
+                           [&] { visit(let->body, f, replace); });
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            visit(case_->scrutinee, f, replace);
+            for (const auto& alt : *case_->alts) {
+                scope.walk_alt(*alt, [&] { visit(alt->body, f, replace); });
+            }
+        }
+        else if (auto con = std::dynamic_pointer_cast<ast::construct>(expr)) {
+            visit_atoms(*con->args, f, replace);
+        }
+        else if (auto app = std::dynamic_pointer_cast<ast::apply>(expr)) {
+            f(app->var, true);
+            visit_atoms(*app->args, f, replace);
+        }
+        else if (auto prim = std::dynamic_pointer_cast<ast::prim_apply>(expr)) {
+            visit_atoms(*prim->args, f, replace);
+        }
+    }
+};
+
+struct scalar_replacer {
+    /**
+       A unique id for each binding of each name in scope; names which are
+       not bound locally have id 0.
+    */
+    std::unordered_map<std::string, std::vector<std::size_t>> ids;
+    std::size_t next_id = 0;
+    std::unordered_map<std::size_t, known_constructor> known;
+
+    void bind(const std::string& name) {
+        ids[name].emplace_back(++next_id);
+    }
+
+    void unbind(const std::string& name) {
+        known.erase(ids[name].back());
+        ids[name].pop_back();
+    }
+
+    std::size_t id_of(const std::string& name) {
+        auto it = ids.find(name);
+        return (it == ids.end() || it->second.empty()) ? 0 : it->second.back();
+    }
+
+    void learn(const ast::binding& binding) {
+        const ast::lambda& lam = *binding.rhs;
+        auto con = std::dynamic_pointer_cast<ast::construct>(lam.body);
+        if (!is_thunk(lam) || !con) {
+            return;
+        }
+        known_constructor k{con, {}};
+        for (const auto& atom : con->args->elems) {
+            auto var = std::dynamic_pointer_cast<ast::variable>(atom);
+            k.field_ids.emplace_back(var ? id_of(var->name) : 0);
+        }
+        known[id_of(binding.lhs->name)] = std::move(k);
+    }
+
+    /**
+       @return The constructor `scrutinee` evaluates to, if it is known and
+               its fields still refer to the same bindings.
+    */
+    std::shared_ptr<ast::construct> known_value(const std::shared_ptr<ast::expr>& scrutinee) {
+        if (auto con = std::dynamic_pointer_cast<ast::construct>(scrutinee)) {
+            return con;
+        }
+        auto app = std::dynamic_pointer_cast<ast::apply>(scrutinee);
+        if (!app || app->args->elems.size()) {
+            return nullptr;
+        }
+        auto it = known.find(id_of(app->var->name));
+        if (it == known.end()) {
+            return nullptr;
+        }
+        const auto& args = it->second.con->args->elems;
+        for (std::size_t n = 0; n < args.size(); ++n) {
+            auto var = std::dynamic_pointer_cast<ast::variable>(args[n]);
+            if (var && id_of(var->name) != it->second.field_ids[n]) {
+                return nullptr;
+            }
+        }
+        return it->second.con;
+    }
+
+    /**
+       @return The body of the alternative `case_` takes for `con`, with the
+               pattern's variables substituted, or `nullptr`.
+    */
+    std::shared_ptr<ast::expr> select(const ast::case_& case_,
+                                      const ast::construct& con) {
+        std::unordered_map<std::string, std::shared_ptr<ast::atom>> atoms;
+        std::shared_ptr<ast::alternative> chosen;
+        for (const auto& alt : *case_.alts) {
+            if (auto a = std::dynamic_pointer_cast<ast::algebraic_alt>(alt)) {
+                if (a->con->name == con.con->name &&
+                    a->vars->elems.size() == con.args->elems.size()) {
+                    for (std::size_t n = 0; n < a->vars->elems.size(); ++n) {
+                        atoms[a->vars->elems[n]->name] = con.args->elems[n];
+                    }
+                    chosen = alt;
+                    break;
+                }
+            }
+            else if (auto b = std::dynamic_pointer_cast<ast::binding_alt>(alt)) {
+                // naming the value needs the value to exist, unless it is
+                // already a variable
+                auto app = std::dynamic_pointer_cast<ast::apply>(case_.scrutinee);
+                if (!app) {
+                    return nullptr;
+                }
+                atoms[b->var->name] = app->var;
+                chosen = alt;
+                break;
+            }
+            else if (std::dynamic_pointer_cast<ast::default_alt>(alt)) {
+                chosen = alt;
+                break;
+            }
+        }
+        if (!chosen) {
+            return nullptr;
+        }
+
+        substitution subst(atoms);
+        if (subst.conflicts(chosen->body)) {
+            return nullptr;
+        }
+        subst.apply(chosen->body);
+        return chosen->body;
+    }
+
+    void walk(ast::lambda& lam) {
+        for (const auto& arg : lam.args->elems) {
+            bind(arg->name);
+        }
+        walk(lam.body);
+        for (const auto& arg : lam.args->elems) {
+            unbind(arg->name);
+        }
+    }
+
+    void walk(std::shared_ptr<ast::expr>& expr) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            bool recursive = static_cast<bool>(
+                std::dynamic_pointer_cast<ast::local_recursion>(expr));
+            if (recursive) {
+                for (const auto& binding : *let->bindings) {
+                    bind(binding->lhs->name);
+                }
+            }
+            for (const auto& binding : *let->bindings) {
+                walk(*binding->rhs);
+            }
+            if (!recursive) {
+                for (const auto& binding : *let->bindings) {
+                    bind(binding->lhs->name);
+                }
+            }
+            for (const auto& binding : *let->bindings) {
+                learn(*binding);
+            }
+            walk(let->body);
+            for (const auto& binding : *let->bindings) {
+                unbind(binding->lhs->name);
+            }
+
+            if (recursive) {
+                return;
+            }
+            // drop the constructor thunks which were only taken apart
+            std::vector<std::shared_ptr<ast::binding>> live;
+            for (const auto& binding : *let->bindings) {
+                bool constructor = is_thunk(*binding->rhs) &&
+                    std::dynamic_pointer_cast<ast::construct>(binding->rhs->body);
+                if (!constructor ||
+                    expr_references(let->body, {binding->lhs->name}).size()) {
+                    live.emplace_back(binding);
+                }
+            }
+            if (live.empty()) {
+                expr = let->body;
+            }
+            else {
+                let->bindings->elems = std::move(live);
+            }
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            walk(case_->scrutinee);
+            if (auto con = known_value(case_->scrutinee)) {
+                if (auto body = select(*case_, *con)) {
+                    expr = body;
+                    walk(expr);
+                    return;
+                }
+            }
+            for (const auto& alt : *case_->alts) {
+                auto bound = alt_binders(*alt);
+                for (const auto& name : bound) {
+                    bind(name);
+                }
+                walk(alt->body);
+                for (const auto& name : bound) {
+                    unbind(name);
+                }
+            }
+        }
+    }
+};
+}
+
+stack_closures find_stack_closures(ast::sequence<ast::binding>& bindings) {
+    // start from nothing escaping and grow until nothing changes; each
+    // round can only add escaping parameters
+    escape_summaries functions;
+    for (const auto& binding : bindings) {
+        if (!is_thunk(*binding->rhs)) {
+            functions[binding->lhs->name].resize(binding->rhs->args->elems.size());
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& binding : bindings) {
+            if (is_thunk(*binding->rhs)) {
+                continue;
+            }
+            escape_walker walker(functions, false);
+            auto escapes = walker.summarize(*binding->rhs);
+            auto& summary = functions[binding->lhs->name];
+            if (escapes != summary) {
+                summary = std::move(escapes);
+                changed = true;
+            }
+        }
+    }
+
+    escape_walker walker(functions, true);
+    for (const auto& binding : bindings) {
+        walker.walk(*binding->rhs);
+    }
+
+    stack_closures result;
+    std::unordered_map<const ast::case_*, std::size_t> frame_words;
+    for (const auto& [binding, closure] : walker.lets) {
+        if (closure.escapes || closure.unframed || !closure.frame) {
+            continue;
+        }
+        std::size_t words = closure_words(*binding->rhs);
+        std::size_t& used = frame_words[closure.frame];
+        if (used + words <= max_frame_closure_words) {
+            used += words;
+            result[binding] = closure.frame;
+        }
+    }
+    return result;
+}
+
+void replace_scalars(ast::sequence<ast::binding>& bindings,
+                     const std::unordered_set<std::string>& externs) {
+    scalar_replacer replacer;
+    for (const auto& binding : bindings) {
+        replacer.walk(*binding->rhs);
+    }
+    compute_freevars(bindings, freevar_mode::overwrite, externs);
+}
+}
+}
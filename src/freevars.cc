@@ -0,0 +1,202 @@
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "gg/freevars.h"
+#include "gg/scoped_map.h"
+
+namespace gg {
+namespace compiler {
+namespace {
+/**
+   The free variables found so far for a lambda being walked.
+*/
+struct lambda_frame {
+    std::vector<std::string> order;
+    std::unordered_set<std::string> seen;
+
+    void add(const std::string& name) {
+        if (seen.insert(name).second) {
+            order.emplace_back(name);
+        }
+    }
+};
+
+struct freevar_walker {
+    freevar_mode mode;
+
+    /**
+       The lambda depth at which each name in scope was bound, innermost
+       last. Top level bindings are at depth 0.
+    */
+    std::unordered_map<std::string, std::vector<std::size_t>> depths;
+    std::vector<lambda_frame> lambdas;
+
+    freevar_walker(freevar_mode mode) : mode(mode) {}
+
+    void bind(const std::string& name) {
+        depths[name].emplace_back(lambdas.size());
+    }
+
+    void unbind(const std::string& name) {
+        depths[name].pop_back();
+    }
+
+    void use(const std::string& name) {
+        auto it = depths.find(name);
+        if (it == depths.end() || it->second.empty()) {
+            throw bad_name_lookup(name);
+        }
+        std::size_t depth = it->second.back();
+        if (depth && depth < lambdas.size()) {
+            lambdas.back().add(name);
+        }
+    }
+
+    void walk_atoms(const ast::sequence<ast::atom>& atoms) {
+        for (const auto& atom : atoms.elems) {
+            if (auto var = std::dynamic_pointer_cast<ast::variable>(atom)) {
+                use(var->name);
+            }
+        }
+    }
+
+    void walk(ast::lambda& lam) {
+        lambdas.emplace_back();
+        for (const auto& arg : lam.args->elems) {
+            bind(arg->name);
+        }
+        walk(lam.body);
+        for (const auto& arg : lam.args->elems) {
+            unbind(arg->name);
+        }
+        lambda_frame frame = std::move(lambdas.back());
+        lambdas.pop_back();
+
+        // whatever this lambda captures from outside of its parent, the
+        // parent must capture too
+        for (const auto& name : frame.order) {
+            std::size_t depth = depths[name].back();
+            if (depth && depth < lambdas.size()) {
+                lambdas.back().add(name);
+            }
+        }
+        finish(lam, frame);
+    }
+
+    void finish(ast::lambda& lam, const lambda_frame& frame) {
+        std::vector<std::shared_ptr<ast::variable>> result;
+        std::unordered_set<std::string> declared;
+        bool correct = true;
+        for (const auto& var : lam.freevars->elems) {
+            declared.insert(var->name);
+            if (frame.seen.count(var->name)) {
+                result.emplace_back(var);
+            }
+            else {
+                correct = false;
+            }
+        }
+        for (const auto& name : frame.order) {
+            if (!declared.count(name)) {
+                result.emplace_back(std::make_shared<ast::variable>(lam.loc, name));
+                correct = false;
+            }
+        }
+        if (correct) {
+            return;
+        }
+
+        if (mode == freevar_mode::check) {
+            std::stringstream ss;
+            ss << "lambda at " << lam.loc << " has free variables {";
+            for (std::size_t n = 0; n < result.size(); ++n) {
+                ss << (n ? ", " : "") << result[n]->name;
+            }
+            ss << "} but declares {";
+            for (std::size_t n = 0; n < lam.freevars->elems.size(); ++n) {
+                ss << (n ? ", " : "") << lam.freevars->elems[n]->name;
+            }
+            ss << '}';
+            throw bad_freevars(ss.str());
+        }
+        lam.freevars = std::make_shared<ast::sequence<ast::variable>>(
+            lam.freevars->loc,
+            result);
+    }
+
+    void walk(const std::shared_ptr<ast::expr>& expr) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            bool recursive = static_cast<bool>(
+                std::dynamic_pointer_cast<ast::local_recursion>(expr));
+            if (recursive) {
+                for (const auto& binding : *let->bindings) {
+                    bind(binding->lhs->name);
+                }
+            }
+            for (const auto& binding : *let->bindings) {
+                walk(*binding->rhs);
+            }
+            if (!recursive) {
+                for (const auto& binding : *let->bindings) {
+                    bind(binding->lhs->name);
+                }
+            }
+            walk(let->body);
+            for (const auto& binding : *let->bindings) {
+                unbind(binding->lhs->name);
+            }
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            walk(case_->scrutinee);
+            for (const auto& alt : *case_->alts) {
+                if (auto b = std::dynamic_pointer_cast<ast::binding_alt>(alt)) {
+                    bind(b->var->name);
+                    walk(alt->body);
+                    unbind(b->var->name);
+                }
+                else if (auto a = std::dynamic_pointer_cast<ast::algebraic_alt>(alt)) {
+                    for (const auto& var : a->vars->elems) {
+                        bind(var->name);
+                    }
+                    walk(alt->body);
+                    for (const auto& var : a->vars->elems) {
+                        unbind(var->name);
+                    }
+                }
+                else {
+                    walk(alt->body);
+                }
+            }
+        }
+        else if (auto con = std::dynamic_pointer_cast<ast::construct>(expr)) {
+            walk_atoms(*con->args);
+        }
+        else if (auto app = std::dynamic_pointer_cast<ast::apply>(expr)) {
+            use(app->var->name);
+            walk_atoms(*app->args);
+        }
+        else if (auto prim = std::dynamic_pointer_cast<ast::prim_apply>(expr)) {
+            walk_atoms(*prim->args);
+        }
+    }
+};
+}
+
+void compute_freevars(ast::sequence<ast::binding>& bindings,
+                      freevar_mode mode,
+                      const std::unordered_set<std::string>& externs) {
+    freevar_walker walker(mode);
+    for (const auto& name : externs) {
+        walker.bind(name);
+    }
+    for (const auto& binding : bindings) {
+        walker.bind(binding->lhs->name);
+    }
+    for (const auto& binding : bindings) {
+        walker.walk(*binding->rhs);
+    }
+}
+}
+}
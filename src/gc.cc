@@ -0,0 +1,1451 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "gg/array.h"
+#include "gg/gc.h"
+#include "gg/scheduler.h"
+#include "gg/stack.h"
+#include "gg/thunk.h"
+
+namespace gg {
+namespace runtime {
+/**
+   A block of the concurrently collected old generation, divided into slots
+   of one size. The header is followed by the slots.
+
+   A slot is in use from the collection which promotes into it until a
+   sweep finds it unmarked. Only the worker which owns a segment allocates
+   in it; the rest are on the list of partly free segments of their size
+   class, or full.
+*/
+struct segment {
+    std::size_t size_class;
+    std::size_t slot_words;
+    std::size_t slots;
+    std::size_t used_slots;
+
+    /**
+       No slot before this one is free.
+    */
+    std::size_t next_free;
+
+    /**
+       The marking cycle this segment was last swept for.
+    */
+    std::size_t swept_cycle;
+
+    bool owned;
+    bool listed;
+
+    static constexpr std::size_t min_slot_words = 2;
+    static constexpr std::size_t bitmap_words =
+        max_block_object_words / min_slot_words / 64 + 1;
+
+    std::uint64_t used[bitmap_words];
+    std::uint64_t marked[bitmap_words];
+};
+
+/**
+   The marks of an old block being compacted: a bit for every live word,
+   and one for the first word of each live closure.
+*/
+struct compaction_block {
+    static constexpr std::size_t bitmap_words = max_block_object_words / 64 + 1;
+
+    std::uint64_t live[bitmap_words];
+    std::uint64_t starts[bitmap_words];
+
+    /**
+       The number of live words before each word of `live`.
+    */
+    std::uint32_t before[bitmap_words];
+
+    /**
+       Where the first live word of the block moves to.
+    */
+    word* destination;
+};
+
+namespace {
+constexpr std::size_t segment_header_words =
+    (sizeof(segment) + sizeof(word) - 1) / sizeof(word);
+
+/**
+   The slot sizes, each about a quarter bigger than the last, up to the
+   largest slot which fits in a segment. Promoting a closure rounds it up to
+   the next size.
+*/
+const std::vector<std::size_t>& size_classes() {
+    static const std::vector<std::size_t> sizes = [] {
+        std::vector<std::size_t> sizes;
+        std::size_t largest = max_block_object_words - segment_header_words;
+        for (std::size_t words = segment::min_slot_words; words < largest;
+             words += std::max<std::size_t>(words / 4, 1)) {
+            sizes.emplace_back(words);
+        }
+        sizes.emplace_back(largest);
+        return sizes;
+    }();
+    return sizes;
+}
+
+inline segment* segment_of(const void* p) {
+    return reinterpret_cast<segment*>(block_start(block_of(p)));
+}
+
+inline word* slot_address(segment* s, std::size_t n) {
+    return reinterpret_cast<word*>(s) + segment_header_words + n * s->slot_words;
+}
+
+inline std::size_t slot_index(segment* s, const void* p) {
+    return (reinterpret_cast<const word*>(p) - slot_address(s, 0)) / s->slot_words;
+}
+
+inline bool test_bit(const std::uint64_t* bitmap, std::size_t n) {
+    return bitmap[n / 64] & (std::uint64_t(1) << (n % 64));
+}
+
+inline void set_bit(std::uint64_t* bitmap, std::size_t n) {
+    bitmap[n / 64] |= std::uint64_t(1) << (n % 64);
+}
+
+inline void clear_bit(std::uint64_t* bitmap, std::size_t n) {
+    bitmap[n / 64] &= ~(std::uint64_t(1) << (n % 64));
+}
+
+/**
+   @return The first free slot at or after `next_free`, or `slots` if the
+           segment is full.
+*/
+std::size_t find_free_slot(segment* s) {
+    for (std::size_t n = s->next_free; n < s->slots;) {
+        std::uint64_t free = ~s->used[n / 64] >> (n % 64);
+        if (free) {
+            return std::min(n + __builtin_ctzll(free), s->slots);
+        }
+        n = (n / 64 + 1) * 64;
+    }
+    return s->slots;
+}
+
+inline closure* load_field(const word* field) {
+    return reinterpret_cast<closure*>(__atomic_load_n(field, __ATOMIC_RELAXED));
+}
+
+/**
+   The worker running on this OS thread during a collection, for
+   `gg_evacuate` and `gg_copy`.
+*/
+thread_local gc_worker* current_worker = nullptr;
+
+inline bool is_forwarded(const info_table* info) {
+    return reinterpret_cast<word>(info) & 1;
+}
+
+inline closure* forwardee(const info_table* info) {
+    return reinterpret_cast<closure*>(reinterpret_cast<word>(info) & ~word(1));
+}
+
+inline const info_table* forwarding(closure* to) {
+    return reinterpret_cast<const info_table*>(reinterpret_cast<word>(to) | 1);
+}
+
+inline const info_table* load_header(const closure* c) {
+    return __atomic_load_n(&c->info, __ATOMIC_ACQUIRE);
+}
+
+/**
+   Replace a header with a forwarding pointer, unless another worker got
+   there first.
+
+   @param c    The closure.
+   @param info The header the caller read; on failure, the forwarding
+               pointer the winner left.
+   @return     Whether this worker claimed the closure.
+*/
+inline bool claim(closure* c, const info_table*& info, closure* to) {
+    return __atomic_compare_exchange_n(&c->info,
+                                       &info,
+                                       forwarding(to),
+                                       false,
+                                       __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE);
+}
+
+std::size_t used_words(block* b) {
+    return b->free - block_start(b);
+}
+
+/**
+   However the measurements come out, the old generation may grow by at
+   least a nursery's worth per capability and by at most this many times
+   what is live.
+*/
+constexpr double max_old_gen_growth = 8;
+
+/**
+   The most selector thunks a worker replaces within one another, and the
+   most indirections it follows to find a selectee. Past these the thunk is
+   copied, which also breaks up cycles of selectors.
+*/
+constexpr std::size_t max_selector_depth = 16;
+}
+
+collector::collector(scheduler& sched, heap& memory, const config& options)
+    : memory(memory),
+      options(options),
+      major_threshold(options.old_gen_min_words),
+      sched(sched),
+      partial_segments(size_classes().size()),
+      last_major_end(std::chrono::steady_clock::now()) {
+    std::size_t nworkers = std::max<std::size_t>(options.gc_threads, 1);
+    for (std::size_t n = 0; n < nworkers; ++n) {
+        workers.emplace_back(std::make_unique<gc_worker>(*this));
+        workers.back()->segments.resize(size_classes().size());
+    }
+}
+
+collector::~collector() {
+    {
+        std::lock_guard<std::mutex> guard(helpers_lock);
+        stopping = true;
+    }
+    helpers_wake.notify_all();
+    for (std::thread& t : helpers) {
+        t.join();
+    }
+    {
+        std::lock_guard<std::mutex> guard(nonmoving_lock);
+        marker_stopping = true;
+    }
+    marker_wake.notify_all();
+    if (marker.joinable()) {
+        marker.join();
+    }
+
+    for (const caf& entry : cafs) {
+        entry.c->payload[thunk_result_slot] = 0;
+        entry.c->info = entry.info;
+    }
+    for (block* b = old_head; b;) {
+        block* next = b->link;
+        memory.free_block(b);
+        b = next;
+    }
+    for (segment* s : segments) {
+        memory.free_block(block_of(s));
+    }
+    for (block* head : {young_large, old_large}) {
+        for (block* b = head; b;) {
+            block* next = b->link;
+            memory.free_group(b);
+            b = next;
+        }
+    }
+}
+
+bool collector::concurrent() const {
+    return options.old_gen_mode == old_gen_collection::concurrent;
+}
+
+word* collector::allocate(gc_worker& w, std::size_t words) {
+    if (concurrent()) {
+        return allocate_in_segment(w, words);
+    }
+    if (!w.current || w.current->free + words > w.current->limit) {
+        block* b = memory.allocate_block(to_space_block);
+        b->link = w.to_head;
+        w.to_head = b;
+        w.current = b;
+    }
+
+    word* p = w.current->free;
+    w.current->free += words;
+    return p;
+}
+
+void collector::retract(gc_worker& w, word* p, std::size_t words) {
+    if (!concurrent()) {
+        w.current->free -= words;
+        return;
+    }
+    block* b = block_of(p);
+    if (b->flags & large_block) {
+        // too rare to be worth unlinking; the next sweep frees it, as
+        // nothing points to it
+        return;
+    }
+    segment* s = segment_of(p);
+    std::size_t n = slot_index(s, p);
+    clear_bit(s->used, n);
+    clear_bit(s->marked, n);
+    --s->used_slots;
+    s->next_free = std::min(s->next_free, n);
+    segment_words.fetch_sub(s->slot_words, std::memory_order_relaxed);
+}
+
+segment* collector::take_segment(std::size_t size_class) {
+    std::lock_guard<spinlock> guard(segments_lock);
+    std::vector<segment*>& partial = partial_segments[size_class];
+    if (partial.size()) {
+        segment* s = partial.back();
+        partial.pop_back();
+        s->listed = false;
+        s->owned = true;
+        return s;
+    }
+
+    block* b = memory.allocate_block(segment_block);
+    b->free = b->limit;
+    auto s = new (block_start(b)) segment();
+    s->size_class = size_class;
+    s->slot_words = size_classes()[size_class];
+    s->slots = std::min((max_block_object_words - segment_header_words) / s->slot_words,
+                        segment::bitmap_words * 64);
+    // a segment made while marking is swept at the end of this cycle, so
+    // that its slots are unmarked again
+    s->swept_cycle = phase == mark_phase::marking ? cycle - 1 : cycle;
+    s->owned = true;
+    segments.emplace_back(s);
+    return s;
+}
+
+word* collector::allocate_in_segment(gc_worker& w, std::size_t words) {
+    const std::vector<std::size_t>& sizes = size_classes();
+    if (words > sizes.back()) {
+        // promote to a group of its own rather than give up a segment to it
+        block* b = memory.allocate_group(words, promoted_large_flags);
+        b->free += words;
+        std::lock_guard<std::mutex> guard(large_lock);
+        b->link = old_large;
+        old_large = b;
+        old_large_words += words;
+        return block_start(b);
+    }
+
+    std::size_t size_class = std::lower_bound(sizes.begin(), sizes.end(), words) -
+                             sizes.begin();
+    segment*& s = w.segments[size_class];
+    std::size_t n = s ? find_free_slot(s) : 0;
+    while (!s || n == s->slots) {
+        if (s) {
+            s->owned = false;
+        }
+        s = take_segment(size_class);
+        s->next_free = 0;
+        n = find_free_slot(s);
+    }
+
+    set_bit(s->used, n);
+    // a closure promoted during a cycle is marked by the cycle, unless its
+    // segment has already been swept
+    if (phase == mark_phase::marking ||
+        (phase == mark_phase::sweeping && s->swept_cycle != cycle)) {
+        set_bit(s->marked, n);
+    }
+    ++s->used_slots;
+    s->next_free = n + 1;
+    segment_words.fetch_add(s->slot_words, std::memory_order_relaxed);
+    return slot_address(s, n);
+}
+
+void collector::push_grey(gc_worker& w, closure* c) {
+    std::lock_guard<spinlock> guard(w.grey_lock);
+    w.grey.push_back(c);
+    w.queued.fetch_add(1, std::memory_order_release);
+}
+
+bool collector::take_work(gc_worker& w, closure*& c, bool& is_static) {
+    is_static = false;
+    {
+        // newest first from our own queue, which is likely still in cache
+        std::lock_guard<spinlock> guard(w.grey_lock);
+        if (w.grey.size()) {
+            c = w.grey.back();
+            w.grey.pop_back();
+            w.queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    if (statics_queued.load(std::memory_order_acquire)) {
+        std::lock_guard<spinlock> guard(statics_lock);
+        if (pending_statics.size()) {
+            c = pending_statics.back();
+            pending_statics.pop_back();
+            statics_queued.fetch_sub(1, std::memory_order_relaxed);
+            is_static = true;
+            return true;
+        }
+    }
+    for (const auto& victim : workers) {
+        if (victim.get() == &w || !victim->queued.load(std::memory_order_acquire)) {
+            continue;
+        }
+        // oldest first from another queue, which is likely to lead to the
+        // most work
+        std::lock_guard<spinlock> guard(victim->grey_lock);
+        if (victim->grey.size()) {
+            c = victim->grey.front();
+            victim->grey.pop_front();
+            victim->queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool collector::work_visible() {
+    if (statics_queued.load(std::memory_order_acquire)) {
+        return true;
+    }
+    for (const auto& w : workers) {
+        if (w->queued.load(std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+closure* collector::allocate_large(std::size_t words) {
+    // young until its first collection, so that writes to it need no
+    // barrier
+    block* b = memory.allocate_group(words, nursery_block | large_block);
+    b->free += words;
+
+    std::lock_guard<std::mutex> guard(large_lock);
+    b->link = young_large;
+    young_large = b;
+    young_large_words += words;
+    return reinterpret_cast<closure*>(block_start(b));
+}
+
+std::size_t collector::young_large_object_words() {
+    std::lock_guard<std::mutex> guard(large_lock);
+    return young_large_words;
+}
+
+closure* collector::copy(closure* c, std::size_t words) {
+    gc_worker& w = *current_worker;
+    const info_table* info = load_header(c);
+    if (is_forwarded(info)) {
+        return forwardee(info);
+    }
+
+    // claim the closure before copying it, so that a worker which loses
+    // the race only has to give back the space
+    auto to = reinterpret_cast<closure*>(allocate(w, words));
+    if (!claim(c, info, to)) {
+        retract(w, reinterpret_cast<word*>(to), words);
+        return forwardee(info);
+    }
+    std::memcpy(to->payload, c->payload, (words - 1) * sizeof(word));
+    to->info = info;
+    w.copied_words += words;
+    push_grey(w, to);
+    return to;
+}
+
+closure* collector::evacuate(closure* c) {
+    if (compaction != compact_phase::none) {
+        return compact_evacuate(c);
+    }
+    if (!memory.contains(c)) {
+        if (major && c) {
+            visit_static(c);
+        }
+        return c;
+    }
+    block* b = block_of(c);
+    unsigned flags = __atomic_load_n(&b->flags, __ATOMIC_ACQUIRE);
+    if (!(flags & from_space_block)) {
+        // an old thunk updated since the last major collection; closures
+        // this collection is copying may not have their header yet
+        if (!(flags & (large_block | segment_block | to_space_block)) &&
+            load_header(c) == &indirection_info) {
+            return evacuate(reinterpret_cast<closure*>(c->payload[thunk_result_slot]));
+        }
+        return c;
+    }
+    if (flags & large_block) {
+        // keep the object where it is; it is old from now on
+        if (__atomic_compare_exchange_n(&b->flags,
+                                        &flags,
+                                        promoted_large_flags,
+                                        false,
+                                        __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE)) {
+            push_grey(*current_worker, c);
+        }
+        return c;
+    }
+    const info_table* info = load_header(c);
+    if (is_forwarded(info)) {
+        return forwardee(info);
+    }
+    if (info == &indirection_info) {
+        // nothing needs the indirection itself, only its value
+        closure* value = evacuate(
+            reinterpret_cast<closure*>(c->payload[thunk_result_slot]));
+        if (!claim(c, info, value)) {
+            // an update frame copied the indirection itself
+            return forwardee(info);
+        }
+        return value;
+    }
+    if (is_selector_thunk(info)) {
+        gc_worker& w = *current_worker;
+        closure* field = w.selector_depth < max_selector_depth ? selected_field(c, info)
+                                                               : nullptr;
+        if (field) {
+            ++w.selector_depth;
+            closure* value = evacuate(field);
+            --w.selector_depth;
+            if (!claim(c, info, value)) {
+                return forwardee(info);
+            }
+            return value;
+        }
+    }
+    if (closure* shared = shared_closure(c, info)) {
+        // a value is as good as the static closure with the same value
+        if (!claim(c, info, shared)) {
+            return forwardee(info);
+        }
+        return shared;
+    }
+    return copy_closure(c);
+}
+
+closure* collector::selected_field(closure* c, const info_table* info) {
+    std::size_t slot = selector_slot(info);
+    auto selectee = reinterpret_cast<closure*>(c->payload[selectee_slot]);
+    for (std::size_t n = 0; n < max_selector_depth; ++n) {
+        if (memory.contains(selectee) &&
+            (__atomic_load_n(&block_of(selectee)->flags, __ATOMIC_ACQUIRE) &
+             (to_space_block | segment_block))) {
+            // it may be a copy which does not have its header yet
+            return nullptr;
+        }
+        const info_table* selectee_info = load_header(selectee);
+        if (is_forwarded(selectee_info)) {
+            return nullptr;
+        }
+        if (selectee_info == &indirection_info) {
+            selectee = reinterpret_cast<closure*>(selectee->payload[thunk_result_slot]);
+            continue;
+        }
+        if (!closure_tag(selectee_info) || slot >= closure_pointers(selectee_info)) {
+            return nullptr;
+        }
+        return reinterpret_cast<closure*>(selectee->payload[slot]);
+    }
+    return nullptr;
+}
+
+closure* collector::evacuate_updatee(closure* c) {
+    if (compaction != compact_phase::none) {
+        return compact_evacuate(c);
+    }
+    if (!memory.contains(c)) {
+        // a CAF under evaluation must not be reverted
+        if (major) {
+            visit_static(c);
+        }
+        return c;
+    }
+    if (!(__atomic_load_n(&block_of(c)->flags, __ATOMIC_ACQUIRE) & from_space_block)) {
+        return c;
+    }
+    return copy_closure(c);
+}
+
+closure* collector::copy_closure(closure* c) {
+    const info_table* info = load_header(c);
+    if (is_forwarded(info)) {
+        return forwardee(info);
+    }
+    if (info->evacuation_code) {
+        return info->evacuation_code(c);
+    }
+    return copy(c, closure_size(info));
+}
+
+std::size_t collector::scavenge(closure* c) {
+    const info_table* info = c->info;
+    if (info->scavenge_code) {
+        return info->scavenge_code(c);
+    }
+    std::size_t pointers = closure_pointers(info);
+    for (std::size_t n = 0; n < pointers; ++n) {
+        c->payload[n] = reinterpret_cast<word>(
+            evacuate(reinterpret_cast<closure*>(c->payload[n])));
+    }
+    return 1 + pointers + closure_raw_words(info);
+}
+
+void collector::flip(block* head, unsigned flags) {
+    for (block* b = head; b; b = b->link) {
+        b->flags = flags | from_space_block;
+    }
+}
+
+void collector::visit_static(closure* c) {
+    if (!current_worker->visited_statics.insert(c).second) {
+        return;
+    }
+    std::lock_guard<spinlock> guard(statics_lock);
+    if (visited_statics.insert(c).second) {
+        pending_statics.emplace_back(c);
+        statics_queued.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void collector::visit_srt(const info_table* info) {
+    if (info->srt) {
+        for (closure* const* p = info->srt; *p; ++p) {
+            visit_static(*p);
+        }
+    }
+}
+
+void collector::scavenge_static(closure* c) {
+    if (c->info == &indirection_info) {
+        // an evaluated CAF
+        c->payload[thunk_result_slot] = reinterpret_cast<word>(
+            evacuate(reinterpret_cast<closure*>(c->payload[thunk_result_slot])));
+    }
+    else {
+        visit_srt(c->info);
+    }
+}
+
+void collector::scavenge_grey(closure* c) {
+    if (major) {
+        visit_srt(c->info);
+    }
+    scavenge(c);
+}
+
+void collector::scavenge_cafs() {
+    std::lock_guard<std::mutex> guard(caf_lock);
+    for (const caf& entry : cafs) {
+        closure* c = entry.c;
+        if (c->info == &indirection_info) {
+            c->payload[thunk_result_slot] = reinterpret_cast<word>(
+                evacuate(reinterpret_cast<closure*>(
+                    c->payload[thunk_result_slot])));
+        }
+    }
+}
+
+void collector::revert_unreachable_cafs() {
+    std::lock_guard<std::mutex> guard(caf_lock);
+    std::vector<caf> live;
+    std::unordered_set<closure*> seen;
+    for (const caf& entry : cafs) {
+        if (!visited_statics.count(entry.c)) {
+            // nothing can enter the CAF again, but reverting it rather than
+            // leaving it dangling is always safe
+            entry.c->payload[thunk_result_slot] = 0;
+            entry.c->info = entry.info;
+        }
+        else if (seen.insert(entry.c).second) {
+            live.emplace_back(entry);
+        }
+    }
+    cafs = std::move(live);
+}
+
+void collector::add_caf(closure* c, const info_table* info) {
+    std::lock_guard<std::mutex> guard(caf_lock);
+    cafs.push_back({c, info});
+}
+
+void collector::scavenge_thread(thread& t) {
+    t.saved.node = evacuate(t.saved.node);
+    t.blocked_value = evacuate(t.blocked_value);
+    t.delivered = evacuate(t.delivered);
+
+    for (word* frame = t.saved.su; frame; frame = reinterpret_cast<word*>(frame[2])) {
+        frame[1] = reinterpret_cast<word>(
+            evacuate_updatee(reinterpret_cast<closure*>(frame[1])));
+    }
+    if (major) {
+        for_each_frame(t.saved, [this](const info_table* info, word*) {
+            visit_srt(info);
+        });
+    }
+    for_each_stack_pointer(t.saved, [this](closure** p) {
+        *p = evacuate(*p);
+    });
+}
+
+void collector::sweep_large() {
+    // a minor collection keeps every old large object
+    block* live = major ? nullptr : old_large;
+    std::size_t live_words = major ? 0 : old_large_words;
+    auto sweep = [&](block* head) {
+        for (block* b = head; b;) {
+            block* next = b->link;
+            if (b->flags & from_space_block) {
+                memory.free_group(b);
+            }
+            else {
+                b->link = live;
+                live = b;
+                live_words += used_words(b);
+            }
+            b = next;
+        }
+    };
+    sweep(young_large);
+    if (major) {
+        sweep(old_large);
+    }
+
+    old_large = live;
+    old_large_words = live_words;
+    young_large = nullptr;
+    young_large_words = 0;
+}
+
+void collector::work(gc_worker& w) {
+    current_worker = &w;
+    for (std::size_t n; (n = next_root.fetch_add(1)) < roots.size();) {
+        roots[n]();
+    }
+
+    closure* c;
+    bool is_static;
+    while (true) {
+        if (take_work(w, c, is_static)) {
+            if (is_static) {
+                scavenge_static(c);
+            }
+            else {
+                scavenge_grey(c);
+            }
+            continue;
+        }
+
+        // a worker only counts as idle while it holds no work, so once
+        // every worker is idle nothing can make more
+        idle_workers.fetch_add(1);
+        while (idle_workers.load() != workers.size() && !work_visible()) {
+            std::this_thread::yield();
+        }
+        if (idle_workers.load() == workers.size()) {
+            break;
+        }
+        idle_workers.fetch_sub(1);
+    }
+    current_worker = nullptr;
+}
+
+void collector::helper(gc_worker& w, std::size_t seen) {
+    std::unique_lock<std::mutex> guard(helpers_lock);
+    while (true) {
+        helpers_wake.wait(guard, [&] { return stopping || collections != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = collections;
+        guard.unlock();
+        work(w);
+        guard.lock();
+        ++helpers_done;
+        helpers_finished.notify_all();
+    }
+}
+
+closure* collector::compact_evacuate(closure* c) {
+    if (!memory.contains(c)) {
+        if (c && compaction == compact_phase::marking) {
+            visit_static(c);
+        }
+        return c;
+    }
+    if (compaction == compact_phase::forwarding) {
+        return forward(c);
+    }
+
+    block* b = block_of(c);
+    if (b->flags & large_block) {
+        if (b->flags & marked_block) {
+            return c;
+        }
+        b->flags |= marked_block;
+    }
+    else {
+        compaction_block* marks = compaction_blocks.at(b);
+        std::size_t n = reinterpret_cast<word*>(c) - block_start(b);
+        if (test_bit(marks->starts, n)) {
+            return c;
+        }
+        set_bit(marks->starts, n);
+    }
+    push_grey(*current_worker, c);
+    return c;
+}
+
+closure* collector::forward(closure* c) {
+    block* b = block_of(c);
+    if (b->flags & large_block) {
+        return c;
+    }
+    compaction_block* marks = compaction_blocks.at(b);
+    std::size_t n = reinterpret_cast<word*>(c) - block_start(b);
+    std::uint64_t below = marks->live[n / 64] & ((std::uint64_t(1) << (n % 64)) - 1);
+    return reinterpret_cast<closure*>(marks->destination + marks->before[n / 64] +
+                                      __builtin_popcountll(below));
+}
+
+void collector::compact(const std::unordered_set<thread*>& threads) {
+    std::vector<block*> blocks;
+    for (block* b = old_head; b; b = b->link) {
+        blocks.emplace_back(b);
+    }
+    std::vector<compaction_block> marks(blocks.size());
+    for (std::size_t n = 0; n < blocks.size(); ++n) {
+        compaction_blocks.emplace(blocks[n], &marks[n]);
+    }
+    gc_worker& w = *workers[0];
+    current_worker = &w;
+
+    // mark from the threads, and from the CAFs their static reference
+    // tables reach, as a major collection would copy
+    major = true;
+    compaction = compact_phase::marking;
+    for (thread* t : threads) {
+        scavenge_thread(*t);
+    }
+    closure* c;
+    bool is_static;
+    while (take_work(w, c, is_static)) {
+        if (is_static) {
+            scavenge_static(c);
+            continue;
+        }
+        visit_srt(c->info);
+        std::size_t words = scavenge(c);
+        block* b = block_of(c);
+        if (!(b->flags & large_block)) {
+            std::size_t start = reinterpret_cast<word*>(c) - block_start(b);
+            for (std::size_t n = start; n < start + words; ++n) {
+                set_bit(compaction_blocks.at(b)->live, n);
+            }
+        }
+    }
+    major = false;
+    revert_unreachable_cafs();
+    visited_statics.clear();
+    for (const auto& worker : workers) {
+        worker->visited_statics.clear();
+    }
+    sweep_old_large();
+
+    // slide the live words of each block down to the first place they
+    // fit whole, so that no closure straddles two blocks
+    std::vector<word*> ends(blocks.size(), nullptr);
+    std::size_t next = 0;
+    word* free = blocks.size() ? block_start(blocks[0]) : nullptr;
+    for (compaction_block& block_marks : marks) {
+        std::uint32_t live = 0;
+        for (std::size_t n = 0; n < compaction_block::bitmap_words; ++n) {
+            block_marks.before[n] = live;
+            live += __builtin_popcountll(block_marks.live[n]);
+        }
+        if (!live) {
+            continue;
+        }
+        if (free + live > blocks[next]->limit) {
+            free = block_start(blocks[++next]);
+        }
+        block_marks.destination = free;
+        free += live;
+        ends[next] = free;
+    }
+
+    compaction = compact_phase::forwarding;
+    for (thread* t : threads) {
+        scavenge_thread(*t);
+    }
+    scavenge_cafs();
+    for (std::size_t n = 0; n < blocks.size(); ++n) {
+        for (std::size_t k = 0; k < compaction_block::bitmap_words; ++k) {
+            for (std::uint64_t bits = marks[n].starts[k]; bits; bits &= bits - 1) {
+                scavenge(reinterpret_cast<closure*>(
+                    block_start(blocks[n]) + k * 64 + __builtin_ctzll(bits)));
+            }
+        }
+    }
+    for (block* b = old_large; b; b = b->link) {
+        scavenge(reinterpret_cast<closure*>(block_start(b)));
+    }
+
+    // every closure moves down, or into an earlier block which has already
+    // been moved out of, so nothing is overwritten before it moves
+    for (std::size_t n = 0; n < blocks.size(); ++n) {
+        word* to = marks[n].destination;
+        for (std::size_t k = 0; k < compaction_block::bitmap_words; ++k) {
+            std::uint64_t bits = marks[n].live[k];
+            while (bits) {
+                std::size_t first = __builtin_ctzll(bits);
+                std::uint64_t run = bits >> first;
+                std::size_t length = ~run ? __builtin_ctzll(~run) : 64 - first;
+                word* from = block_start(blocks[n]) + k * 64 + first;
+                if (from != to) {
+                    // a run moves as a whole, as nothing in it is dead
+                    std::memmove(to, from, length * sizeof(word));
+                    stats.copied_bytes += length * sizeof(word);
+                }
+                to += length;
+                bits &= length + first < 64 ? ~std::uint64_t(0) << (length + first) : 0;
+            }
+        }
+    }
+
+    block** tail = &old_head;
+    for (std::size_t n = 0; n < blocks.size(); ++n) {
+        if (ends[n]) {
+            blocks[n]->free = ends[n];
+            *tail = blocks[n];
+            tail = &blocks[n]->link;
+        }
+        else {
+            memory.free_block(blocks[n]);
+        }
+    }
+    *tail = nullptr;
+
+    compaction = compact_phase::none;
+    compaction_blocks.clear();
+    current_worker = nullptr;
+    for (const auto& worker : workers) {
+        worker->current = nullptr;
+    }
+}
+
+void collector::mark(closure* c) {
+    if (!memory.contains(c)) {
+        return;
+    }
+    block* b = block_of(c);
+    unsigned flags = __atomic_load_n(&b->flags, __ATOMIC_RELAXED);
+    if (flags & segment_block) {
+        segment* s = segment_of(c);
+        std::size_t n = slot_index(s, c);
+        if (test_bit(s->marked, n)) {
+            return;
+        }
+        set_bit(s->marked, n);
+    }
+    else if ((flags & large_block) && !(flags & nursery_block)) {
+        if (flags & marked_block) {
+            return;
+        }
+        __atomic_store_n(&b->flags, flags | marked_block, __ATOMIC_RELAXED);
+    }
+    else {
+        // young closures are marked when they are promoted
+        return;
+    }
+    mark_stack.emplace_back(c);
+}
+
+void collector::mark_fields(closure* c) {
+    // the mutator may be writing to the closure; a field read here holds
+    // either the old pointer or one the mutator could already reach
+    const info_table* info = load_header(c);
+    if (info == &array_info || info == &mutable_array_info) {
+        auto a = reinterpret_cast<array*>(c);
+        for (std::size_t n = 0; n < a->size; ++n) {
+            mark(load_field(reinterpret_cast<word*>(&a->elems[n])));
+        }
+        return;
+    }
+    if (info->scavenge_code) {
+        // every other closure with scavenge code of its own is raw
+        return;
+    }
+    std::size_t pointers = closure_pointers(info);
+    for (std::size_t n = 0; n < pointers; ++n) {
+        mark(load_field(&c->payload[n]));
+    }
+}
+
+void collector::start_marking(const std::unordered_set<thread*>& threads) {
+    ++cycle;
+    phase = mark_phase::marking;
+    marking.store(true, std::memory_order_relaxed);
+    large_swept = false;
+
+    for (thread* t : threads) {
+        mark(t->saved.node);
+        mark(t->blocked_value);
+        mark(t->delivered);
+        for_each_stack_pointer(t->saved, [this](closure** p) { mark(*p); });
+    }
+    {
+        std::lock_guard<std::mutex> guard(caf_lock);
+        for (const caf& entry : cafs) {
+            if (entry.c->info == &indirection_info) {
+                mark(reinterpret_cast<closure*>(entry.c->payload[thunk_result_slot]));
+            }
+        }
+    }
+
+    if (!marker.joinable()) {
+        marker = std::thread([this] { mark_and_sweep(); });
+    }
+}
+
+void collector::drain_snapshot_logs(
+    const std::vector<std::unique_ptr<capability>>& capabilities) {
+    for (const auto& cap : capabilities) {
+        for (closure* c : cap->snapshot_log) {
+            mark(c);
+        }
+        cap->snapshot_log.clear();
+    }
+}
+
+void collector::sweep_segment(segment* s) {
+    std::size_t used = 0;
+    for (std::size_t n = 0; n < segment::bitmap_words; ++n) {
+        s->used[n] &= s->marked[n];
+        s->marked[n] = 0;
+        used += __builtin_popcountll(s->used[n]);
+    }
+    segment_words.fetch_sub((s->used_slots - used) * s->slot_words,
+                            std::memory_order_relaxed);
+    s->used_slots = used;
+    s->next_free = 0;
+    s->swept_cycle = cycle;
+}
+
+void collector::sweep_old_large() {
+    block* live = nullptr;
+    std::size_t live_words = 0;
+    for (block* b = old_large; b;) {
+        block* next = b->link;
+        if (b->flags & marked_block) {
+            b->flags &= ~marked_block;
+            b->link = live;
+            live = b;
+            live_words += used_words(b);
+        }
+        else {
+            memory.free_group(b);
+        }
+        b = next;
+    }
+    old_large = live;
+    old_large_words = live_words;
+}
+
+void collector::mark_slice(std::chrono::steady_clock::time_point deadline) {
+    for (std::size_t n = 0; mark_stack.size(); ++n) {
+        if (pause_requested.load(std::memory_order_relaxed) ||
+            (n % 64 == 63 && std::chrono::steady_clock::now() >= deadline)) {
+            return;
+        }
+        closure* c = mark_stack.back();
+        mark_stack.pop_back();
+        mark_fields(c);
+    }
+}
+
+void collector::sweep_slice(std::chrono::steady_clock::time_point deadline) {
+    if (!large_swept) {
+        sweep_old_large();
+        large_swept = true;
+    }
+    while (sweep_position < segments.size()) {
+        if (pause_requested.load(std::memory_order_relaxed) ||
+            std::chrono::steady_clock::now() >= deadline) {
+            return;
+        }
+        segment* s = segments[sweep_position];
+        if (s->swept_cycle == cycle) {
+            ++sweep_position;
+            continue;
+        }
+        sweep_segment(s);
+        if (!s->used_slots && !s->owned) {
+            if (s->listed) {
+                std::vector<segment*>& partial = partial_segments[s->size_class];
+                partial.erase(std::find(partial.begin(), partial.end(), s));
+            }
+            segments[sweep_position] = segments.back();
+            segments.pop_back();
+            memory.free_block(block_of(s));
+            continue;
+        }
+        if (!s->owned && !s->listed && s->used_slots < s->slots) {
+            partial_segments[s->size_class].emplace_back(s);
+            s->listed = true;
+        }
+        ++sweep_position;
+    }
+
+    phase = mark_phase::idle;
+    cycle_finished = true;
+    cycle_live_words = segment_words.load(std::memory_order_relaxed) + old_large_words;
+    cycle_ended = std::chrono::steady_clock::now();
+}
+
+void collector::resize_old_generation(std::size_t before,
+                                      std::size_t live,
+                                      std::chrono::steady_clock::time_point began,
+                                      std::chrono::steady_clock::time_point ended) {
+    using seconds = std::chrono::duration<double>;
+    double target = std::min(std::max(options.gc_time_target, 1e-3), 0.999);
+    double cost = seconds(ended - began).count();
+    double mutator =
+        seconds(began - last_major_end - (stats.minor_gc_time - last_minor_gc_time)).count();
+    double promoted = before > last_live_words ? before - last_live_words : 0;
+    double survival = 1;
+    if (promoted > 0) {
+        survival = std::min(std::max((double(live) - last_live_words) / promoted, 0.0), 1.0);
+    }
+
+    double most = std::max<double>(live, 1) * max_old_gen_growth;
+    double least = std::min(double(std::max<std::size_t>(options.capabilities, 1) *
+                                   options.nursery_words),
+                            most);
+    double headroom = most;
+    if (mutator > 0 && promoted > 0 && live > 0) {
+        double k = cost * (1 - target) / target;
+        double denominator = mutator / promoted - k * survival / live;
+        // otherwise even unbounded growth would miss the target
+        if (denominator > 0) {
+            headroom = std::min(std::max(k / denominator, least), most);
+        }
+    }
+    major_threshold = std::max<std::size_t>(options.old_gen_min_words, live + headroom);
+
+    last_live_words = live;
+    last_major_end = ended;
+    last_minor_gc_time = stats.minor_gc_time;
+}
+
+void collector::mark_and_sweep() {
+    std::unique_lock<std::mutex> guard(nonmoving_lock);
+    while (!marker_stopping) {
+        if (phase == mark_phase::idle) {
+            marker_wake.wait(guard, [this] {
+                return marker_stopping || phase != mark_phase::idle;
+            });
+            continue;
+        }
+        if (phase == mark_phase::marking && mark_stack.empty()) {
+            // only a collection can show that the mutator has not logged
+            // anything more; ask again now and then, because a request
+            // made while the scheduler is not running is dropped
+            guard.unlock();
+            sched.request_gc();
+            guard.lock();
+            marker_wake.wait_for(guard, std::chrono::milliseconds(10), [this] {
+                return marker_stopping || phase != mark_phase::marking ||
+                       mark_stack.size();
+            });
+            continue;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + options.pause_budget;
+        if (phase == mark_phase::marking) {
+            mark_slice(deadline);
+        }
+        else {
+            sweep_slice(deadline);
+        }
+        if (pause_requested.load()) {
+            guard.unlock();
+            while (pause_requested.load()) {
+                std::this_thread::yield();
+            }
+            guard.lock();
+        }
+    }
+}
+
+void collector::collect(const std::unordered_set<thread*>& threads,
+                        const std::vector<std::unique_ptr<capability>>& capabilities) {
+    auto started = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> marker_guard;
+    if (concurrent()) {
+        pause_requested.store(true);
+        marker_guard = std::unique_lock<std::mutex>(nonmoving_lock);
+        pause_requested.store(false);
+        if (phase == mark_phase::marking) {
+            drain_snapshot_logs(capabilities);
+            promoted_large_flags = large_block | marked_block;
+        }
+        else {
+            promoted_large_flags = large_block;
+        }
+    }
+
+    std::size_t nursery_words = 0;
+    for (const auto& cap : capabilities) {
+        cap->nursery_current->free = cap->regs.hp;
+        for (block* b = cap->nursery; b; b = b->link) {
+            nursery_words += used_words(b);
+        }
+        flip(cap->nursery, nursery_block);
+    }
+    flip(young_large, nursery_block | large_block);
+    nursery_words += young_large_words;
+    stats.allocated_bytes += nursery_words * sizeof(word);
+    std::size_t old_words_before = old_words;
+
+    bool compacting = options.old_gen_mode == old_gen_collection::compacting &&
+                      old_words + nursery_words >= major_threshold;
+    major = options.old_gen_mode == old_gen_collection::copying &&
+            old_words + nursery_words >= major_threshold;
+    if (major) {
+        flip(old_head, 0);
+        flip(old_large, large_block);
+    }
+    // every collection copies into fresh to-space blocks, as evacuate tells
+    // a copy from an old closure by the flags of the block it is in
+    for (const auto& w : workers) {
+        w->to_head = nullptr;
+        w->current = nullptr;
+    }
+
+    for (const auto& cap : capabilities) {
+        if (!major) {
+            roots.emplace_back([this, &cap] {
+                for (closure* c : cap->remembered) {
+                    scavenge(c);
+                }
+                cap->remembered.clear();
+            });
+        }
+        else {
+            cap->remembered.clear();
+        }
+    }
+    if (!major) {
+        roots.emplace_back([this] { scavenge_cafs(); });
+    }
+    for (thread* t : threads) {
+        roots.emplace_back([this, t] { scavenge_thread(*t); });
+    }
+
+    next_root = 0;
+    idle_workers = 0;
+    {
+        std::lock_guard<std::mutex> guard(helpers_lock);
+        while (helpers.size() + 1 < workers.size()) {
+            gc_worker& w = *workers[helpers.size() + 1];
+            helpers.emplace_back([this, &w, seen = collections] { helper(w, seen); });
+        }
+        ++collections;
+        helpers_done = 0;
+    }
+    helpers_wake.notify_all();
+    work(*workers[0]);
+    {
+        std::unique_lock<std::mutex> guard(helpers_lock);
+        helpers_finished.wait(guard, [&] { return helpers_done == helpers.size(); });
+    }
+    roots.clear();
+    sweep_large();
+
+    if (major) {
+        revert_unreachable_cafs();
+        visited_statics.clear();
+        for (const auto& w : workers) {
+            w->visited_statics.clear();
+        }
+        for (block* b = old_head; b;) {
+            block* next = b->link;
+            memory.free_block(b);
+            b = next;
+        }
+        old_head = nullptr;
+    }
+    for (const auto& cap : capabilities) {
+        cap->reset_nursery();
+    }
+
+    // promote everything the workers copied into the old generation
+    for (const auto& w : workers) {
+        stats.copied_bytes += w->copied_words * sizeof(word);
+        w->copied_words = 0;
+        for (block* b = w->to_head; b;) {
+            block* next = b->link;
+            b->flags = 0;
+            b->link = old_head;
+            old_head = b;
+            b = next;
+        }
+        w->to_head = nullptr;
+    }
+    if (compacting) {
+        compact(threads);
+    }
+    old_words = 0;
+    for (block* b = old_head; b; b = b->link) {
+        old_words += used_words(b);
+    }
+    old_words += old_large_words + segment_words.load(std::memory_order_relaxed);
+    if (major || compacting) {
+        resize_old_generation(old_words_before + nursery_words,
+                              old_words,
+                              started,
+                              std::chrono::steady_clock::now());
+        stats.max_residency_bytes = std::max<std::uint64_t>(stats.max_residency_bytes,
+                                                            old_words * sizeof(word));
+    }
+
+    if (concurrent()) {
+        if (cycle_finished) {
+            ++stats.concurrent_cycles;
+            stats.max_residency_bytes = std::max<std::uint64_t>(
+                stats.max_residency_bytes, cycle_live_words * sizeof(word));
+            resize_old_generation(cycle_start_words,
+                                  cycle_live_words,
+                                  cycle_started,
+                                  cycle_ended);
+            cycle_finished = false;
+        }
+        if (phase == mark_phase::marking && mark_stack.empty()) {
+            // the marker has run out of work and the mutator has logged
+            // nothing since, so everything reachable is marked
+            marking.store(false, std::memory_order_relaxed);
+            phase = mark_phase::sweeping;
+            sweep_position = 0;
+        }
+        else if (phase == mark_phase::idle && old_words >= major_threshold) {
+            cycle_started = std::chrono::steady_clock::now();
+            cycle_start_words = old_words;
+            start_marking(threads);
+        }
+        marker_guard.unlock();
+        marker_wake.notify_all();
+    }
+
+    std::chrono::nanoseconds pause = std::chrono::steady_clock::now() - started;
+    if (major || compacting) {
+        ++stats.major_collections;
+        stats.major_gc_time += pause;
+    }
+    else {
+        ++stats.minor_collections;
+        stats.minor_gc_time += pause;
+    }
+    stats.max_pause = std::max(stats.max_pause, pause);
+}
+
+void write_barrier(capability& cap, closure* c) {
+    if (in_old_generation(cap.sched.memory, c)) {
+        cap.remembered.emplace_back(c);
+    }
+}
+
+void snapshot_barrier(capability& cap, closure* c) {
+    if (cap.sched.gc.is_marking() && in_old_generation(cap.sched.memory, c)) {
+        cap.snapshot_log.emplace_back(c);
+    }
+}
+
+void snapshot_barrier_fields(capability& cap, closure* c) {
+    if (!cap.sched.gc.is_marking() || !in_old_generation(cap.sched.memory, c)) {
+        return;
+    }
+    std::size_t pointers = closure_pointers(load_header(c));
+    for (std::size_t n = 0; n < pointers; ++n) {
+        snapshot_barrier(cap, reinterpret_cast<closure*>(c->payload[n]));
+    }
+}
+
+closure* allocate(capability& cap, std::size_t words) {
+    if (words >= large_object_words) {
+        collector& gc = cap.sched.gc;
+        closure* c = gc.allocate_large(words);
+        if (gc.young_large_object_words() >= cap.sched.options.nursery_words) {
+            cap.sched.request_gc();
+        }
+        return c;
+    }
+
+    registers& regs = cap.regs;
+    block* b = cap.nursery_current;
+    if (regs.hp + words > b->limit) {
+        b->free = regs.hp;
+        if (b->link) {
+            b = b->link;
+        }
+        else {
+            // grow the nursery rather than collect with closures in C++
+            // locals; the next safe point collects
+            b = cap.sched.memory.allocate_block(nursery_block);
+            b->link = cap.nursery_current->link;
+            cap.nursery_current->link = b;
+            cap.sched.request_gc();
+        }
+        cap.nursery_current = b;
+        regs.hp = b->free;
+        cap.restore_hp_limit();
+    }
+
+    auto c = reinterpret_cast<closure*>(regs.hp);
+    regs.hp += words;
+    return c;
+}
+}
+}
+
+using namespace gg::runtime;
+
+closure* gg_evacuate(closure* c) {
+    return current_worker->gc.evacuate(c);
+}
+
+closure* gg_copy(closure* c, std::size_t words) {
+    return current_worker->gc.copy(c, words);
+}
+
+void gg_heap_overflow(std::size_t words) {
+    capability& cap = *current_capability;
+    registers& regs = cap.regs;
+    block* b = cap.nursery_current;
+
+    regs.hp -= words;
+    if (words > max_block_object_words) {
+        raise(cap, heap_overflow_closure);
+        return;
+    }
+    if (cap.context_switch.load(std::memory_order_relaxed)) {
+        // the scheduler cleared hp_limit to preempt the thread
+        cap.restore_hp_limit();
+        cap.stop = true;
+        return;
+    }
+    if (regs.hp + words <= b->limit) {
+        // hp_limit was cleared for a context switch which already happened
+        cap.restore_hp_limit();
+        return;
+    }
+
+    b->free = regs.hp;
+    if (b->link) {
+        cap.nursery_current = b = b->link;
+        regs.hp = b->free;
+        cap.restore_hp_limit();
+        return;
+    }
+
+    // the nursery is full; run the continuation again after collecting
+    cap.sched.request_gc();
+    cap.stop = true;
+}
+
+word* gg_allocate(std::size_t words) {
+    return reinterpret_cast<word*>(allocate(*current_capability, words));
+}
@@ -0,0 +1,129 @@
+#include <iterator>
+
+#include <sys/mman.h>
+
+#include "gg/heap.h"
+
+namespace gg {
+namespace runtime {
+heap::heap(std::size_t max_bytes) {
+    // reserve an extra block so that the range can be aligned
+    reserved_bytes = max_bytes + block_bytes;
+    void* mem = mmap(nullptr,
+                     reserved_bytes,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                     -1,
+                     0);
+    if (mem == MAP_FAILED) {
+        throw heap_exhausted();
+    }
+    reserved = static_cast<char*>(mem);
+    base = reinterpret_cast<char*>(
+        (reinterpret_cast<word>(reserved) + block_bytes - 1) &
+        ~(block_bytes - 1));
+    end = base + max_bytes;
+    high_water = base;
+}
+
+heap::~heap() {
+    munmap(reserved, reserved_bytes);
+}
+
+char* heap::take_run(std::size_t bytes) {
+    // first fit, so that low addresses are reused before high ones
+    for (auto it = free_runs.begin(); it != free_runs.end(); ++it) {
+        if (it->second < bytes) {
+            continue;
+        }
+        char* start = it->first;
+        std::size_t rest = it->second - bytes;
+        free_runs.erase(it);
+        if (rest) {
+            free_runs.emplace(start + bytes, rest);
+        }
+        free_bytes -= bytes;
+        return start;
+    }
+
+    if (high_water + bytes > end) {
+        throw heap_exhausted();
+    }
+    char* start = high_water;
+    high_water += bytes;
+    return start;
+}
+
+void heap::free_run(char* start, std::size_t bytes) {
+    auto next = free_runs.lower_bound(start);
+    if (next != free_runs.end() && start + bytes == next->first) {
+        bytes += next->second;
+        free_bytes -= next->second;
+        next = free_runs.erase(next);
+    }
+    if (next != free_runs.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == start) {
+            start = prev->first;
+            bytes += prev->second;
+            free_bytes -= prev->second;
+            free_runs.erase(prev);
+        }
+    }
+
+    if (start + bytes == high_water) {
+        high_water = start;
+        return;
+    }
+    free_runs.emplace(start, bytes);
+    free_bytes += bytes;
+}
+
+block* heap::allocate_block(unsigned flags) {
+    block* b;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        b = reinterpret_cast<block*>(take_run(block_bytes));
+    }
+
+    b->free = block_start(b);
+    b->limit = reinterpret_cast<word*>(reinterpret_cast<char*>(b) + block_bytes);
+    b->link = nullptr;
+    b->flags = flags;
+    return b;
+}
+
+void heap::free_block(block* b) {
+    std::lock_guard<std::mutex> guard(lock);
+    free_run(reinterpret_cast<char*>(b), block_bytes);
+}
+
+block* heap::allocate_group(std::size_t words, unsigned flags) {
+    std::size_t bytes = sizeof(block) + words * sizeof(word);
+    std::size_t group_bytes = (bytes + block_bytes - 1) & ~(block_bytes - 1);
+    block* b;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        b = reinterpret_cast<block*>(take_run(group_bytes));
+    }
+
+    b->free = block_start(b);
+    b->limit = reinterpret_cast<word*>(reinterpret_cast<char*>(b) + group_bytes);
+    b->link = nullptr;
+    b->flags = flags;
+    return b;
+}
+
+void heap::free_group(block* b) {
+    auto start = reinterpret_cast<char*>(b);
+    auto group_end = reinterpret_cast<char*>(b->limit);
+    std::lock_guard<std::mutex> guard(lock);
+    free_run(start, group_end - start);
+}
+
+std::size_t heap::used_bytes() {
+    std::lock_guard<std::mutex> guard(lock);
+    return (high_water - base) - free_bytes;
+}
+}
+}
@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "gg/gc.h"
+#include "gg/integer.h"
+#include "gg/scheduler.h"
+
+namespace gg {
+namespace runtime {
+namespace {
+closure* copy_big_integer(closure* c) {
+    auto i = reinterpret_cast<big_integer*>(c);
+    return gg_copy(c, big_integer_words(std::abs(i->size)));
+}
+
+std::size_t scavenge_big_integer(closure* c) {
+    return big_integer_words(std::abs(reinterpret_cast<big_integer*>(c)->size));
+}
+
+/**
+   The largest power of ten in a limb, for converting to and from decimal
+   a limb at a time.
+*/
+constexpr std::uint64_t decimal_limb = 10000000000000000000ull;
+constexpr std::size_t decimal_limb_digits = 19;
+
+bool is_small(const closure* c) {
+    return c->info == &gg_small_integer_info;
+}
+
+std::int64_t small_value(const closure* c) {
+    return reinterpret_cast<const small_integer*>(c)->value;
+}
+
+closure* new_small(std::int64_t value) {
+    if (value >= min_shared_value && value <= max_shared_value) {
+        return reinterpret_cast<closure*>(&gg_small_integers[value - min_shared_value]);
+    }
+    closure* c = allocate(*current_capability, small_integer_words);
+    auto i = reinterpret_cast<small_integer*>(c);
+    i->info = &gg_small_integer_info;
+    i->value = value;
+    return c;
+}
+
+constexpr std::array<small_integer, shared_values> make_small_integers() {
+    std::array<small_integer, shared_values> integers{};
+    for (std::size_t n = 0; n < shared_values; ++n) {
+        integers[n] = {&gg_small_integer_info, min_shared_value + std::int64_t(n)};
+    }
+    return integers;
+}
+
+integer_value value_of(const closure* c) {
+    integer_value out;
+    if (is_small(c)) {
+        std::int64_t value = small_value(c);
+        out.negative = value < 0;
+        // negate unsigned so that the most negative value has a magnitude
+        std::uint64_t magnitude = static_cast<std::uint64_t>(value);
+        if (out.negative) {
+            magnitude = 0 - magnitude;
+        }
+        if (magnitude) {
+            out.limbs.emplace_back(magnitude);
+        }
+        return out;
+    }
+    auto i = reinterpret_cast<const big_integer*>(c);
+    out.negative = i->size < 0;
+    out.limbs.assign(i->limbs, i->limbs + std::abs(i->size));
+    return out;
+}
+
+/**
+   @return A small integer if `value` fits in 64 bits, otherwise a big one.
+*/
+closure* make_integer(const integer_value& value) {
+    if (auto small = as_small_integer(value)) {
+        return new_small(*small);
+    }
+
+    const auto& limbs = value.limbs;
+    closure* c = allocate(*current_capability, big_integer_words(limbs.size()));
+    auto i = reinterpret_cast<big_integer*>(c);
+    i->info = &gg_big_integer_info;
+    i->size = value.negative ? -std::int64_t(limbs.size()) : limbs.size();
+    std::copy(limbs.begin(), limbs.end(), i->limbs);
+    return c;
+}
+
+void trim(std::vector<std::uint64_t>& limbs) {
+    while (!limbs.empty() && !limbs.back()) {
+        limbs.pop_back();
+    }
+}
+
+int compare_magnitudes(const std::vector<std::uint64_t>& a,
+                       const std::vector<std::uint64_t>& b) {
+    if (a.size() != b.size()) {
+        return a.size() < b.size() ? -1 : 1;
+    }
+    for (std::size_t n = a.size(); n--;) {
+        if (a[n] != b[n]) {
+            return a[n] < b[n] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+std::vector<std::uint64_t> add_magnitudes(const std::vector<std::uint64_t>& a,
+                                          const std::vector<std::uint64_t>& b) {
+    const auto& longer = a.size() < b.size() ? b : a;
+    const auto& shorter = a.size() < b.size() ? a : b;
+    std::vector<std::uint64_t> out(longer.size() + 1);
+    bool carry = false;
+    for (std::size_t n = 0; n < longer.size(); ++n) {
+        std::uint64_t limb = n < shorter.size() ? shorter[n] : 0;
+        bool c1 = __builtin_add_overflow(longer[n], limb, &out[n]);
+        bool c2 = __builtin_add_overflow(out[n], std::uint64_t(carry), &out[n]);
+        carry = c1 || c2;
+    }
+    out.back() = carry;
+    trim(out);
+    return out;
+}
+
+/**
+   @return `a - b`, where `a` is at least `b`.
+*/
+std::vector<std::uint64_t> sub_magnitudes(const std::vector<std::uint64_t>& a,
+                                          const std::vector<std::uint64_t>& b) {
+    std::vector<std::uint64_t> out(a.size());
+    bool borrow = false;
+    for (std::size_t n = 0; n < a.size(); ++n) {
+        std::uint64_t limb = n < b.size() ? b[n] : 0;
+        bool b1 = __builtin_sub_overflow(a[n], limb, &out[n]);
+        bool b2 = __builtin_sub_overflow(out[n], std::uint64_t(borrow), &out[n]);
+        borrow = b1 || b2;
+    }
+    trim(out);
+    return out;
+}
+
+std::vector<std::uint64_t> mul_magnitudes(const std::vector<std::uint64_t>& a,
+                                          const std::vector<std::uint64_t>& b) {
+    if (a.empty() || b.empty()) {
+        return {};
+    }
+    std::vector<std::uint64_t> out(a.size() + b.size());
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        std::uint64_t carry = 0;
+        for (std::size_t j = 0; j < b.size(); ++j) {
+            unsigned __int128 product =
+                static_cast<unsigned __int128>(a[i]) * b[j] + out[i + j] + carry;
+            out[i + j] = static_cast<std::uint64_t>(product);
+            carry = static_cast<std::uint64_t>(product >> 64);
+        }
+        out[i + b.size()] = carry;
+    }
+    trim(out);
+    return out;
+}
+
+/**
+   Multiply a magnitude by `factor` and add `addend` in place.
+*/
+void mul_add_limb(std::vector<std::uint64_t>& limbs,
+                  std::uint64_t factor,
+                  std::uint64_t addend) {
+    std::uint64_t carry = addend;
+    for (auto& limb : limbs) {
+        unsigned __int128 product = static_cast<unsigned __int128>(limb) * factor + carry;
+        limb = static_cast<std::uint64_t>(product);
+        carry = static_cast<std::uint64_t>(product >> 64);
+    }
+    if (carry) {
+        limbs.emplace_back(carry);
+    }
+}
+
+/**
+   Divide a magnitude by `divisor` in place.
+
+   @return The remainder.
+*/
+std::uint64_t div_limb(std::vector<std::uint64_t>& limbs, std::uint64_t divisor) {
+    unsigned __int128 remainder = 0;
+    for (std::size_t n = limbs.size(); n--;) {
+        unsigned __int128 dividend = (remainder << 64) | limbs[n];
+        limbs[n] = static_cast<std::uint64_t>(dividend / divisor);
+        remainder = dividend % divisor;
+    }
+    trim(limbs);
+    return static_cast<std::uint64_t>(remainder);
+}
+
+integer_value add_values(integer_value a, const integer_value& b) {
+    if (a.negative == b.negative) {
+        a.limbs = add_magnitudes(a.limbs, b.limbs);
+        return a;
+    }
+    integer_value out;
+    if (compare_magnitudes(a.limbs, b.limbs) >= 0) {
+        out.negative = a.negative;
+        out.limbs = sub_magnitudes(a.limbs, b.limbs);
+    }
+    else {
+        out.negative = b.negative;
+        out.limbs = sub_magnitudes(b.limbs, a.limbs);
+    }
+    if (out.limbs.empty()) {
+        out.negative = false;
+    }
+    return out;
+}
+
+integer_value negate_value(integer_value a) {
+    a.negative = !a.negative && !a.limbs.empty();
+    return a;
+}
+
+[[gnu::noinline]] closure* add_slow(const closure* a, const closure* b) {
+    return make_integer(add_values(value_of(a), value_of(b)));
+}
+
+[[gnu::noinline]] closure* sub_slow(const closure* a, const closure* b) {
+    return make_integer(add_values(value_of(a), negate_value(value_of(b))));
+}
+
+[[gnu::noinline]] closure* mul_slow(const closure* a, const closure* b) {
+    integer_value x = value_of(a);
+    integer_value y = value_of(b);
+    integer_value out;
+    out.limbs = mul_magnitudes(x.limbs, y.limbs);
+    out.negative = x.negative != y.negative && !out.limbs.empty();
+    return make_integer(out);
+}
+
+[[gnu::noinline]] closure* negate_slow(const closure* a) {
+    return make_integer(negate_value(value_of(a)));
+}
+
+[[gnu::noinline]] std::int64_t compare_slow(const closure* a, const closure* b) {
+    integer_value x = value_of(a);
+    integer_value y = value_of(b);
+    if (x.negative != y.negative) {
+        return x.negative ? -1 : 1;
+    }
+    int order = compare_magnitudes(x.limbs, y.limbs);
+    return x.negative ? -order : order;
+}
+}
+
+std::optional<std::int64_t> as_small_integer(const integer_value& value) {
+    const auto& limbs = value.limbs;
+    if (limbs.empty()) {
+        return 0;
+    }
+    if (limbs.size() == 1) {
+        std::uint64_t magnitude = limbs[0];
+        if (!value.negative && magnitude <= INT64_MAX) {
+            return static_cast<std::int64_t>(magnitude);
+        }
+        if (value.negative && magnitude <= std::uint64_t(INT64_MAX) + 1) {
+            return static_cast<std::int64_t>(0 - magnitude);
+        }
+    }
+    return std::nullopt;
+}
+
+integer_value parse_integer(const std::string& digits) {
+    integer_value out;
+    std::size_t start = !digits.empty() && digits[0] == '-';
+    if (start == digits.size()) {
+        throw bad_integer("not an integer: '" + digits + "'");
+    }
+    for (std::size_t n = start; n < digits.size(); n += decimal_limb_digits) {
+        std::size_t count = std::min(decimal_limb_digits, digits.size() - n);
+        std::uint64_t chunk = 0;
+        std::uint64_t scale = 1;
+        for (std::size_t k = n; k < n + count; ++k) {
+            if (digits[k] < '0' || digits[k] > '9') {
+                throw bad_integer("not an integer: '" + digits + "'");
+            }
+            chunk = chunk * 10 + (digits[k] - '0');
+            scale *= 10;
+        }
+        mul_add_limb(out.limbs, scale, chunk);
+    }
+    trim(out.limbs);
+    out.negative = start && !out.limbs.empty();
+    return out;
+}
+
+std::string integer_to_string(const closure* c) {
+    integer_value value = value_of(c);
+    if (value.limbs.empty()) {
+        return "0";
+    }
+
+    // the chunks come out least significant first
+    std::vector<std::uint64_t> chunks;
+    while (!value.limbs.empty()) {
+        chunks.emplace_back(div_limb(value.limbs, decimal_limb));
+    }
+    std::string out = value.negative ? "-" : "";
+    out += std::to_string(chunks.back());
+    for (std::size_t n = chunks.size() - 1; n--;) {
+        std::string chunk = std::to_string(chunks[n]);
+        out.append(decimal_limb_digits - chunk.size(), '0');
+        out += chunk;
+    }
+    return out;
+}
+}
+}
+
+using namespace gg::runtime;
+
+std::array<small_integer, shared_values> gg_small_integers = make_small_integers();
+
+const info_table gg_small_integer_info = {
+    nullptr,
+    0,
+    nullptr,
+    nullptr,
+    closure_layout(0, 1),
+    nullptr,
+    reinterpret_cast<closure*>(gg_small_integers.data()),
+};
+const info_table gg_big_integer_info = {nullptr,
+                                        0,
+                                        copy_big_integer,
+                                        scavenge_big_integer,
+                                        0,
+                                        nullptr};
+
+closure* gg_integer_from_int(std::int64_t i) {
+    return new_small(i);
+}
+
+std::int64_t gg_integer_to_int(closure* a) {
+    if (is_small(a)) {
+        return small_value(a);
+    }
+    auto i = reinterpret_cast<const big_integer*>(a);
+    std::uint64_t low = i->limbs[0];
+    return static_cast<std::int64_t>(i->size < 0 ? 0 - low : low);
+}
+
+closure* gg_integer_add(closure* a, closure* b) {
+    std::int64_t out;
+    if (is_small(a) && is_small(b) &&
+        !__builtin_add_overflow(small_value(a), small_value(b), &out)) {
+        return new_small(out);
+    }
+    return add_slow(a, b);
+}
+
+closure* gg_integer_sub(closure* a, closure* b) {
+    std::int64_t out;
+    if (is_small(a) && is_small(b) &&
+        !__builtin_sub_overflow(small_value(a), small_value(b), &out)) {
+        return new_small(out);
+    }
+    return sub_slow(a, b);
+}
+
+closure* gg_integer_mul(closure* a, closure* b) {
+    std::int64_t out;
+    if (is_small(a) && is_small(b) &&
+        !__builtin_mul_overflow(small_value(a), small_value(b), &out)) {
+        return new_small(out);
+    }
+    return mul_slow(a, b);
+}
+
+closure* gg_integer_negate(closure* a) {
+    std::int64_t out;
+    if (is_small(a) && !__builtin_sub_overflow(0, small_value(a), &out)) {
+        return new_small(out);
+    }
+    return negate_slow(a);
+}
+
+std::int64_t gg_integer_compare(closure* a, closure* b) {
+    if (is_small(a) && is_small(b)) {
+        std::int64_t x = small_value(a);
+        std::int64_t y = small_value(b);
+        return (x > y) - (x < y);
+    }
+    return compare_slow(a, b);
+}
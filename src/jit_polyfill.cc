@@ -39,3 +39,54 @@ void gg::jit::set_fields(gccjit::struct_& st,
                               fields.size(),
                               raw_fields.data());
 }
+
+void gg::jit::set_tls_model(gccjit::lvalue& global, gcc_jit_tls_model model) {
+    gcc_jit_lvalue_set_tls_model(global.get_inner_lvalue(), model);
+}
+
+namespace {
+std::vector<gcc_jit_rvalue*> raw_rvalues(const std::vector<gccjit::rvalue>& values) {
+    std::vector<gcc_jit_rvalue*> raw_values;
+    raw_values.reserve(values.size());
+
+    for (const auto& elem : values) {
+        raw_values.emplace_back(elem.get_inner_rvalue());
+    }
+    return raw_values;
+}
+}
+
+gccjit::rvalue
+gg::jit::new_struct_constructor(gccjit::context& ctx,
+                                const gccjit::type& type,
+                                const std::vector<gccjit::rvalue>& values,
+                                const gccjit::location& loc) {
+    auto raw_values = raw_rvalues(values);
+    // no fields means the values are for the fields in order
+    return gccjit::rvalue(gcc_jit_context_new_struct_constructor(
+                              ctx.get_inner_context(),
+                              loc.get_inner_location(),
+                              type.get_inner_type(),
+                              raw_values.size(),
+                              nullptr,
+                              raw_values.data()));
+}
+
+gccjit::rvalue
+gg::jit::new_array_constructor(gccjit::context& ctx,
+                               const gccjit::type& type,
+                               const std::vector<gccjit::rvalue>& values,
+                               const gccjit::location& loc) {
+    auto raw_values = raw_rvalues(values);
+    return gccjit::rvalue(gcc_jit_context_new_array_constructor(
+                              ctx.get_inner_context(),
+                              loc.get_inner_location(),
+                              type.get_inner_type(),
+                              raw_values.size(),
+                              raw_values.data()));
+}
+
+void gg::jit::set_initializer(gccjit::lvalue& global, const gccjit::rvalue& value) {
+    gcc_jit_global_set_initializer_rvalue(global.get_inner_lvalue(),
+                                          value.get_inner_rvalue());
+}
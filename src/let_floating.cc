@@ -0,0 +1,509 @@
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "gg/freevars.h"
+#include "gg/let_floating.h"
+#include "gg/references.h"
+
+namespace gg {
+namespace compiler {
+namespace {
+/**
+   A `let` or `letrec` group being floated, and the lambda depth of the
+   deepest variable it depends on.
+*/
+struct float_group {
+    std::vector<std::shared_ptr<ast::binding>> bindings;
+    bool recursive;
+    std::size_t level;
+};
+
+std::shared_ptr<ast::expr> wrap(const location& loc,
+                                const std::vector<std::shared_ptr<ast::binding>>& bindings,
+                                bool recursive,
+                                const std::shared_ptr<ast::expr>& body) {
+    auto seq = std::make_shared<ast::sequence<ast::binding>>(loc, bindings);
+    if (recursive) {
+        return std::make_shared<ast::local_recursion>(loc, seq, body);
+    }
+    return std::make_shared<ast::local_definition>(loc, seq, body);
+}
+
+/**
+   Rename the free occurrences of some names.
+*/
+struct renamer {
+    const std::unordered_map<std::string, std::string>& names;
+    compiler::scope scope;
+
+    renamer(const std::unordered_map<std::string, std::string>& names)
+        : names(names) {}
+
+    const std::string* target(const std::string& name) {
+        auto it = names.find(name);
+        if (it == names.end() || scope.shadows(name)) {
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    void rename(std::shared_ptr<ast::variable>& var) {
+        if (auto to = target(var->name)) {
+            var = std::make_shared<ast::variable>(var->loc, *to);
+        }
+    }
+
+    void rename_atoms(ast::sequence<ast::atom>& atoms) {
+        for (auto& atom : atoms.elems) {
+            if (auto var = std::dynamic_pointer_cast<ast::variable>(atom)) {
+                if (auto to = target(var->name)) {
+                    atom = std::make_shared<ast::variable>(var->loc, *to);
+                }
+            }
+        }
+    }
+
+    void walk(ast::lambda& lam) {
+        for (auto& var : lam.freevars->elems) {
+            rename(var);
+        }
+        scope.walk_lambda(lam, [&] { walk(lam.body); });
+    }
+
+    void walk(const std::shared_ptr<ast::expr>& expr) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            scope.walk_let(*let,
+                           [&](ast::binding& binding) { walk(*binding.rhs); },
+                           [&] { walk(let->body); });
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            walk(case_->scrutinee);
+            for (const auto& alt : *case_->alts) {
+                scope.walk_alt(*alt, [&] { walk(alt->body); });
+            }
+        }
+        else if (auto con = std::dynamic_pointer_cast<ast::construct>(expr)) {
+            rename_atoms(*con->args);
+        }
+        else if (auto app = std::dynamic_pointer_cast<ast::apply>(expr)) {
+            rename(app->var);
+            rename_atoms(*app->args);
+        }
+        else if (auto prim = std::dynamic_pointer_cast<ast::prim_apply>(expr)) {
+            rename_atoms(*prim->args);
+        }
+    }
+};
+
+/**
+   Floats bindings out of the lambdas they do not depend on.
+
+   Every name in scope has a level: the number of enclosing lambdas with
+   arguments where it was bound, with the top level at 0. A binding whose free variables all have levels
+   below the depth of its `let` can be allocated outside of the enclosing
+   lambda; it is passed outward until it reaches the `let` which binds the
+   lambda at its level and placed just around it, or becomes a top level
+   binding at level 0.
+*/
+struct out_floater {
+    float_out_policy policy;
+    std::unordered_set<std::string>& taken;
+    std::unordered_map<std::string, std::vector<std::size_t>> levels;
+
+    out_floater(float_out_policy policy, std::unordered_set<std::string>& taken)
+        : policy(policy), taken(taken) {}
+
+    void bind(const std::string& name, std::size_t level) {
+        levels[name].emplace_back(level);
+    }
+
+    void unbind(const std::string& name) {
+        levels[name].pop_back();
+    }
+
+    std::size_t level_of(const std::string& name) {
+        auto it = levels.find(name);
+        if (it == levels.end() || it->second.empty()) {
+            // a top level binding
+            return 0;
+        }
+        return it->second.back();
+    }
+
+    std::size_t level_of(const ast::lambda& lam,
+                         const std::unordered_set<std::string>& group) {
+        std::size_t level = 0;
+        for (const auto& var : lam.freevars->elems) {
+            if (!group.count(var->name)) {
+                level = std::max(level, level_of(var->name));
+            }
+        }
+        return level;
+    }
+
+    bool may_float(const ast::lambda& lam) {
+        switch (policy) {
+        case float_out_policy::never:
+            return false;
+        case float_out_policy::safe:
+            return !(lam.update && is_thunk(lam));
+        case float_out_policy::full:
+            return true;
+        }
+        return false;
+    }
+
+    /**
+       Give floated bindings fresh names, so that no binder they move across
+       can capture them, and rename their uses in `scope`.
+    */
+    void rename(const std::vector<std::shared_ptr<ast::binding>>& bindings,
+                bool recursive,
+                const std::shared_ptr<ast::expr>& scope) {
+        std::unordered_map<std::string, std::string> names;
+        for (const auto& binding : bindings) {
+            names[binding->lhs->name] = fresh_name(binding->lhs->name, taken);
+        }
+        renamer r(names);
+        r.walk(scope);
+        for (const auto& binding : bindings) {
+            if (recursive) {
+                r.walk(*binding->rhs);
+            }
+            binding->lhs = std::make_shared<ast::variable>(
+                binding->lhs->loc,
+                names[binding->lhs->name]);
+        }
+    }
+
+    /**
+       @param depth The depth of the `let` binding `lam`.
+       @return The groups floated out of `lam`, dependencies first.
+    */
+    std::vector<float_group> walk(ast::lambda& lam, std::size_t depth) {
+        // a thunk's body runs at most once per allocation of the thunk, so
+        // there is nothing to gain by floating out of it alone
+        if (!is_thunk(lam)) {
+            ++depth;
+        }
+        std::vector<float_group> out;
+        for (const auto& arg : lam.args->elems) {
+            bind(arg->name, depth);
+        }
+        walk(lam.body, depth, out);
+        for (const auto& arg : lam.args->elems) {
+            unbind(arg->name);
+        }
+        return out;
+    }
+
+    void walk(std::shared_ptr<ast::expr>& expr,
+              std::size_t depth,
+              std::vector<float_group>& out) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_recursion>(expr)) {
+            walk_recursion(expr, let, depth, out);
+        }
+        else if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            walk_definition(expr, let, depth, out);
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            walk(case_->scrutinee, depth, out);
+            for (const auto& alt : *case_->alts) {
+                auto bound = alt_binders(*alt);
+                for (const auto& name : bound) {
+                    bind(name, depth);
+                }
+                walk(alt->body, depth, out);
+                for (const auto& name : bound) {
+                    unbind(name);
+                }
+            }
+        }
+    }
+
+    void walk_definition(std::shared_ptr<ast::expr>& expr,
+                         const std::shared_ptr<ast::local_bindings>& let,
+                         std::size_t depth,
+                         std::vector<float_group>& out) {
+        // groups floated out of the right hand sides which stop here
+        std::vector<float_group> here;
+        std::vector<std::shared_ptr<ast::binding>> stay;
+        std::vector<std::shared_ptr<ast::binding>> floated;
+        std::vector<std::size_t> floated_levels;
+        static const std::unordered_set<std::string> no_group;
+
+        for (const auto& binding : *let->bindings) {
+            std::size_t level = level_of(*binding->rhs, no_group);
+            for (auto& group : walk(*binding->rhs, depth)) {
+                level = std::max(level, group.level);
+                if (group.level == depth) {
+                    here.emplace_back(std::move(group));
+                }
+                else {
+                    out.emplace_back(std::move(group));
+                }
+            }
+
+            if (level < depth && may_float(*binding->rhs)) {
+                rename({binding}, false, let->body);
+                floated.emplace_back(binding);
+                floated_levels.emplace_back(level);
+                out.push_back({{binding}, false, level});
+            }
+            else {
+                stay.emplace_back(binding);
+            }
+        }
+
+        for (const auto& binding : stay) {
+            bind(binding->lhs->name, depth);
+        }
+        for (std::size_t n = 0; n < floated.size(); ++n) {
+            bind(floated[n]->lhs->name, floated_levels[n]);
+        }
+        walk(let->body, depth, out);
+        for (const auto& binding : *let->bindings) {
+            unbind(binding->lhs->name);
+        }
+
+        if (stay.empty()) {
+            expr = let->body;
+        }
+        else {
+            let->bindings->elems = std::move(stay);
+        }
+        for (auto it = here.rbegin(); it != here.rend(); ++it) {
+            expr = wrap(let->loc, it->bindings, it->recursive, expr);
+        }
+    }
+
+    void walk_recursion(std::shared_ptr<ast::expr>& expr,
+                        const std::shared_ptr<ast::local_bindings>& let,
+                        std::size_t depth,
+                        std::vector<float_group>& out) {
+        std::unordered_set<std::string> group;
+        for (const auto& binding : *let->bindings) {
+            group.insert(binding->lhs->name);
+            bind(binding->lhs->name, depth);
+        }
+
+        std::size_t level = 0;
+        bool movable = true;
+        std::vector<float_group> inner;
+        std::vector<std::shared_ptr<ast::binding>> merged;
+        for (const auto& binding : *let->bindings) {
+            level = std::max(level, level_of(*binding->rhs, group));
+            movable = movable && may_float(*binding->rhs);
+            for (auto& floated : walk(*binding->rhs, depth)) {
+                if (floated.level == depth) {
+                    // these may depend on the group, so they join it
+                    merged.insert(merged.end(),
+                                  floated.bindings.begin(),
+                                  floated.bindings.end());
+                }
+                else {
+                    level = std::max(level, floated.level);
+                    inner.emplace_back(std::move(floated));
+                }
+            }
+        }
+        for (const auto& binding : merged) {
+            let->bindings->elems.emplace_back(binding);
+            bind(binding->lhs->name, depth);
+        }
+        out.insert(out.end(), inner.begin(), inner.end());
+
+        if (merged.empty() && movable && level < depth) {
+            for (const auto& binding : *let->bindings) {
+                unbind(binding->lhs->name);
+            }
+            rename(let->bindings->elems, true, let->body);
+            for (const auto& binding : *let->bindings) {
+                bind(binding->lhs->name, level);
+            }
+            out.push_back({let->bindings->elems, true, level});
+            expr = let->body;
+        }
+
+        walk(let->body, depth, out);
+        for (const auto& binding : *let->bindings) {
+            unbind(binding->lhs->name);
+        }
+    }
+};
+
+/**
+   Floats bindings into the single case alternative which uses them, so that
+   the other alternatives never allocate them.
+*/
+struct in_floater {
+    float_in_policy policy;
+
+    in_floater(float_in_policy policy) : policy(policy) {}
+
+    bool allowed(const std::unordered_set<std::string>& freevars) {
+        switch (policy) {
+        case float_in_policy::never:
+            return false;
+        case float_in_policy::safe:
+            return freevars.size() <= 1;
+        case float_in_policy::always:
+            return true;
+        }
+        return false;
+    }
+
+    /**
+       Move a group into the case alternative in `into` which uses it,
+       looking through `let`s.
+
+       @return Whether the group was moved.
+    */
+    bool sink(const float_group& group,
+              const std::unordered_set<std::string>& names,
+              const std::unordered_set<std::string>& freevars,
+              std::shared_ptr<ast::expr>& into) {
+        auto captures = [&](const std::string& name) {
+            return names.count(name) || freevars.count(name);
+        };
+
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(into)) {
+            for (const auto& binding : *let->bindings) {
+                if (captures(binding->lhs->name) ||
+                    global_references(*binding->rhs, names).size()) {
+                    return false;
+                }
+            }
+            // only worth moving past the let if it ends up in an alternative
+            return sink(group, names, freevars, let->body);
+        }
+
+        auto case_ = std::dynamic_pointer_cast<ast::case_>(into);
+        if (!case_ || expr_references(case_->scrutinee, names).size()) {
+            return false;
+        }
+
+        std::shared_ptr<ast::alternative> target;
+        for (const auto& alt : *case_->alts) {
+            auto bound = alt_binders(*alt);
+            auto used = expr_references(alt->body, names);
+            for (const auto& name : bound) {
+                used.erase(name);
+            }
+            if (used.empty()) {
+                continue;
+            }
+            if (target) {
+                return false;
+            }
+            if (std::any_of(bound.begin(), bound.end(), captures)) {
+                return false;
+            }
+            target = alt;
+        }
+        if (!target || !allowed(freevars)) {
+            return false;
+        }
+
+        if (!sink(group, names, freevars, target->body)) {
+            target->body = wrap(into->loc,
+                                group.bindings,
+                                group.recursive,
+                                target->body);
+        }
+        return true;
+    }
+
+    bool sink(const float_group& group, std::shared_ptr<ast::expr>& into) {
+        std::unordered_set<std::string> names;
+        for (const auto& binding : group.bindings) {
+            names.insert(binding->lhs->name);
+        }
+        std::unordered_set<std::string> freevars;
+        for (const auto& binding : group.bindings) {
+            for (const auto& var : binding->rhs->freevars->elems) {
+                if (!names.count(var->name)) {
+                    freevars.insert(var->name);
+                }
+            }
+        }
+        return sink(group, names, freevars, into);
+    }
+
+    void walk(ast::lambda& lam) {
+        walk(lam.body);
+    }
+
+    void walk(std::shared_ptr<ast::expr>& expr) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            for (const auto& binding : *let->bindings) {
+                walk(*binding->rhs);
+            }
+            walk(let->body);
+
+            if (std::dynamic_pointer_cast<ast::local_recursion>(expr)) {
+                if (sink({let->bindings->elems, true, 0}, let->body)) {
+                    expr = let->body;
+                }
+                return;
+            }
+
+            // the bindings of a let are independent, so each may go to a
+            // different alternative
+            std::vector<std::shared_ptr<ast::binding>> stay;
+            for (const auto& binding : *let->bindings) {
+                if (!sink({{binding}, false, 0}, let->body)) {
+                    stay.emplace_back(binding);
+                }
+            }
+            if (stay.empty()) {
+                expr = let->body;
+            }
+            else {
+                let->bindings->elems = std::move(stay);
+            }
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            walk(case_->scrutinee);
+            for (const auto& alt : *case_->alts) {
+                walk(alt->body);
+            }
+        }
+    }
+};
+}
+
+void float_lets(ast::sequence<ast::binding>& bindings,
+                const float_options& options,
+                const std::unordered_set<std::string>& externs) {
+    if (options.out != float_out_policy::never) {
+        std::unordered_set<std::string> taken = bound_names(bindings);
+        taken.insert(externs.begin(), externs.end());
+        out_floater floater(options.out, taken);
+        std::vector<std::shared_ptr<ast::binding>> floated;
+        for (const auto& binding : bindings) {
+            for (const auto& group : floater.walk(*binding->rhs, 0)) {
+                floated.insert(floated.end(),
+                               group.bindings.begin(),
+                               group.bindings.end());
+            }
+        }
+        bindings.elems.insert(bindings.elems.end(), floated.begin(), floated.end());
+
+        // floated bindings are captured by different lambdas now, and those
+        // which reached the top level are not captured at all
+        compute_freevars(bindings, freevar_mode::overwrite, externs);
+    }
+
+    if (options.in != float_in_policy::never) {
+        in_floater floater(options.in);
+        for (const auto& binding : bindings) {
+            floater.walk(*binding->rhs);
+        }
+    }
+}
+}
+}
@@ -17,6 +17,12 @@ digit     [0-9]
 white     [ \t]
 newline   \n
 primop    ("+"|"-"|"*"|"/"|"%"|"**"|"<<"|">>"|"|"|"&"|"^"|"<"|"<="|"=="|"/="|">="|">"|"~"|"~-")
+namedprimop ("fork"|"yield"|"newMVar"|"takeMVar"|"putMVar"|"sqrtDouble"|"int2Double"|"double2Int")
+bytearrayop ("newByteArray"|"sizeofByteArray"|"unsafeFreezeByteArray"|"copyByteArray"|"setByteArray"|"compareByteArrays")
+elementop   (("index"|"read"|"write")("Int"|"Double")"Array"|"sum"("Int"|"Double")"Array")
+arrayop     ("newArray"|"sizeofArray"|"indexArray"|"readArray"|"writeArray"|"copyArray"|"unsafeFreezeArray")
+integerop   (("plus"|"minus"|"times"|"negate"|"compare")"Integer"|"int2Integer"|"integer2Int")
+exponent  [eE][-+]?{digit}+
 
 %{
 // Code run each time a pattern is matched.
@@ -78,6 +84,26 @@ primop    ("+"|"-"|"*"|"/"|"%"|"**"|"<<"|">>"|"|"|"&"|"^"|"<"|"<="|"=="|"/="|">=
     return gg::parser::make_DEFAULT(loc);
 }
 
+"data" {
+    return gg::parser::make_DATA(loc);
+}
+
+{primop}"#" |
+{primop}"##" |
+{namedprimop}"#" |
+{bytearrayop}"#" |
+{elementop}"#" |
+{arrayop}"#" |
+{integerop}"#" {
+    auto maybe_opcode = gg::ast::primopcode_from_s(yytext);
+    if (maybe_opcode) {
+        return gg::parser::make_PRIMOP(*maybe_opcode, loc);
+    }
+    std::stringstream ss;
+    ss << "unknown primop: " << yytext;
+    throw gg::ast::bad_parse(ss.str(), loc);
+}
+
 {lowercase}({alpha}|{digit})*"'"*"#"? {
     return gg::parser::make_VARNAME(yytext, loc);
 }
@@ -97,7 +123,25 @@ primop    ("+"|"-"|"*"|"/"|"%"|"**"|"<<"|">>"|"|"|"&"|"^"|"<"|"<="|"=="|"/="|">=
     }
     catch (std::exception &e) {
         std::stringstream ss;
-        ss << "bad int: " << yytext << ": out of bounds for 64bit integer";
+        ss << "bad int: " << yytext
+           << ": out of bounds for 64bit integer; Integer literals end in 'I#'";
+        throw gg::ast::bad_parse(ss.str(), loc);
+    }
+}
+
+"-"?{digit}+"I#" {
+    std::string digits(yytext, yyleng - 2);
+    return gg::parser::make_INTEGER_BIG_LIT(gg::ast::integer_digits{digits}, loc);
+}
+
+"-"?{digit}+("."{digit}+)?{exponent}?"##" {
+    try {
+        double d = std::stod(yytext);
+        return gg::parser::make_DOUBLE_LIT(d, loc);
+    }
+    catch (std::exception &e) {
+        std::stringstream ss;
+        ss << "bad double: " << yytext << ": out of range for a 64bit double";
         throw gg::ast::bad_parse(ss.str(), loc);
     }
 }
@@ -108,6 +152,12 @@ primop    ("+"|"-"|"*"|"/"|"%"|"**"|"<<"|">>"|"|"|"&"|"^"|"<"|"<="|"=="|"/="|">=
     throw gg::ast::bad_parse(ss.str(), loc);
 }
 
+"-"?{digit}+("."{digit}+)?{exponent}?"#"? {
+    std::stringstream ss;
+    ss << "bad literal: " << yytext << ": doubles must end in '##'";
+    throw gg::ast::bad_parse(ss.str(), loc);
+}
+
 "{" {
     return gg::parser::make_LBRACE(loc);
 }
@@ -124,14 +174,8 @@ primop    ("+"|"-"|"*"|"/"|"%"|"**"|"<<"|">>"|"|"|"&"|"^"|"<"|"<="|"=="|"/="|">=
     return gg::parser::make_COMMA(loc);
 }
 
-{primop}"#" {
-    auto maybe_opcode = gg::ast::primopcode_from_s(yytext);
-    if (maybe_opcode) {
-        return gg::parser::make_PRIMOP(*maybe_opcode, loc);
-    }
-    std::stringstream ss;
-    ss << "unknown primop: " << yytext;
-    throw gg::ast::bad_parse(ss.str(), loc);
+"!" {
+    return gg::parser::make_BANG(loc);
 }
 
 . {
@@ -0,0 +1,286 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "gg/apply.h"
+#include "gg/gc.h"
+#include "gg/integer.h"
+#include "gg/library.h"
+#include "gg/parse.h"
+#include "gg/stack.h"
+#include "gg/thunk.h"
+
+namespace gg {
+namespace {
+using runtime::closure;
+using runtime::info_table;
+using runtime::word;
+
+/**
+   The root closure of the thread evaluating one call. It lives outside of
+   the heap and holds no heap pointers, so the collector never moves it.
+*/
+struct pending_call {
+    const info_table* info;
+    closure* function;
+    std::vector<word> arguments;
+
+    /**
+       The info table of the constructor each argument is boxed in.
+    */
+    std::vector<const info_table*> boxes;
+};
+
+void pending_call_entry() {
+    runtime::capability& cap = *runtime::current_capability;
+    runtime::registers& regs = cap.regs;
+    auto call = reinterpret_cast<pending_call*>(regs.node);
+    closure* function = call->function;
+    const info_table* info = function->info;
+    std::size_t count = call->arguments.size();
+    regs.node = function;
+    if (!count) {
+        // a CAF is entered, anything else is already a value
+        regs.next = info->entry_code && !info->arity ?
+            info->entry_code :
+            reinterpret_cast<const info_table*>(regs.sp[0])->entry_code;
+        return;
+    }
+
+    // compiled functions take their arguments boxed
+    if (regs.sp - (count + 1) < regs.sp_limit && !gg_grow_stack(count + 1)) {
+        return;
+    }
+    regs.sp -= count + 1;
+    regs.sp[0] = reinterpret_cast<word>(&gg_apply_frames[count]);
+    for (std::size_t n = 0; n < count; ++n) {
+        closure* box = runtime::allocate(cap, 2);
+        box->info = call->boxes[n];
+        box->payload[0] = call->arguments[n];
+        regs.sp[n + 1] = reinterpret_cast<word>(box);
+    }
+    regs.next = info->entry_code;
+}
+
+const info_table pending_call_info = {pending_call_entry,
+                                      0,
+                                      nullptr,
+                                      nullptr,
+                                      0,
+                                      nullptr};
+
+word raw_argument(const argument& arg) {
+    return std::visit(
+        [](auto value) {
+            word raw;
+            static_assert(sizeof(value) == sizeof(raw));
+            std::memcpy(&raw, &value, sizeof(raw));
+            return raw;
+        },
+        arg);
+}
+
+std::unique_ptr<pending_call> make_call(closure* function,
+                                        const std::vector<argument>& arguments,
+                                        const std::vector<const info_table*>& boxes) {
+    auto call = std::make_unique<pending_call>();
+    call->info = &pending_call_info;
+    call->function = function;
+    for (const argument& arg : arguments) {
+        call->arguments.emplace_back(raw_argument(arg));
+    }
+    call->boxes = boxes;
+    return call;
+}
+}
+
+value_view::value_view(const program* owner, closure* value)
+    : owner(owner), value(value) {}
+
+closure* value_view::get() const {
+    return runtime::follow_indirections(value);
+}
+
+bool value_view::is_constructor() const {
+    return owner->compiled.describe(get()->info);
+}
+
+const compiler::constructor_description& value_view::description() const {
+    auto description = owner->compiled.describe(get()->info);
+    if (!description) {
+        throw bad_value("value is not an evaluated constructor");
+    }
+    return *description;
+}
+
+const std::string& value_view::constructor() const {
+    return description().name;
+}
+
+std::size_t value_view::fields() const {
+    return description().fields.size();
+}
+
+std::size_t value_view::slot(std::size_t n, ast::field_kind kind) const {
+    const auto& con = description();
+    if (n >= con.fields.size()) {
+        std::stringstream s;
+        s << con.name << " has no field " << n;
+        throw bad_value(s.str());
+    }
+    if (con.fields[n] != kind) {
+        std::stringstream s;
+        s << "field " << n << " of " << con.name << " holds another kind of value";
+        throw bad_value(s.str());
+    }
+    return compiler::field_slots(con.fields)[n];
+}
+
+value_view value_view::field(std::size_t n) const {
+    word raw = get()->payload[slot(n, ast::field_kind::boxed)];
+    return value_view(owner, reinterpret_cast<closure*>(raw));
+}
+
+std::int64_t value_view::int_field(std::size_t n) const {
+    return static_cast<std::int64_t>(get()->payload[slot(n, ast::field_kind::int64)]);
+}
+
+double value_view::double_field(std::size_t n) const {
+    word raw = get()->payload[slot(n, ast::field_kind::float64)];
+    double value;
+    std::memcpy(&value, &raw, sizeof(value));
+    return value;
+}
+
+std::int64_t value_view::as_int() const {
+    closure* c = get();
+    if (c->info == &gg_small_integer_info) {
+        return reinterpret_cast<runtime::small_integer*>(c)->value;
+    }
+    if (c->info == &gg_big_integer_info) {
+        throw bad_value("Integer does not fit in 64 bits");
+    }
+    if (fields() != 1) {
+        throw bad_value(constructor() + " is not a box");
+    }
+    return int_field(0);
+}
+
+double value_view::as_double() const {
+    if (fields() != 1) {
+        throw bad_value(constructor() + " is not a box");
+    }
+    return double_field(0);
+}
+
+program::program(std::istream& source, const runtime::config& options)
+    : evaluator(options) {
+    add(source);
+}
+
+std::unique_ptr<program> program::from_buffer(const std::string& source,
+                                              const runtime::config& options) {
+    std::istringstream in(source);
+    return std::make_unique<program>(in, options);
+}
+
+std::unique_ptr<program> program::from_path(const std::string& path,
+                                            const runtime::config& options) {
+    std::ifstream in(path);
+    if (!in) {
+        throw bad_source("cannot read " + path);
+    }
+    return std::make_unique<program>(in, options);
+}
+
+void program::add(std::istream& source) {
+    auto batch = ast::parse(source);
+    std::lock_guard<std::mutex> guard(lock);
+    compiled.add(batch);
+}
+
+closure* program::lookup(const std::string& name) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return compiled.lookup(name);
+}
+
+void program::save_snapshot(const std::string& path) const {
+    std::lock_guard<std::mutex> guard(lock);
+    gg::save_snapshot(compiled, path);
+}
+
+void program::load_snapshot(const std::string& path) {
+    std::lock_guard<std::mutex> guard(lock);
+    images.emplace_back(gg::load_snapshot(compiled, path));
+}
+
+closure* program::callee(const std::string& name, std::size_t arguments) const {
+    closure* function = compiled.lookup(name);
+    if (!function) {
+        throw bad_call("no binding named " + name);
+    }
+    if (arguments > runtime::max_frame_words) {
+        throw bad_call("too many arguments to " + name);
+    }
+    if (function->info->arity != arguments) {
+        std::stringstream s;
+        s << name << " takes " << function->info->arity << " arguments, not "
+          << arguments;
+        throw bad_call(s.str());
+    }
+    return function;
+}
+
+const info_table* program::box_info(const argument& arg) const {
+    bool is_double = std::holds_alternative<double>(arg);
+    std::vector<ast::field_kind> fields = {is_double ? ast::field_kind::float64 :
+                                                       ast::field_kind::int64};
+    const info_table* box = nullptr;
+    const std::string* box_name = nullptr;
+    for (const auto& [name, info] : compiled.linked_bindings().constructors) {
+        auto con = static_cast<const info_table*>(info);
+        auto description = compiled.describe(con);
+        if (description && description->fields == fields &&
+            (!box_name || name < *box_name)) {
+            box = con;
+            box_name = &name;
+        }
+    }
+    if (!box) {
+        std::stringstream s;
+        s << "no constructor with one strict " << (is_double ? "double" : "int")
+          << " field to pass the argument in";
+        throw bad_call(s.str());
+    }
+    return box;
+}
+
+evaluation program::call(const std::string& name, const std::vector<argument>& arguments) {
+    return call_batch(name, {arguments});
+}
+
+evaluation program::call_batch(const std::string& name,
+                               const std::vector<std::vector<argument>>& batch) {
+    evaluation result{std::unique_lock<std::mutex>(lock), {}};
+
+    std::vector<std::unique_ptr<pending_call>> calls;
+    std::vector<closure*> roots;
+    for (const auto& arguments : batch) {
+        std::vector<const info_table*> boxes;
+        for (const argument& arg : arguments) {
+            boxes.emplace_back(box_info(arg));
+        }
+        calls.emplace_back(make_call(callee(name, arguments.size()), arguments, boxes));
+        roots.emplace_back(reinterpret_cast<closure*>(calls.back().get()));
+    }
+
+    for (closure* value : evaluator.run_all(roots)) {
+        result.results.emplace_back(this, value);
+    }
+    return result;
+}
+
+runtime::rts_stats program::statistics() {
+    return evaluator.statistics();
+}
+}
@@ -5,8 +5,8 @@
 
 using namespace gg::ast;
 
-std::shared_ptr<sequence<binding>> gg::ast::parse(std::istream &in) {
-    std::shared_ptr<sequence<binding>> result;
+std::shared_ptr<program> gg::ast::parse(std::istream &in) {
+    std::shared_ptr<program> result;
     gg::lexer l(&in);
     gg::parser p(l, result);
     p.parse();
@@ -17,7 +17,7 @@ namespace gg {
 }
 }
 %parse-param { gg::lexer &lex }
-%parse-param { std::shared_ptr<gg::ast::sequence<gg::ast::binding>> &result }
+%parse-param { std::shared_ptr<gg::ast::program> &result }
 %lex-param { nullptr }
 %locations
 %initial-action {
@@ -39,6 +39,19 @@ auto make_shared_seq(const gg::parser::location_type &loc,
         loc,
         std::vector<std::shared_ptr<T>>(es));
 }
+
+gg::ast::field_kind unboxed_field_kind(const std::string &type,
+                                       const gg::parser::location_type &loc) {
+    if (type == "int") {
+        return gg::ast::field_kind::int64;
+    }
+    if (type == "double") {
+        return gg::ast::field_kind::float64;
+    }
+    std::stringstream ss;
+    ss << "unknown unboxed field type: " << type;
+    throw gg::ast::bad_parse(ss.str(), loc);
+}
 }
 }
 %define api.token.prefix {TOK_}
@@ -56,13 +69,23 @@ auto make_shared_seq(const gg::parser::location_type &loc,
   CASE       "case"
   OF         "of"
   DEFAULT    "default"
+  DATA       "data"
+  BANG       "!"
 ;
 %token <std::string> VARNAME "varname"
 %token <std::string> CONNAME "conname"
 %token <bool> UPDATEFLAG "updateflag"
 %token <int64_t> INTEGER_LIT "int"
+%token <double> DOUBLE_LIT "double"
+%token <gg::ast::integer_digits> INTEGER_BIG_LIT "Integer"
 %token <gg::ast::primopcode> PRIMOP "primop"
 
+%type <std::shared_ptr<gg::ast::program>> toplevels
+%type <std::shared_ptr<gg::ast::data_declaration>> declaration
+%type <std::shared_ptr<gg::ast::field>> field
+%type <std::shared_ptr<gg::ast::field>> fieldlistelem
+%type <std::shared_ptr<gg::ast::sequence<gg::ast::field>>> fieldlistbody
+%type <std::shared_ptr<gg::ast::sequence<gg::ast::field>>> fieldlist
 %type <std::shared_ptr<gg::ast::sequence<gg::ast::binding>>> bindings
 %type <std::shared_ptr<gg::ast::binding>> binding
 %type <std::shared_ptr<gg::ast::lambda>> lambdaform
@@ -87,12 +110,45 @@ auto make_shared_seq(const gg::parser::location_type &loc,
 %%
 %start program;
 
-program : bindings "<EOF>" { result = $1; }
-        | "\n" bindings "<EOF>" { result = $2; }
-        | bindings "\n" "<EOF>" { result = $1; }
-        | "\n" bindings "\n" "<EOF>" { result = $2; }
+program : toplevels "<EOF>" { result = $1; }
+        | "\n" toplevels "<EOF>" { result = $2; }
+        | toplevels "\n" "<EOF>" { result = $1; }
+        | "\n" toplevels "\n" "<EOF>" { result = $2; }
         ;
 
+toplevels : binding {
+                $$ = std::make_shared<gg::ast::program>(
+                    @$,
+                    make_shared_seq<gg::ast::data_declaration>(@$, {}),
+                    make_shared_seq<gg::ast::binding>(@$, {$1}));
+            }
+          | declaration {
+                $$ = std::make_shared<gg::ast::program>(
+                    @$,
+                    make_shared_seq<gg::ast::data_declaration>(@$, {$1}),
+                    make_shared_seq<gg::ast::binding>(@$, {}));
+            }
+          | toplevels "\n" binding { $1->bindings->elems.push_back($3); $$ = $1; }
+          | toplevels "\n" declaration { $1->declarations->elems.push_back($3); $$ = $1; }
+          ;
+
+declaration : "data" constructor fieldlist { $$ = std::make_shared<gg::ast::data_declaration>(@$, $2, $3); }
+            ;
+
+field : "varname" { $$ = std::make_shared<gg::ast::field>(@$, gg::ast::field_kind::boxed); }
+      | "!" "varname" { $$ = std::make_shared<gg::ast::field>(@$, unboxed_field_kind($2, @2)); }
+      ;
+
+fieldlistelem : field { $$ = $1; }
+              | field "," { $$ = $1; }
+
+fieldlistbody : fieldlistelem { $$ = make_shared_seq<gg::ast::field>(@$, {$1}); }
+              | fieldlistbody fieldlistelem { $1->elems.push_back($2); $$ = $1; }
+
+fieldlist : "{" fieldlistbody "}" { $$ = $2; }
+          | "{" "}" {$$ = make_shared_seq<gg::ast::field>(@$, {}); }
+          ;
+
 bindings : binding { $$ = make_shared_seq<gg::ast::binding>(@$, {$1}); }
          | bindings "\n" binding { $1->elems.push_back($3); $$ = $1; }
          ;
@@ -145,6 +201,8 @@ defaultalt : variable "->" expr "\n" { $$ = std::make_shared<gg::ast::binding_al
            ;
 
 literal : "int" { $$ = std::make_shared<gg::ast::literal>(@$, $1); }
+        | "double" { $$ = std::make_shared<gg::ast::literal>(@$, $1); }
+        | "Integer" { $$ = std::make_shared<gg::ast::literal>(@$, $1); }
         ;
 
 variablelistelem : variable { $$ = $1; }
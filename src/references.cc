@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <utility>
+
+#include "gg/references.h"
+
+namespace gg {
+namespace compiler {
+namespace {
+/**
+   Walks a lambda collecting the uses of top level names which are not
+   shadowed by a local binding.
+*/
+struct reference_walker {
+    const std::unordered_set<std::string>& globals;
+    compiler::scope scope;
+    std::unordered_set<std::string> found;
+
+    reference_walker(const std::unordered_set<std::string>& globals)
+        : globals(globals) {}
+
+    void use(const std::string& name) {
+        if (globals.count(name) && !scope.shadows(name)) {
+            found.insert(name);
+        }
+    }
+
+    void walk_atoms(const ast::sequence<ast::atom>& atoms) {
+        for (const auto& atom : atoms.elems) {
+            if (auto var = std::dynamic_pointer_cast<ast::variable>(atom)) {
+                use(var->name);
+            }
+        }
+    }
+
+    void walk(const ast::lambda& lam) {
+        // the free variables are captured from the enclosing scope
+        for (const auto& var : lam.freevars->elems) {
+            use(var->name);
+        }
+        for (const auto& var : lam.freevars->elems) {
+            scope.bind(var->name);
+        }
+        scope.walk_lambda(lam, [&] { walk(lam.body); });
+        for (const auto& var : lam.freevars->elems) {
+            scope.unbind(var->name);
+        }
+    }
+
+    void walk(const std::shared_ptr<ast::expr>& expr) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            scope.walk_let(*let,
+                           [&](const ast::binding& binding) { walk(*binding.rhs); },
+                           [&] { walk(let->body); });
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            walk(case_->scrutinee);
+            for (const auto& alt : *case_->alts) {
+                scope.walk_alt(*alt, [&] { walk(alt->body); });
+            }
+        }
+        else if (auto con = std::dynamic_pointer_cast<ast::construct>(expr)) {
+            walk_atoms(*con->args);
+        }
+        else if (auto app = std::dynamic_pointer_cast<ast::apply>(expr)) {
+            use(app->var->name);
+            walk_atoms(*app->args);
+        }
+        else if (auto prim = std::dynamic_pointer_cast<ast::prim_apply>(expr)) {
+            walk_atoms(*prim->args);
+        }
+    }
+};
+}
+
+bool is_thunk(const ast::lambda& lam) {
+    return lam.args->elems.empty();
+}
+
+std::vector<std::string> alt_binders(const ast::alternative& alt) {
+    std::vector<std::string> bound;
+    if (auto b = dynamic_cast<const ast::binding_alt*>(&alt)) {
+        bound.emplace_back(b->var->name);
+    }
+    else if (auto a = dynamic_cast<const ast::algebraic_alt*>(&alt)) {
+        for (const auto& var : a->vars->elems) {
+            bound.emplace_back(var->name);
+        }
+    }
+    return bound;
+}
+
+void scope::bind(const std::string& name) {
+    ++shadowed[name];
+}
+
+void scope::unbind(const std::string& name) {
+    --shadowed[name];
+}
+
+bool scope::shadows(const std::string& name) const {
+    auto it = shadowed.find(name);
+    return it != shadowed.end() && it->second;
+}
+
+std::unordered_set<std::string>
+global_references(const ast::lambda& lam,
+                  const std::unordered_set<std::string>& globals) {
+    reference_walker walker(globals);
+    walker.walk(lam);
+    return std::move(walker.found);
+}
+
+std::unordered_set<std::string>
+expr_references(const std::shared_ptr<ast::expr>& expr,
+                const std::unordered_set<std::string>& names) {
+    reference_walker walker(names);
+    walker.walk(expr);
+    return std::move(walker.found);
+}
+
+namespace {
+void collect_names(std::unordered_set<std::string>& names,
+                   const std::shared_ptr<ast::expr>& expr);
+
+void collect_names(std::unordered_set<std::string>& names, const ast::lambda& lam) {
+    for (const auto& arg : lam.args->elems) {
+        names.insert(arg->name);
+    }
+    collect_names(names, lam.body);
+}
+
+void collect_names(std::unordered_set<std::string>& names,
+                   const std::shared_ptr<ast::expr>& expr) {
+    if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+        for (const auto& binding : *let->bindings) {
+            names.insert(binding->lhs->name);
+            collect_names(names, *binding->rhs);
+        }
+        collect_names(names, let->body);
+    }
+    else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+        collect_names(names, case_->scrutinee);
+        for (const auto& alt : *case_->alts) {
+            if (auto b = std::dynamic_pointer_cast<ast::binding_alt>(alt)) {
+                names.insert(b->var->name);
+            }
+            else if (auto a = std::dynamic_pointer_cast<ast::algebraic_alt>(alt)) {
+                for (const auto& var : a->vars->elems) {
+                    names.insert(var->name);
+                }
+            }
+            collect_names(names, alt->body);
+        }
+    }
+}
+}
+
+std::unordered_set<std::string> bound_names(const ast::sequence<ast::binding>& bindings) {
+    std::unordered_set<std::string> names;
+    for (const auto& binding : bindings.elems) {
+        names.insert(binding->lhs->name);
+        collect_names(names, *binding->rhs);
+    }
+    return names;
+}
+
+std::string fresh_name(const std::string& base,
+                       std::unordered_set<std::string>& taken) {
+    for (std::size_t n = 0;; ++n) {
+        std::string name = base + '_' + std::to_string(n);
+        if (taken.insert(name).second) {
+            return name;
+        }
+    }
+}
+
+bool is_caf(const ast::lambda& lam) {
+    return lam.update && lam.args->elems.empty();
+}
+
+srt_map static_reference_tables(ast::sequence<ast::binding>& bindings,
+                                const std::unordered_set<std::string>& external_cafs) {
+    std::unordered_set<std::string> globals = external_cafs;
+    // external names are all at 0 and fall back to ordering by name
+    std::unordered_map<std::string, std::size_t> order;
+    for (const auto& binding : bindings) {
+        globals.insert(binding->lhs->name);
+        order.emplace(binding->lhs->name, order.size() + 1);
+    }
+
+    std::unordered_map<std::string, std::unordered_set<std::string>> refs;
+    std::unordered_map<std::string, std::vector<std::string>> referrers;
+    std::vector<std::string> pending;
+    std::unordered_set<std::string> reaches_caf = external_cafs;
+    for (const auto& binding : bindings) {
+        const std::string& name = binding->lhs->name;
+        refs[name] = global_references(*binding->rhs, globals);
+        for (const auto& ref : refs[name]) {
+            referrers[ref].emplace_back(name);
+        }
+        if (is_caf(*binding->rhs)) {
+            reaches_caf.insert(name);
+            pending.emplace_back(name);
+        }
+    }
+
+    // walk the references backwards from the CAFs
+    while (pending.size()) {
+        std::string name = std::move(pending.back());
+        pending.pop_back();
+        for (const auto& referrer : referrers[name]) {
+            if (reaches_caf.insert(referrer).second) {
+                pending.emplace_back(referrer);
+            }
+        }
+    }
+
+    srt_map srts;
+    for (const auto& binding : bindings) {
+        auto& srt = srts[binding->lhs->name];
+        for (const auto& ref : refs[binding->lhs->name]) {
+            if (reaches_caf.count(ref)) {
+                srt.emplace_back(ref);
+            }
+        }
+        std::sort(srt.begin(), srt.end(), [&](const auto& a, const auto& b) {
+            return std::make_pair(order[a], a) < std::make_pair(order[b], b);
+        });
+    }
+    return srts;
+}
+}
+}
@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <iostream>
+#include <new>
+
+#include "gg/scheduler.h"
+#include "gg/thunk.h"
+
+namespace gg {
+namespace runtime {
+thread_local capability* current_capability = nullptr;
+
+namespace {
+constexpr std::size_t mvar_words = sizeof(mvar) / sizeof(word);
+static_assert(sizeof(mvar) % sizeof(word) == 0, "mvar must be whole words");
+
+std::size_t nursery_blocks(const config& options) {
+    return std::max<std::size_t>(
+        (options.nursery_words + max_block_object_words - 1) /
+            max_block_object_words,
+        1);
+}
+}
+
+// the value is the only field the collector needs to see; the queued
+// threads are kept alive by the scheduler
+const info_table mvar_info = {nullptr,
+                              0,
+                              nullptr,
+                              nullptr,
+                              closure_layout(1, mvar_words - 2),
+                              nullptr};
+
+thread::thread(std::int64_t id, std::size_t stack_words)
+    : id(id), saved(), stack_words(stack_words) {
+    new_stack(saved, stack_words);
+}
+
+thread::~thread() {
+    free_stack(saved);
+    if (spare) {
+        free_chunk(spare);
+    }
+}
+
+capability::capability(scheduler& sched, std::size_t index)
+    : sched(sched), index(index), regs() {
+    std::size_t nblocks = nursery_blocks(sched.options);
+    for (std::size_t n = 0; n < nblocks; ++n) {
+        block* b = sched.memory.allocate_block(nursery_block);
+        b->link = nursery;
+        nursery = b;
+    }
+    reset_nursery();
+}
+
+void capability::reset_nursery() {
+    std::size_t nblocks = nursery_blocks(sched.options);
+
+    block* b = nursery;
+    for (std::size_t n = 1; n < nblocks && b->link; ++n) {
+        b = b->link;
+    }
+    // free the blocks the nursery grew by since the last collection
+    for (block* extra = b->link; extra;) {
+        block* next = extra->link;
+        sched.memory.free_block(extra);
+        extra = next;
+    }
+    b->link = nullptr;
+
+    for (b = nursery; b; b = b->link) {
+        b->free = block_start(b);
+        b->flags = nursery_block;
+    }
+    nursery_current = nursery;
+    regs.hp = nursery->free;
+    restore_hp_limit();
+}
+
+void capability::restore_hp_limit() {
+    // the ticker clears hp_limit from another OS thread
+    __atomic_store_n(&regs.hp_limit, nursery_current->limit, __ATOMIC_RELAXED);
+}
+
+void capability::run(thread& t) {
+    current = &t;
+    // the heap registers belong to the capability
+    regs.next = t.saved.next;
+    regs.node = t.delivered ? t.delivered : t.saved.node;
+    regs.sp = t.saved.sp;
+    regs.sp_limit = t.saved.sp_limit;
+    regs.su = t.saved.su;
+    t.delivered = nullptr;
+    stop = false;
+    context_switch.store(false, std::memory_order_relaxed);
+    restore_hp_limit();
+
+    while (regs.next &&
+           !stop &&
+           !context_switch.load(std::memory_order_relaxed)) {
+        continuation k = regs.next;
+        regs.next = nullptr;
+        k();
+    }
+
+    t.saved.next = regs.next;
+    t.saved.node = regs.node;
+    t.saved.sp = regs.sp;
+    t.saved.sp_limit = regs.sp_limit;
+    t.saved.su = regs.su;
+    if (!regs.next && t.status == thread_status::runnable) {
+        t.status = thread_status::finished;
+    }
+    else if (sched.options.blackholing_mode == blackholing::lazy) {
+        lazy_blackhole(t);
+    }
+    current = nullptr;
+}
+
+scheduler::scheduler(const config& options)
+    : options(options), memory(options.max_heap_bytes), gc(*this, memory, this->options) {
+    std::size_t ncapabilities = std::max<std::size_t>(options.capabilities, 1);
+    for (std::size_t n = 0; n < ncapabilities; ++n) {
+        capabilities.emplace_back(std::make_unique<capability>(*this, n));
+    }
+}
+
+scheduler::~scheduler() {
+    shutdown();
+    report_stats();
+    for (thread* t : threads) {
+        delete t;
+    }
+}
+
+void scheduler::push(thread* t) {
+    t->link = nullptr;
+    if (run_queue_tail) {
+        run_queue_tail->link = t;
+    }
+    else {
+        run_queue_head = t;
+    }
+    run_queue_tail = t;
+    work_available.notify_one();
+}
+
+thread* scheduler::pop() {
+    thread* t = run_queue_head;
+    run_queue_head = t->link;
+    if (!run_queue_head) {
+        run_queue_tail = nullptr;
+    }
+    t->link = nullptr;
+    return t;
+}
+
+thread* scheduler::new_thread(closure* c) {
+    auto t = new thread(next_thread_id++, options.stack_words);
+    t->saved.node = c;
+    t->saved.next = c->info->entry_code;
+    threads.emplace(t);
+    return t;
+}
+
+std::int64_t scheduler::fork(closure* c) {
+    std::lock_guard<std::mutex> guard(lock);
+    thread* t = new_thread(c);
+    push(t);
+    // the thread may already be running, but it cannot be retired until
+    // the lock is released
+    return t->id;
+}
+
+void scheduler::wake(thread* t) {
+    bool requeue;
+    {
+        std::lock_guard<std::mutex> guard(t->lock);
+        t->status = thread_status::runnable;
+        requeue = t->parked;
+        t->parked = false;
+    }
+    // once the thread is back on the run queue it may finish and be freed
+    // at any time, so its lock must already be released
+    if (requeue) {
+        std::lock_guard<std::mutex> guard(lock);
+        push(t);
+    }
+}
+
+void scheduler::retire(thread* t) {
+    if (roots.count(t)) {
+        // keep the result alive until `run_all` takes it
+        --roots_running;
+        main_done.notify_all();
+        return;
+    }
+    threads.erase(t);
+    delete t;
+}
+
+void scheduler::interrupt_all() {
+    for (auto& cap : capabilities) {
+        cap->context_switch.store(true, std::memory_order_relaxed);
+        // fail the next heap check
+        __atomic_store_n(&cap->regs.hp_limit, nullptr, __ATOMIC_RELAXED);
+    }
+}
+
+void scheduler::request_gc() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (gc_requested || shutting_down) {
+        return;
+    }
+    gc_requested = true;
+    interrupt_all();
+    work_available.notify_all();
+}
+
+void scheduler::sync_gc(std::unique_lock<std::mutex>& guard) {
+    std::size_t epoch = gc_epoch;
+    if (++gc_waiting < capabilities.size()) {
+        gc_done.wait(guard, [&] { return gc_epoch != epoch; });
+        return;
+    }
+
+    // every other capability is waiting, so no STG code is running
+    gc.collect(threads, capabilities);
+    gc_waiting = 0;
+    gc_requested = false;
+    ++gc_epoch;
+    gc_done.notify_all();
+}
+
+void scheduler::worker(capability& cap) {
+    current_capability = &cap;
+    gg_base = &cap.regs;
+
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        work_available.wait(guard, [&] {
+            return gc_requested || shutting_down || run_queue_head;
+        });
+        if (gc_requested) {
+            sync_gc(guard);
+            continue;
+        }
+        if (shutting_down) {
+            break;
+        }
+
+        thread* t = pop();
+        ++running;
+        guard.unlock();
+
+        cap.run(*t);
+
+        bool requeue = false;
+        if (t->status == thread_status::blocked) {
+            std::lock_guard<std::mutex> thread_guard(t->lock);
+            // the thread may have been woken before we descheduled it
+            if (t->status == thread_status::blocked) {
+                t->parked = true;
+            }
+            else {
+                requeue = true;
+            }
+        }
+        else if (t->status == thread_status::runnable) {
+            requeue = true;
+        }
+
+        guard.lock();
+        --running;
+        if (requeue) {
+            push(t);
+        }
+        else if (t->status != thread_status::blocked) {
+            retire(t);
+        }
+
+        if (!run_queue_head && !running && roots_running) {
+            // nothing is running, so nothing can ever wake the blocked roots
+            deadlocked = true;
+            main_done.notify_all();
+        }
+    }
+    current_capability = nullptr;
+    gg_base = nullptr;
+}
+
+void scheduler::tick() {
+    std::unique_lock<std::mutex> guard(lock);
+    auto sampled = std::chrono::steady_clock::now();
+    while (!shutting_down) {
+        main_done.wait_for(guard, options.timeslice);
+        interrupt_all();
+
+        auto now = std::chrono::steady_clock::now();
+        if (options.stats_interval.count() && now - sampled >= options.stats_interval) {
+            sampled = now;
+            guard.unlock();
+            rts_stats sample = statistics();
+            std::ostream& out = options.stats_stream ? *options.stats_stream : std::cerr;
+            format_stats_json(out, sample);
+            out << std::endl;
+            guard.lock();
+        }
+    }
+}
+
+void scheduler::shutdown() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        shutting_down = true;
+    }
+    work_available.notify_all();
+    main_done.notify_all();
+    for (auto& w : workers) {
+        w.join();
+    }
+    workers.clear();
+    if (ticker.joinable()) {
+        ticker.join();
+    }
+}
+
+rts_stats scheduler::statistics() {
+    std::lock_guard<std::mutex> guard(lock);
+    rts_stats stats = gc.statistics();
+    for (const auto& cap : capabilities) {
+        stats.thunk_updates += cap->thunk_updates.load(std::memory_order_relaxed);
+    }
+
+    stats.elapsed = run_time;
+    if (in_run) {
+        stats.elapsed += std::chrono::steady_clock::now() - run_started;
+    }
+    else {
+        // nothing is allocating, so the nurseries can be read
+        std::size_t words = gc.young_large_object_words();
+        for (const auto& cap : capabilities) {
+            for (block* b = cap->nursery; b; b = b->link) {
+                word* end = b == cap->nursery_current ? cap->regs.hp : b->free;
+                words += end - block_start(b);
+            }
+        }
+        stats.allocated_bytes += words * sizeof(word);
+    }
+    return stats;
+}
+
+void scheduler::report_stats() {
+    if (options.stats_output == stats_format::none) {
+        return;
+    }
+    rts_stats stats = statistics();
+    std::ostream& out = options.stats_stream ? *options.stats_stream : std::cerr;
+    if (options.stats_output == stats_format::json) {
+        format_stats_json(out, stats);
+        out << std::endl;
+    }
+    else {
+        format_stats(out, stats);
+    }
+}
+
+closure* scheduler::run(closure* main) {
+    return run_all({main})[0];
+}
+
+std::vector<closure*> scheduler::run_all(const std::vector<closure*>& mains) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        shutting_down = false;
+        deadlocked = false;
+        roots_running = mains.size();
+        run_started = std::chrono::steady_clock::now();
+        in_run = true;
+    }
+    std::vector<thread*> started;
+    for (closure* main : mains) {
+        std::lock_guard<std::mutex> guard(lock);
+        thread* t = new_thread(main);
+        roots.emplace(t);
+        started.emplace_back(t);
+        push(t);
+    }
+    for (auto& cap : capabilities) {
+        workers.emplace_back([this, &cap] { worker(*cap); });
+    }
+    ticker = std::thread([this] { tick(); });
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        main_done.wait(guard, [&] { return deadlocked || !roots_running; });
+    }
+    shutdown();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        run_time += std::chrono::steady_clock::now() - run_started;
+        in_run = false;
+    }
+
+    std::vector<closure*> values;
+    std::string killed;
+    bool blocked = false;
+    for (thread* root : started) {
+        std::unique_ptr<thread> t(root);
+        roots.erase(root);
+        threads.erase(root);
+        if (t->status == thread_status::killed && killed.empty()) {
+            killed = t->error;
+        }
+        blocked |= t->status != thread_status::finished &&
+            t->status != thread_status::killed;
+        values.emplace_back(t->saved.node);
+    }
+
+    if (killed.size()) {
+        throw thread_killed(killed);
+    }
+    if (blocked) {
+        throw deadlock();
+    }
+    return values;
+}
+
+namespace {
+/**
+   Deschedule the current thread until another thread wakes it.
+*/
+void block_current(capability& cap) {
+    cap.current->status = thread_status::blocked;
+    cap.stop = true;
+}
+
+void enqueue(thread*& head, thread*& tail, thread* t) {
+    t->link = nullptr;
+    if (tail) {
+        tail->link = t;
+    }
+    else {
+        head = t;
+    }
+    tail = t;
+}
+
+thread* dequeue(thread*& head, thread*& tail) {
+    thread* t = head;
+    if (t) {
+        head = t->link;
+        if (!head) {
+            tail = nullptr;
+        }
+        t->link = nullptr;
+    }
+    return t;
+}
+}
+}
+}
+
+using namespace gg::runtime;
+
+thread_local registers* gg_base = nullptr;
+
+std::int64_t gg_fork(closure* c) {
+    return current_capability->sched.fork(c);
+}
+
+void gg_yield() {
+    current_capability->stop = true;
+}
+
+closure* gg_new_mvar() {
+    closure* c = allocate(*current_capability, mvar_words);
+    new (c) mvar{&mvar_info, nullptr, nullptr, nullptr, nullptr, nullptr, {}};
+    return c;
+}
+
+void gg_take_mvar(closure* c) {
+    auto m = reinterpret_cast<mvar*>(c);
+    capability& cap = *current_capability;
+
+    std::lock_guard<spinlock> guard(m->lock);
+    if (!m->value) {
+        enqueue(m->takers_head, m->takers_tail, cap.current);
+        block_current(cap);
+        return;
+    }
+
+    cap.regs.node = m->value;
+    snapshot_barrier(cap, m->value);
+    if (thread* putter = dequeue(m->putters_head, m->putters_tail)) {
+        m->value = putter->blocked_value;
+        putter->blocked_value = nullptr;
+        write_barrier(cap, c);
+        cap.sched.wake(putter);
+    }
+    else {
+        m->value = nullptr;
+    }
+}
+
+void gg_put_mvar(closure* c, closure* v) {
+    auto m = reinterpret_cast<mvar*>(c);
+    capability& cap = *current_capability;
+
+    std::lock_guard<spinlock> guard(m->lock);
+    if (m->value) {
+        cap.current->blocked_value = v;
+        enqueue(m->putters_head, m->putters_tail, cap.current);
+        block_current(cap);
+        return;
+    }
+
+    if (thread* taker = dequeue(m->takers_head, m->takers_tail)) {
+        taker->delivered = v;
+        cap.sched.wake(taker);
+    }
+    else {
+        m->value = v;
+        write_barrier(cap, c);
+    }
+}
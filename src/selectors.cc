@@ -0,0 +1,106 @@
+#include "gg/selectors.h"
+#include "gg/thunk.h"
+
+namespace gg {
+namespace compiler {
+namespace {
+/**
+   @return The variable an expression consists of, or `nullptr`.
+*/
+const ast::variable* variable_expr(const std::shared_ptr<ast::expr>& expr) {
+    auto app = std::dynamic_pointer_cast<ast::apply>(expr);
+    return app && app->args->elems.empty() ? app->var.get() : nullptr;
+}
+
+/**
+   @return The payload slot the thunk selects, or `max_selector_slot` if
+           it is not a selector thunk.
+*/
+std::size_t selected_slot(const ast::lambda& lam, const constructor_layouts& layouts) {
+    const std::size_t none = runtime::max_selector_slot;
+    auto case_ = std::dynamic_pointer_cast<ast::case_>(lam.body);
+    if (!lam.args->elems.empty() || lam.freevars->elems.size() != 1 || !case_ ||
+        case_->alts->elems.size() != 1) {
+        return none;
+    }
+    const ast::variable* selectee = variable_expr(case_->scrutinee);
+    auto alt = std::dynamic_pointer_cast<ast::algebraic_alt>(case_->alts->elems.front());
+    if (!selectee || selectee->name != lam.freevars->elems.front()->name || !alt) {
+        return none;
+    }
+    const ast::variable* result = variable_expr(alt->body);
+    if (!result) {
+        return none;
+    }
+
+    const auto& vars = alt->vars->elems;
+    std::vector<ast::field_kind> fields(vars.size(), ast::field_kind::boxed);
+    auto layout = layouts.find(alt->con->name);
+    if (layout != layouts.end()) {
+        if (layout->second.size() != vars.size()) {
+            return none;
+        }
+        fields = layout->second;
+    }
+    // a later pattern variable shadows an earlier one of the same name
+    for (std::size_t n = vars.size(); n--;) {
+        if (vars[n]->name == result->name) {
+            if (fields[n] != ast::field_kind::boxed) {
+                return none;
+            }
+            return std::min(field_slots(fields)[n], none);
+        }
+    }
+    return none;
+}
+
+struct finder {
+    const constructor_layouts& layouts;
+    selector_map selectors;
+
+    finder(const constructor_layouts& layouts) : layouts(layouts) {}
+
+    void find_lambda(ast::lambda& lam) {
+        find_expr(lam.body);
+    }
+
+    void find_expr(const std::shared_ptr<ast::expr>& expr) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            for (const auto& binding : *let->bindings) {
+                ast::lambda& lam = *binding->rhs;
+                std::size_t slot = selected_slot(lam, layouts);
+                if (slot < runtime::max_selector_slot) {
+                    // overrides a single entry inferred by
+                    // infer_update_flags: the runtime's selector info
+                    // tables are for updatable thunks, with the result slot
+                    // before the selectee. Entering pays for an update it
+                    // does not need, but until then the collector can drop
+                    // the rest of the constructor, which is the space leak
+                    // this is for.
+                    lam.update = true;
+                    selectors.emplace(&lam, slot);
+                }
+                find_lambda(lam);
+            }
+            find_expr(let->body);
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            find_expr(case_->scrutinee);
+            for (const auto& alt : *case_->alts) {
+                find_expr(alt->body);
+            }
+        }
+    }
+};
+}
+
+selector_map find_selectors(ast::sequence<ast::binding>& bindings,
+                            const constructor_layouts& layouts) {
+    finder f(layouts);
+    for (const auto& binding : bindings) {
+        f.find_lambda(*binding->rhs);
+    }
+    return std::move(f.selectors);
+}
+}
+}
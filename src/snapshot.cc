@@ -0,0 +1,547 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gg/array.h"
+#include "gg/integer.h"
+#include "gg/snapshot.h"
+#include "gg/thunk.h"
+
+namespace gg {
+namespace {
+using runtime::closure;
+using runtime::info_table;
+using runtime::word;
+
+constexpr char image_magic[8] = {'g', 'g', 'i', 'm', 'a', 'g', 'e', '1'};
+
+/**
+   The layout of an image file: the header, then the info tables, the
+   static closures and the roots it uses, then the objects, then the names
+   of everything.
+*/
+struct image_header {
+    char magic[8];
+    word infos;
+    word statics;
+    word roots;
+    word object_words;
+    word string_bytes;
+};
+
+/**
+   A span of the names at the end of an image.
+*/
+struct image_string {
+    word offset;
+    word size;
+};
+
+enum class object_kind : word {
+    constructor,
+    small_integer,
+    big_integer,
+    byte_array,
+    array,
+};
+
+/**
+   An info table, by its constructor's name and fields or by the kind of
+   runtime object it describes.
+*/
+struct image_info {
+    object_kind kind;
+    image_string name;
+
+    /**
+       One character per field: `b`oxed, `i`nt or `d`ouble.
+    */
+    image_string fields;
+};
+
+struct image_root {
+    image_string name;
+    word value;
+};
+
+/**
+   Pointers in an image are null, an object by its offset in words from the
+   start of the objects, or a static closure by its index in the statics.
+*/
+constexpr word null_pointer = 0;
+
+word object_pointer(std::size_t offset) {
+    return (offset + 1) << 1;
+}
+
+word static_pointer(std::size_t index) {
+    return index << 1 | 1;
+}
+
+const info_table* runtime_info(object_kind kind) {
+    switch (kind) {
+    case object_kind::small_integer:
+        return &gg_small_integer_info;
+    case object_kind::big_integer:
+        return &gg_big_integer_info;
+    case object_kind::byte_array:
+        return &runtime::byte_array_info;
+    case object_kind::array:
+        return &runtime::array_info;
+    default:
+        return nullptr;
+    }
+}
+
+/**
+   The words of an object before its size is known.
+*/
+std::size_t header_words(object_kind kind) {
+    switch (kind) {
+    case object_kind::big_integer:
+    case object_kind::byte_array:
+    case object_kind::array:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+/**
+   The size of an object and where its pointer fields are, as word indices
+   from its info table pointer.
+*/
+struct object_shape {
+    std::size_t words;
+    std::size_t first_pointer;
+    std::size_t pointers;
+};
+
+object_shape shape_of(object_kind kind, const closure* c) {
+    switch (kind) {
+    case object_kind::constructor:
+        return {runtime::closure_size(c->info), 1, runtime::closure_pointers(c->info)};
+    case object_kind::small_integer:
+        return {runtime::small_integer_words, 0, 0};
+    case object_kind::big_integer: {
+        std::int64_t size = reinterpret_cast<const runtime::big_integer*>(c)->size;
+        return {runtime::big_integer_words(size < 0 ? -size : size), 0, 0};
+    }
+    case object_kind::byte_array:
+        return {runtime::byte_array_words(
+                    reinterpret_cast<const runtime::byte_array*>(c)->bytes),
+                0,
+                0};
+    case object_kind::array: {
+        std::size_t size = reinterpret_cast<const runtime::array*>(c)->size;
+        return {runtime::array_words(size), runtime::array_header_words, size};
+    }
+    }
+    __builtin_unreachable();
+}
+
+char field_code(ast::field_kind kind) {
+    switch (kind) {
+    case ast::field_kind::boxed:
+        return 'b';
+    case ast::field_kind::int64:
+        return 'i';
+    case ast::field_kind::float64:
+        return 'd';
+    }
+    __builtin_unreachable();
+}
+
+std::string field_codes(const std::vector<ast::field_kind>& fields) {
+    std::string codes;
+    for (ast::field_kind kind : fields) {
+        codes += field_code(kind);
+    }
+    return codes;
+}
+
+/**
+   Copy everything reachable from the values of the evaluated CAFs.
+   Objects are numbered in the order they are found, which is the order
+   they are written in.
+*/
+struct image_writer {
+private:
+    const compiler::session& compiled;
+
+    /**
+       The name of each top level binding, by its static closure.
+    */
+    std::unordered_map<const void*, const std::string*> names;
+
+    std::string strings;
+    std::vector<image_info> infos;
+    std::unordered_map<const info_table*, word> info_indices;
+    std::vector<image_string> statics;
+    std::unordered_map<const void*, word> static_indices;
+    std::vector<image_root> roots;
+
+    std::vector<const closure*> found;
+    std::unordered_map<const closure*, std::size_t> offsets;
+    std::size_t object_words = 0;
+
+    image_string intern(const std::string& s) {
+        image_string span{strings.size(), s.size()};
+        strings += s;
+        return span;
+    }
+
+    object_kind kind_of(const closure* c) const {
+        for (object_kind kind : {object_kind::small_integer,
+                                 object_kind::big_integer,
+                                 object_kind::byte_array,
+                                 object_kind::array}) {
+            if (c->info == runtime_info(kind)) {
+                return kind;
+            }
+        }
+        if (compiled.describe(c->info)) {
+            return object_kind::constructor;
+        }
+        if (c->info == &runtime::mutable_byte_array_info ||
+            c->info == &runtime::mutable_array_info) {
+            throw bad_snapshot("cannot save a mutable array");
+        }
+        throw bad_snapshot("cannot save a thunk, function or runtime object");
+    }
+
+    word info_index(const info_table* info, object_kind kind) {
+        auto it = info_indices.find(info);
+        if (it != info_indices.end()) {
+            return it->second;
+        }
+        image_info entry{kind, {0, 0}, {0, 0}};
+        if (kind == object_kind::constructor) {
+            const compiler::constructor_description* con = compiled.describe(info);
+            entry.name = intern(con->name);
+            entry.fields = intern(field_codes(con->fields));
+        }
+        word index = infos.size();
+        infos.emplace_back(entry);
+        info_indices.emplace(info, index);
+        return index;
+    }
+
+    word encode(const closure* c) {
+        if (!c) {
+            return null_pointer;
+        }
+        while (true) {
+            auto name = names.find(c);
+            if (name != names.end()) {
+                auto [it, added] = static_indices.emplace(c, statics.size());
+                if (added) {
+                    statics.emplace_back(intern(*name->second));
+                }
+                return static_pointer(it->second);
+            }
+            if (c->info != &runtime::indirection_info) {
+                break;
+            }
+            c = reinterpret_cast<const closure*>(c->payload[runtime::thunk_result_slot]);
+        }
+
+        auto it = offsets.find(c);
+        if (it != offsets.end()) {
+            return object_pointer(it->second);
+        }
+        std::size_t offset = object_words;
+        object_words += shape_of(kind_of(c), c).words;
+        offsets.emplace(c, offset);
+        found.emplace_back(c);
+        return object_pointer(offset);
+    }
+
+public:
+    image_writer(const compiler::session& compiled) : compiled(compiled) {
+        for (const auto& [name, address] : compiled.linked_bindings().closures) {
+            names.emplace(address, &name);
+        }
+    }
+
+    void write(std::ostream& out) {
+        std::vector<std::string> cafs;
+        for (const auto& [name, address] : compiled.linked_bindings().closures) {
+            if (static_cast<closure*>(address)->info == &runtime::indirection_info) {
+                cafs.emplace_back(name);
+            }
+        }
+        std::sort(cafs.begin(), cafs.end());
+        for (const std::string& name : cafs) {
+            auto c = static_cast<closure*>(compiled.linked_bindings().closures.at(name));
+            roots.push_back({intern(name),
+                             encode(reinterpret_cast<const closure*>(
+                                 c->payload[runtime::thunk_result_slot]))});
+        }
+
+        // encoding the fields of an object finds more objects
+        std::vector<word> objects;
+        for (std::size_t n = 0; n < found.size(); ++n) {
+            const closure* c = found[n];
+            object_kind kind = kind_of(c);
+            object_shape shape = shape_of(kind, c);
+            auto words = reinterpret_cast<const word*>(c);
+            std::size_t start = objects.size();
+            objects.insert(objects.end(), words, words + shape.words);
+            objects[start] = info_index(c->info, kind);
+            for (std::size_t k = 0; k < shape.pointers; ++k) {
+                std::size_t slot = start + shape.first_pointer + k;
+                objects[slot] = encode(reinterpret_cast<const closure*>(objects[slot]));
+            }
+        }
+
+        image_header header;
+        std::memcpy(header.magic, image_magic, sizeof(image_magic));
+        header.infos = infos.size();
+        header.statics = statics.size();
+        header.roots = roots.size();
+        header.object_words = objects.size();
+        header.string_bytes = strings.size();
+
+        auto put = [&out](const auto* data, std::size_t count) {
+            out.write(reinterpret_cast<const char*>(data), count * sizeof(*data));
+        };
+        put(&header, 1);
+        put(infos.data(), infos.size());
+        put(statics.data(), statics.size());
+        put(roots.data(), roots.size());
+        put(objects.data(), objects.size());
+        put(strings.data(), strings.size());
+    }
+};
+
+/**
+   Check and relocate a mapped image in place.
+*/
+struct image_reader {
+private:
+    const compiler::session& compiled;
+    char* base;
+    std::size_t bytes;
+    std::size_t position = 0;
+
+    const image_header* header;
+    const image_info* infos;
+    const image_string* statics;
+    const image_root* roots;
+    word* objects;
+    const char* strings;
+
+    std::vector<const info_table*> info_tables;
+    std::vector<object_kind> kinds;
+    std::vector<closure*> static_closures;
+
+    /**
+       Which words of the objects start an object.
+    */
+    std::vector<bool> starts;
+
+    template<typename T>
+    T* section(std::size_t count) {
+        if (count > (bytes - position) / sizeof(T)) {
+            throw bad_snapshot("image is truncated");
+        }
+        auto p = reinterpret_cast<T*>(base + position);
+        position += count * sizeof(T);
+        return p;
+    }
+
+    std::string string_at(const image_string& s) const {
+        if (s.offset > header->string_bytes || s.size > header->string_bytes - s.offset) {
+            throw bad_snapshot("image is malformed");
+        }
+        return std::string(strings + s.offset, s.size);
+    }
+
+    closure* decode(word pointer) const {
+        if (pointer == null_pointer) {
+            return nullptr;
+        }
+        if (pointer & 1) {
+            std::size_t index = pointer >> 1;
+            if (index >= static_closures.size()) {
+                throw bad_snapshot("image is malformed");
+            }
+            return static_closures[index];
+        }
+        std::size_t offset = (pointer >> 1) - 1;
+        if (offset >= starts.size() || !starts[offset]) {
+            throw bad_snapshot("image is malformed");
+        }
+        return reinterpret_cast<closure*>(objects + offset);
+    }
+
+    void resolve_infos() {
+        const compiler::linkage& linked = compiled.linked_bindings();
+        for (std::size_t n = 0; n < header->infos; ++n) {
+            const image_info& entry = infos[n];
+            if (entry.kind > object_kind::array) {
+                throw bad_snapshot("image is malformed");
+            }
+            const info_table* info = runtime_info(entry.kind);
+            if (entry.kind == object_kind::constructor) {
+                std::string name = string_at(entry.name);
+                auto it = linked.constructors.find(name);
+                if (it == linked.constructors.end()) {
+                    throw bad_snapshot("image uses unknown constructor " + name);
+                }
+                info = static_cast<const info_table*>(it->second);
+                const compiler::constructor_description* con = compiled.describe(info);
+                if (!con || field_codes(con->fields) != string_at(entry.fields)) {
+                    throw bad_snapshot("constructor " + name +
+                                       " has different fields in the image");
+                }
+            }
+            info_tables.emplace_back(info);
+            kinds.emplace_back(entry.kind);
+        }
+
+        for (std::size_t n = 0; n < header->statics; ++n) {
+            std::string name = string_at(statics[n]);
+            auto it = linked.closures.find(name);
+            if (it == linked.closures.end()) {
+                throw bad_snapshot("image uses unknown binding " + name);
+            }
+            static_closures.emplace_back(static_cast<closure*>(it->second));
+        }
+    }
+
+    void relocate() {
+        std::size_t words = header->object_words;
+        starts.assign(words, false);
+
+        // set the info tables first: the shapes of constructors come from
+        // them
+        std::vector<std::pair<std::size_t, object_kind>> found;
+        for (std::size_t offset = 0; offset < words;) {
+            std::size_t index = objects[offset];
+            if (index >= info_tables.size() ||
+                header_words(kinds[index]) > words - offset) {
+                throw bad_snapshot("image is malformed");
+            }
+            auto c = reinterpret_cast<closure*>(objects + offset);
+            c->info = info_tables[index];
+            object_shape shape = shape_of(kinds[index], c);
+            if (shape.words > words - offset) {
+                throw bad_snapshot("image is malformed");
+            }
+            starts[offset] = true;
+            found.emplace_back(offset, kinds[index]);
+            offset += shape.words;
+        }
+
+        for (const auto& [offset, kind] : found) {
+            auto c = reinterpret_cast<closure*>(objects + offset);
+            object_shape shape = shape_of(kind, c);
+            for (std::size_t k = 0; k < shape.pointers; ++k) {
+                word& field = objects[offset + shape.first_pointer + k];
+                field = reinterpret_cast<word>(decode(field));
+            }
+        }
+    }
+
+public:
+    image_reader(const compiler::session& compiled, void* base, std::size_t bytes)
+        : compiled(compiled), base(static_cast<char*>(base)), bytes(bytes) {
+        header = section<const image_header>(1);
+        if (std::memcmp(header->magic, image_magic, sizeof(image_magic))) {
+            throw bad_snapshot("not an image");
+        }
+        infos = section<const image_info>(header->infos);
+        statics = section<const image_string>(header->statics);
+        roots = section<const image_root>(header->roots);
+        objects = section<word>(header->object_words);
+        strings = section<const char>(header->string_bytes);
+    }
+
+    void load() {
+        resolve_infos();
+        relocate();
+
+        const compiler::linkage& linked = compiled.linked_bindings();
+        std::vector<std::pair<closure*, closure*>> values;
+        for (std::size_t n = 0; n < header->roots; ++n) {
+            std::string name = string_at(roots[n].name);
+            auto it = linked.closures.find(name);
+            closure* value = decode(roots[n].value);
+            if (it == linked.closures.end() || !linked.cafs.count(name) || !value) {
+                throw bad_snapshot("image sets " + name + ", which is not a CAF");
+            }
+            values.emplace_back(static_cast<closure*>(it->second), value);
+        }
+
+        // only change the program once the whole image has been checked
+        for (const auto& [caf, value] : values) {
+            caf->payload[runtime::thunk_result_slot] = reinterpret_cast<word>(value);
+            caf->info = &runtime::indirection_info;
+        }
+    }
+};
+}
+
+snapshot_image::snapshot_image(void* base, std::size_t bytes) : base(base), bytes(bytes) {}
+
+snapshot_image::snapshot_image(snapshot_image&& other)
+    : base(std::exchange(other.base, nullptr)), bytes(std::exchange(other.bytes, 0)) {}
+
+snapshot_image& snapshot_image::operator=(snapshot_image&& other) {
+    std::swap(base, other.base);
+    std::swap(bytes, other.bytes);
+    return *this;
+}
+
+snapshot_image::~snapshot_image() {
+    if (base) {
+        munmap(base, bytes);
+    }
+}
+
+void save_snapshot(const compiler::session& compiled, const std::string& path) {
+    image_writer writer(compiled);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    writer.write(out);
+    out.close();
+    if (!out) {
+        throw bad_snapshot("cannot write " + path);
+    }
+}
+
+snapshot_image load_snapshot(const compiler::session& compiled, const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw bad_snapshot("cannot read " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) || static_cast<std::size_t>(st.st_size) < sizeof(image_header)) {
+        close(fd);
+        throw bad_snapshot(path + " is not an image");
+    }
+
+    // a private mapping: relocating writes to our own copy of the pages
+    std::size_t bytes = st.st_size;
+    void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw bad_snapshot("cannot map " + path);
+    }
+    snapshot_image image(base, bytes);
+
+    image_reader(compiled, base, bytes).load();
+    mprotect(base, bytes, PROT_READ);
+    return image;
+}
+}
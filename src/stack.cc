@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <new>
+
+#include "gg/scheduler.h"
+#include "gg/stack.h"
+#include "gg/thunk.h"
+
+namespace gg {
+namespace runtime {
+namespace {
+void stop_frame_entry() {
+    current_capability->regs.next = nullptr;
+}
+
+void underflow_frame_entry() {
+    capability& cap = *current_capability;
+    registers& regs = cap.regs;
+    thread* t = cap.current;
+
+    stack_chunk* chunk = chunk_of(regs.sp_limit);
+    stack_chunk* prev = chunk->prev;
+    regs.sp = prev->saved_sp;
+    regs.sp_limit = prev->data;
+    t->stack_words -= chunk->words;
+
+    // hold on to one chunk so that a function which keeps calling across
+    // a chunk boundary does not allocate each time
+    if (t->spare && t->spare->words >= chunk->words) {
+        free_chunk(chunk);
+    }
+    else {
+        if (t->spare) {
+            free_chunk(t->spare);
+        }
+        t->spare = chunk;
+    }
+
+    // return the value to the top frame of the previous chunk
+    regs.next = reinterpret_cast<const info_table*>(regs.sp[0])->entry_code;
+}
+}
+
+const info_table stop_frame_info = {stop_frame_entry,
+                                    0,
+                                    nullptr,
+                                    nullptr,
+                                    frame_layout(0, 0),
+                                    nullptr};
+
+const info_table underflow_frame_info = {underflow_frame_entry,
+                                         0,
+                                         nullptr,
+                                         nullptr,
+                                         frame_layout(0, 0),
+                                         nullptr};
+
+stack_chunk* new_chunk(std::size_t words) {
+    void* mem = ::operator new(sizeof(stack_chunk) + words * sizeof(word));
+    auto chunk = new(mem) stack_chunk;
+    chunk->prev = nullptr;
+    chunk->saved_sp = nullptr;
+    chunk->words = words;
+    return chunk;
+}
+
+void free_chunk(stack_chunk* chunk) {
+    ::operator delete(chunk);
+}
+
+void new_stack(registers& regs, std::size_t words) {
+    stack_chunk* chunk = new_chunk(words);
+    regs.sp_limit = chunk->data;
+    regs.sp = chunk->data + words - 1;
+    regs.sp[0] = reinterpret_cast<word>(&stop_frame_info);
+    regs.su = nullptr;
+}
+
+void free_stack(registers& regs) {
+    stack_chunk* chunk = chunk_of(regs.sp_limit);
+    while (chunk) {
+        stack_chunk* prev = chunk->prev;
+        free_chunk(chunk);
+        chunk = prev;
+    }
+    regs.sp = regs.sp_limit = regs.su = nullptr;
+}
+}
+}
+
+using namespace gg::runtime;
+
+int gg_grow_stack(std::size_t words) {
+    capability& cap = *current_capability;
+    registers& regs = cap.regs;
+    thread* t = cap.current;
+    const config& options = cap.sched.options;
+
+    // leave room for the underflow frame
+    std::size_t needed = words + 1;
+    bool reuse = t->spare && t->spare->words >= needed;
+    std::size_t size = reuse ? t->spare->words
+                             : std::max(options.stack_chunk_words, needed);
+    if (t->stack_words + size > options.max_stack_words) {
+        raise(cap, stack_overflow_closure);
+        return 0;
+    }
+    stack_chunk* chunk;
+    if (reuse) {
+        chunk = t->spare;
+        t->spare = nullptr;
+    }
+    else {
+        chunk = new_chunk(size);
+    }
+
+    chunk->prev = chunk_of(regs.sp_limit);
+    chunk->prev->saved_sp = regs.sp;
+    t->stack_words += chunk->words;
+
+    regs.sp_limit = chunk->data;
+    regs.sp = chunk->data + chunk->words - 1;
+    regs.sp[0] = reinterpret_cast<word>(&underflow_frame_info);
+    return 1;
+}
@@ -0,0 +1,67 @@
+#include <iomanip>
+#include <locale>
+
+#include "gg/stats.h"
+
+namespace gg {
+namespace runtime {
+namespace {
+double seconds(std::chrono::nanoseconds t) {
+    return std::chrono::duration<double>(t).count();
+}
+
+/**
+   Group the digits of counts in threes, whatever the global locale.
+*/
+struct thousands : std::numpunct<char> {
+    char do_thousands_sep() const {
+        return ',';
+    }
+
+    std::string do_grouping() const {
+        return "\3";
+    }
+};
+}
+
+void format_stats(std::ostream& out, const rts_stats& stats) {
+    std::ostream text(out.rdbuf());
+    text.imbue(std::locale(std::locale::classic(), new thousands));
+
+    text << std::setw(20) << stats.allocated_bytes << " bytes allocated in the heap\n"
+         << std::setw(20) << stats.copied_bytes << " bytes copied during GC\n"
+         << std::setw(20) << stats.max_residency_bytes << " bytes maximum residency\n"
+         << std::setw(20) << stats.thunk_updates << " thunk updates\n\n";
+
+    text << std::fixed << std::setprecision(3)
+         << "  minor collections " << std::setw(10) << stats.minor_collections
+         << "   " << seconds(stats.minor_gc_time) << "s\n"
+         << "  major collections " << std::setw(10) << stats.major_collections
+         << "   " << seconds(stats.major_gc_time) << "s\n"
+         << "  concurrent cycles " << std::setw(10) << stats.concurrent_cycles << '\n'
+         << "  longest pause     " << std::setw(10) << seconds(stats.max_pause) << "s\n\n"
+         << "  mutator time      " << std::setw(10) << seconds(stats.mutator_time()) << "s\n"
+         << "  GC time           " << std::setw(10) << seconds(stats.gc_time()) << "s\n"
+         << "  total time        " << std::setw(10) << seconds(stats.elapsed) << "s\n";
+}
+
+void format_stats_json(std::ostream& out, const rts_stats& stats) {
+    std::ostream json(out.rdbuf());
+    json.imbue(std::locale::classic());
+    json << std::setprecision(9)
+         << "{\"allocated_bytes\":" << stats.allocated_bytes
+         << ",\"copied_bytes\":" << stats.copied_bytes
+         << ",\"minor_collections\":" << stats.minor_collections
+         << ",\"major_collections\":" << stats.major_collections
+         << ",\"concurrent_cycles\":" << stats.concurrent_cycles
+         << ",\"minor_gc_seconds\":" << seconds(stats.minor_gc_time)
+         << ",\"major_gc_seconds\":" << seconds(stats.major_gc_time)
+         << ",\"max_pause_seconds\":" << seconds(stats.max_pause)
+         << ",\"max_residency_bytes\":" << stats.max_residency_bytes
+         << ",\"thunk_updates\":" << stats.thunk_updates
+         << ",\"mutator_seconds\":" << seconds(stats.mutator_time())
+         << ",\"gc_seconds\":" << seconds(stats.gc_time())
+         << ",\"elapsed_seconds\":" << seconds(stats.elapsed) << '}';
+}
+}
+}
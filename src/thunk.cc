@@ -0,0 +1,315 @@
+#include <array>
+#include <functional>
+#include <mutex>
+
+#include "gg/gc.h"
+#include "gg/stack.h"
+#include "gg/thunk.h"
+
+namespace gg {
+namespace runtime {
+namespace {
+/**
+   Blackholes are woken under a lock picked by the address of the thunk so
+   that unrelated updates do not contend.
+*/
+std::array<spinlock, 64> blackhole_locks;
+
+spinlock& lock_for(closure* c) {
+    return blackhole_locks[std::hash<closure*>{}(c) % blackhole_locks.size()];
+}
+
+const info_table* load_info(closure* c) {
+    return __atomic_load_n(&c->info, __ATOMIC_ACQUIRE);
+}
+
+/**
+   Is the closure a thunk currently being evaluated by the given thread?
+*/
+bool under_evaluation_by(const registers& regs, closure* c) {
+    for (word* frame = regs.su; frame; frame = reinterpret_cast<word*>(frame[2])) {
+        if (reinterpret_cast<closure*>(frame[1]) == c) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void blackhole_entry() {
+    capability& cap = *current_capability;
+    closure* c = cap.regs.node;
+
+    if (under_evaluation_by(cap.regs, c)) {
+        raise(cap, nontermination_closure);
+        return;
+    }
+
+    std::lock_guard<spinlock> guard(lock_for(c));
+    const info_table* info = load_info(c);
+    if (info != &blackhole_info && info != &blocking_blackhole_info) {
+        // the thunk was updated before we took the lock
+        cap.regs.next = info->entry_code;
+        return;
+    }
+
+    thread* t = cap.current;
+    t->link = info == &blocking_blackhole_info ?
+        reinterpret_cast<thread*>(c->payload[thunk_result_slot]) :
+        nullptr;
+    c->payload[thunk_result_slot] = reinterpret_cast<word>(t);
+    __atomic_store_n(&c->info, &blocking_blackhole_info, __ATOMIC_RELEASE);
+
+    // re-enter the thunk once it has been updated
+    t->status = thread_status::blocked;
+    cap.stop = true;
+    cap.regs.next = blackhole_entry;
+}
+
+/**
+   Enter `node`, or return it to the frame on top of the stack if it is
+   already a value.
+*/
+void evaluate(registers& regs) {
+    regs.node = follow_indirections(regs.node);
+    const info_table* info = load_info(regs.node);
+    if (info->entry_code && !info->arity) {
+        regs.next = info->entry_code;
+    }
+    else {
+        regs.next = reinterpret_cast<const info_table*>(regs.sp[0])->entry_code;
+    }
+}
+
+// the value may be a constructor or function, which have no code to enter
+void indirection_entry() {
+    evaluate(current_capability->regs);
+}
+
+void update_frame_entry() {
+    registers& regs = current_capability->regs;
+    word* frame = regs.sp;
+    auto updatee = reinterpret_cast<closure*>(frame[1]);
+    regs.su = reinterpret_cast<word*>(frame[2]);
+    regs.sp += update_frame_words;
+
+    gg_update(updatee, regs.node);
+
+    // return the value to the next frame
+    regs.next = reinterpret_cast<const info_table*>(regs.sp[0])->entry_code;
+}
+
+void error_entry() {
+    capability& cap = *current_capability;
+    raise(cap, *reinterpret_cast<error_closure*>(cap.regs.node));
+}
+
+void selector_frame_entry();
+
+using selector_frames = std::array<info_table, max_selector_slot>;
+
+/**
+   The frame a selector thunk pushes while its selectee is evaluated; one
+   word, and which one tells the slot.
+*/
+constexpr selector_frames make_selector_frames() {
+    selector_frames infos{};
+    for (auto& info : infos) {
+        info = {selector_frame_entry, 0, nullptr, nullptr, frame_layout(0, 0), nullptr};
+    }
+    return infos;
+}
+
+const selector_frames selector_frame_infos = make_selector_frames();
+
+void selector_frame_entry() {
+    registers& regs = current_capability->regs;
+    std::size_t slot =
+        reinterpret_cast<const info_table*>(regs.sp[0]) - selector_frame_infos.data();
+    regs.sp += 1;
+    regs.node = reinterpret_cast<closure*>(
+        follow_indirections(regs.node)->payload[slot]);
+    evaluate(regs);
+}
+
+void selector_entry() {
+    capability& cap = *current_capability;
+    registers& regs = cap.regs;
+    closure* c = regs.node;
+    // eager blackholing overwrites the info table
+    std::size_t slot = selector_slot(load_info(c));
+    auto selectee = reinterpret_cast<closure*>(c->payload[selectee_slot]);
+    if (!gg_enter_thunk(c)) {
+        return;
+    }
+    if (regs.sp - 1 < regs.sp_limit && !gg_grow_stack(1)) {
+        return;
+    }
+    regs.sp -= 1;
+    regs.sp[0] = reinterpret_cast<word>(&selector_frame_infos[slot]);
+    regs.node = selectee;
+    evaluate(regs);
+}
+
+using selector_infos = std::array<info_table, max_selector_slot>;
+
+constexpr selector_infos make_selector_infos() {
+    selector_infos infos{};
+    for (auto& info : infos) {
+        info = {selector_entry, 0, nullptr, nullptr, closure_layout(2, 0), nullptr};
+    }
+    return infos;
+}
+}
+
+
+// a blackhole no longer keeps the free variables of the thunk alive, and
+// the waiting threads are kept alive by the scheduler
+const info_table blackhole_info = {blackhole_entry,
+                                   0,
+                                   nullptr,
+                                   nullptr,
+                                   closure_layout(0, 1),
+                                   nullptr};
+const info_table blocking_blackhole_info = {blackhole_entry,
+                                            0,
+                                            nullptr,
+                                            nullptr,
+                                            closure_layout(0, 1),
+                                            nullptr};
+const info_table indirection_info = {indirection_entry,
+                                     0,
+                                     nullptr,
+                                     nullptr,
+                                     closure_layout(1, 0),
+                                     nullptr};
+
+// the updatee is a closure, the link to the previous update frame is not
+const info_table update_frame_info = {update_frame_entry,
+                                      0,
+                                      nullptr,
+                                      nullptr,
+                                      frame_layout(2, 0b01),
+                                      nullptr};
+
+const info_table error_info = {error_entry, 0, nullptr, nullptr, 0, nullptr};
+
+error_closure nontermination_closure = {&error_info, "<<loop>>"};
+error_closure stack_overflow_closure = {&error_info, "stack overflow"};
+error_closure heap_overflow_closure = {&error_info, "heap overflow"};
+error_closure match_failure_closure = {&error_info, "no alternative matched"};
+
+void lazy_blackhole(thread& t) {
+    for (word* frame = t.saved.su; frame; frame = reinterpret_cast<word*>(frame[2])) {
+        auto c = reinterpret_cast<closure*>(frame[1]);
+        const info_table* info = load_info(c);
+        if (info == &blackhole_info || info == &blocking_blackhole_info) {
+            // everything below here was blackholed the last time the
+            // thread was descheduled
+            break;
+        }
+        if (info != &indirection_info) {
+            snapshot_barrier_fields(*current_capability, c);
+            // another thread may be racing to claim the same thunk, in
+            // which case both evaluate it
+            __atomic_compare_exchange_n(&c->info,
+                                        &info,
+                                        &blackhole_info,
+                                        false,
+                                        __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE);
+        }
+    }
+}
+
+void raise(capability& cap, error_closure& error) {
+    auto error_value = reinterpret_cast<closure*>(&error);
+    for (word* frame = cap.regs.su; frame; frame = reinterpret_cast<word*>(frame[2])) {
+        gg_update(reinterpret_cast<closure*>(frame[1]), error_value);
+    }
+    cap.regs.su = nullptr;
+    cap.regs.next = nullptr;
+    cap.current->error = error.message;
+    cap.current->status = thread_status::killed;
+    cap.stop = true;
+}
+}
+}
+
+using namespace gg::runtime;
+
+const selector_infos gg_selector_info = make_selector_infos();
+
+int gg_enter_thunk(closure* c) {
+    capability& cap = *current_capability;
+    registers& regs = cap.regs;
+
+    if (regs.sp - update_frame_words < regs.sp_limit &&
+        !gg_grow_stack(update_frame_words)) {
+        return 0;
+    }
+
+    if (cap.sched.options.blackholing_mode == blackholing::eager) {
+        snapshot_barrier_fields(cap, c);
+        const info_table* info = load_info(c);
+        if (info == &blackhole_info ||
+            info == &blocking_blackhole_info ||
+            info == &indirection_info ||
+            !__atomic_compare_exchange_n(&c->info,
+                                         &info,
+                                         &blackhole_info,
+                                         false,
+                                         __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE)) {
+            // another thread claimed the thunk first
+            regs.node = c;
+            regs.next = load_info(c)->entry_code;
+            return 0;
+        }
+    }
+
+    regs.sp -= update_frame_words;
+    regs.sp[0] = reinterpret_cast<word>(&update_frame_info);
+    regs.sp[1] = reinterpret_cast<word>(c);
+    regs.sp[2] = reinterpret_cast<word>(regs.su);
+    regs.su = regs.sp;
+    return 1;
+}
+
+int gg_enter_caf(closure* c, const info_table* info) {
+    if (!gg_enter_thunk(c)) {
+        return 0;
+    }
+    current_capability->sched.gc.add_caf(c, info);
+    return 1;
+}
+
+void gg_update(closure* updatee, closure* value) {
+    capability& cap = *current_capability;
+    thread* waiters = nullptr;
+    {
+        std::lock_guard<spinlock> guard(lock_for(updatee));
+        // the free variables of a thunk which was never blackholed
+        snapshot_barrier_fields(cap, updatee);
+        if (load_info(updatee) == &blocking_blackhole_info) {
+            waiters = reinterpret_cast<thread*>(
+                updatee->payload[thunk_result_slot]);
+        }
+        updatee->payload[thunk_result_slot] = reinterpret_cast<word>(value);
+        __atomic_store_n(&updatee->info, &indirection_info, __ATOMIC_RELEASE);
+    }
+
+    write_barrier(cap, updatee);
+    cap.thunk_updates.store(cap.thunk_updates.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+    scheduler& sched = cap.sched;
+    while (waiters) {
+        thread* t = waiters;
+        waiters = t->link;
+        t->link = nullptr;
+        sched.wake(t);
+    }
+}
+
+void gg_match_failure() {
+    raise(*current_capability, match_failure_closure);
+}
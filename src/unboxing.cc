@@ -0,0 +1,642 @@
+#include <algorithm>
+#include <sstream>
+#include <unordered_set>
+
+#include "gg/freevars.h"
+#include "gg/references.h"
+#include "gg/unboxing.h"
+
+namespace gg {
+namespace compiler {
+namespace {
+/**
+   @return Whether `con` is a box: a constructor with a single strict field.
+*/
+bool is_box(const constructor_layouts& layouts, const std::string& con) {
+    auto it = layouts.find(con);
+    return it != layouts.end() &&
+        it->second.size() == 1 &&
+        it->second[0] != ast::field_kind::boxed;
+}
+
+/**
+   The box to use for each type of strict field. If there are several, the
+   first by name is used so that the choice does not depend on hashing.
+*/
+std::unordered_map<ast::field_kind, std::string>
+find_boxes(const constructor_layouts& layouts) {
+    std::unordered_map<ast::field_kind, std::string> boxes;
+    for (const auto& [name, fields] : layouts) {
+        if (!is_box(layouts, name)) {
+            continue;
+        }
+        auto [it, inserted] = boxes.emplace(fields[0], name);
+        if (!inserted && name < it->second) {
+            it->second = name;
+        }
+    }
+    return boxes;
+}
+
+auto variable_sequence(const location& loc, const std::vector<std::string>& names) {
+    std::vector<std::shared_ptr<ast::variable>> vars;
+    for (const auto& name : names) {
+        vars.emplace_back(std::make_shared<ast::variable>(loc, name));
+    }
+    return std::make_shared<ast::sequence<ast::variable>>(loc, vars);
+}
+
+/**
+   @return `case boxed {} of box {raw} -> body`
+*/
+std::shared_ptr<ast::expr> unbox(const location& loc,
+                                 const std::string& boxed,
+                                 const std::string& box,
+                                 const std::string& raw,
+                                 const std::shared_ptr<ast::expr>& body) {
+    auto scrutinee = std::make_shared<ast::apply>(
+        loc,
+        std::make_shared<ast::variable>(loc, boxed),
+        std::make_shared<ast::sequence<ast::atom>>(
+            loc,
+            std::vector<std::shared_ptr<ast::atom>>{}));
+    std::vector<std::shared_ptr<ast::alternative>> alts = {
+        std::make_shared<ast::algebraic_alt>(
+            loc,
+            std::make_shared<ast::constructor>(loc, box),
+            variable_sequence(loc, {raw}),
+            body),
+    };
+    return std::make_shared<ast::case_>(
+        loc,
+        scrutinee,
+        std::make_shared<ast::sequence<ast::alternative>>(loc, alts));
+}
+
+/**
+   Tracks which variables in scope hold raw values.
+*/
+struct raw_scopes {
+    const constructor_layouts& layouts;
+
+    /**
+       Whether each name in scope holds a raw value, innermost last.
+    */
+    std::unordered_map<std::string, std::vector<bool>> raw;
+
+    raw_scopes(const constructor_layouts& layouts) : layouts(layouts) {}
+
+    void bind(const std::string& name, bool is_raw) {
+        raw[name].emplace_back(is_raw);
+    }
+
+    void unbind(const std::string& name) {
+        raw[name].pop_back();
+    }
+
+    bool is_raw(const std::string& name) {
+        auto it = raw.find(name);
+        return it != raw.end() && it->second.size() && it->second.back();
+    }
+
+    const std::vector<ast::field_kind>* layout_of(const ast::constructor& con,
+                                                  std::size_t fields) {
+        auto it = layouts.find(con.name);
+        if (it == layouts.end()) {
+            return nullptr;
+        }
+        if (it->second.size() != fields) {
+            std::stringstream ss;
+            ss << "constructor " << con.name << " at " << con.loc << " has "
+               << fields << " fields but is declared with " << it->second.size();
+            throw bad_declaration(ss.str());
+        }
+        return &it->second;
+    }
+
+    /**
+       @return Whether the case is on a literal other than an `Integer`, a
+               primitive operation which returns a raw value, or a variable
+               which holds one, so its binding alternative holds a raw
+               value.
+    */
+    bool raw_scrutinee(const ast::case_& case_) {
+        auto prim = std::dynamic_pointer_cast<ast::prim_apply>(case_.scrutinee);
+        auto lit = std::dynamic_pointer_cast<ast::lit_expr>(case_.scrutinee);
+        auto app = std::dynamic_pointer_cast<ast::apply>(case_.scrutinee);
+        bool raw_value =
+            (prim && !prim->op->returns_closure()) ||
+            (lit && !std::holds_alternative<ast::integer_digits>(lit->lit->value)) ||
+            (app && app->args->elems.empty() && is_raw(app->var->name));
+        for (const auto& alt : *case_.alts) {
+            if (std::dynamic_pointer_cast<ast::prim_alt>(alt)) {
+                raw_value = true;
+            }
+        }
+        return raw_value;
+    }
+
+    /**
+       Bind the variables of a case alternative.
+
+       @param alt       The alternative.
+       @param raw_value The result of `raw_scrutinee` for the case.
+       @return          The names bound, to unbind afterwards.
+    */
+    std::vector<std::string> bind_alternative(const ast::alternative& alt,
+                                              bool raw_value) {
+        std::vector<std::string> bound;
+        if (auto b = dynamic_cast<const ast::binding_alt*>(&alt)) {
+            bound.emplace_back(b->var->name);
+            bind(b->var->name, raw_value);
+        }
+        else if (auto a = dynamic_cast<const ast::algebraic_alt*>(&alt)) {
+            const auto* layout = layout_of(*a->con, a->vars->elems.size());
+            for (std::size_t n = 0; n < a->vars->elems.size(); ++n) {
+                bound.emplace_back(a->vars->elems[n]->name);
+                bind(bound.back(),
+                     layout && (*layout)[n] != ast::field_kind::boxed);
+            }
+        }
+        return bound;
+    }
+};
+
+struct strict_field_walker : public raw_scopes {
+    std::unordered_map<ast::field_kind, std::string> boxes;
+    std::unordered_set<std::string>& taken;
+
+    strict_field_walker(const constructor_layouts& layouts,
+                        std::unordered_set<std::string>& taken)
+        : raw_scopes(layouts), boxes(find_boxes(layouts)), taken(taken) {}
+
+    void walk(ast::lambda& lam) {
+        for (const auto& arg : lam.args->elems) {
+            bind(arg->name, false);
+        }
+        walk(lam.body);
+        for (const auto& arg : lam.args->elems) {
+            unbind(arg->name);
+        }
+    }
+
+    void walk_construct(std::shared_ptr<ast::expr>& expr,
+                        const std::shared_ptr<ast::construct>& con) {
+        const auto* layout = layout_of(*con->con, con->args->elems.size());
+        if (!layout) {
+            return;
+        }
+
+        struct unboxing {
+            std::string boxed;
+            std::string box;
+            std::string raw;
+        };
+        std::vector<unboxing> unboxings;
+        std::vector<std::shared_ptr<ast::atom>> args = con->args->elems;
+        for (std::size_t n = 0; n < args.size(); ++n) {
+            ast::field_kind kind = (*layout)[n];
+            auto var = std::dynamic_pointer_cast<ast::variable>(args[n]);
+            if (kind == ast::field_kind::boxed || !var || is_raw(var->name)) {
+                continue;
+            }
+
+            auto box = boxes.find(kind);
+            if (box == boxes.end()) {
+                std::stringstream ss;
+                ss << "boxed value " << var->name << " at " << var->loc
+                   << " is stored in a strict field of " << con->con->name
+                   << " but no box is declared for its type";
+                throw bad_declaration(ss.str());
+            }
+
+            auto same = std::find_if(unboxings.begin(),
+                                     unboxings.end(),
+                                     [&](const auto& u) {
+                                         return u.boxed == var->name;
+                                     });
+            if (same == unboxings.end()) {
+                unboxings.push_back({var->name,
+                                     box->second,
+                                     fresh_name(var->name, taken)});
+                same = unboxings.end() - 1;
+            }
+            args[n] = std::make_shared<ast::variable>(var->loc, same->raw);
+        }
+        if (unboxings.empty()) {
+            return;
+        }
+
+        std::shared_ptr<ast::expr> result = std::make_shared<ast::construct>(
+            con->loc,
+            con->con,
+            std::make_shared<ast::sequence<ast::atom>>(con->args->loc, args));
+        for (auto it = unboxings.rbegin(); it != unboxings.rend(); ++it) {
+            result = unbox(con->loc, it->boxed, it->box, it->raw, result);
+        }
+        expr = result;
+    }
+
+    void walk(std::shared_ptr<ast::expr>& expr) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            bool recursive = static_cast<bool>(
+                std::dynamic_pointer_cast<ast::local_recursion>(expr));
+            if (recursive) {
+                for (const auto& binding : *let->bindings) {
+                    bind(binding->lhs->name, false);
+                }
+            }
+            for (const auto& binding : *let->bindings) {
+                walk(*binding->rhs);
+            }
+            if (!recursive) {
+                for (const auto& binding : *let->bindings) {
+                    bind(binding->lhs->name, false);
+                }
+            }
+            walk(let->body);
+            for (const auto& binding : *let->bindings) {
+                unbind(binding->lhs->name);
+            }
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            walk(case_->scrutinee);
+            bool raw_value = raw_scrutinee(*case_);
+            for (const auto& alt : *case_->alts) {
+                auto bound = bind_alternative(*alt, raw_value);
+                walk(alt->body);
+                for (const auto& name : bound) {
+                    unbind(name);
+                }
+            }
+        }
+        else if (auto con = std::dynamic_pointer_cast<ast::construct>(expr)) {
+            walk_construct(expr, con);
+        }
+    }
+};
+
+/**
+   An argument a worker takes raw.
+*/
+struct strict_argument {
+    std::size_t index;
+    std::string box;
+    std::string raw;
+};
+
+struct worker {
+    std::string name;
+    std::size_t arity;
+    std::vector<strict_argument> strict;
+};
+
+/**
+   Replaces saturated calls of split functions with calls of their workers.
+*/
+struct call_site_walker {
+    const std::unordered_map<std::string, worker>& workers;
+    std::unordered_set<std::string>& taken;
+    compiler::scope scope;
+
+    call_site_walker(const std::unordered_map<std::string, worker>& workers,
+                     std::unordered_set<std::string>& taken)
+        : workers(workers), taken(taken) {}
+
+    void walk(ast::lambda& lam) {
+        scope.walk_lambda(lam, [&] { walk(lam.body); });
+    }
+
+    void walk_apply(std::shared_ptr<ast::expr>& expr,
+                    const std::shared_ptr<ast::apply>& app) {
+        auto it = workers.find(app->var->name);
+        if (it == workers.end() ||
+            scope.shadows(app->var->name) ||
+            app->args->elems.size() != it->second.arity) {
+            return;
+        }
+        const worker& w = it->second;
+
+        std::vector<std::shared_ptr<ast::atom>> args = app->args->elems;
+        std::vector<std::pair<std::string, std::string>> unboxed;
+        for (const auto& strict : w.strict) {
+            auto var = std::dynamic_pointer_cast<ast::variable>(args[strict.index]);
+            if (!var) {
+                return;
+            }
+            std::string raw = fresh_name(var->name, taken);
+            unboxed.emplace_back(var->name, raw);
+            args[strict.index] = std::make_shared<ast::variable>(var->loc, raw);
+        }
+
+        std::shared_ptr<ast::expr> result = std::make_shared<ast::apply>(
+            app->loc,
+            std::make_shared<ast::variable>(app->var->loc, w.name),
+            std::make_shared<ast::sequence<ast::atom>>(app->args->loc, args));
+        // evaluate the arguments in the same order as the wrapper
+        for (std::size_t n = w.strict.size(); n--;) {
+            result = unbox(app->loc,
+                           unboxed[n].first,
+                           w.strict[n].box,
+                           unboxed[n].second,
+                           result);
+        }
+        expr = result;
+    }
+
+    void walk(std::shared_ptr<ast::expr>& expr) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            scope.walk_let(*let,
+                           [&](ast::binding& binding) { walk(*binding.rhs); },
+                           [&] { walk(let->body); });
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            walk(case_->scrutinee);
+            for (const auto& alt : *case_->alts) {
+                scope.walk_alt(*alt, [&] { walk(alt->body); });
+            }
+        }
+        else if (auto app = std::dynamic_pointer_cast<ast::apply>(expr)) {
+            walk_apply(expr, app);
+        }
+    }
+};
+
+/**
+   Split a function into a worker and a wrapper if its body starts by
+   unboxing some of its arguments.
+
+   @return The worker's binding, or `nullptr`.
+*/
+std::shared_ptr<ast::binding> split(ast::binding& binding,
+                                    const constructor_layouts& layouts,
+                                    std::unordered_set<std::string>& taken,
+                                    std::unordered_map<std::string, worker>& workers) {
+    ast::lambda& lam = *binding.rhs;
+    std::vector<std::string> params;
+    for (const auto& arg : lam.args->elems) {
+        params.emplace_back(arg->name);
+    }
+    if (params.empty()) {
+        return nullptr;
+    }
+
+    std::vector<strict_argument> strict;
+    std::unordered_set<std::string> bound(params.begin(), params.end());
+    std::shared_ptr<ast::expr>* body = &lam.body;
+    while (true) {
+        auto case_ = std::dynamic_pointer_cast<ast::case_>(*body);
+        if (!case_ || case_->alts->elems.size() != 1) {
+            break;
+        }
+        auto app = std::dynamic_pointer_cast<ast::apply>(case_->scrutinee);
+        if (!app || app->args->elems.size()) {
+            break;
+        }
+        auto param = std::find(params.begin(), params.end(), app->var->name);
+        auto alt = std::dynamic_pointer_cast<ast::algebraic_alt>(case_->alts->elems[0]);
+        if (param == params.end() ||
+            !alt ||
+            !is_box(layouts, alt->con->name) ||
+            alt->vars->elems.size() != 1 ||
+            bound.count(alt->vars->elems[0]->name)) {
+            break;
+        }
+        std::size_t index = param - params.begin();
+        if (std::any_of(strict.begin(), strict.end(), [&](const auto& s) {
+                    return s.index == index;
+                })) {
+            break;
+        }
+
+        const std::string& raw = alt->vars->elems[0]->name;
+        strict.push_back({index, alt->con->name, raw});
+        bound.insert(raw);
+        body = &alt->body;
+    }
+    if (strict.empty()) {
+        return nullptr;
+    }
+
+    std::vector<std::string> worker_params = params;
+    for (const auto& s : strict) {
+        worker_params[s.index] = s.raw;
+    }
+
+    // rebox the arguments the worker still uses boxed
+    std::shared_ptr<ast::expr> worker_body = *body;
+    const location& loc = binding.loc;
+    for (const auto& s : strict) {
+        const std::string& boxed = params[s.index];
+        if (expr_references(worker_body, {boxed}).empty()) {
+            continue;
+        }
+        auto box = std::make_shared<ast::construct>(
+            loc,
+            std::make_shared<ast::constructor>(loc, s.box),
+            std::make_shared<ast::sequence<ast::atom>>(
+                loc,
+                std::vector<std::shared_ptr<ast::atom>>{
+                    std::make_shared<ast::variable>(loc, s.raw)}));
+        auto rebox = std::make_shared<ast::lambda>(loc,
+                                                   variable_sequence(loc, {s.raw}),
+                                                   false,
+                                                   variable_sequence(loc, {}),
+                                                   box);
+        worker_body = std::make_shared<ast::local_definition>(
+            loc,
+            std::make_shared<ast::sequence<ast::binding>>(
+                loc,
+                std::vector<std::shared_ptr<ast::binding>>{
+                    std::make_shared<ast::binding>(
+                        loc,
+                        std::make_shared<ast::variable>(loc, boxed),
+                        rebox)}),
+            worker_body);
+    }
+
+    std::string name = fresh_name(binding.lhs->name + "_worker", taken);
+    std::vector<std::shared_ptr<ast::atom>> call_args;
+    for (const auto& param : worker_params) {
+        call_args.emplace_back(std::make_shared<ast::variable>(loc, param));
+    }
+    *body = std::make_shared<ast::apply>(
+        loc,
+        std::make_shared<ast::variable>(loc, name),
+        std::make_shared<ast::sequence<ast::atom>>(loc, call_args));
+
+    workers[binding.lhs->name] = {name, params.size(), strict};
+    return std::make_shared<ast::binding>(
+        loc,
+        std::make_shared<ast::variable>(loc, name),
+        std::make_shared<ast::lambda>(lam.loc,
+                                      variable_sequence(loc, {}),
+                                      false,
+                                      variable_sequence(loc, worker_params),
+                                      worker_body));
+}
+
+/**
+   Moves the free variables which hold raw values to the end of each
+   lambda's list.
+*/
+struct closure_field_walker : public raw_scopes {
+    const raw_parameters& workers;
+    pointer_fields& fields;
+
+    closure_field_walker(const constructor_layouts& layouts,
+                         const raw_parameters& workers,
+                         pointer_fields& fields)
+        : raw_scopes(layouts), workers(workers), fields(fields) {}
+
+    void walk(ast::lambda& lam,
+              const std::vector<ast::field_kind>* raw_args = nullptr) {
+        auto& freevars = lam.freevars->elems;
+        auto raw_begin = std::stable_partition(freevars.begin(),
+                                               freevars.end(),
+                                               [&](const auto& var) {
+                                                   return !is_raw(var->name);
+                                               });
+        fields[&lam] = raw_begin - freevars.begin();
+
+        for (std::size_t n = 0; n < lam.args->elems.size(); ++n) {
+            bind(lam.args->elems[n]->name,
+                 raw_args && (*raw_args)[n] != ast::field_kind::boxed);
+        }
+        walk(lam.body);
+        for (const auto& arg : lam.args->elems) {
+            unbind(arg->name);
+        }
+    }
+
+    void walk(const std::shared_ptr<ast::expr>& expr) {
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            bool recursive = static_cast<bool>(
+                std::dynamic_pointer_cast<ast::local_recursion>(expr));
+            if (recursive) {
+                for (const auto& binding : *let->bindings) {
+                    bind(binding->lhs->name, false);
+                }
+            }
+            for (const auto& binding : *let->bindings) {
+                walk(*binding->rhs);
+            }
+            if (!recursive) {
+                for (const auto& binding : *let->bindings) {
+                    bind(binding->lhs->name, false);
+                }
+            }
+            walk(let->body);
+            for (const auto& binding : *let->bindings) {
+                unbind(binding->lhs->name);
+            }
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            walk(case_->scrutinee);
+            bool raw_value = raw_scrutinee(*case_);
+            for (const auto& alt : *case_->alts) {
+                auto bound = bind_alternative(*alt, raw_value);
+                walk(alt->body);
+                for (const auto& name : bound) {
+                    unbind(name);
+                }
+            }
+        }
+    }
+};
+}
+
+constructor_layouts
+declared_layouts(const ast::sequence<ast::data_declaration>& declarations) {
+    constructor_layouts layouts;
+    for (const auto& decl : declarations.elems) {
+        std::vector<ast::field_kind> fields;
+        for (const auto& field : decl->fields->elems) {
+            fields.emplace_back(field->kind);
+        }
+        if (!layouts.emplace(decl->con->name, std::move(fields)).second) {
+            std::stringstream ss;
+            ss << "constructor " << decl->con->name << " at " << decl->loc
+               << " is already declared";
+            throw bad_declaration(ss.str());
+        }
+    }
+    return layouts;
+}
+
+void unbox_strict_fields(ast::sequence<ast::binding>& bindings,
+                         const constructor_layouts& layouts,
+                         const std::unordered_set<std::string>& externs) {
+    std::unordered_set<std::string> taken = bound_names(bindings);
+    taken.insert(externs.begin(), externs.end());
+    strict_field_walker walker(layouts, taken);
+    for (const auto& binding : bindings) {
+        walker.walk(*binding->rhs);
+    }
+    compute_freevars(bindings, freevar_mode::overwrite, externs);
+}
+
+raw_parameters split_workers(ast::sequence<ast::binding>& bindings,
+                             const constructor_layouts& layouts,
+                             const std::unordered_set<std::string>& externs) {
+    std::unordered_set<std::string> taken = bound_names(bindings);
+    taken.insert(externs.begin(), externs.end());
+    std::unordered_map<std::string, worker> workers;
+    std::vector<std::shared_ptr<ast::binding>> added;
+    for (const auto& binding : bindings) {
+        if (auto w = split(*binding, layouts, taken, workers)) {
+            added.emplace_back(w);
+        }
+    }
+    if (added.empty()) {
+        return {};
+    }
+    bindings.elems.insert(bindings.elems.end(), added.begin(), added.end());
+
+    call_site_walker walker(workers, taken);
+    for (const auto& binding : bindings) {
+        walker.walk(*binding->rhs);
+    }
+    compute_freevars(bindings, freevar_mode::overwrite, externs);
+
+    raw_parameters raw;
+    for (const auto& [name, w] : workers) {
+        std::vector<ast::field_kind>& params = raw[w.name];
+        params.resize(w.arity, ast::field_kind::boxed);
+        for (const auto& strict : w.strict) {
+            params[strict.index] = layouts.at(strict.box)[0];
+        }
+    }
+    return raw;
+}
+
+std::vector<std::size_t> field_slots(const std::vector<ast::field_kind>& fields) {
+    std::vector<std::size_t> slots(fields.size());
+    std::size_t next = 0;
+    for (std::size_t n = 0; n < fields.size(); ++n) {
+        if (fields[n] == ast::field_kind::boxed) {
+            slots[n] = next++;
+        }
+    }
+    for (std::size_t n = 0; n < fields.size(); ++n) {
+        if (fields[n] != ast::field_kind::boxed) {
+            slots[n] = next++;
+        }
+    }
+    return slots;
+}
+
+pointer_fields order_closure_fields(ast::sequence<ast::binding>& bindings,
+                                    const constructor_layouts& layouts,
+                                    const raw_parameters& workers) {
+    pointer_fields fields;
+    closure_field_walker walker(layouts, workers, fields);
+    for (const auto& binding : bindings) {
+        auto it = workers.find(binding->lhs->name);
+        walker.walk(*binding->rhs,
+                    it == workers.end() ? nullptr : &it->second);
+    }
+    return fields;
+}
+}
+}
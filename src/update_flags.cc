@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "gg/references.h"
+#include "gg/update_flags.h"
+
+namespace gg {
+namespace compiler {
+namespace {
+/**
+   How many times each name may be entered, saturating at `many`.
+*/
+using usage = std::unordered_map<std::string, int>;
+
+constexpr int many = 2;
+
+void add_usage(usage& into, const usage& from) {
+    for (const auto& [name, count] : from) {
+        int& c = into[name];
+        c = std::min(many, c + count);
+    }
+}
+
+void max_usage(usage& into, const usage& from) {
+    for (const auto& [name, count] : from) {
+        int& c = into[name];
+        c = std::max(c, count);
+    }
+}
+
+/**
+   Counts the entries of a set of let bound names in their scope.
+*/
+struct usage_walker {
+    const std::unordered_set<std::string>& names;
+    compiler::scope scope;
+
+    usage_walker(const std::unordered_set<std::string>& names) : names(names) {}
+
+    void use(usage& u, const std::string& name, int count) {
+        if (names.count(name) && !scope.shadows(name)) {
+            int& c = u[name];
+            c = std::min(many, c + count);
+        }
+    }
+
+    void escape_atoms(usage& u, const ast::sequence<ast::atom>& atoms) {
+        for (const auto& atom : atoms.elems) {
+            if (auto var = std::dynamic_pointer_cast<ast::variable>(atom)) {
+                use(u, var->name, many);
+            }
+        }
+    }
+
+    usage walk(const ast::lambda& lam) {
+        usage u;
+        scope.walk_lambda(lam, [&] { u = walk(lam.body); });
+
+        // the body of an updatable thunk runs at most once; anything else
+        // may run any number of times
+        if (!(lam.update && is_thunk(lam))) {
+            for (auto& entry : u) {
+                if (entry.second) {
+                    entry.second = many;
+                }
+            }
+        }
+        return u;
+    }
+
+    usage walk(const std::shared_ptr<ast::expr>& expr) {
+        usage u;
+        if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+            scope.walk_let(*let,
+                           [&](const ast::binding& binding) {
+                               add_usage(u, walk(*binding.rhs));
+                           },
+                           [&] { add_usage(u, walk(let->body)); });
+        }
+        else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+            u = walk(case_->scrutinee);
+            usage alts;
+            for (const auto& alt : *case_->alts) {
+                // only one alternative runs
+                scope.walk_alt(*alt, [&] { max_usage(alts, walk(alt->body)); });
+            }
+            add_usage(u, alts);
+        }
+        else if (auto con = std::dynamic_pointer_cast<ast::construct>(expr)) {
+            escape_atoms(u, *con->args);
+        }
+        else if (auto app = std::dynamic_pointer_cast<ast::apply>(expr)) {
+            use(u, app->var->name, 1);
+            escape_atoms(u, *app->args);
+        }
+        else if (auto prim = std::dynamic_pointer_cast<ast::prim_apply>(expr)) {
+            escape_atoms(u, *prim->args);
+        }
+        return u;
+    }
+};
+
+/**
+   Is a thunk's body already a value?
+*/
+bool is_value_thunk(const ast::lambda& lam) {
+    return is_thunk(lam) &&
+        static_cast<bool>(std::dynamic_pointer_cast<ast::construct>(lam.body));
+}
+
+void infer_expr(const std::shared_ptr<ast::expr>& expr);
+
+void infer_lambda(ast::lambda& lam) {
+    if (lam.update && is_value_thunk(lam)) {
+        lam.update = false;
+    }
+    infer_expr(lam.body);
+}
+
+void infer_expr(const std::shared_ptr<ast::expr>& expr) {
+    if (auto let = std::dynamic_pointer_cast<ast::local_bindings>(expr)) {
+        std::unordered_set<std::string> candidates;
+        for (const auto& binding : *let->bindings) {
+            const ast::lambda& lam = *binding->rhs;
+            if (lam.update && is_thunk(lam)) {
+                candidates.insert(binding->lhs->name);
+            }
+        }
+
+        if (candidates.size()) {
+            usage_walker walker(candidates);
+            usage u = walker.walk(let->body);
+            if (std::dynamic_pointer_cast<ast::local_recursion>(expr)) {
+                // the group's closures are in scope in each other too
+                for (const auto& binding : *let->bindings) {
+                    add_usage(u, walker.walk(*binding->rhs));
+                }
+            }
+            for (const auto& binding : *let->bindings) {
+                if (candidates.count(binding->lhs->name) &&
+                    u[binding->lhs->name] < many) {
+                    binding->rhs->update = false;
+                }
+            }
+        }
+
+        for (const auto& binding : *let->bindings) {
+            infer_lambda(*binding->rhs);
+        }
+        infer_expr(let->body);
+    }
+    else if (auto case_ = std::dynamic_pointer_cast<ast::case_>(expr)) {
+        infer_expr(case_->scrutinee);
+        for (const auto& alt : *case_->alts) {
+            infer_expr(alt->body);
+        }
+    }
+}
+}
+
+void infer_update_flags(ast::sequence<ast::binding>& bindings) {
+    for (const auto& binding : bindings) {
+        infer_lambda(*binding->rhs);
+    }
+}
+}
+}
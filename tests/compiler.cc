@@ -0,0 +1,407 @@
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gg/compiler.h"
+#include "gg/heap.h"
+#include "gg/integer.h"
+#include "gg/parse.h"
+#include "gg/scheduler.h"
+#include "gg/thunk.h"
+
+using namespace gg::runtime;
+
+namespace {
+config single_capability() {
+    config options;
+    options.capabilities = 1;
+    options.gc_threads = 1;
+    return options;
+}
+
+/**
+   A program compiled by a session, with a scheduler to run it on.
+*/
+struct compiled {
+    gg::compiler::session session;
+    scheduler sched;
+
+    /**
+       @param batches The batches to compile in turn. The last alternative
+                      of a case ends the line, so a binding whose body is a
+                      case has to be the last of its batch.
+    */
+    compiled(const std::vector<std::string>& batches,
+             const config& options = single_capability())
+        : sched(options) {
+        for (const auto& source : batches) {
+            std::istringstream in(source);
+            session.add(gg::ast::parse(in));
+        }
+    }
+
+    /**
+       @return The value of a top level binding.
+    */
+    closure* run(const std::string& name = "main") {
+        return sched.run(session.lookup(name));
+    }
+
+    /**
+       @return The constructor of a value, or an empty string.
+    */
+    std::string constructor(const closure* c) const {
+        auto description = session.describe(c->info);
+        return description ? description->name : "";
+    }
+
+    closure* field(const closure* c, std::size_t n) const {
+        return reinterpret_cast<closure*>(c->payload[n]);
+    }
+};
+
+/**
+   Batches defining `repeat {four, one}`, a list of 2^16 cells, and
+   `count`, which counts a list in `S`s with a recursion which is not a tail
+   call, so the stack grows and the collector runs with frames on it.
+
+   @param batches Batches to compile after them.
+*/
+std::vector<std::string> with_lists(const std::vector<std::string>& batches) {
+    std::vector<std::string> out = {R"(
+nil = {} \n {} -> Nil {}
+zero = {} \n {} -> Z {}
+one = {} \n {} -> Cons {zero, nil}
+four = {} \u {} -> let n1 = {} \n {} -> S {zero} in let n2 = {n1} \n {} -> S {n1} in let n3 = {n2} \n {} -> S {n2} in S {n3}
+append = {} \n {xs, ys} -> case xs {} of
+  Nil {} -> ys {}
+  Cons {x, rest} -> let tail = {rest, ys} \u {} -> append {rest, ys} in Cons {x, tail}
+)", R"(
+twice = {} \n {xs} -> append {xs, xs}
+sixteenfold = {} \n {xs} -> let a1 = {xs} \u {} -> twice {xs} in let a2 = {a1} \u {} -> twice {a1} in let a3 = {a2} \u {} -> twice {a2} in twice {a3}
+repeat = {} \n {n, xs} -> case n {} of
+  Z {} -> xs {}
+  S {m} -> let next = {xs} \u {} -> sixteenfold {xs} in repeat {m, next}
+)", R"(
+succ = {} \n {f, xs} -> case f {xs} of
+  n -> S {n}
+)", R"(
+count = {} \n {xs} -> case xs {} of
+  Nil {} -> Z {}
+  Cons {x, rest} -> succ {count, rest}
+)"};
+    out.insert(out.end(), batches.begin(), batches.end());
+    return out;
+}
+}
+
+TEST(compiler, constructor_fields) {
+    compiled program({R"(
+data Pair {!int, !double, x}
+data I {!int}
+a = {} \n {} -> A {}
+three = {} \n {} -> I {3#}
+main = {} \u {} -> case three {} of
+  I {n} -> Pair {n, 1.5##, a}
+)"});
+    closure* value = program.run();
+    ASSERT_EQ(program.constructor(value), "Pair");
+    // the boxed field comes first in the payload
+    EXPECT_EQ(program.constructor(program.field(value, 0)), "A");
+    EXPECT_EQ(static_cast<std::int64_t>(value->payload[1]), 3);
+    double d;
+    std::memcpy(&d, &value->payload[2], sizeof(d));
+    EXPECT_EQ(d, 1.5);
+}
+
+TEST(compiler, static_constructor_fields) {
+    // constructors applied to literals are built at compile time, and are
+    // checked against their declarations all the same
+    EXPECT_THROW(compiled({R"(
+data I {!int}
+bad = {} \n {} -> I {1.5##}
+)"}),
+                 gg::compiler::bad_compile);
+}
+
+TEST(compiler, calls) {
+    compiled program({R"(
+a = {} \n {} -> A {}
+b = {} \n {} -> B {}
+konst = {} \n {x, y} -> x {}
+flip = {} \n {f, x, y} -> f {y, x}
+id = {} \n {x} -> x {}
+saturated = {} \u {} -> flip {konst, a, b}
+partial = {} \u {} -> let k = {} \u {} -> konst {a} in k {b}
+over = {} \u {} -> id {konst, b, a}
+)"});
+    EXPECT_EQ(program.constructor(program.run("saturated")), "B");
+    EXPECT_EQ(program.constructor(program.run("partial")), "A");
+    EXPECT_EQ(program.constructor(program.run("over")), "B");
+}
+
+TEST(compiler, alternatives) {
+    compiled program({R"(
+data I {!int}
+a = {} \n {} -> A {}
+b = {} \n {} -> B {}
+two = {} \n {} -> I {2#}
+ints = {} \u {} -> case 2# of
+  1# -> a {}
+  2# -> b {}
+  default -> a {}
+)", R"(
+doubles = {} \u {} -> case 0.5## of
+  0.5## -> a {}
+  y -> b {}
+)", R"(
+binding = {} \u {} -> case two {} of
+  A {} -> a {}
+  v -> v {}
+)"});
+    EXPECT_EQ(program.constructor(program.run("ints")), "B");
+    EXPECT_EQ(program.constructor(program.run("doubles")), "A");
+    EXPECT_EQ(program.constructor(program.run("binding")), "I");
+}
+
+TEST(compiler, shared_constructs) {
+    // the constructors of the second batch were declared by the first
+    compiled program({R"(
+data I {!int}
+a = {} \n {} -> A {}
+none = {} \n {x} -> Nil {}
+seven = {} \n {x} -> I {7#}
+big = {} \n {x} -> I {1000#}
+nil1 = {} \u {} -> none {a}
+int1 = {} \u {} -> seven {a}
+big1 = {} \u {} -> big {a}
+)", R"(
+nil2 = {} \n {x} -> Nil {}
+int2 = {} \n {x} -> I {7#}
+main = {} \u {} -> nil2 {a}
+ints = {} \u {} -> int2 {a}
+)"});
+    closure* nil = program.run("nil1");
+    ASSERT_EQ(program.constructor(nil), "Nil");
+    EXPECT_EQ(nil, nil->info->shared);
+    EXPECT_EQ(program.run(), nil);
+
+    closure* seven = program.run("int1");
+    ASSERT_EQ(program.constructor(seven), "I");
+    EXPECT_EQ(static_cast<std::int64_t>(seven->payload[0]), 7);
+    EXPECT_EQ(seven, shared_closure(seven, seven->info));
+    EXPECT_EQ(program.run("ints"), seven);
+
+    // outside of the shared range
+    closure* big = program.run("big1");
+    EXPECT_EQ(static_cast<std::int64_t>(big->payload[0]), 1000);
+    EXPECT_EQ(shared_closure(big, big->info), nullptr);
+}
+
+TEST(compiler, primops) {
+    compiled program({R"(
+data I {!int}
+data D {!double}
+a = {} \n {} -> A {}
+b = {} \n {} -> B {}
+total = {} \u {} -> case +# {3#, 4#} of
+  n -> I {n}
+)", R"(
+product = {} \u {} -> case *## {1.5##, 2.0##} of
+  d -> D {d}
+)", R"(
+less = {} \u {} -> case <# {1#, 2#} of
+  1# -> a {}
+  default -> b {}
+)", R"(
+big = {} \u {} -> plusInteger# {2I#, 3I#}
+built = {} \u {} -> timesInteger# {1000I#, 3000I#}
+negated = {} \u {} -> negateInteger# {300I#}
+overflow = {} \u {} -> case plusInteger# {9223372036854775807I#, 1I#} of
+  n -> minusInteger# {n, 2I#}
+)"});
+    closure* value = program.run("total");
+    ASSERT_EQ(program.constructor(value), "I");
+    EXPECT_EQ(static_cast<std::int64_t>(value->payload[0]), 7);
+
+    value = program.run("product");
+    ASSERT_EQ(program.constructor(value), "D");
+    double d;
+    std::memcpy(&d, &value->payload[0], sizeof(d));
+    EXPECT_EQ(d, 3.0);
+
+    EXPECT_EQ(program.constructor(program.run("less")), "A");
+
+    value = program.run("big");
+    ASSERT_EQ(value->info, &gg_small_integer_info);
+    EXPECT_EQ(static_cast<std::int64_t>(value->payload[0]), 5);
+
+    // small results outside the shared range are built inline, and results
+    // which overflow go to the runtime
+    EXPECT_EQ(integer_to_string(program.run("built")), "3000000");
+    EXPECT_EQ(integer_to_string(program.run("negated")), "-300");
+    EXPECT_EQ(integer_to_string(program.run("overflow")), "9223372036854775806");
+}
+
+TEST(compiler, mvars) {
+    // the main thread blocks on the mvar until the forked thread fills it
+    // with a thunk, which is evaluated once it is taken
+    compiled program({R"(
+a = {} \n {} -> A {}
+fill = {} \n {m} -> let v = {} \u {} -> a {} in case putMVar# {m, v} of
+  r -> v {}
+)", R"(
+wait = {} \n {m} -> let p = {m} \u {} -> fill {m} in case fork# {p} of
+  t -> takeMVar# {m}
+)", R"(
+main = {} \u {} -> case newMVar# {} of
+  m -> wait {m}
+)"});
+    EXPECT_EQ(program.constructor(program.run()), "A");
+}
+
+TEST(compiler, selector_thunks) {
+    compiled program({R"(
+a = {} \n {} -> A {}
+b = {} \n {} -> B {}
+pair = {} \n {} -> P {a, b}
+second = {} \n {p} -> let s = {p} \u {} -> case p {} of
+  P {x, y} -> y {}
+in Box {s}
+)", R"(
+boxed = {} \u {} -> second {pair}
+unboxed = {} \u {} -> case boxed {} of
+  Box {s} -> s {}
+)"});
+    closure* box = program.run("boxed");
+    ASSERT_EQ(program.constructor(box), "Box");
+    EXPECT_EQ(program.field(box, 0)->info, &gg_selector_info[1]);
+    EXPECT_EQ(program.constructor(program.run("unboxed")), "B");
+}
+
+TEST(compiler, match_failure) {
+    compiled program({R"(
+a = {} \n {} -> A {}
+main = {} \u {} -> case a {} of
+  B {} -> a {}
+)"});
+    EXPECT_THROW(program.run(), thread_killed);
+}
+
+TEST(compiler, frame_closures) {
+    compiled program({R"(
+a = {} \n {} -> A {}
+b = {} \n {} -> B {}
+call = {} \n {f, x} -> f {x}
+main = {} \u {} -> pair {b}
+pair = {} \n {v} -> let g = {v} \n {y} -> P {y, v} in case call {g, a} of
+  r -> r {}
+)"});
+    closure* value = program.run();
+    ASSERT_EQ(program.constructor(value), "P");
+    EXPECT_EQ(program.constructor(program.field(value, 0)), "A");
+    EXPECT_EQ(program.constructor(program.field(value, 1)), "B");
+}
+
+TEST(compiler, large_allocations) {
+    // a block which allocates more than a nursery block holds is split
+    // across several heap checks, and a closure bigger than a block is a
+    // large object
+    constexpr std::size_t width = 32;
+    constexpr std::size_t links = max_block_object_words / width + 1;
+    std::string params = "x0";
+    for (std::size_t n = 1; n < width; ++n) {
+        params += ", x" + std::to_string(n);
+    }
+    std::string chain = "chain = {} \\n {" + params + "} -> let c0 = {x0} \\n {} -> x0 {} in ";
+    for (std::size_t n = 1; n < links; ++n) {
+        std::string prev = "c" + std::to_string(n - 1);
+        std::string fields = prev + ", " + params;
+        chain += "let c" + std::to_string(n) + " = {" + fields + "} \\n {} -> T {" +
+                 fields + "} in ";
+    }
+    chain += "L {c" + std::to_string(links - 1) + "}\n";
+    std::string args = "a";
+    for (std::size_t n = 1; n < width; ++n) {
+        args += ", a";
+    }
+
+    constexpr std::size_t fields = max_block_object_words + 1;
+    std::string wide = "wide = {} \\n {x} -> W {x";
+    for (std::size_t n = 1; n < fields; ++n) {
+        wide += ", x";
+    }
+    wide += "}\n";
+
+    compiled program({"a = {} \\n {} -> A {}\n" + chain + wide +
+                      "linked = {} \\u {} -> chain {" + args + "}\n"
+                      "big = {} \\u {} -> wide {a}\n"});
+    closure* value = program.run("linked");
+    ASSERT_EQ(program.constructor(value), "L");
+    closure* c = program.field(value, 0);
+    for (std::size_t n = 0; n < links; ++n) {
+        c = program.field(c, 0);
+    }
+    EXPECT_EQ(program.constructor(c), "A");
+
+    value = program.run("big");
+    ASSERT_EQ(program.constructor(value), "W");
+    EXPECT_EQ(program.constructor(program.field(value, fields - 1)), "A");
+}
+
+TEST(compiler, deep_recursion) {
+    compiled program(with_lists({R"(
+main = {} \u {} -> let cells = {} \u {} -> repeat {four, one} in count {cells}
+)"}));
+    closure* value = program.run();
+    std::size_t count = 0;
+    while (program.constructor(value) == "S") {
+        value = program.field(value, 0);
+        ++count;
+    }
+    EXPECT_EQ(program.constructor(value), "Z");
+    EXPECT_EQ(count, 1u << 16);
+    EXPECT_GT(program.sched.statistics().minor_collections, 0u);
+}
+
+TEST(compiler, cafs) {
+    // every collection is a major one
+    config options = single_capability();
+    options.old_gen_min_words = 0;
+    compiled program(with_lists({R"(
+a = {} \n {} -> A {}
+pair = {} \n {x} -> P {x, x}
+kept = {} \u {} -> pair {a}
+dropped = {} \u {} -> pair {a}
+churn = {} \n {p} -> let cells = {} \u {} -> repeat {four, one} in case count {cells} of
+  n -> kept {}
+)", R"(
+main = {} \u {} -> case kept {} of
+  p -> churn {p}
+)"}),
+                     options);
+
+    // evaluated once
+    closure* dropped = program.run("dropped");
+    ASSERT_EQ(program.constructor(dropped), "P");
+    EXPECT_EQ(program.session.lookup("dropped")->info, &indirection_info);
+    EXPECT_EQ(program.run("dropped"), dropped);
+
+    // `kept` is evaluated before the collections and used after them, and
+    // `dropped` is not used
+    closure* kept = program.run();
+    EXPECT_GT(program.sched.statistics().major_collections, 0u);
+    ASSERT_EQ(program.constructor(kept), "P");
+    EXPECT_EQ(program.constructor(program.field(kept, 0)), "A");
+    closure* kept_caf = program.session.lookup("kept");
+    ASSERT_EQ(kept_caf->info, &indirection_info);
+    EXPECT_EQ(program.field(kept_caf, thunk_result_slot), kept);
+    EXPECT_NE(program.session.lookup("dropped")->info, &indirection_info);
+
+    // a reverted CAF is evaluated again
+    EXPECT_EQ(program.constructor(program.run("dropped")), "P");
+}
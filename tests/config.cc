@@ -0,0 +1,99 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gg/config.h"
+#include "gg/runtime.h"
+
+using namespace gg::runtime;
+
+TEST(parse_bytes, suffixes) {
+    EXPECT_EQ(parse_bytes("512"), 512u);
+    EXPECT_EQ(parse_bytes("2048K"), 2048u << 10);
+    EXPECT_EQ(parse_bytes("2048k"), 2048u << 10);
+    EXPECT_EQ(parse_bytes("8M"), 8u << 20);
+    EXPECT_EQ(parse_bytes("8m"), 8u << 20);
+    EXPECT_EQ(parse_bytes("3G"), std::uint64_t(3) << 30);
+    EXPECT_EQ(parse_bytes("0"), 0u);
+}
+
+TEST(parse_bytes, rejects) {
+    for (const char* text : {"", "K", "-1", "8X", "8MB", "8 M", "1.5M", "M8"}) {
+        EXPECT_EQ(parse_bytes(text), 0u) << text;
+    }
+}
+
+TEST(parse_bytes, digit_limit) {
+    EXPECT_EQ(parse_bytes("999999999"), 999999999u);
+    EXPECT_EQ(parse_bytes("999999999G"), std::uint64_t(999999999) << 30);
+    EXPECT_EQ(parse_bytes("1000000000"), 0u);
+    EXPECT_EQ(parse_bytes("0000000001"), 0u);
+    EXPECT_EQ(parse_bytes("123456789012345678901234567890"), 0u);
+}
+
+TEST(parse_rts_options, keeps_other_arguments) {
+    config options;
+    auto rest = parse_rts_options({"a", "--rts-stats", "-b", "--rts", "c"}, options);
+    EXPECT_EQ(rest, std::vector<std::string>({"a", "-b", "--rts", "c"}));
+    EXPECT_EQ(options.stats_output, stats_format::text);
+}
+
+TEST(parse_rts_options, stats) {
+    config options;
+    parse_rts_options({"--rts-stats=json", "--rts-stats-interval=250"}, options);
+    EXPECT_EQ(options.stats_output, stats_format::json);
+    EXPECT_EQ(options.stats_interval, std::chrono::milliseconds(250));
+
+    for (const char* arg : {"--rts-stats-interval=",
+                            "--rts-stats-interval=-5",
+                            "--rts-stats-interval=1s",
+                            "--rts-stats-interval=1234567890123",
+                            "--rts-stats=yaml"}) {
+        EXPECT_THROW(parse_rts_options({arg}, options), bad_rts_option) << arg;
+    }
+}
+
+TEST(parse_rts_options, nursery) {
+    config options;
+    parse_rts_options({"--rts-nursery=8M"}, options);
+    EXPECT_EQ(options.nursery_words, (8u << 20) / sizeof(word));
+    parse_rts_options({"--rts-nursery=8"}, options);
+    EXPECT_EQ(options.nursery_words, 1u);
+
+    for (const char* arg : {"--rts-nursery=",
+                            "--rts-nursery=7",
+                            "--rts-nursery=0K",
+                            "--rts-nursery=8MB",
+                            "--rts-nursery=1000000000",
+                            "--rts-nursery=99999999999999999999M"}) {
+        EXPECT_THROW(parse_rts_options({arg}, options), bad_rts_option) << arg;
+    }
+}
+
+TEST(parse_rts_options, gc_target) {
+    config options;
+    parse_rts_options({"--rts-gc-target=5"}, options);
+    EXPECT_DOUBLE_EQ(options.gc_time_target, 0.05);
+    parse_rts_options({"--rts-gc-target=99.5"}, options);
+    EXPECT_DOUBLE_EQ(options.gc_time_target, 0.995);
+    parse_rts_options({"--rts-gc-target=0.01"}, options);
+    EXPECT_DOUBLE_EQ(options.gc_time_target, 0.0001);
+
+    for (const char* arg : {"--rts-gc-target=",
+                            "--rts-gc-target=0",
+                            "--rts-gc-target=100",
+                            "--rts-gc-target=-5",
+                            "--rts-gc-target=5%",
+                            "--rts-gc-target=nan",
+                            "--rts-gc-target=inf",
+                            "--rts-gc-target=five"}) {
+        EXPECT_THROW(parse_rts_options({arg}, options), bad_rts_option) << arg;
+    }
+}
+
+TEST(parse_rts_options, unknown) {
+    config options;
+    EXPECT_THROW(parse_rts_options({"--rts-nurseries=8M"}, options), bad_rts_option);
+    EXPECT_THROW(parse_rts_options({"--rts-"}, options), bad_rts_option);
+}
@@ -0,0 +1,227 @@
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gg/integer.h"
+#include "gg/scheduler.h"
+
+using namespace gg::runtime;
+
+namespace {
+const std::function<void()>* running_body = nullptr;
+
+void body_entry() {
+    (*running_body)();
+    registers& regs = current_capability->regs;
+    regs.node = reinterpret_cast<closure*>(&gg_small_integers[0]);
+    regs.next = reinterpret_cast<const info_table*>(regs.sp[0])->entry_code;
+}
+
+const info_table body_info = {body_entry, 0, nullptr, nullptr, 0, nullptr};
+
+/**
+   Run a test on a green thread, where the `Integer` primops can allocate.
+*/
+void on_runtime(const std::function<void()>& body) {
+    config options;
+    options.capabilities = 1;
+    options.gc_threads = 1;
+    scheduler sched(options);
+    struct {
+        const info_table* info;
+    } root{&body_info};
+    running_body = &body;
+    sched.run(reinterpret_cast<closure*>(&root));
+    running_body = nullptr;
+}
+
+/**
+   An `Integer` outside of the heap with the value of some digits, built
+   the way the compiler builds a static literal.
+*/
+struct static_integer {
+    std::vector<word> words;
+
+    static_integer(const std::string& digits) {
+        integer_value value = parse_integer(digits);
+        if (auto small = as_small_integer(value)) {
+            words = {reinterpret_cast<word>(&gg_small_integer_info),
+                     static_cast<word>(*small)};
+            return;
+        }
+        std::int64_t size = value.limbs.size();
+        words = {reinterpret_cast<word>(&gg_big_integer_info),
+                 static_cast<word>(value.negative ? -size : size)};
+        words.insert(words.end(), value.limbs.begin(), value.limbs.end());
+    }
+
+    closure* get() {
+        return reinterpret_cast<closure*>(words.data());
+    }
+};
+
+closure* from_int(std::int64_t i) {
+    return gg_integer_from_int(i);
+}
+
+const std::string two_64 = "18446744073709551616";
+const std::string two_128 = "340282366920938463463374607431768211456";
+}
+
+TEST(integer, parse_splits_limbs) {
+    integer_value max_limb = parse_integer("18446744073709551615");
+    EXPECT_FALSE(max_limb.negative);
+    EXPECT_EQ(max_limb.limbs, std::vector<std::uint64_t>({UINT64_MAX}));
+
+    integer_value carry = parse_integer(two_64);
+    EXPECT_EQ(carry.limbs, std::vector<std::uint64_t>({0, 1}));
+
+    integer_value negative = parse_integer("-" + two_128);
+    EXPECT_TRUE(negative.negative);
+    EXPECT_EQ(negative.limbs, std::vector<std::uint64_t>({0, 0, 1}));
+}
+
+TEST(integer, parse_zero) {
+    for (const char* digits : {"0", "-0", "0000", "-000"}) {
+        integer_value zero = parse_integer(digits);
+        EXPECT_FALSE(zero.negative) << digits;
+        EXPECT_TRUE(zero.limbs.empty()) << digits;
+        EXPECT_EQ(as_small_integer(zero), 0) << digits;
+    }
+}
+
+TEST(integer, parse_rejects_non_digits) {
+    for (const char* digits : {"", "-", "12a", "+1", "1-2", "--1", " 1"}) {
+        EXPECT_THROW(parse_integer(digits), bad_integer) << digits;
+    }
+}
+
+TEST(integer, small_bounds) {
+    EXPECT_EQ(as_small_integer(parse_integer("9223372036854775807")), INT64_MAX);
+    EXPECT_EQ(as_small_integer(parse_integer("-9223372036854775808")), INT64_MIN);
+    EXPECT_FALSE(as_small_integer(parse_integer("9223372036854775808")));
+    EXPECT_FALSE(as_small_integer(parse_integer("-9223372036854775809")));
+    EXPECT_FALSE(as_small_integer(parse_integer(two_64)));
+}
+
+TEST(integer, digits_round_trip) {
+    for (const std::string& digits : {std::string("0"),
+                                      std::string("-1"),
+                                      std::string("255"),
+                                      std::string("9223372036854775807"),
+                                      std::string("-9223372036854775808"),
+                                      std::string("9223372036854775808"),
+                                      std::string("10000000000000000000"),
+                                      std::string("-99999999999999999999"),
+                                      two_64,
+                                      "-" + two_128,
+                                      std::string("123456789012345678901234567890123456789")}) {
+        static_integer i(digits);
+        EXPECT_EQ(integer_to_string(i.get()), digits);
+    }
+    EXPECT_EQ(integer_to_string(static_integer("-000123").get()), "-123");
+}
+
+TEST(integer, add_carries_across_limbs) {
+    on_runtime([] {
+        static_integer max_limb("18446744073709551615");
+        EXPECT_EQ(integer_to_string(gg_integer_add(max_limb.get(), from_int(1))), two_64);
+
+        static_integer below("340282366920938463463374607431768211455");
+        EXPECT_EQ(integer_to_string(gg_integer_add(below.get(), from_int(1))), two_128);
+
+        closure* over = gg_integer_add(from_int(INT64_MAX), from_int(1));
+        EXPECT_EQ(over->info, &gg_big_integer_info);
+        EXPECT_EQ(integer_to_string(over), "9223372036854775808");
+    });
+}
+
+TEST(integer, sub_borrows_across_limbs) {
+    on_runtime([] {
+        static_integer big(two_128);
+        EXPECT_EQ(integer_to_string(gg_integer_sub(big.get(), from_int(1))),
+                  "340282366920938463463374607431768211455");
+
+        static_integer carry(two_64);
+        closure* max_limb = gg_integer_sub(carry.get(), from_int(1));
+        EXPECT_EQ(integer_to_string(max_limb), "18446744073709551615");
+
+        // results which fit are small again
+        closure* back = gg_integer_sub(gg_integer_add(from_int(INT64_MAX), from_int(1)),
+                                       from_int(1));
+        EXPECT_EQ(back->info, &gg_small_integer_info);
+        EXPECT_EQ(gg_integer_to_int(back), INT64_MAX);
+
+        closure* under = gg_integer_sub(from_int(INT64_MIN), from_int(1));
+        EXPECT_EQ(integer_to_string(under), "-9223372036854775809");
+    });
+}
+
+TEST(integer, signs) {
+    on_runtime([] {
+        static_integer big(two_64);
+        static_integer negative_big("-" + two_64);
+
+        EXPECT_EQ(integer_to_string(gg_integer_add(negative_big.get(), from_int(1))),
+                  "-18446744073709551615");
+        EXPECT_EQ(integer_to_string(gg_integer_sub(from_int(1), big.get())),
+                  "-18446744073709551615");
+        EXPECT_EQ(integer_to_string(gg_integer_mul(negative_big.get(), from_int(-1))),
+                  two_64);
+        EXPECT_EQ(integer_to_string(gg_integer_mul(negative_big.get(), big.get())),
+                  "-" + two_128);
+        EXPECT_EQ(integer_to_string(gg_integer_negate(from_int(INT64_MIN))),
+                  "9223372036854775808");
+        EXPECT_EQ(gg_integer_negate(gg_integer_negate(from_int(INT64_MIN)))->info,
+                  &gg_small_integer_info);
+    });
+}
+
+TEST(integer, zero) {
+    on_runtime([] {
+        static_integer big(two_128);
+        static_integer negative_big("-" + two_128);
+
+        closure* sum = gg_integer_add(big.get(), negative_big.get());
+        EXPECT_EQ(sum->info, &gg_small_integer_info);
+        EXPECT_EQ(integer_to_string(sum), "0");
+        EXPECT_EQ(integer_to_string(gg_integer_mul(negative_big.get(), from_int(0))), "0");
+        EXPECT_EQ(integer_to_string(gg_integer_negate(from_int(0))), "0");
+        EXPECT_EQ(gg_integer_compare(gg_integer_sub(big.get(), big.get()), from_int(0)), 0);
+    });
+}
+
+TEST(integer, mul_carries_across_limbs) {
+    on_runtime([] {
+        static_integer max_limb("18446744073709551615");
+        EXPECT_EQ(integer_to_string(gg_integer_mul(max_limb.get(), max_limb.get())),
+                  "340282366920938463426481119284349108225");
+
+        closure* factorial = from_int(1);
+        for (std::int64_t n = 1; n <= 30; ++n) {
+            factorial = gg_integer_mul(factorial, from_int(n));
+        }
+        EXPECT_EQ(integer_to_string(factorial), "265252859812191058636308480000000");
+    });
+}
+
+TEST(integer, compare) {
+    on_runtime([] {
+        static_integer big(two_64);
+        static_integer bigger(two_128);
+        static_integer negative_big("-" + two_64);
+        static_integer negative_bigger("-" + two_128);
+
+        EXPECT_EQ(gg_integer_compare(from_int(-1), from_int(1)), -1);
+        EXPECT_EQ(gg_integer_compare(from_int(7), from_int(7)), 0);
+        EXPECT_EQ(gg_integer_compare(big.get(), from_int(INT64_MAX)), 1);
+        EXPECT_EQ(gg_integer_compare(from_int(INT64_MIN), negative_big.get()), 1);
+        EXPECT_EQ(gg_integer_compare(big.get(), bigger.get()), -1);
+        EXPECT_EQ(gg_integer_compare(negative_big.get(), negative_bigger.get()), 1);
+        EXPECT_EQ(gg_integer_compare(negative_big.get(), big.get()), -1);
+        EXPECT_EQ(gg_integer_compare(big.get(), static_integer(two_64).get()), 0);
+    });
+}
@@ -0,0 +1,100 @@
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gg/library.h"
+
+using namespace gg::runtime;
+
+namespace {
+config single_capability() {
+    config options;
+    options.capabilities = 1;
+    options.gc_threads = 1;
+    return options;
+}
+
+const char* const boxes = R"(
+data I {!int}
+data W {!int}
+data D {!double}
+a = {} \n {} -> A {}
+pair = {} \n {x, y} -> P {x, y}
+wrap = {} \n {x} -> case x {} of
+  I {n} -> W {n}
+)";
+}
+
+TEST(library, boxes_arguments) {
+    auto program = gg::program::from_buffer(boxes, single_capability());
+    auto result = program->call("pair", {std::int64_t(3), 2.5});
+    ASSERT_EQ(result.results.size(), 1u);
+    const auto& value = result.results[0];
+    ASSERT_EQ(value.constructor(), "P");
+    // the first box by name
+    EXPECT_EQ(value.field(0).constructor(), "I");
+    EXPECT_EQ(value.field(0).as_int(), 3);
+    EXPECT_EQ(value.field(1).constructor(), "D");
+    EXPECT_EQ(value.field(1).as_double(), 2.5);
+}
+
+TEST(library, takes_apart_arguments) {
+    auto program = gg::program::from_buffer(boxes, single_capability());
+    auto result = program->call_batch("wrap", {{std::int64_t(1)}, {std::int64_t(2)}});
+    ASSERT_EQ(result.results.size(), 2u);
+    EXPECT_EQ(result.results[0].constructor(), "W");
+    EXPECT_EQ(result.results[0].as_int(), 1);
+    EXPECT_EQ(result.results[1].as_int(), 2);
+}
+
+TEST(library, evaluates_bindings) {
+    auto program = gg::program::from_buffer(boxes, single_capability());
+    std::istringstream batch(R"(
+lazy = {} \u {} -> pair {a, a}
+)");
+    program->add(batch);
+    {
+        auto result = program->call("lazy");
+        ASSERT_TRUE(result.results[0].is_constructor());
+        EXPECT_EQ(result.results[0].constructor(), "P");
+    }
+    EXPECT_EQ(program->call("a").results[0].constructor(), "A");
+}
+
+TEST(library, bad_calls) {
+    auto program = gg::program::from_buffer(R"(
+data I {!int}
+wrap = {} \n {x} -> case x {} of
+  I {n} -> I {n}
+)",
+                                            single_capability());
+    EXPECT_THROW(program->call("missing"), gg::bad_call);
+    EXPECT_THROW(program->call("wrap"), gg::bad_call);
+    // no box for doubles
+    EXPECT_THROW(program->call("wrap", {1.5}), gg::bad_call);
+    EXPECT_EQ(program->call("wrap", {std::int64_t(4)}).results[0].as_int(), 4);
+}
+
+TEST(library, reuses_large_object_space) {
+    // each array is a large object of a different size, dropped before the
+    // next; they only fit in the heap if the space of the dead ones is
+    // reused. Every collection is a major one, so that the arrays which
+    // outlived a call are freed too.
+    config options = single_capability();
+    options.nursery_words = 1 << 14;
+    options.old_gen_min_words = 0;
+    options.max_heap_bytes = 8 << 20;
+    auto program = gg::program::from_buffer(R"(
+data I {!int}
+a = {} \n {} -> A {}
+array = {} \n {s} -> case s {} of
+  I {size} -> newArray# {size, a}
+)",
+                                            options);
+    for (std::int64_t n = 0; n < 1000; ++n) {
+        std::int64_t size = 3000 + n * 997 % 20000;
+        EXPECT_EQ(program->call("array", {size}).results.size(), 1u);
+    }
+}